@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace mutables_ui {
+
+// Bump allocator over one memory block, for module state built in Init and
+// dropped all at once when the module is switched out. Allocate() is O(1)
+// and there is no per-object free: objects with non-trivial destructors
+// are destroyed by their owner before Reset().
+//
+// Allocation only works while the arena is open (the module's Init). A
+// closed arena returns nullptr and counts the attempt, so memory is never
+// taken on the audio path.
+class Arena {
+public:
+    Arena() : base_(nullptr), size_(0), used_(0), peak_(0), failed_(0), open_(true) {}
+
+    void Init(void* memory, size_t size) {
+        base_ = static_cast<uint8_t*>(memory);
+        size_ = size;
+        used_ = 0;
+        peak_ = 0;
+        failed_ = 0;
+    }
+
+    // Returns nullptr when the arena is full or closed. alignment is a
+    // power of two.
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(base_) + used_;
+        size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+        if (!open_ || used_ + padding + size > size_) {
+            failed_++;
+            return nullptr;
+        }
+        used_ += padding;
+        void* result = base_ + used_;
+        used_ += size;
+        if (used_ > peak_) peak_ = used_;
+        return result;
+    }
+
+    template <typename T, typename... Args>
+    T* New(Args&&... args) {
+        void* memory = Allocate(sizeof(T), alignof(T));
+        return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    // Whether Allocate() would succeed, without counting a failure
+    bool Fits(size_t size, size_t alignment = alignof(std::max_align_t)) const {
+        uintptr_t address = reinterpret_cast<uintptr_t>(base_) + used_;
+        size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+        return open_ && used_ + padding + size <= size_;
+    }
+
+    void Reset() { used_ = 0; }
+
+    void Open() { open_ = true; }
+    void Close() { open_ = false; }
+
+    // Scratch space: Release(mark) frees everything allocated after Mark()
+    size_t Mark() const { return used_; }
+    void Release(size_t mark) {
+        if (mark < used_) used_ = mark;
+    }
+
+    size_t GetUsed() const { return used_; }
+    size_t GetPeak() const { return peak_; }
+    size_t GetSize() const { return size_; }
+    uint32_t GetFailedCount() const { return failed_; }
+    bool IsOpen() const { return open_; }
+
+private:
+    uint8_t* base_;
+    size_t size_;
+    size_t used_;
+    size_t peak_;
+    uint32_t failed_;
+    bool open_;
+};
+
+// Daisy memory regions, fastest first:
+// - Dtcm: 128KB tightly coupled RAM, no cache, not reachable by DMA
+// - Sram: AXI/D2 SRAM, cached
+// - Sdram: 64MB external, cached, for delay lines and sample buffers
+enum class MemoryRegion {
+    Dtcm,
+    Sram,
+    Sdram,
+    Count
+};
+
+// One arena per region. The module switcher resets and opens them all
+// before building the chain's modules and closes them after their Init.
+class MemoryRegions {
+public:
+    static constexpr int kCount = static_cast<int>(MemoryRegion::Count);
+
+    void Init(MemoryRegion region, void* memory, size_t size) {
+        Get(region).Init(memory, size);
+    }
+
+    Arena& Get(MemoryRegion region) { return arenas_[static_cast<int>(region)]; }
+    const Arena& Get(MemoryRegion region) const { return arenas_[static_cast<int>(region)]; }
+
+    void* Allocate(MemoryRegion region, size_t size, size_t alignment = alignof(std::max_align_t)) {
+        return Get(region).Allocate(size, alignment);
+    }
+
+    template <typename T, typename... Args>
+    T* New(MemoryRegion region, Args&&... args) {
+        return Get(region).template New<T>(std::forward<Args>(args)...);
+    }
+
+    // From region, or the next slower one with room when it is full, so
+    // modules sharing a chain spill out of DTCM instead of failing. Only a
+    // miss in every region from region on counts as a failure.
+    void* AllocatePreferred(MemoryRegion region, size_t size, size_t alignment = alignof(std::max_align_t)) {
+        for (int r = static_cast<int>(region); r < kCount - 1; r++) {
+            if (arenas_[r].Fits(size, alignment)) return arenas_[r].Allocate(size, alignment);
+        }
+        return arenas_[kCount - 1].Allocate(size, alignment);
+    }
+
+    template <typename T, typename... Args>
+    T* NewPreferred(MemoryRegion region, Args&&... args) {
+        void* memory = AllocatePreferred(region, sizeof(T), alignof(T));
+        return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    void Reset() {
+        for (Arena& arena : arenas_) arena.Reset();
+    }
+
+    void Open() {
+        for (Arena& arena : arenas_) arena.Open();
+    }
+
+    void Close() {
+        for (Arena& arena : arenas_) arena.Close();
+    }
+
+    uint32_t GetFailedCount() const {
+        uint32_t count = 0;
+        for (const Arena& arena : arenas_) count += arena.GetFailedCount();
+        return count;
+    }
+
+    static const char* GetName(MemoryRegion region) {
+        static const char* const names[kCount] = {"dtcm", "sram", "sdram"};
+        return names[static_cast<int>(region)];
+    }
+
+private:
+    Arena arenas_[kCount];
+};
+
+// Init-time scratch: everything allocated from the region while the scope
+// lives is released when it ends
+class ArenaScope {
+public:
+    ArenaScope(MemoryRegions& regions, MemoryRegion region)
+        : arena_(regions.Get(region)), mark_(arena_.Mark()) {}
+    ~ArenaScope() { arena_.Release(mark_); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena& arena_;
+    size_t mark_;
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Lock-free single-producer ring used to hand audio from the audio callback
+// to the main loop (spectrum page, meters, ...).
+// The audio side never waits: it overwrites the oldest samples. The reader
+// copies the most recent samples and detects if the writer lapped it during
+// the copy, in which case the read is simply retried later.
+template <size_t kCapacity>
+class AudioTap {
+public:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of 2");
+
+    AudioTap() : write_index_(0) {
+        for (size_t i = 0; i < kCapacity; i++) {
+            buffer_[i] = 0.0f;
+        }
+    }
+
+    // Audio callback side
+    void Write(const float* in, size_t size) {
+        uint32_t index = write_index_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < size; i++) {
+            buffer_[(index + i) & kMask] = in[i];
+        }
+        write_index_.store(index + size, std::memory_order_release);
+    }
+
+    // Main loop side
+    // Copies the latest `size` samples (oldest first) into `out`.
+    // Returns false if fewer samples were written so far or if the writer
+    // overwrote part of the window while copying.
+    bool ReadLatest(float* out, size_t size) const {
+        if (size > kCapacity) return false;
+
+        uint32_t end = write_index_.load(std::memory_order_acquire);
+        if (end < size) return false;
+
+        uint32_t start = end - size;
+        for (size_t i = 0; i < size; i++) {
+            out[i] = buffer_[(start + i) & kMask];
+        }
+
+        // Torn if the writer advanced far enough to reuse the window start
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t now = write_index_.load(std::memory_order_relaxed);
+        return (now - start) <= kCapacity;
+    }
+
+    // Total number of samples written (wraps at 2^32)
+    uint32_t GetWriteCount() const {
+        return write_index_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr uint32_t kMask = kCapacity - 1;
+
+    float buffer_[kCapacity];
+    std::atomic<uint32_t> write_index_;
+};
+
+} // namespace mutables_ui
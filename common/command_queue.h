@@ -0,0 +1,111 @@
+#pragma once
+
+#include "preset_format.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Parameter changes requested by the main loop (MIDI, UI, storage) and
+// applied by the audio callback at the start of the next block, so the DSP
+// never sees a half-applied change.
+struct ParamCommand {
+    enum class Type : uint8_t {
+        SetValue,       // Module's params[index].value = value
+        LoadPreset,     // Apply *preset, a PresetPool entry
+        SetMorph        // Preset morph on (value 1) or off (value 0)
+    };
+
+    Type type;
+    uint8_t module;     // Module chain slot (SetValue)
+    uint16_t index;
+    float value;
+    const PresetRecord* preset;
+
+    static ParamCommand SetValue(uint16_t index, float value, uint8_t module = 0) {
+        return ParamCommand{Type::SetValue, module, index, value, nullptr};
+    }
+
+    static ParamCommand LoadPreset(const PresetRecord* preset) {
+        return ParamCommand{Type::LoadPreset, 0, 0, 0.0f, preset};
+    }
+
+    static ParamCommand SetMorph(bool enabled) {
+        return ParamCommand{Type::SetMorph, 0, 0, enabled ? 1.0f : 0.0f, nullptr};
+    }
+};
+
+// Copies of preset records for LoadPreset commands. The main loop fills a
+// free entry and queues a pointer to it; the entry stays reserved until the
+// audio callback has applied it and released it. Storage the main loop
+// rewrites (SysEx input, SD reads, flash slots) is never queued directly.
+template <size_t kCount>
+class PresetPool {
+public:
+    PresetPool() {
+        for (size_t i = 0; i < kCount; i++) busy_[i].store(false, std::memory_order_relaxed);
+    }
+
+    // Main loop: a copy of record, reserved; nullptr if every entry is
+    // still waiting to be applied
+    const PresetRecord* Copy(const PresetRecord& record) {
+        for (size_t i = 0; i < kCount; i++) {
+            if (!busy_[i].load(std::memory_order_acquire)) {
+                records_[i] = record;
+                busy_[i].store(true, std::memory_order_relaxed);
+                return &records_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Audio callback once applied (or main loop if the queue refused it)
+    void Release(const PresetRecord* record) {
+        size_t i = static_cast<size_t>(record - records_);
+        if (i < kCount) busy_[i].store(false, std::memory_order_release);
+    }
+
+private:
+    PresetRecord records_[kCount];
+    std::atomic<bool> busy_[kCount];
+};
+
+// Wait-free single-producer single-consumer queue
+template <typename T, size_t kCapacity>
+class SpscQueue {
+public:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "Capacity must be a power of 2");
+
+    SpscQueue() : head_(0), tail_(0) {}
+
+    // Producer side, false when full
+    bool Push(const T& item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= kCapacity) return false;
+        items_[head & (kCapacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, false when empty
+    bool Pop(T& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        item = items_[tail & (kCapacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    T items_[kCapacity];
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> tail_;
+};
+
+} // namespace mutables_ui
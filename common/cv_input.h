@@ -9,27 +9,6 @@ class CVInput {
 public:
     CVInput() : filtered_value_(0.0f) {}
     
-    // Process CV input with attenuverter simulation
-    // knob_value: current knob position (0.0 to 1.0)
-    // cv_value: CV input value (0.0 to 1.0, hardware already normalized)
-    // Returns: final parameter value with CV applied
-    static float ProcessWithMapping(const Parameter& param, 
-                                   float knob_value, 
-                                   float cv_value) {
-        if (param.cv_mapping.cv_input < 0 || !param.cv_mapping.active) {
-            return knob_value;
-        }
-        
-        // CV contribution scaled by attenuverter
-        float cv_contribution = (cv_value - 0.5f) * 2.0f * param.cv_mapping.attenuverter;
-        
-        // Apply relative to origin offset
-        float result = param.cv_mapping.origin_offset + cv_contribution;
-        
-        // Clamp to normalized range
-        return std::clamp(result, 0.0f, 1.0f);
-    }
-    
     // Simple one-pole lowpass filter for CV input
     // Helps reduce noise and jitter from CV inputs
     float Filter(float input, float coefficient = 0.02f) {
@@ -91,4 +70,22 @@ private:
     CVInput filters_[4];
 };
 
+// Parameters mapped to a CV input follow its filtered value through the
+// origin and attenuverter, as modulation; the set value itself is left
+// alone. Returns true if any moved past the hysteresis.
+inline bool ApplyCvModulation(Parameter* params, size_t count, const CVInputBank& cv) {
+    bool moved = false;
+    for (size_t i = 0; i < count; i++) {
+        Parameter& param = params[i];
+        if (param.cv_mapping.active && param.cv_mapping.cv_input >= 0) {
+            // 0.1% hysteresis against ADC noise
+            moved |= param.SetModulationWithHysteresis(cv.GetFiltered(param.cv_mapping.cv_input), 0.001f);
+        } else if (param.modulation != 0.0f) {
+            param.modulation = 0.0f;  // Unmapped
+            moved = true;
+        }
+    }
+    return moved;
+}
+
 } // namespace mutables_ui
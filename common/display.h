@@ -1,8 +1,14 @@
 #pragma once
 
 #include "daisy_patch.h"
+#include "module_registry.h"
 #include "parameter.h"
+#include "preset_bank.h"
+#include "preset_manager.h"
+#include "spectrum_analyzer.h"
 #include "ui_state.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 
@@ -35,22 +41,43 @@ public:
     }
     
     // Render main parameter menu
-    void RenderMenu(const MenuState& menu, Parameter* params) {
+    // live_values: effective values from the audio side (may be null),
+    // drawn as a bar under the base value when they differ
+    void RenderMenu(const MenuState& menu, Parameter* params, const float* live_values = nullptr) {
         if (!hw_) return;
         
         hw_->display.Fill(false);
         
         int line = 0;
         for (int i = 0; i < MenuState::VISIBLE_PARAMS && 
-                    (menu.scroll_offset + i) < menu.param_count; i++) {
+                    (menu.scroll_offset + i) < menu.RowCount(); i++) {
             int param_idx = menu.scroll_offset + i;
+            if (!menu.IsParamRow(param_idx)) {
+                char label[16];
+                if (menu.IsUndoRow(param_idx)) {
+                    snprintf(label, sizeof(label), "Undo %d", menu.undo_count);
+                } else if (menu.IsRedoRow(param_idx)) {
+                    snprintf(label, sizeof(label), "Redo %d", menu.redo_count);
+                } else if (menu.IsModuleRow(param_idx)) {
+                    snprintf(label, sizeof(label), "Module");
+                } else if (menu.IsSlotRow(param_idx)) {
+                    snprintf(label, sizeof(label), "Slot");
+                } else {
+                    snprintf(label, sizeof(label), "%s", menu.IsSaveRow(param_idx) ? "Save" : "Load");
+                }
+                RenderActionRow(label, line, param_idx == menu.selected_param);
+                line += 14;
+                continue;
+            }
             RenderParameter(params[param_idx], 
                           line, 
                           param_idx == menu.selected_param,
-                          menu.state == UIState::EditValue && param_idx == menu.selected_param);
+                          menu.state == UIState::EditValue && param_idx == menu.selected_param,
+                          live_values ? &live_values[param_idx] : nullptr);
             line += 14;  // 10px font + 4px padding for descenders
         }
         
+        RenderPageMarker(menu);
         hw_->display.Update();
     }
     
@@ -88,10 +115,206 @@ public:
         hw_->display.Update();
     }
     
+    // Render preset name entry: name with the current character inverted
+    void RenderNameEntry(const MenuState& menu) {
+        if (!hw_) return;
+        
+        hw_->display.Fill(false);
+        
+        hw_->display.SetCursor(0, 1);
+        hw_->display.WriteString("SAVE AS", Font_7x10, true);
+        
+        char c[2] = {0, 0};
+        for (int i = 0; menu.preset_name[i]; i++) {
+            bool cursor = i == menu.name_cursor;
+            int x = i * 8;
+            if (cursor) {
+                hw_->display.DrawRect(x, 20, x + 7, 31, true, true);
+            }
+            c[0] = menu.preset_name[i];
+            hw_->display.SetCursor(x, 21);
+            hw_->display.WriteString(c, Font_7x10, !cursor);
+        }
+        
+        hw_->display.SetCursor(0, 40);
+        hw_->display.WriteString("press: next", Font_7x10, true);
+        hw_->display.SetCursor(0, 52);
+        hw_->display.WriteString("hold: save", Font_7x10, true);
+        
+        hw_->display.Update();
+    }
+    
+    // Render preset list, selected entry inverted
+    void RenderPresetList(const MenuState& menu, const PresetManager& presets) {
+        if (!hw_) return;
+        
+        hw_->display.Fill(false);
+        
+        hw_->display.SetCursor(0, 1);
+        hw_->display.WriteString("LOAD", Font_7x10, true);
+        
+        char buffer[32];
+        int count = presets.GetListCount();
+        bool no_card = presets.GetStatus() == PresetManager::Status::NoCard;
+        if (presets.IsIndexing() || no_card) {
+            if (no_card) {
+                snprintf(buffer, sizeof(buffer), "No SD card");
+            } else {
+                snprintf(buffer, sizeof(buffer), "Indexing %d", count);
+            }
+            hw_->display.SetCursor(0, 21);
+            hw_->display.WriteString(buffer, Font_7x10, true);
+        } else if (count == 0) {
+            hw_->display.SetCursor(0, 21);
+            hw_->display.WriteString("No presets", Font_7x10, true);
+        } else {
+            // Three rows, selected entry kept on screen
+            int first = std::clamp(menu.selected_preset - 1, 0, std::max(0, count - 3));
+            for (int i = 0; i < 3 && first + i < count; i++) {
+                int index = first + i;
+                int y = 16 + i * 14;
+                bool selected = index == menu.selected_preset;
+                if (selected) {
+                    hw_->display.DrawRect(0, y, 127, y + 11, true, true);
+                }
+                snprintf(buffer, sizeof(buffer), "%.18s", presets.GetListName(index));
+                hw_->display.SetCursor(2, y + 1);
+                hw_->display.WriteString(buffer, Font_7x10, !selected);
+            }
+        }
+        
+        hw_->display.Update();
+    }
+    
+    // Render the QSPI preset slots with the name stored in each, selected
+    // entry inverted
+    void RenderSlotList(const MenuState& menu, const PresetBank& bank) {
+        if (!hw_) return;
+        
+        hw_->display.Fill(false);
+        
+        hw_->display.SetCursor(0, 1);
+        hw_->display.WriteString("STORE TO SLOT", Font_7x10, true);
+        
+        char buffer[32];
+        int count = bank.GetSlotCount();
+        int first = std::clamp(menu.selected_slot - 1, 0, std::max(0, count - 3));
+        for (int i = 0; i < 3 && first + i < count; i++) {
+            int index = first + i;
+            int y = 16 + i * 14;
+            bool selected = index == menu.selected_slot;
+            if (selected) {
+                hw_->display.DrawRect(0, y, 127, y + 11, true, true);
+            }
+            const PresetRecord* record = bank.Get(index);
+            snprintf(buffer, sizeof(buffer), "%3d %.14s", index, record ? record->name : "-");
+            hw_->display.SetCursor(2, y + 1);
+            hw_->display.WriteString(buffer, Font_7x10, !selected);
+        }
+        
+        hw_->display.Update();
+    }
+    
+    // Render the module list of the current page's slot, selected row
+    // inverted, the slot's module marked
+    void RenderModuleList(const MenuState& menu, const ModuleSwitcher& modules) {
+        if (!hw_) return;
+        
+        hw_->display.Fill(false);
+        
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "MODULE %d/%d", menu.module_page + 1, modules.GetSlotCount());
+        hw_->display.SetCursor(0, 1);
+        hw_->display.WriteString(buffer, Font_7x10, true);
+        
+        int count = menu.ModuleRowCount();
+        int current = modules.GetSlotIndex(menu.module_page);
+        int first = std::clamp(menu.selected_module - 1, 0, std::max(0, count - 3));
+        for (int i = 0; i < 3 && first + i < count; i++) {
+            int row = first + i;
+            int y = 16 + i * 14;
+            bool selected = row == menu.selected_module;
+            if (selected) {
+                hw_->display.DrawRect(0, y, 127, y + 11, true, true);
+            }
+            if (menu.IsRemoveModuleRow(row)) {
+                snprintf(buffer, sizeof(buffer), "- remove");
+            } else {
+                int entry = menu.ModuleRowEntry(row);
+                char mark = menu.IsAddModuleRow(row) ? '+' : (entry == current ? '*' : ' ');
+                snprintf(buffer, sizeof(buffer), "%c %.16s", mark, modules.GetName(entry));
+            }
+            hw_->display.SetCursor(2, y + 1);
+            hw_->display.WriteString(buffer, Font_7x10, !selected);
+        }
+        
+        hw_->display.Update();
+    }
+    
+    // Render save/load progress or result
+    void RenderPresetStatus(const PresetManager& presets) {
+        if (!hw_) return;
+        
+        hw_->display.Fill(false);
+        
+        bool saving = presets.GetOperation() == PresetManager::Operation::Save;
+        hw_->display.SetCursor(0, 1);
+        hw_->display.WriteString(saving ? "SAVING" : "LOADING", Font_7x10, true);
+        
+        const char* message = nullptr;
+        switch (presets.GetStatus()) {
+            case PresetManager::Status::Done:   message = "Done"; break;
+            case PresetManager::Status::Failed: message = saving ? "Save failed" : "Bad preset"; break;
+            case PresetManager::Status::NoCard: message = "No SD card"; break;
+            default: break;
+        }
+        
+        if (message) {
+            hw_->display.SetCursor(0, 26);
+            hw_->display.WriteString(message, Font_7x10, true);
+        } else {
+            int width = (int)(presets.GetProgress() * 124.0f);
+            hw_->display.DrawRect(0, 26, 127, 37, true, false);
+            if (width > 0) {
+                hw_->display.DrawRect(2, 28, 2 + width - 1, 35, true, true);
+            }
+        }
+        
+        hw_->display.Update();
+    }
+    
+    // Render spectrum analyzer page: one 4px bar per band below a title line
+    void RenderSpectrum(const SpectrumAnalyzer& analyzer) {
+        if (!hw_) return;
+        
+        hw_->display.Fill(false);
+        
+        char buffer[32];
+        if (analyzer.IsPaused()) {
+            snprintf(buffer, sizeof(buffer), "SPECTRUM  busy");
+        } else {
+            snprintf(buffer, sizeof(buffer), "SPECTRUM  %4d", (int)analyzer.GetFftSize());
+        }
+        hw_->display.SetCursor(0, 1);
+        hw_->display.WriteString(buffer, Font_7x10, true);
+        
+        const int bottom = 63;
+        const int max_height = 50;
+        for (int b = 0; b < SpectrumAnalyzer::kNumBands; b++) {
+            int height = (int)(analyzer.GetBand(b) * max_height);
+            if (height <= 0) continue;
+            int x = b * 4;
+            hw_->display.DrawRect(x, bottom - height + 1, x + 2, bottom, true, true);
+        }
+        
+        hw_->display.Update();
+    }
+    
 private:
     daisy::DaisyPatch* hw_;
     
-    void RenderParameter(const Parameter& param, int y, bool selected, bool editing) {
+    void RenderParameter(const Parameter& param, int y, bool selected, bool editing,
+                         const float* live_value) {
         char buffer[32];
         
         // Parameter name (truncated)
@@ -135,11 +358,53 @@ private:
             hw_->display.WriteString(cv_num, Font_7x10, false);  // Black text on white
         }
         
+        // Modulated value bar under the value column
+        if (live_value) {
+            RenderModulation(param, *live_value, y + 13);
+        }
+        
         // Submenu indicator
         hw_->display.SetCursor(121, y + 1);
         hw_->display.WriteString(">", Font_7x10, true);
     }
     
+    // One tick per module page down the right edge, the shown one filled
+    void RenderPageMarker(const MenuState& menu) {
+        if (menu.module_count < 2) return;
+        for (int page = 0; page < menu.module_count; page++) {
+            int y = page * 6;
+            hw_->display.DrawRect(125, y, 127, y + 3, true, page == menu.module_page);
+        }
+    }
+    
+    void RenderActionRow(const char* label, int y, bool selected) {
+        hw_->display.SetCursor(0, y + 1);
+        hw_->display.WriteString(label, Font_7x10, true);
+        if (selected) {
+            hw_->display.DrawLine(0, y + 11, (int)strlen(label) * 7 - 1, y + 11, true);
+        }
+        hw_->display.SetCursor(121, y + 1);
+        hw_->display.WriteString(">", Font_7x10, true);
+    }
+    
+    void RenderModulation(const Parameter& param, float live_value, int y) {
+        if (param.type != ParamType::Continuous && param.type != ParamType::Bipolar) return;
+        
+        float range = param.max - param.min;
+        if (range <= 0.0f) return;
+        if (std::abs(live_value - param.value) < range * 0.005f) return;
+        
+        // 1px bar from the left of the value column, 42px = full range
+        float normalized = std::clamp((live_value - param.min) / range, 0.0f, 1.0f);
+        int width = (int)(normalized * 42.0f);
+        if (width > 0) {
+            hw_->display.DrawLine(76, y, 76 + width - 1, y, true);
+        }
+        // Tick at the base value so the modulation direction is visible
+        int base_x = 76 + (int)(param.GetNormalized() * 42.0f);
+        hw_->display.DrawPixel(base_x, y - 1, true);
+    }
+    
     void RenderSubmenuItem(SubmenuItem item, int y, bool selected, bool editing, const Parameter& param) {
         char buffer[32];
         
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace mutables_ui {
+
+// Undo/redo history of parameter edits made from the UI.
+// Each step is a delta (param index, old value, new value) packed into
+// kEntryBytes of a fixed byte budget, used as a ring: when full, the oldest
+// step is dropped. No heap, main loop only.
+//
+// Consecutive edits of the same parameter are folded into one step until
+// Seal() is called (end of an edit), so a full encoder sweep undoes at once.
+template <size_t kBudgetBytes>
+class EditHistory {
+public:
+    static constexpr size_t kEntryBytes = 1 + 2 * sizeof(float);
+    static constexpr size_t kCapacity = kBudgetBytes / kEntryBytes;
+    static_assert(kCapacity >= 2, "Budget too small for an undo history");
+
+    EditHistory() { Clear(); }
+
+    void Clear() {
+        first_ = 0;
+        count_ = 0;
+        position_ = 0;
+        sealed_ = true;
+    }
+
+    // An edit just applied: params[index] went from old_value to new_value
+    void Record(uint8_t index, float old_value, float new_value) {
+        if (old_value == new_value) return;
+
+        // New edits discard the redo steps
+        count_ = position_;
+
+        if (!sealed_ && position_ > 0) {
+            Delta last = Read(position_ - 1);
+            if (last.index == index) {
+                if (last.old_value == new_value) {
+                    // Back where the edit started: nothing left to undo
+                    count_ = --position_;
+                    sealed_ = true;
+                } else {
+                    last.new_value = new_value;
+                    Write(position_ - 1, last);
+                }
+                return;
+            }
+        }
+
+        if (count_ == kCapacity) {
+            first_ = (first_ + 1) % kCapacity;  // Drop the oldest step
+            count_--;
+            position_--;
+        }
+        Write(position_, Delta{index, old_value, new_value});
+        count_ = ++position_;
+        sealed_ = false;
+    }
+
+    // Close the current step, the next edit starts a new one
+    void Seal() { sealed_ = true; }
+
+    size_t GetUndoCount() const { return position_; }
+    size_t GetRedoCount() const { return count_ - position_; }
+
+    // Parameter and value to restore, false when there is nothing to undo
+    bool Undo(uint8_t& index, float& value) {
+        if (position_ == 0) return false;
+        Delta delta = Read(--position_);
+        index = delta.index;
+        value = delta.old_value;
+        sealed_ = true;
+        return true;
+    }
+
+    bool Redo(uint8_t& index, float& value) {
+        if (position_ == count_) return false;
+        Delta delta = Read(position_++);
+        index = delta.index;
+        value = delta.new_value;
+        sealed_ = true;
+        return true;
+    }
+
+private:
+    struct Delta {
+        uint8_t index;
+        float old_value;
+        float new_value;
+    };
+
+    // Step n counted from the oldest one kept
+    uint8_t* Slot(size_t n) {
+        return bytes_ + ((first_ + n) % kCapacity) * kEntryBytes;
+    }
+
+    Delta Read(size_t n) {
+        const uint8_t* slot = Slot(n);
+        Delta delta;
+        delta.index = slot[0];
+        memcpy(&delta.old_value, slot + 1, sizeof(float));
+        memcpy(&delta.new_value, slot + 1 + sizeof(float), sizeof(float));
+        return delta;
+    }
+
+    void Write(size_t n, const Delta& delta) {
+        uint8_t* slot = Slot(n);
+        slot[0] = delta.index;
+        memcpy(slot + 1, &delta.old_value, sizeof(float));
+        memcpy(slot + 1 + sizeof(float), &delta.new_value, sizeof(float));
+    }
+
+    uint8_t bytes_[kCapacity * kEntryBytes];
+    size_t first_;      // Ring slot of the oldest step
+    size_t count_;      // Steps stored, including redo steps
+    size_t position_;   // Steps applied (undo count)
+    bool sealed_;
+};
+
+} // namespace mutables_ui
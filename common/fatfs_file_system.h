@@ -0,0 +1,118 @@
+#pragma once
+
+#include "fatfs.h"
+#include "file_system.h"
+#include <cstring>
+
+namespace mutables_ui {
+
+// FileSystem over FatFS on the Daisy SD card.
+// The SDMMC peripheral and FatFSInterface are initialized by the firmware;
+// this only mounts and issues f_* calls. SDMMC DMA cannot reach DTCM, so the
+// instance must live in AXI SRAM (regular .bss with APP_TYPE = BOOT_QSPI).
+class FatFsFileSystem : public FileSystem {
+public:
+    FatFsFileSystem() : fs_(nullptr), file_open_(false), dir_open_(false) {}
+
+    void Init(FATFS* fs) {
+        fs_ = fs;
+    }
+
+    // Deferred: registers the volume without touching the card. FatFS
+    // initializes the card in the first call that needs it, so a missing
+    // card shows up there as NoCard.
+    Result Mount() override {
+        if (!fs_) return Result::NoCard;
+        FRESULT res = f_mount(fs_, "/", 0);
+        return res == FR_OK ? Result::Ok : Result::NoCard;
+    }
+
+    Result MakeDir(const char* path) override {
+        return Convert(f_mkdir(path));
+    }
+
+    Result Open(const char* path, OpenMode mode) override {
+        if (file_open_) Close();
+        BYTE flags = FA_READ | FA_OPEN_EXISTING;
+        if (mode == OpenMode::Write) flags = FA_WRITE | FA_CREATE_ALWAYS;
+        if (mode == OpenMode::Update) flags = FA_READ | FA_WRITE | FA_OPEN_ALWAYS;
+        FRESULT res = f_open(&file_, path, flags);
+        file_open_ = res == FR_OK;
+        return Convert(res);
+    }
+    
+    Result Seek(size_t offset) override {
+        return Convert(f_lseek(&file_, static_cast<FSIZE_t>(offset)));
+    }
+
+    Result Read(void* data, size_t size, size_t* read) override {
+        UINT count = 0;
+        FRESULT res = f_read(&file_, data, static_cast<UINT>(size), &count);
+        *read = count;
+        return Convert(res);
+    }
+
+    Result Write(const void* data, size_t size) override {
+        UINT count = 0;
+        FRESULT res = f_write(&file_, data, static_cast<UINT>(size), &count);
+        if (res == FR_OK && count != size) return Result::Error;  // Card full
+        return Convert(res);
+    }
+
+    Result Close() override {
+        if (!file_open_) return Result::Ok;
+        file_open_ = false;
+        return Convert(f_close(&file_));
+    }
+
+    Result OpenDir(const char* path) override {
+        if (dir_open_) CloseDir();
+        FRESULT res = f_opendir(&dir_, path);
+        dir_open_ = res == FR_OK;
+        return Convert(res);
+    }
+
+    Result ReadDir(char* name, size_t size, bool* end) override {
+        FILINFO info;
+        while (true) {
+            FRESULT res = f_readdir(&dir_, &info);
+            if (res != FR_OK) return Convert(res);
+            if (info.fname[0] == 0) {
+                *end = true;
+                return Result::Ok;
+            }
+            if (!(info.fattrib & AM_DIR)) break;
+        }
+        *end = false;
+        size_t length = strnlen(info.fname, size - 1);
+        memcpy(name, info.fname, length);
+        name[length] = '\0';
+        return Result::Ok;
+    }
+
+    Result CloseDir() override {
+        if (!dir_open_) return Result::Ok;
+        dir_open_ = false;
+        return Convert(f_closedir(&dir_));
+    }
+
+private:
+    FATFS* fs_;
+    FIL file_;
+    DIR dir_;
+    bool file_open_;
+    bool dir_open_;
+
+    static Result Convert(FRESULT res) {
+        switch (res) {
+            case FR_OK: return Result::Ok;
+            case FR_NO_FILE:
+            case FR_NO_PATH: return Result::NotFound;
+            case FR_EXIST: return Result::Exists;
+            case FR_NOT_READY: return Result::NoCard;
+            default: return Result::Error;
+        }
+    }
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Minimal file access used by the preset code. Each call maps to a single
+// short FatFS operation so a caller can spread work over main-loop
+// iterations. One file and one directory can be open at a time, so
+// implementations need no heap.
+class FileSystem {
+public:
+    enum class Result {
+        Ok,
+        NotFound,
+        Exists,
+        NoCard,
+        Error
+    };
+
+    enum class OpenMode {
+        Read,           // Existing file
+        Write,          // Created or truncated
+        Update          // Read/write in place, created if missing
+    };
+
+    virtual ~FileSystem() = default;
+
+    virtual Result Mount() = 0;                         // Card errors may show up in the next call
+    virtual Result MakeDir(const char* path) = 0;       // Exists if already there
+
+    virtual Result Open(const char* path, OpenMode mode) = 0;
+    virtual Result Seek(size_t offset) = 0;
+    virtual Result Read(void* data, size_t size, size_t* read) = 0;
+    virtual Result Write(const void* data, size_t size) = 0;
+    virtual Result Close() = 0;
+
+    virtual Result OpenDir(const char* path) = 0;
+    // Next regular file name, *end set after the last entry
+    virtual Result ReadDir(char* name, size_t size, bool* end) = 0;
+    virtual Result CloseDir() = 0;
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Memory-mapped flash area. Reads are plain pointer accesses into GetData(),
+// writes go through sector erase and program.
+// Program can only clear bits (1 -> 0); a sector must be erased (all 0xFF)
+// before it is rewritten.
+class FlashRegion {
+public:
+    virtual ~FlashRegion() = default;
+
+    virtual const uint8_t* GetData() const = 0;
+    virtual size_t GetSize() const = 0;
+    virtual size_t GetSectorSize() const = 0;
+
+    // Offsets are relative to the start of the region
+    virtual bool EraseSector(size_t offset) = 0;
+    virtual bool Program(size_t offset, const void* data, size_t size) = 0;
+};
+
+} // namespace mutables_ui
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "daisy_patch.h"
+#include "arena.h"
+#include "module_event.h"
 #include "parameter.h"
-#include <vector>
+#include <cstddef>
+#include <new>
 
 namespace mutables_ui {
 
@@ -19,10 +22,72 @@ public:
     virtual void Init(float sample_rate) = 0;
     virtual void Process(float** in, float** out, size_t size) = 0;
     
+    // Sample-accurate form: the block's events, sorted by time, each
+    // handled before sample `time` is rendered. in and out hold
+    // kModuleChannels pointers. Default: the block is split at the events,
+    // with HandleEvent() and Process(in, out, size) in turn. Override to
+    // handle events inside the DSP loop or to batch them, e.g. parameter
+    // changes once per block. An override that batches may apply an event
+    // early (at the start of the piece it falls in) or move it to a
+    // boundary its DSP needs (PlaitsPort: notes and gates to the nearest
+    // 24-sample block); it documents which, and keeps the order.
+    virtual void Process(const EventList& events, float** in, float** out, size_t size) {
+        if (events.IsEmpty()) {
+            Process(in, out, size);
+            return;
+        }
+        SplitAtEvents(events, in, out, size,
+                      [this](const ModuleEvent& event) { HandleEvent(event); },
+                      [this](float** i, float** o, size_t n) { Process(i, o, n); });
+    }
+    
+    // One event through the separate hooks below
+    virtual void HandleEvent(const ModuleEvent& event) {
+        switch (event.type) {
+            case ModuleEvent::Type::NoteOn:
+                NoteOn(static_cast<uint8_t>(event.index), static_cast<uint8_t>(event.value));
+                break;
+            case ModuleEvent::Type::NoteOff:
+                NoteOff(static_cast<uint8_t>(event.index), static_cast<uint8_t>(event.value));
+                break;
+            case ModuleEvent::Type::Gate:
+                ProcessGate(event.index, event.value > 0.5f);
+                break;
+            case ModuleEvent::Type::SetParameter:
+                ApplyParameterEvent(GetParameters(), GetParameterCount(), event);
+                break;
+        }
+    }
+    
     // Parameter access
     virtual Parameter* GetParameters() = 0;
     virtual size_t GetParameterCount() const = 0;
     
+    // Output channels the module writes, every sample of every block:
+    // out[0] .. out[count - 1]. The others are neither written nor routed.
+    virtual size_t GetOutputCount() const { return 2; }
+    virtual const char* GetOutputName(size_t channel) const {
+        static const char* const names[] = {"out 1", "out 2", "out 3", "out 4"};
+        return channel < 4 ? names[channel] : "";
+    }
+    
+    // Effective values used by the DSP after CV/modulation, in parameter
+    // units and parameter order. Called from the audio callback once per
+    // block. Default: each parameter's value plus its CV modulation.
+    virtual size_t GetEffectiveValues(float* out, size_t max_count) {
+        Parameter* params = GetParameters();
+        size_t count = GetParameterCount();
+        if (count > max_count) count = max_count;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = params[i].GetEffective();
+        }
+        return count;
+    }
+    
+    // Called after parameter values were replaced as a whole (preset
+    // recall, undo) so dependent state can follow without resetting them
+    virtual void OnParametersLoaded() {}
+    
     // Hardware configuration (module-specific)
     virtual void ConfigureIO(daisy::DaisyPatch& hw) {
         // Default: standard stereo audio
@@ -36,8 +101,47 @@ public:
     // CV output handling (optional)
     virtual float GetCVOutput(int cv_index) { return 0.0f; }
     
+    // Notes (optional), from MIDI or the event list
+    virtual void NoteOn(uint8_t note, uint8_t velocity) {}
+    virtual void NoteOff(uint8_t note, uint8_t velocity) {}
+    
     // MIDI handling (optional)
     virtual void ProcessMidi(daisy::MidiEvent& event) {}
+    
+    // Memory for Init-time allocations, set before Init when the module
+    // lives in the shared regions of a multi-module image. Without it,
+    // Create() and AllocateBuffer() use the heap.
+    void SetMemory(MemoryRegions* memory) { memory_ = memory; }
+    
+protected:
+    MemoryRegions* memory_ = nullptr;
+    
+    // From Init only. region is the preferred one: when it is full (other
+    // modules of the chain took it) the next slower region is used.
+    // Returns nullptr when none has room.
+    template <typename T>
+    T* Create(MemoryRegion region = MemoryRegion::Sram) {
+        return memory_ ? memory_->NewPreferred<T>(region) : new T;
+    }
+    
+    template <typename T>
+    void Destroy(T* object) {
+        if (!object) return;
+        if (memory_) {
+            object->~T();
+        } else {
+            delete object;
+        }
+    }
+    
+    void* AllocateBuffer(size_t size, MemoryRegion region = MemoryRegion::Sram, size_t alignment = 32) {
+        if (memory_) return memory_->AllocatePreferred(region, size, alignment);
+        return ::operator new(size, std::align_val_t(alignment));
+    }
+    
+    void FreeBuffer(void* buffer, size_t alignment = 32) {
+        if (!memory_ && buffer) ::operator delete(buffer, std::align_val_t(alignment));
+    }
 };
 
 } // namespace mutables_ui
@@ -0,0 +1,378 @@
+#pragma once
+
+#include "daisy_patch.h"
+#include "module_base.h"
+#include "module_event.h"
+#include "cv_input.h"
+#include <cstring>
+
+namespace mutables_ui {
+
+// Runs several modules each audio block, in the order they were added,
+// either chained (one module's outputs into the next one's inputs) or side
+// by side on different jacks. Channels are wired by pointer: a module reads
+// its inputs straight from the hardware input buffers or from an earlier
+// module's output buffer. No samples are copied for module-to-module
+// connections.
+//
+// Output jacks are fed through a routing matrix: every (module output,
+// jack) pair has a gain, 0 meaning not routed. Whenever routing changes,
+// the matrix is compiled:
+// - a jack fed by one output at unity gain is rendered into directly
+// - any other routed jack gets a short list of mix operations (copy,
+//   scale, add, multiply-add) run after the modules
+// - a jack nothing feeds is cleared with one memset per callback
+// Modules declare how many outputs they write (GetOutputCount); reading or
+// routing an undeclared output yields silence.
+//
+// Each module's Process() is timed in System ticks for the profiler and
+// the load display. Routing is set up from Init code, before audio starts.
+//
+// Process() takes the block's events (module_event.h), sorted by time.
+// Each module gets the ones addressed to its slot or to all slots, with
+// times relative to the piece it renders.
+//
+// Modules are called through ModuleBase, on the audio path as from the UI:
+// one virtual call per slot and operation per block.
+class ModuleChain {
+public:
+    static constexpr int kMaxModules = 4;
+    static constexpr int kChannels = 4;           // Per module, like the Patch
+    static constexpr size_t kMaxBlockSize = 48;   // Larger blocks run in pieces
+    static constexpr int kHardware = -1;          // Port::slot of the Patch jacks
+    static_assert(kChannels == static_cast<int>(kModuleChannels), "Event form passes every channel");
+    static constexpr int kMaxMixOps = kChannels * kMaxModules * kChannels;
+    static constexpr size_t kMaxBlockEvents = 32;  // Per module and piece, the rest dropped
+
+    // A module channel (slot, channel), or a jack (kHardware, channel)
+    struct Port {
+        int slot;
+        int channel;
+    };
+
+    // One module output to one jack
+    struct OutputRoute {
+        int channel;
+        int jack;
+        float gain;
+    };
+
+    struct Stats {
+        uint32_t last_ticks;
+        uint32_t max_ticks;
+        float average_ticks;
+    };
+
+    ModuleChain() : count_(0), mix_count_(0), clear_mask_(0), ticks_per_block_(1.0f) {}
+
+    void Init(float sample_rate, size_t block_size) {
+        count_ = 0;
+        ticks_per_block_ = static_cast<float>(daisy::System::GetTickFreq())
+                         * static_cast<float>(block_size) / sample_rate;
+        memset(silence_, 0, sizeof(silence_));
+        memset(gains_, 0, sizeof(gains_));
+        Compile();
+    }
+
+    // Returns the slot, or -1 when full. Inputs read silence and outputs go
+    // nowhere until connected.
+    int Add(ModuleBase* module) {
+        if (count_ >= kMaxModules) return -1;
+        Slot& slot = slots_[count_];
+        slot.module = module;
+        for (int c = 0; c < kChannels; c++) {
+            slot.source[c] = Port{kHardware, kNone};
+        }
+        slot.stats = Stats{0, 0, 0.0f};
+        count_++;
+        Compile();
+        return count_ - 1;
+    }
+
+    // Wire an output (module output or input jack) to an input (module
+    // input or output jack). Modules run in slot order, so a module only
+    // reads from earlier ones. A jack passes through only via a module.
+    // Connecting to an output jack is SetRoute() at unity gain.
+    bool Connect(Port from, Port to) {
+        if (!IsValid(from) || !IsValid(to)) return false;
+        if (from.slot == kHardware && to.slot == kHardware) return false;
+        if (to.slot == kHardware) return SetRoute(from, to.channel, 1.0f);
+        if (from.slot != kHardware && from.slot >= to.slot) return false;
+
+        slots_[to.slot].source[to.channel] = from;
+        Compile();
+        return true;
+    }
+
+    // Mix a module output into a jack; gain 0 removes the route
+    bool SetRoute(Port from, int jack, float gain) {
+        if (from.slot == kHardware || !IsValid(from) || jack < 0 || jack >= kChannels) return false;
+        gains_[jack][from.slot * kChannels + from.channel] = gain;
+        Compile();
+        return true;
+    }
+
+    // Several routes of one slot, e.g. a module's default output table
+    void SetRoutes(int slot, const OutputRoute* routes, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            SetRoute(Port{slot, routes[i].channel}, routes[i].jack, routes[i].gain);
+        }
+    }
+
+    float GetRouteGain(Port from, int jack) const {
+        if (from.slot == kHardware || !IsValid(from) || jack < 0 || jack >= kChannels) return 0.0f;
+        return gains_[jack][from.slot * kChannels + from.channel];
+    }
+
+    // CV mappings of every module, true if a parameter moved
+    bool ApplyCv(const CVInputBank& cv) {
+        bool moved = false;
+        for (int s = 0; s < count_; s++) {
+            ModuleBase* module = slots_[s].module;
+            moved |= ApplyCvModulation(module->GetParameters(), module->GetParameterCount(), cv);
+        }
+        return moved;
+    }
+
+    void ProcessGate(int gate_index, bool state) {
+        for (int s = 0; s < count_; s++) {
+            slots_[s].module->ProcessGate(gate_index, state);
+        }
+    }
+
+    // Without events, for callers that deliver notes and gates through
+    // the separate hooks
+    void Process(const float* const* in, float** out, size_t size) {
+        Process(EventList(), in, out, size);
+    }
+
+    void Process(const EventList& events, const float* const* in, float** out, size_t size) {
+        // Jacks nothing feeds, once for the whole callback
+        for (int c = 0; c < kChannels; c++) {
+            if (clear_mask_ & (1 << c)) {
+                memset(out[c], 0, size * sizeof(float));
+            }
+        }
+        for (size_t offset = 0; offset < size; offset += kMaxBlockSize) {
+            size_t block = size - offset < kMaxBlockSize ? size - offset : kMaxBlockSize;
+            for (int c = 0; c < kChannels; c++) {
+                jacks_[kFirstInput + c] = const_cast<float*>(in[c]) + offset;
+                jacks_[kFirstOutput + c] = out[c] + offset;
+            }
+            bool last = offset + block >= size;
+            for (int s = 0; s < count_; s++) {
+                ModuleEvent local[kMaxBlockEvents];
+                size_t count = SelectEvents(events, s, offset, block, last, local);
+                ProcessSlot(slots_[s], EventList(local, count), block);
+            }
+            for (int i = 0; i < mix_count_; i++) {
+                Mix(mix_[i], block);
+            }
+        }
+    }
+
+    int GetModuleCount() const { return count_; }
+    ModuleBase* GetModule(int slot) const {
+        return slot >= 0 && slot < count_ ? slots_[slot].module : nullptr;
+    }
+
+    size_t GetEffectiveValues(int slot, float* out, size_t max_count) {
+        return slots_[slot].module->GetEffectiveValues(out, max_count);
+    }
+
+    // Mix operations run per block by the compiled routing
+    int GetMixOpCount() const { return mix_count_; }
+
+    const Stats& GetStats(int slot) const { return slots_[slot].stats; }
+
+    // Average share of the block period spent in the module
+    float GetLoad(int slot) const {
+        return slots_[slot].stats.average_ticks / ticks_per_block_;
+    }
+
+private:
+    static constexpr int kNone = -1;
+    static constexpr int kFirstInput = 0;
+    static constexpr int kFirstOutput = kFirstInput + kChannels;
+    static constexpr int kSilence = kFirstOutput + kChannels;
+    static constexpr int kDiscard = kSilence + 1;
+    static constexpr int kFirstBus = kDiscard + 1;
+    static constexpr float kAverageCoefficient = 0.01f;
+
+    enum class MixKind : uint8_t {
+        Copy,       // jack = source
+        Scale,      // jack = gain * source
+        Add,        // jack += source
+        MultiplyAdd // jack += gain * source
+    };
+
+    struct MixOp {
+        MixKind kind;
+        uint8_t source;              // Buffer id
+        uint8_t jack;
+        float gain;
+    };
+
+    struct Slot {
+        ModuleBase* module;
+        Port source[kChannels];      // What each input reads, as connected
+        uint8_t input[kChannels];    // Buffer ids, compiled
+        uint8_t output[kChannels];
+        Stats stats;
+    };
+
+    Slot slots_[kMaxModules];
+    int count_;
+    float gains_[kChannels][kMaxModules * kChannels];  // [jack][slot * kChannels + channel]
+    MixOp mix_[kMaxMixOps];
+    int mix_count_;
+    uint8_t clear_mask_;             // Jacks nothing feeds
+    float* jacks_[kSilence] = {};    // Hardware buffers of the current block
+    float silence_[kMaxBlockSize];
+    float discard_[kMaxBlockSize];   // Target of undeclared outputs
+    float buses_[kMaxModules * kChannels][kMaxBlockSize];
+    float ticks_per_block_;
+
+    bool IsValid(Port port) const {
+        return port.channel >= 0 && port.channel < kChannels
+            && port.slot >= kHardware && port.slot < count_;
+    }
+
+    bool IsDeclared(int slot, int channel) const {
+        return static_cast<size_t>(channel) < slots_[slot].module->GetOutputCount();
+    }
+
+    // Turn the connections and the gain matrix into buffer ids, the mix
+    // list and the clear mask
+    void Compile() {
+        for (int s = 0; s < count_; s++) {
+            for (int c = 0; c < kChannels; c++) {
+                slots_[s].output[c] = static_cast<uint8_t>(
+                    IsDeclared(s, c) ? kFirstBus + s * kChannels + c : kDiscard);
+            }
+        }
+
+        // Jacks fed by a single unity route are rendered in place
+        clear_mask_ = 0;
+        int feeds[kChannels];
+        for (int jack = 0; jack < kChannels; jack++) {
+            feeds[jack] = 0;
+            int only = kNone;
+            for (int i = 0; i < count_ * kChannels; i++) {
+                if (gains_[jack][i] != 0.0f && IsDeclared(i / kChannels, i % kChannels)) {
+                    feeds[jack]++;
+                    only = i;
+                }
+            }
+            if (feeds[jack] == 0) {
+                clear_mask_ |= 1 << jack;
+            } else if (feeds[jack] == 1 && gains_[jack][only] == 1.0f) {
+                uint8_t& output = slots_[only / kChannels].output[only % kChannels];
+                if (output >= kFirstBus) {
+                    output = static_cast<uint8_t>(kFirstOutput + jack);
+                    feeds[jack] = 0;
+                }
+            }
+        }
+
+        // Everything else is mixed from wherever the output was rendered
+        mix_count_ = 0;
+        for (int jack = 0; jack < kChannels; jack++) {
+            if (feeds[jack] == 0) continue;
+            bool first = true;
+            for (int i = 0; i < count_ * kChannels; i++) {
+                float gain = gains_[jack][i];
+                if (gain == 0.0f || !IsDeclared(i / kChannels, i % kChannels)) continue;
+                MixOp& op = mix_[mix_count_++];
+                op.source = slots_[i / kChannels].output[i % kChannels];
+                op.jack = static_cast<uint8_t>(jack);
+                op.gain = gain;
+                if (first) {
+                    op.kind = gain == 1.0f ? MixKind::Copy : MixKind::Scale;
+                } else {
+                    op.kind = gain == 1.0f ? MixKind::Add : MixKind::MultiplyAdd;
+                }
+                first = false;
+            }
+        }
+
+        // Inputs follow their source to wherever it is rendered
+        for (int s = 0; s < count_; s++) {
+            for (int c = 0; c < kChannels; c++) {
+                Port from = slots_[s].source[c];
+                if (from.channel == kNone) {
+                    slots_[s].input[c] = kSilence;
+                } else if (from.slot == kHardware) {
+                    slots_[s].input[c] = static_cast<uint8_t>(kFirstInput + from.channel);
+                } else if (!IsDeclared(from.slot, from.channel)) {
+                    slots_[s].input[c] = kSilence;
+                } else {
+                    slots_[s].input[c] = slots_[from.slot].output[from.channel];
+                }
+            }
+        }
+    }
+
+    // Events of one slot within [offset, offset + size), rebased to the
+    // piece; the last piece also takes late events
+    size_t SelectEvents(const EventList& events, int slot, size_t offset, size_t size, bool last,
+                        ModuleEvent* selected) const {
+        size_t count = 0;
+        for (size_t i = 0; i < events.GetCount() && count < kMaxBlockEvents; i++) {
+            const ModuleEvent& event = events[i];
+            if (event.slot != slot && event.slot != ModuleEvent::kAllSlots) continue;
+            if (event.time < offset || (!last && event.time >= offset + size)) continue;
+            selected[count] = event;
+            selected[count].time = static_cast<uint16_t>(event.time - offset);
+            count++;
+        }
+        return count;
+    }
+
+    void ProcessSlot(Slot& slot, const EventList& events, size_t size) {
+        float* ins[kChannels];
+        float* outs[kChannels];
+        for (int c = 0; c < kChannels; c++) {
+            ins[c] = Buffer(slot.input[c]);
+            outs[c] = Buffer(slot.output[c]);
+        }
+
+        uint32_t start = daisy::System::GetTick();
+        slot.module->Process(events, ins, outs, size);
+        uint32_t ticks = daisy::System::GetTick() - start;
+
+        Stats& stats = slot.stats;
+        stats.last_ticks = ticks;
+        if (ticks > stats.max_ticks) stats.max_ticks = ticks;
+        stats.average_ticks += kAverageCoefficient * (static_cast<float>(ticks) - stats.average_ticks);
+    }
+
+    void Mix(const MixOp& op, size_t size) {
+        const float* source = Buffer(op.source);
+        float* jack = jacks_[kFirstOutput + op.jack];
+        float gain = op.gain;
+        switch (op.kind) {
+            case MixKind::Copy:
+                memcpy(jack, source, size * sizeof(float));
+                break;
+            case MixKind::Scale:
+                for (size_t i = 0; i < size; i++) jack[i] = gain * source[i];
+                break;
+            case MixKind::Add:
+                for (size_t i = 0; i < size; i++) jack[i] += source[i];
+                break;
+            case MixKind::MultiplyAdd:
+                for (size_t i = 0; i < size; i++) jack[i] += gain * source[i];
+                break;
+        }
+    }
+
+    float* Buffer(uint8_t id) {
+        if (id == kSilence) return silence_;
+        if (id == kDiscard) return discard_;
+        if (id >= kFirstBus) return buses_[id - kFirstBus];
+        return jacks_[id];
+    }
+};
+
+} // namespace mutables_ui
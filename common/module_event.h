@@ -0,0 +1,135 @@
+#pragma once
+
+#include "parameter.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Pointers per side passed to the event form of Process(), like the jacks
+// of the Patch
+constexpr size_t kModuleChannels = 4;
+
+// Something that happens to a module at a sample offset within a block
+struct ModuleEvent {
+    enum class Type : uint8_t {
+        NoteOn,         // index = note, value = velocity (1-127)
+        NoteOff,        // index = note, value = release velocity
+        Gate,           // index = gate input, value = 0 or 1
+        SetParameter    // index = parameter, value in parameter units
+    };
+
+    static constexpr uint8_t kAllSlots = 0xFF;
+
+    uint16_t time;      // Sample offset in the block
+    Type type;
+    uint8_t slot;       // Module chain slot, or kAllSlots
+    uint16_t index;
+    float value;
+
+    static ModuleEvent NoteOn(uint16_t time, uint8_t note, uint8_t velocity, uint8_t slot = 0) {
+        return ModuleEvent{time, Type::NoteOn, slot, note, static_cast<float>(velocity)};
+    }
+
+    static ModuleEvent NoteOff(uint16_t time, uint8_t note, uint8_t velocity, uint8_t slot = 0) {
+        return ModuleEvent{time, Type::NoteOff, slot, note, static_cast<float>(velocity)};
+    }
+
+    static ModuleEvent Gate(uint16_t time, int gate_index, bool state, uint8_t slot = kAllSlots) {
+        return ModuleEvent{time, Type::Gate, slot, static_cast<uint16_t>(gate_index), state ? 1.0f : 0.0f};
+    }
+
+    static ModuleEvent SetParameter(uint16_t time, uint16_t index, float value, uint8_t slot = 0) {
+        return ModuleEvent{time, Type::SetParameter, slot, index, value};
+    }
+};
+
+// Events of one block, sorted by time; events with the same time keep
+// their order. A view: the storage belongs to whoever built it.
+class EventList {
+public:
+    EventList() : events_(nullptr), count_(0) {}
+    EventList(const ModuleEvent* events, size_t count) : events_(events), count_(count) {}
+
+    size_t GetCount() const { return count_; }
+    bool IsEmpty() const { return count_ == 0; }
+    const ModuleEvent& operator[](size_t index) const { return events_[index]; }
+
+private:
+    const ModuleEvent* events_;
+    size_t count_;
+};
+
+// Fixed-capacity event storage for one block, kept sorted as events are
+// added. Events mostly arrive in time order, so Add() is usually O(1).
+template <size_t kCapacity>
+class EventBuffer {
+public:
+    EventBuffer() : count_(0), dropped_(0) {}
+
+    // False (and counted) when full
+    bool Add(const ModuleEvent& event) {
+        if (count_ >= kCapacity) {
+            dropped_++;
+            return false;
+        }
+        size_t i = count_++;
+        while (i > 0 && events_[i - 1].time > event.time) {
+            events_[i] = events_[i - 1];
+            i--;
+        }
+        events_[i] = event;
+        return true;
+    }
+
+    void Clear() { count_ = 0; }
+
+    EventList GetList() const { return EventList(events_, count_); }
+    size_t GetCount() const { return count_; }
+    uint32_t GetDroppedCount() const { return dropped_; }
+
+private:
+    ModuleEvent events_[kCapacity];
+    size_t count_;
+    uint32_t dropped_;
+};
+
+// Parameter write of a SetParameter event, clamped to the parameter range
+inline void ApplyParameterEvent(Parameter* params, size_t count, const ModuleEvent& event) {
+    if (event.index >= count) return;
+    Parameter& param = params[event.index];
+    param.value = event.value < param.min ? param.min
+                : event.value > param.max ? param.max : event.value;
+}
+
+// Adapter for modules that render whole blocks: splits the block at the
+// event times, hands each event to apply() when its sample is reached and
+// renders the pieces in between with render(in, out, size). in and out
+// hold kModuleChannels pointers (in may be null). Events at or past `size`
+// are applied after the last piece.
+template <typename Apply, typename Render>
+void SplitAtEvents(const EventList& events, float** in, float** out, size_t size,
+                   Apply apply, Render render) {
+    size_t done = 0;
+    size_t next = 0;
+    while (done < size) {
+        while (next < events.GetCount() && events[next].time <= done) {
+            apply(events[next++]);
+        }
+        size_t end = next < events.GetCount() && events[next].time < size ? events[next].time : size;
+
+        float* ins[kModuleChannels];
+        float* outs[kModuleChannels];
+        for (size_t c = 0; c < kModuleChannels; c++) {
+            ins[c] = in && in[c] ? in[c] + done : nullptr;
+            outs[c] = out[c] ? out[c] + done : nullptr;
+        }
+        render(in ? ins : nullptr, outs, end - done);
+        done = end;
+    }
+    while (next < events.GetCount()) {
+        apply(events[next++]);
+    }
+}
+
+} // namespace mutables_ui
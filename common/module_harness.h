@@ -0,0 +1,114 @@
+#pragma once
+
+#include "cv_input.h"
+#include "module_event.h"
+#include "parameter.h"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace mutables_ui {
+
+// Audio-callback work for one module type, bound at compile time. Calls
+// name the module's own functions (Module::Process, ...), so they compile
+// to direct calls instead of loads through the ModuleBase vtable, are
+// inlined where the definition is visible, and an empty hook costs
+// nothing. The module does not have to derive from ModuleBase: ProcessGate,
+// HandleEvent and GetEffectiveValues are then optional.
+//
+// ModuleChain does not use it: host/dispatch_bench measured no gain over
+// the vtable for Plaits, whose per-block cost is its DSP. It stays for
+// code that holds a module by its concrete type.
+template <typename Module>
+class ModuleHarness {
+public:
+    explicit ModuleHarness(Module& module) : module_(module) {}
+
+    // See ApplyCvModulation (cv_input.h)
+    bool ApplyCv(const CVInputBank& cv) {
+        return ApplyCvModulation(module_.Module::GetParameters(), module_.Module::GetParameterCount(), cv);
+    }
+
+    void ProcessGate(int gate_index, bool state) {
+        if constexpr (HasProcessGate<Module>::value) {
+            module_.Module::ProcessGate(gate_index, state);
+        }
+    }
+
+    void Process(float** in, float** out, size_t size) {
+        module_.Module::Process(in, out, size);
+    }
+
+    // With the block's events: the module's own event form when it
+    // declares one, otherwise the block is split at the events around
+    // direct Process() calls. No events, no splitting.
+    void Process(const EventList& events, float** in, float** out, size_t size) {
+        if (events.IsEmpty()) {
+            module_.Module::Process(in, out, size);
+        } else if constexpr (HasEventProcess<Module>::value) {
+            module_.Module::Process(events, in, out, size);
+        } else {
+            SplitAtEvents(events, in, out, size,
+                          [this](const ModuleEvent& event) { HandleEvent(event); },
+                          [this](float** i, float** o, size_t n) { module_.Module::Process(i, o, n); });
+        }
+    }
+
+    void HandleEvent(const ModuleEvent& event) {
+        if constexpr (HasHandleEvent<Module>::value) {
+            module_.Module::HandleEvent(event);
+        } else if (event.type == ModuleEvent::Type::Gate) {
+            ProcessGate(event.index, event.value > 0.5f);
+        } else if (event.type == ModuleEvent::Type::SetParameter) {
+            ApplyParameterEvent(module_.Module::GetParameters(), module_.Module::GetParameterCount(), event);
+        }
+    }
+
+    size_t GetEffectiveValues(float* out, size_t max_count) {
+        if constexpr (HasEffectiveValues<Module>::value) {
+            return module_.Module::GetEffectiveValues(out, max_count);
+        } else {
+            Parameter* params = module_.Module::GetParameters();
+            size_t count = module_.Module::GetParameterCount();
+            if (count > max_count) count = max_count;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = params[i].GetEffective();
+            }
+            return count;
+        }
+    }
+
+private:
+    template <typename T, typename = void>
+    struct HasProcessGate : std::false_type {};
+    template <typename T>
+    struct HasProcessGate<T, std::void_t<decltype(std::declval<T&>().ProcessGate(0, false))>>
+        : std::true_type {};
+
+    template <typename T, typename = void>
+    struct HasEffectiveValues : std::false_type {};
+    template <typename T>
+    struct HasEffectiveValues<T, std::void_t<decltype(
+        std::declval<T&>().GetEffectiveValues(std::declval<float*>(), size_t(0)))>>
+        : std::true_type {};
+
+    // False when the module's own Process(in, out, size) hides the
+    // ModuleBase event form
+    template <typename T, typename = void>
+    struct HasEventProcess : std::false_type {};
+    template <typename T>
+    struct HasEventProcess<T, std::void_t<decltype(std::declval<T&>().Process(
+        std::declval<const EventList&>(), std::declval<float**>(), std::declval<float**>(), size_t(0)))>>
+        : std::true_type {};
+
+    template <typename T, typename = void>
+    struct HasHandleEvent : std::false_type {};
+    template <typename T>
+    struct HasHandleEvent<T, std::void_t<decltype(
+        std::declval<T&>().HandleEvent(std::declval<const ModuleEvent&>()))>>
+        : std::true_type {};
+
+    Module& module_;
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "arena.h"
+#include "module_chain.h"
+#include <cstring>
+
+namespace mutables_ui {
+
+// Data a module wants in fast RAM while it is active (lookup tables read
+// through a pointer). Copied to DTCM on activation, see
+// ModuleSwitcher::GetTable.
+struct LookupTable {
+    const void* data;
+    size_t size;
+};
+
+// A module built into the image. install() constructs it in SRAM and
+// adds it to the chain.
+// short_name matches the module's GetShortName() (preset and state tags).
+struct ModuleEntry {
+    const char* name;
+    const char* short_name;
+    ModuleBase* (*install)(MemoryRegions& memory, ModuleChain& chain);
+    const LookupTable* tables;
+    size_t table_count;
+};
+
+template <typename Module>
+ModuleEntry MakeModuleEntry(const char* name, const char* short_name,
+                            const LookupTable* tables = nullptr, size_t table_count = 0) {
+    return ModuleEntry{
+        name,
+        short_name,
+        [](MemoryRegions& memory, ModuleChain& chain) -> ModuleBase* {
+            Module* module = memory.New<Module>(MemoryRegion::Sram);
+            if (!module) return nullptr;
+            module->SetMemory(&memory);
+            chain.Add(module);
+            return module;
+        },
+        tables,
+        table_count};
+}
+
+// Builds the chain's modules from the image's entries. Slot 0 is the
+// active module; SetSlot() and RemoveSlot() add, replace or drop the
+// modules after it. Every change rebuilds the whole chain, since the
+// modules share the memory regions: destroy them all, reset the regions,
+// copy each module's tables to DTCM and build the modules in slot order.
+// Modules that keep their entry get their parameter values back. The
+// regions are open for allocation only during construction and Init. The
+// caller keeps audio stopped meanwhile and sets the chain's routing
+// afterwards (ModuleChain::Init clears it).
+class ModuleSwitcher {
+public:
+    static constexpr size_t kMaxTables = 8;
+    static constexpr int kMaxSlots = ModuleChain::kMaxModules;
+
+    ModuleSwitcher()
+        : entries_(nullptr)
+        , count_(0)
+        , memory_(nullptr)
+        , chain_(nullptr)
+        , sample_rate_(48000.0f)
+        , block_size_(24)
+        , slot_count_(0)
+        , building_slot_(0)
+        , switch_ticks_(0) {}
+
+    void Init(const ModuleEntry* entries, size_t count, MemoryRegions* memory,
+              ModuleChain* chain, float sample_rate, size_t block_size) {
+        entries_ = entries;
+        count_ = count;
+        memory_ = memory;
+        memory_->Close();
+        chain_ = chain;
+        sample_rate_ = sample_rate;
+        block_size_ = block_size;
+    }
+
+    // Replace the active module (slot 0), keeping the slots after it.
+    // Returns the new module, or nullptr if the chain didn't get all the
+    // memory it asked for; the previous chain is rebuilt then.
+    ModuleBase* Activate(int index) {
+        return SetSlot(0, index) ? GetActive() : nullptr;
+    }
+
+    // Put entry index in slot: replaces the module there, or adds one when
+    // slot is the slot count. False (previous chain rebuilt) if it doesn't
+    // fit the memory regions.
+    bool SetSlot(int slot, int index) {
+        if (index < 0 || static_cast<size_t>(index) >= count_) return false;
+        if (slot < 0 || slot > slot_count_ || slot >= kMaxSlots) return false;
+        Layout layout = Current();
+        layout.entries[slot] = index;
+        layout.origins[slot] = -1;
+        if (slot == layout.count) layout.count++;
+        return Rebuild(layout);
+    }
+
+    // Drop a module after the active one; later slots move up
+    bool RemoveSlot(int slot) {
+        if (slot < 1 || slot >= slot_count_) return false;
+        Layout layout = Current();
+        for (int s = slot; s + 1 < layout.count; s++) {
+            layout.entries[s] = layout.entries[s + 1];
+            layout.origins[s] = layout.origins[s + 1];
+        }
+        layout.count--;
+        return Rebuild(layout);
+    }
+
+    // Fast-RAM copy of table i of the module in slot (the original if it
+    // didn't fit). From a module's Init, GetTable(i) is its own slot's.
+    const void* GetTable(size_t i, int slot) const { return tables_[slot][i]; }
+    const void* GetTable(size_t i) const { return tables_[building_slot_][i]; }
+
+    ModuleBase* GetActive() const { return slot_count_ > 0 ? modules_[0] : nullptr; }
+    int GetActiveIndex() const { return slot_count_ > 0 ? slot_entries_[0] : -1; }
+    int GetSlotCount() const { return slot_count_; }
+    int GetSlotIndex(int slot) const { return slot >= 0 && slot < slot_count_ ? slot_entries_[slot] : -1; }
+    size_t GetCount() const { return count_; }
+    const char* GetName(size_t i) const { return entries_[i].name; }
+    const char* GetShortName(size_t i) const { return entries_[i].short_name; }
+
+    // Time of the last rebuild
+    uint32_t GetSwitchTicks() const { return switch_ticks_; }
+    // Largest footprint in a region since boot
+    size_t GetPeakBytes(MemoryRegion region) const { return memory_->Get(region).GetPeak(); }
+
+private:
+    // Entries per slot, and the current slot each keeps its values from
+    struct Layout {
+        int count;
+        int entries[kMaxSlots];
+        int origins[kMaxSlots];
+    };
+
+    Layout Current() const {
+        Layout layout;
+        layout.count = slot_count_;
+        for (int s = 0; s < slot_count_; s++) {
+            layout.entries[s] = slot_entries_[s];
+            layout.origins[s] = s;
+        }
+        return layout;
+    }
+
+    bool Rebuild(const Layout& layout) {
+        uint32_t start = daisy::System::GetTick();
+        Layout previous = Current();
+        SaveValues();
+        bool ok = Build(layout);
+        if (!ok) {
+            Build(previous);
+        }
+        switch_ticks_ = daisy::System::GetTick() - start;
+        return ok;
+    }
+
+    void SaveValues() {
+        for (int s = 0; s < slot_count_; s++) {
+            Parameter* params = modules_[s]->GetParameters();
+            saved_counts_[s] = modules_[s]->GetParameterCount();
+            if (saved_counts_[s] > kMaxParameters) saved_counts_[s] = kMaxParameters;
+            for (size_t i = 0; i < saved_counts_[s]; i++) {
+                saved_[s][i] = params[i].value;
+            }
+        }
+    }
+
+    bool Build(const Layout& layout) {
+        for (int s = slot_count_ - 1; s >= 0; s--) {
+            modules_[s]->~ModuleBase();
+        }
+        slot_count_ = 0;
+        memory_->Reset();
+        memory_->Open();
+
+        for (int s = 0; s < layout.count; s++) {
+            CopyTables(s, layout.entries[s], layout);
+        }
+        uint32_t failed = memory_->GetFailedCount();  // Table misses are not fatal
+
+        chain_->Init(sample_rate_, block_size_);
+        bool ok = true;
+        for (int s = 0; s < layout.count && ok; s++) {
+            building_slot_ = s;
+            ModuleBase* module = entries_[layout.entries[s]].install(*memory_, *chain_);
+            if (!module) break;
+            modules_[s] = module;
+            slot_entries_[s] = layout.entries[s];
+            slot_count_ = s + 1;
+            module->Init(sample_rate_);
+            ok = memory_->GetFailedCount() == failed;
+        }
+        ok = ok && slot_count_ == layout.count;
+        if (!ok) {
+            for (int s = slot_count_ - 1; s >= 0; s--) {
+                modules_[s]->~ModuleBase();
+            }
+            slot_count_ = 0;
+            chain_->Init(sample_rate_, block_size_);
+        }
+        memory_->Close();
+        building_slot_ = 0;
+
+        for (int s = 0; s < slot_count_; s++) {
+            if (layout.origins[s] >= 0) RestoreValues(s, layout.origins[s]);
+        }
+        return ok;
+    }
+
+    // DTCM copies, shared by slots of the same entry
+    void CopyTables(int slot, int index, const Layout& layout) {
+        for (int s = 0; s < slot; s++) {
+            if (layout.entries[s] == index) {
+                for (size_t i = 0; i < kMaxTables; i++) tables_[slot][i] = tables_[s][i];
+                return;
+            }
+        }
+        const ModuleEntry& entry = entries_[index];
+        for (size_t i = 0; i < entry.table_count && i < kMaxTables; i++) {
+            const LookupTable& table = entry.tables[i];
+            void* copy = memory_->Allocate(MemoryRegion::Dtcm, table.size, 32);
+            if (copy) {
+                memcpy(copy, table.data, table.size);
+            }
+            tables_[slot][i] = copy ? copy : table.data;  // Read in place if DTCM is full
+        }
+    }
+
+    void RestoreValues(int slot, int origin) {
+        Parameter* params = modules_[slot]->GetParameters();
+        size_t count = modules_[slot]->GetParameterCount();
+        if (count > saved_counts_[origin]) count = saved_counts_[origin];
+        for (size_t i = 0; i < count; i++) {
+            params[i].value = saved_[origin][i];
+        }
+        modules_[slot]->OnParametersLoaded();
+    }
+
+    const ModuleEntry* entries_;
+    size_t count_;
+    MemoryRegions* memory_;
+    ModuleChain* chain_;
+    float sample_rate_;
+    size_t block_size_;
+    int slot_count_;
+    int building_slot_;
+    int slot_entries_[kMaxSlots] = {};
+    ModuleBase* modules_[kMaxSlots] = {};
+    const void* tables_[kMaxSlots][kMaxTables] = {};
+    float saved_[kMaxSlots][kMaxParameters] = {};
+    size_t saved_counts_[kMaxSlots] = {};
+    uint32_t switch_ticks_;
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "module_base.h"
+#include "resampler.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace mutables_ui {
+
+// Runs a module at its native sample rate inside a chain at the codec
+// rate: inputs are converted to kNativeRate, the module renders whatever
+// that produced, and its outputs are converted back. The output side keeps
+// a small FIFO, primed with kPriming samples of silence, that absorbs the
+// one-sample jitter of the per-block counts.
+//
+// Everything else (parameters, gates, notes, MIDI, presets) is passed
+// through, so the wrapper registers like the module itself. Events land on
+// the block split nearest their codec-rate time.
+//
+//   MakeModuleEntry<NativeRateModule<CloudsPort, 32000>>("Clouds", "clouds")
+//
+// If the codec rate has no supported ratio to kNativeRate, the module runs
+// at the codec rate unconverted.
+template <typename Module, uint32_t kNativeRate, size_t kInputs = 2, size_t kOutputs = 2,
+          ResamplerQuality kQuality = ResamplerQuality::Balanced>
+class NativeRateModule final : public ModuleBase {
+public:
+    static constexpr size_t kMaxBlockSize = 48;  // Codec rate
+    static constexpr size_t kMaxNativeBlock = kMaxBlockSize * PolyphaseResampler::kMaxPhases + 1;
+    static constexpr size_t kPriming = 2;
+    static constexpr size_t kFifoSize = kMaxBlockSize + 2 * kPriming + PolyphaseResampler::kMaxPhases;
+
+    NativeRateModule() : converted_(false), up_(1), down_(1), remainder_(0), fifo_count_(0) {}
+
+    const char* GetName() const override { return module_.Module::GetName(); }
+    const char* GetShortName() const override { return module_.Module::GetShortName(); }
+
+    void Init(float sample_rate) override {
+        uint32_t codec_rate = static_cast<uint32_t>(sample_rate + 0.5f);
+        converted_ = codec_rate != kNativeRate;
+        for (size_t c = 0; c < kInputs && converted_; c++) {
+            converted_ = input_[c].Init(kNativeRate, codec_rate, kQuality);
+        }
+        for (size_t c = 0; c < kOutputs && converted_; c++) {
+            converted_ = output_[c].Init(codec_rate, kNativeRate, kQuality);
+        }
+
+        uint32_t divisor = Gcd(kNativeRate, codec_rate);
+        up_ = kNativeRate / divisor;
+        down_ = codec_rate / divisor;
+        remainder_ = 0;
+
+        module_.SetMemory(memory_);
+        module_.Module::Init(converted_ ? static_cast<float>(kNativeRate) : sample_rate);
+
+        fifo_count_ = kPriming;
+        for (size_t c = 0; c < kOutputs; c++) {
+            memset(fifo_[c], 0, sizeof(fifo_[c]));
+        }
+    }
+
+    void Process(float** in, float** out, size_t size) override {
+        if (!converted_) {
+            module_.Module::Process(in, out, size);
+            return;
+        }
+
+        float* native_in[kInputs > 0 ? kInputs : 1];
+        float* native_out[kOutputs];
+        size_t native_size = 0;
+        if constexpr (kInputs == 0) {
+            // Same count the input converters would produce
+            remainder_ += static_cast<uint32_t>(size) * up_;
+            native_size = remainder_ / down_;
+            remainder_ %= down_;
+        }
+        for (size_t c = 0; c < kInputs; c++) {
+            native_size = input_[c].Process(in[c], size, native_in_[c]);
+            native_in[c] = native_in_[c];
+        }
+        for (size_t c = 0; c < kOutputs; c++) {
+            native_out[c] = native_out_[c];
+        }
+        module_.Module::Process(kInputs > 0 ? native_in : nullptr, native_out, native_size);
+
+        size_t produced = 0;
+        for (size_t c = 0; c < kOutputs; c++) {
+            produced = output_[c].Process(native_out_[c], native_size, fifo_[c] + fifo_count_);
+        }
+        fifo_count_ += produced;
+
+        // Short by a sample while the counts settle: repeat the last one
+        size_t available = fifo_count_ < size ? fifo_count_ : size;
+        for (size_t c = 0; c < kOutputs; c++) {
+            memcpy(out[c], fifo_[c], available * sizeof(float));
+            for (size_t i = available; i < size; i++) {
+                out[c][i] = available > 0 ? out[c][available - 1] : 0.0f;
+            }
+            memmove(fifo_[c], fifo_[c] + available, (fifo_count_ - available) * sizeof(float));
+        }
+        fifo_count_ -= available;
+    }
+
+    Parameter* GetParameters() override { return module_.Module::GetParameters(); }
+    size_t GetParameterCount() const override { return module_.Module::GetParameterCount(); }
+    size_t GetOutputCount() const override {
+        size_t count = module_.Module::GetOutputCount();
+        return count < kOutputs ? count : kOutputs;
+    }
+    const char* GetOutputName(size_t channel) const override {
+        return module_.Module::GetOutputName(channel);
+    }
+    size_t GetEffectiveValues(float* out, size_t max_count) override {
+        return module_.Module::GetEffectiveValues(out, max_count);
+    }
+    void OnParametersLoaded() override { module_.Module::OnParametersLoaded(); }
+    void ProcessGate(int gate_index, bool state) override { module_.Module::ProcessGate(gate_index, state); }
+    bool GetGateOutput(int gate_index) override { return module_.Module::GetGateOutput(gate_index); }
+    float GetCVOutput(int cv_index) override { return module_.Module::GetCVOutput(cv_index); }
+    void NoteOn(uint8_t note, uint8_t velocity) override { module_.Module::NoteOn(note, velocity); }
+    void NoteOff(uint8_t note, uint8_t velocity) override { module_.Module::NoteOff(note, velocity); }
+    void ProcessMidi(daisy::MidiEvent& event) override { module_.Module::ProcessMidi(event); }
+
+    bool IsConverted() const { return converted_; }
+    Module& GetModule() { return module_; }
+
+private:
+    static uint32_t Gcd(uint32_t a, uint32_t b) {
+        while (b != 0) {
+            uint32_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a > 0 ? a : 1;
+    }
+
+    Module module_;
+    bool converted_;
+    uint32_t up_;
+    uint32_t down_;
+    uint32_t remainder_;
+    PolyphaseResampler input_[kInputs > 0 ? kInputs : 1];
+    PolyphaseResampler output_[kOutputs];
+    float native_in_[kInputs > 0 ? kInputs : 1][kMaxNativeBlock];
+    float native_out_[kOutputs][kMaxNativeBlock];
+    float fifo_[kOutputs][kFifoSize];
+    size_t fifo_count_;
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "parameter.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Seqlock publishing the effective (post-modulation) parameter values from
+// the audio callback to the main loop.
+// The writer is the audio interrupt and never waits. The reader copies the
+// values and retries if the interrupt published in the middle of the copy;
+// after a few failed attempts it keeps its previous copy.
+class ParamSnapshot {
+public:
+    ParamSnapshot() : sequence_(0), count_(0) {
+        for (size_t i = 0; i < kMaxParameters; i++) {
+            values_[i].store(0.0f, std::memory_order_relaxed);
+        }
+    }
+
+    // Audio callback side, once per block
+    void Publish(const float* values, size_t count) {
+        if (count > kMaxParameters) count = kMaxParameters;
+
+        uint32_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);  // Odd: writing
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < count; i++) {
+            values_[i].store(values[i], std::memory_order_relaxed);
+        }
+        count_.store(static_cast<uint32_t>(count), std::memory_order_relaxed);
+
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    // Main loop side
+    // Returns the number of values copied, 0 if nothing consistent could be
+    // read (never published yet, or repeatedly interrupted).
+    size_t Read(float* out, size_t max_count) const {
+        for (int attempt = 0; attempt < kMaxAttempts; attempt++) {
+            uint32_t begin = sequence_.load(std::memory_order_acquire);
+            if (begin == 0 || (begin & 1)) continue;
+
+            size_t count = count_.load(std::memory_order_relaxed);
+            if (count > max_count) count = max_count;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = values_[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == begin) {
+                return count;
+            }
+        }
+        return 0;
+    }
+
+private:
+    static constexpr int kMaxAttempts = 4;
+
+    std::atomic<uint32_t> sequence_;
+    std::atomic<uint32_t> count_;
+    std::atomic<float> values_[kMaxParameters];
+};
+
+} // namespace mutables_ui
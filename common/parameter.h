@@ -1,10 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <algorithm>
 
 namespace mutables_ui {
 
+// Upper bound on parameters per module (snapshots, presets)
+static constexpr size_t kMaxParameters = 32;
+
 enum class ParamType {
     Continuous,    // Float 0.0-1.0 (most MI params)
     Bipolar,       // Float -1.0 to 1.0
@@ -29,7 +33,8 @@ struct CVMapping {
 struct Parameter {
     const char* name;
     ParamType type;
-    float value;
+    float value;            // As set: UI, presets, MIDI
+    float modulation;       // CV offset on top, written by the audio callback
     float min;
     float max;
     CVMapping cv_mapping;
@@ -46,6 +51,7 @@ struct Parameter {
         : name("")
         , type(ParamType::Continuous)
         , value(0.0f)
+        , modulation(0.0f)
         , min(0.0f)
         , max(1.0f)
         , enum_labels(nullptr)
@@ -56,6 +62,7 @@ struct Parameter {
         : name(name)
         , type(ParamType::Continuous)
         , value((min + max) / 2.0f)
+        , modulation(0.0f)
         , min(min)
         , max(max)
         , enum_labels(nullptr)
@@ -66,6 +73,7 @@ struct Parameter {
         : name(name)
         , type(ParamType::Enum)
         , value(0.0f)
+        , modulation(0.0f)
         , min(0.0f)
         , max(count - 1.0f)
         , enum_labels(labels)
@@ -100,6 +108,28 @@ struct Parameter {
         return false;
     }
     
+    // What the DSP uses: the set value plus the CV modulation, in range
+    float GetEffective() const {
+        return std::clamp(value + modulation, min, max);
+    }
+    
+    // Follow a normalized knob + CV reading through the mapping: the
+    // captured origin plus the reading's distance from it, scaled by the
+    // attenuverter (see common/README.md). Stored as the offset from the
+    // set value, which is left alone. Only updates past the tolerance, to
+    // ignore ADC jitter. Returns true if the effective value moved.
+    bool SetModulationWithHysteresis(float cv, float tolerance = 0.005f) {
+        float range = max - min;
+        float origin = cv_mapping.origin_offset;
+        float normalized = std::clamp(origin + (cv - origin) * cv_mapping.attenuverter, 0.0f, 1.0f);
+        float target = min + normalized * range;
+        if (std::abs(target - (value + modulation)) > range * tolerance) {
+            modulation = target - value;
+            return true;
+        }
+        return false;
+    }
+    
     // Get integer index for enum/integer params
     int GetIndex() const {
         return static_cast<int>(value + 0.5f);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "flash_region.h"
+#include "preset_format.h"
+
+namespace mutables_ui {
+
+// Preset slots in a reserved flash region, one slot per sector so a slot
+// can be rewritten without touching its neighbours.
+// Slots are checked in place in memory-mapped flash: looking up a preset is
+// a pointer plus a CRC check. Copy the record before handing it to the
+// audio callback (PresetPool), since a later Store() rewrites the flash.
+class PresetBank {
+public:
+    static constexpr int kMaxSlots = 128;  // One per MIDI program number
+
+    PresetBank() : flash_(nullptr), module_tag_(0), slot_stride_(0), slot_count_(0) {}
+
+    void Init(FlashRegion* flash, uint32_t module_tag) {
+        flash_ = flash;
+        module_tag_ = module_tag;
+
+        size_t sector = flash->GetSectorSize();
+        slot_stride_ = ((sizeof(PresetRecord) + sector - 1) / sector) * sector;
+        slot_count_ = static_cast<int>(flash->GetSize() / slot_stride_);
+        if (slot_count_ > kMaxSlots) slot_count_ = kMaxSlots;
+    }
+
+    int GetSlotCount() const { return slot_count_; }
+
+    // Validated record for this module, nullptr if the slot is empty or corrupt
+    const PresetRecord* Get(int slot) const {
+        if (!flash_ || slot < 0 || slot >= slot_count_) return nullptr;
+        const PresetRecord* record =
+            reinterpret_cast<const PresetRecord*>(flash_->GetData() + slot * slot_stride_);
+        return PresetIsValid(*record, module_tag_) ? record : nullptr;
+    }
+
+    // Erase the slot and program the record. Slow (sector erase): call from
+    // the main loop, never from the audio callback.
+    bool Store(int slot, const PresetRecord& record) {
+        if (!flash_ || slot < 0 || slot >= slot_count_) return false;
+        size_t offset = slot * slot_stride_;
+        for (size_t s = 0; s < slot_stride_; s += flash_->GetSectorSize()) {
+            if (!flash_->EraseSector(offset + s)) return false;
+        }
+        if (!flash_->Program(offset, &record, sizeof(record))) return false;
+        return Get(slot) != nullptr;
+    }
+
+    bool Clear(int slot) {
+        if (!flash_ || slot < 0 || slot >= slot_count_) return false;
+        return flash_->EraseSector(slot * slot_stride_);
+    }
+
+private:
+    FlashRegion* flash_;
+    uint32_t module_tag_;
+    size_t slot_stride_;
+    int slot_count_;
+};
+
+} // namespace mutables_ui
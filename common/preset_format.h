@@ -0,0 +1,135 @@
+#pragma once
+
+#include "parameter.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace mutables_ui {
+
+// Binary preset record shared by QSPI slots, SD card files and SysEx dumps.
+// Fixed layout, no pointers: a record can be used in place from
+// memory-mapped flash and copied with memcpy. Multi-byte fields are stored
+// little-endian (native on Cortex-M7 and x86/ARM hosts).
+
+static constexpr uint32_t kPresetMagic = 0x5053494D;  // "MISP"
+static constexpr uint16_t kPresetVersion = 1;
+static constexpr size_t kPresetNameLength = 16;       // Including terminator
+
+struct CVMappingRecord {
+    int8_t cv_input;
+    uint8_t active;
+    uint8_t reserved[2];
+    float attenuverter;
+    float origin_offset;
+};
+
+struct PresetRecord {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t param_count;
+    uint32_t module_tag;                 // See ModuleTag()
+    char name[kPresetNameLength];
+    float values[kMaxParameters];
+    CVMappingRecord mappings[kMaxParameters];
+    uint32_t crc;                        // CRC-32 of all preceding bytes
+};
+
+static_assert(std::is_trivially_copyable<PresetRecord>::value, "PresetRecord must be POD");
+static_assert(std::is_standard_layout<PresetRecord>::value, "PresetRecord must be POD");
+static_assert(sizeof(CVMappingRecord) == 12, "CVMappingRecord layout changed");
+static_assert(sizeof(PresetRecord) == 28 + kMaxParameters * 16 + 4, "PresetRecord layout changed");
+static_assert(offsetof(PresetRecord, crc) == sizeof(PresetRecord) - 4, "CRC must be last");
+
+// CRC-32 (IEEE, reflected), nibble table to keep flash usage small
+inline uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// Four-character tag from a module short name ("plaits" -> "plai")
+inline uint32_t ModuleTag(const char* short_name) {
+    uint32_t tag = 0;
+    for (int i = 0; i < 4 && short_name[i]; i++) {
+        tag |= static_cast<uint32_t>(static_cast<uint8_t>(short_name[i])) << (8 * i);
+    }
+    return tag;
+}
+
+// Copy a string into a fixed-size field, truncated to fit and always
+// terminated
+template <size_t kSize>
+inline void CopyName(char (&out)[kSize], const char* name) {
+    size_t length = strnlen(name, kSize - 1);
+    memcpy(out, name, length);
+    out[length] = '\0';
+}
+
+inline uint32_t PresetChecksum(const PresetRecord& record) {
+    return Crc32(&record, offsetof(PresetRecord, crc));
+}
+
+// Fill a record from the current parameter state
+inline void PresetCapture(PresetRecord& record,
+                          const char* name,
+                          uint32_t module_tag,
+                          const Parameter* params,
+                          size_t count) {
+    memset(&record, 0, sizeof(record));
+    count = std::min(count, kMaxParameters);
+
+    record.magic = kPresetMagic;
+    record.version = kPresetVersion;
+    record.param_count = static_cast<uint16_t>(count);
+    record.module_tag = module_tag;
+    CopyName(record.name, name);
+
+    for (size_t i = 0; i < count; i++) {
+        record.values[i] = params[i].value;
+        record.mappings[i].cv_input = params[i].cv_mapping.cv_input;
+        record.mappings[i].active = params[i].cv_mapping.active ? 1 : 0;
+        record.mappings[i].attenuverter = params[i].cv_mapping.attenuverter;
+        record.mappings[i].origin_offset = params[i].cv_mapping.origin_offset;
+    }
+    record.crc = PresetChecksum(record);
+}
+
+// Check header and CRC. module_tag 0 accepts any module.
+inline bool PresetIsValid(const PresetRecord& record, uint32_t module_tag) {
+    if (record.magic != kPresetMagic) return false;
+    if (record.version != kPresetVersion) return false;
+    if (record.param_count > kMaxParameters) return false;
+    if (module_tag != 0 && record.module_tag != module_tag) return false;
+    return record.crc == PresetChecksum(record);
+}
+
+// Copy a validated record into parameter state. Bounded by kMaxParameters,
+// safe to call from the audio callback at a block boundary.
+inline void PresetApply(const PresetRecord& record, Parameter* params, size_t count) {
+    count = std::min(count, static_cast<size_t>(record.param_count));
+    for (size_t i = 0; i < count; i++) {
+        Parameter& param = params[i];
+        param.value = std::clamp(record.values[i], param.min, param.max);
+
+        const CVMappingRecord& mapping = record.mappings[i];
+        param.cv_mapping.cv_input = (mapping.cv_input >= -1 && mapping.cv_input < 4) ? mapping.cv_input : -1;
+        param.cv_mapping.active = mapping.active != 0;
+        param.cv_mapping.attenuverter = std::clamp(mapping.attenuverter, -1.0f, 1.0f);
+        param.cv_mapping.origin_offset = std::clamp(mapping.origin_offset, 0.0f, 1.0f);
+    }
+}
+
+} // namespace mutables_ui
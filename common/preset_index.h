@@ -0,0 +1,118 @@
+#pragma once
+
+#include "preset_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace mutables_ui {
+
+// Compact table of the presets stored on the card, kept in RAM and mirrored
+// to <module>/presets/index.idx so the LOAD browser never walks the
+// directory. File layout: header, then fixed-size entries; entry i lives at
+// EntryOffset(i), so a save rewrites one entry plus the header.
+
+static constexpr uint32_t kPresetIndexMagic = 0x5844494D;  // "MIDX"
+static constexpr uint16_t kPresetIndexVersion = 1;
+
+struct PresetIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t module_tag;
+    uint32_t crc;                     // CRC-32 of the `count` entries
+};
+
+struct PresetIndexEntry {
+    char name[kPresetNameLength];
+    uint32_t hash;                    // PresetRecord::crc of the file
+    uint32_t module_tag;
+};
+
+static_assert(sizeof(PresetIndexHeader) == 16, "PresetIndexHeader layout changed");
+static_assert(sizeof(PresetIndexEntry) == 24, "PresetIndexEntry layout changed");
+
+class PresetIndex {
+public:
+    static constexpr int kMaxEntries = 512;
+
+    PresetIndex() : count_(0), module_tag_(0), valid_(false) {}
+
+    void Clear(uint32_t module_tag) {
+        count_ = 0;
+        module_tag_ = module_tag;
+        valid_ = false;
+    }
+
+    // Marks the RAM table as matching the card
+    void SetValid(bool valid) { valid_ = valid; }
+    bool IsValid() const { return valid_; }
+
+    int GetCount() const { return count_; }
+    bool IsFull() const { return count_ >= kMaxEntries; }
+
+    // Constant time, for paging through the browser
+    const PresetIndexEntry& GetEntry(int index) const { return entries_[index]; }
+
+    int Find(const char* name) const {
+        for (int i = 0; i < count_; i++) {
+            if (strncmp(entries_[i].name, name, kPresetNameLength) == 0) return i;
+        }
+        return -1;
+    }
+
+    // Add or update an entry, returns its position or -1 when full
+    int Upsert(const char* name, uint32_t hash, uint32_t module_tag) {
+        int index = Find(name);
+        if (index < 0) {
+            if (IsFull()) return -1;
+            index = count_++;
+            memset(&entries_[index], 0, sizeof(PresetIndexEntry));
+            CopyName(entries_[index].name, name);
+        }
+        entries_[index].hash = hash;
+        entries_[index].module_tag = module_tag;
+        return index;
+    }
+
+    void FillHeader(PresetIndexHeader& header) const {
+        header.magic = kPresetIndexMagic;
+        header.version = kPresetIndexVersion;
+        header.count = static_cast<uint16_t>(count_);
+        header.module_tag = module_tag_;
+        header.crc = Crc32(entries_, count_ * sizeof(PresetIndexEntry));
+    }
+
+    // Header read from the card: accept its count before reading entries
+    bool BeginLoad(const PresetIndexHeader& header) {
+        if (header.magic != kPresetIndexMagic) return false;
+        if (header.version != kPresetIndexVersion) return false;
+        if (header.module_tag != module_tag_) return false;
+        if (header.count > kMaxEntries) return false;
+        count_ = header.count;
+        return true;
+    }
+
+    // Entries read from the card: check them against the header CRC
+    bool EndLoad(const PresetIndexHeader& header) {
+        valid_ = header.crc == Crc32(entries_, count_ * sizeof(PresetIndexEntry));
+        if (!valid_) count_ = 0;
+        return valid_;
+    }
+
+    static size_t EntryOffset(int index) {
+        return sizeof(PresetIndexHeader) + index * sizeof(PresetIndexEntry);
+    }
+
+    // Raw entry storage for chunked reads and writes
+    uint8_t* GetEntryBytes() { return reinterpret_cast<uint8_t*>(entries_); }
+    size_t GetEntryBytesSize() const { return count_ * sizeof(PresetIndexEntry); }
+
+private:
+    PresetIndexEntry entries_[kMaxEntries];
+    int count_;
+    uint32_t module_tag_;
+    bool valid_;
+};
+
+} // namespace mutables_ui
@@ -1,64 +1,540 @@
 #pragma once
 
-#include "fatfs.h"
+#include "file_system.h"
 #include "parameter.h"
-#include <vector>
+#include "preset_format.h"
+#include "preset_index.h"
+#include <cstddef>
+#include <cstdio>
 #include <cstring>
 
 namespace mutables_ui {
 
-// Simple preset structure
-struct Preset {
-    char name[32];
-    std::vector<float> param_values;
-    std::vector<CVMapping> cv_mappings;
-};
-
+// SD card presets: /<module_name>/presets/<preset_name>.bin, one
+// PresetRecord per file, plus index.idx listing them (see preset_index.h).
+// Operations are started with Begin*() and advanced by Poll() from the main
+// loop, one short file system call per Poll(), so a slow card delays a
+// save or load but never the encoder, MIDI or display handling around it.
+//
+// The index is read once at boot and updated entry by entry on save. If it
+// is missing, corrupt, or names a file that no longer exists, it is rebuilt
+// from a directory scan in the background.
 class PresetManager {
 public:
-    PresetManager() : initialized_(false) {}
-    
-    bool Init(const char* module_name) {
+    static constexpr size_t kChunkSize = 128;    // Bytes per read/write call
+    static constexpr size_t kPathLength = 64;
+
+    enum class Operation {
+        None,
+        Save,
+        Load,
+        LoadIndex,
+        RebuildIndex
+    };
+
+    enum class Status {
+        Idle,
+        Busy,
+        Done,
+        Failed,
+        NoCard
+    };
+
+    PresetManager()
+        : fs_(nullptr)
+        , module_name_("")
+        , module_tag_(0)
+        , mounted_(false)
+        , rebuild_pending_(false)
+        , operation_(Operation::None)
+        , status_(Status::Idle)
+        , step_(Step::Idle)
+        , transferred_(0)
+        , entry_index_(-1) {}
+
+    bool Init(FileSystem* fs, const char* module_name) {
+        fs_ = fs;
         module_name_ = module_name;
-        
-        // TODO: Initialize SD card and create directory structure
-        // Path: /<module_name>/presets/
-        
-        initialized_ = true;
-        return initialized_;
-    }
-    
-    bool SavePreset(const char* preset_name, 
-                   const std::vector<Parameter>& params) {
-        if (!initialized_) return false;
-        
-        // TODO: Implement binary or JSON serialization
-        // Path: /<module_name>/presets/<preset_name>.bin
-        
-        return false; // Placeholder
-    }
-    
-    bool LoadPreset(const char* preset_name, 
-                   std::vector<Parameter>& params) {
-        if (!initialized_) return false;
-        
-        // TODO: Implement deserialization
-        
-        return false; // Placeholder
-    }
-    
-    // List available presets
-    std::vector<const char*> ListPresets() {
-        std::vector<const char*> presets;
-        
-        // TODO: Scan directory for preset files
-        
-        return presets;
-    }
-    
+        module_tag_ = ModuleTag(module_name);
+        mounted_ = false;
+        rebuild_pending_ = false;
+        operation_ = Operation::None;
+        status_ = Status::Idle;
+        step_ = Step::Idle;
+        index_.Clear(module_tag_);
+        snprintf(index_path_, sizeof(index_path_), "/%s/presets/index.idx", module_name_);
+        return fs_ != nullptr;
+    }
+
+    // Start writing `record` as <name>.bin (the record is copied)
+    bool BeginSave(const char* preset_name, const PresetRecord& record) {
+        if (!Begin(Operation::Save)) return false;
+        record_ = record;
+        SetPresetPath(preset_name);
+        CopyName(name_, preset_name);
+        step_ = mounted_ ? Step::MakeModuleDir : Step::Mount;
+        return true;
+    }
+
+    // Start reading <name>.bin, result in GetLoaded() once Done
+    bool BeginLoad(const char* preset_name) {
+        if (!Begin(Operation::Load)) return false;
+        SetPresetPath(preset_name);
+        step_ = mounted_ ? Step::Open : Step::Mount;
+        return true;
+    }
+
+    // Read index.idx (boot). Falls back to a rebuild if it is unusable.
+    bool BeginLoadIndex() {
+        if (!Begin(Operation::LoadIndex)) return false;
+        index_.Clear(module_tag_);
+        step_ = mounted_ ? Step::IndexOpen : Step::Mount;
+        return true;
+    }
+
+    // Rebuild index.idx from the preset files
+    bool BeginRebuildIndex() {
+        if (!Begin(Operation::RebuildIndex)) return false;
+        rebuild_pending_ = false;
+        index_.Clear(module_tag_);
+        step_ = mounted_ ? Step::ScanOpenDir : Step::Mount;
+        return true;
+    }
+
+    // Main loop: advance the current operation by one file system call
+    void Poll() {
+        if (status_ == Status::Idle && rebuild_pending_) {
+            BeginRebuildIndex();
+        }
+        if (status_ != Status::Busy) return;
+
+        switch (step_) {
+            case Step::Mount:
+                if (fs_->Mount() != FileSystem::Result::Ok) {
+                    Finish(Status::NoCard);
+                    return;
+                }
+                mounted_ = true;
+                step_ = operation_ == Operation::Save ? Step::MakeModuleDir
+                      : operation_ == Operation::Load ? Step::Open
+                      : operation_ == Operation::LoadIndex ? Step::IndexOpen
+                      : Step::ScanOpenDir;
+                break;
+
+            case Step::MakeModuleDir: {
+                char dir[kPathLength];
+                snprintf(dir, sizeof(dir), "/%s", module_name_);
+                if (!Check(fs_->MakeDir(dir), true)) return;
+                step_ = Step::MakePresetDir;
+                break;
+            }
+
+            case Step::MakePresetDir: {
+                char dir[kPathLength];
+                snprintf(dir, sizeof(dir), "/%s/presets", module_name_);
+                if (!Check(fs_->MakeDir(dir), true)) return;
+                step_ = Step::Open;
+                break;
+            }
+
+            // Preset file
+
+            case Step::Open: {
+                bool save = operation_ == Operation::Save;
+                FileSystem::Result res = fs_->Open(path_, save ? FileSystem::OpenMode::Write
+                                                               : FileSystem::OpenMode::Read);
+                if (res == FileSystem::Result::NotFound) {
+                    // Listed but gone: the index is stale
+                    rebuild_pending_ = true;
+                    Finish(Status::Failed);
+                    return;
+                }
+                if (!Check(res, false)) return;
+                transferred_ = 0;
+                step_ = Step::Transfer;
+                break;
+            }
+
+            case Step::Transfer: {
+                uint8_t* bytes = reinterpret_cast<uint8_t*>(&record_);
+                size_t chunk = NextChunk(sizeof(record_));
+                if (operation_ == Operation::Save) {
+                    if (!Check(fs_->Write(bytes + transferred_, chunk), false)) return;
+                } else if (!ReadExactly(bytes + transferred_, chunk)) {
+                    return;
+                }
+                transferred_ += chunk;
+                if (transferred_ >= sizeof(record_)) {
+                    step_ = Step::Close;
+                }
+                break;
+            }
+
+            case Step::Close:
+                if (!Check(fs_->Close(), false)) return;
+                if (operation_ == Operation::Load) {
+                    Finish(PresetIsValid(record_, module_tag_) ? Status::Done : Status::Failed);
+                    return;
+                }
+                // Saved: update its index entry, or rebuild if the index was never read
+                if (!index_.IsValid()) {
+                    rebuild_pending_ = true;
+                    Finish(Status::Done);
+                    return;
+                }
+                entry_index_ = index_.Upsert(name_, record_.crc, record_.module_tag);
+                if (entry_index_ < 0) {
+                    Finish(Status::Done);  // Index full, the file is saved anyway
+                    return;
+                }
+                index_.FillHeader(index_header_);
+                step_ = Step::IndexUpdateOpen;
+                break;
+
+            // Incremental index update: one entry, then the header
+
+            case Step::IndexUpdateOpen:
+                if (!Check(fs_->Open(index_path_, FileSystem::OpenMode::Update), false)) return;
+                step_ = Step::IndexUpdateSeekEntry;
+                break;
+
+            case Step::IndexUpdateSeekEntry:
+                if (!Check(fs_->Seek(PresetIndex::EntryOffset(entry_index_)), false)) return;
+                step_ = Step::IndexUpdateWriteEntry;
+                break;
+
+            case Step::IndexUpdateWriteEntry:
+                if (!Check(fs_->Write(&index_.GetEntry(entry_index_), sizeof(PresetIndexEntry)), false)) return;
+                step_ = Step::IndexUpdateSeekHeader;
+                break;
+
+            case Step::IndexUpdateSeekHeader:
+                if (!Check(fs_->Seek(0), false)) return;
+                step_ = Step::IndexUpdateWriteHeader;
+                break;
+
+            case Step::IndexUpdateWriteHeader:
+                if (!Check(fs_->Write(&index_header_, sizeof(index_header_)), false)) return;
+                step_ = Step::IndexClose;
+                break;
+
+            // Index load
+
+            case Step::IndexOpen: {
+                FileSystem::Result res = fs_->Open(index_path_, FileSystem::OpenMode::Read);
+                if (res == FileSystem::Result::NotFound) {
+                    StartRebuild();
+                    return;
+                }
+                if (!Check(res, false)) return;
+                step_ = Step::IndexReadHeader;
+                break;
+            }
+
+            case Step::IndexReadHeader: {
+                size_t read = 0;
+                if (!Check(fs_->Read(&index_header_, sizeof(index_header_), &read), false)) return;
+                if (read != sizeof(index_header_) || !index_.BeginLoad(index_header_)) {
+                    fs_->Close();
+                    StartRebuild();
+                    return;
+                }
+                transferred_ = 0;
+                step_ = index_.GetEntryBytesSize() > 0 ? Step::IndexReadEntries : Step::IndexClose;
+                break;
+            }
+
+            case Step::IndexReadEntries: {
+                size_t chunk = NextChunk(index_.GetEntryBytesSize());
+                size_t read = 0;
+                if (!Check(fs_->Read(index_.GetEntryBytes() + transferred_, chunk, &read), false)) return;
+                if (read != chunk) {
+                    fs_->Close();
+                    StartRebuild();
+                    return;
+                }
+                transferred_ += chunk;
+                if (transferred_ >= index_.GetEntryBytesSize()) {
+                    step_ = Step::IndexClose;
+                }
+                break;
+            }
+
+            case Step::IndexClose:
+                if (!Check(fs_->Close(), false)) return;
+                if (operation_ == Operation::LoadIndex && !index_.EndLoad(index_header_)) {
+                    StartRebuild();
+                    return;
+                }
+                Finish(Status::Done);
+                break;
+
+            // Rebuild: scan the directory, probe each preset file
+
+            case Step::ScanOpenDir: {
+                FileSystem::Result res = fs_->OpenDir(path_);
+                if (res == FileSystem::Result::NotFound) {
+                    index_.SetValid(true);  // No preset saved yet
+                    Finish(Status::Done);
+                    return;
+                }
+                if (!Check(res, false)) return;
+                step_ = Step::ScanReadDir;
+                break;
+            }
+
+            case Step::ScanReadDir: {
+                char file_name[kPathLength];
+                bool end = false;
+                if (!Check(fs_->ReadDir(file_name, sizeof(file_name), &end), false)) return;
+                if (end || index_.IsFull()) {
+                    step_ = Step::ScanCloseDir;
+                } else if (PresetNameFromFile(file_name, name_)) {
+                    snprintf(probe_path_, sizeof(probe_path_), "%s/%s", path_, file_name);
+                    step_ = Step::ProbeOpen;
+                }
+                break;
+            }
+
+            case Step::ProbeOpen:
+                // Unreadable files are left out of the index
+                step_ = fs_->Open(probe_path_, FileSystem::OpenMode::Read) == FileSystem::Result::Ok
+                      ? Step::ProbeReadHeader : Step::ScanReadDir;
+                break;
+
+            case Step::ProbeReadHeader: {
+                // magic, version, param_count, module_tag
+                size_t read = 0;
+                fs_->Read(&record_, offsetof(PresetRecord, name), &read);
+                bool ok = read == offsetof(PresetRecord, name)
+                       && record_.magic == kPresetMagic
+                       && record_.version == kPresetVersion
+                       && record_.module_tag == module_tag_;
+                step_ = ok ? Step::ProbeSeekCrc : Step::ProbeClose;
+                break;
+            }
+
+            case Step::ProbeSeekCrc:
+                step_ = fs_->Seek(offsetof(PresetRecord, crc)) == FileSystem::Result::Ok
+                      ? Step::ProbeReadCrc : Step::ProbeClose;
+                break;
+
+            case Step::ProbeReadCrc: {
+                size_t read = 0;
+                fs_->Read(&record_.crc, sizeof(record_.crc), &read);
+                if (read == sizeof(record_.crc)) {
+                    index_.Upsert(name_, record_.crc, record_.module_tag);
+                }
+                step_ = Step::ProbeClose;
+                break;
+            }
+
+            case Step::ProbeClose:
+                fs_->Close();
+                step_ = Step::ScanReadDir;
+                break;
+
+            case Step::ScanCloseDir:
+                fs_->CloseDir();
+                index_.SetValid(true);
+                index_.FillHeader(index_header_);
+                step_ = Step::IndexWriteOpen;
+                break;
+
+            // Full index write after a rebuild
+
+            case Step::IndexWriteOpen:
+                if (!Check(fs_->Open(index_path_, FileSystem::OpenMode::Write), false)) return;
+                step_ = Step::IndexWriteHeader;
+                break;
+
+            case Step::IndexWriteHeader:
+                if (!Check(fs_->Write(&index_header_, sizeof(index_header_)), false)) return;
+                transferred_ = 0;
+                step_ = index_.GetEntryBytesSize() > 0 ? Step::IndexWriteEntries : Step::IndexClose;
+                break;
+
+            case Step::IndexWriteEntries: {
+                size_t chunk = NextChunk(index_.GetEntryBytesSize());
+                if (!Check(fs_->Write(index_.GetEntryBytes() + transferred_, chunk), false)) return;
+                transferred_ += chunk;
+                if (transferred_ >= index_.GetEntryBytesSize()) {
+                    step_ = Step::IndexClose;
+                }
+                break;
+            }
+
+            case Step::Idle:
+            default:
+                break;
+        }
+    }
+
+    bool IsBusy() const { return status_ == Status::Busy; }
+    Status GetStatus() const { return status_; }
+    Operation GetOperation() const { return operation_; }
+
+    bool IsIndexing() const {
+        return status_ == Status::Busy
+            && (operation_ == Operation::LoadIndex || operation_ == Operation::RebuildIndex);
+    }
+
+    // 0.0 to 1.0 for save/load, presets indexed / capacity while indexing
+    float GetProgress() const {
+        if (status_ == Status::Done) return 1.0f;
+        if (operation_ == Operation::LoadIndex || operation_ == Operation::RebuildIndex) {
+            return static_cast<float>(index_.GetCount()) / PresetIndex::kMaxEntries;
+        }
+        return static_cast<float>(transferred_) / sizeof(record_);
+    }
+
+    // Back to Idle once the UI has shown a Done/Failed/NoCard result
+    void Acknowledge() {
+        if (status_ != Status::Busy) {
+            status_ = Status::Idle;
+            operation_ = Operation::None;
+        }
+    }
+
+    // Valid after a successful load
+    const PresetRecord& GetLoaded() const { return record_; }
+
+    const PresetIndex& GetIndex() const { return index_; }
+
+    // Browser access, served from the RAM index in constant time
+    int GetListCount() const { return index_.GetCount(); }
+
+    const char* GetListName(int index) const {
+        if (index < 0 || index >= index_.GetCount()) return "";
+        return index_.GetEntry(index).name;
+    }
+
 private:
-    bool initialized_;
+    enum class Step {
+        Idle,
+        Mount,
+        MakeModuleDir,
+        MakePresetDir,
+        Open,
+        Transfer,
+        Close,
+        IndexUpdateOpen,
+        IndexUpdateSeekEntry,
+        IndexUpdateWriteEntry,
+        IndexUpdateSeekHeader,
+        IndexUpdateWriteHeader,
+        IndexOpen,
+        IndexReadHeader,
+        IndexReadEntries,
+        IndexClose,
+        ScanOpenDir,
+        ScanReadDir,
+        ProbeOpen,
+        ProbeReadHeader,
+        ProbeSeekCrc,
+        ProbeReadCrc,
+        ProbeClose,
+        ScanCloseDir,
+        IndexWriteOpen,
+        IndexWriteHeader,
+        IndexWriteEntries
+    };
+
+    FileSystem* fs_;
     const char* module_name_;
+    uint32_t module_tag_;
+    bool mounted_;
+    bool rebuild_pending_;
+
+    Operation operation_;
+    Status status_;
+    Step step_;
+
+    char path_[kPathLength];
+    char index_path_[kPathLength];
+    char probe_path_[kPathLength * 2];
+    char name_[kPresetNameLength];
+    PresetRecord record_;
+    size_t transferred_;
+
+    PresetIndex index_;
+    PresetIndexHeader index_header_;
+    int entry_index_;
+
+    bool Begin(Operation operation) {
+        if (!fs_ || status_ == Status::Busy) return false;
+        operation_ = operation;
+        status_ = Status::Busy;
+        transferred_ = 0;
+        if (operation == Operation::LoadIndex || operation == Operation::RebuildIndex) {
+            snprintf(path_, sizeof(path_), "/%s/presets", module_name_);
+        }
+        return true;
+    }
+
+    void SetPresetPath(const char* preset_name) {
+        snprintf(path_, sizeof(path_), "/%s/presets/%.15s.bin", module_name_, preset_name);
+    }
+
+    size_t NextChunk(size_t total) const {
+        size_t chunk = total - transferred_;
+        return chunk > kChunkSize ? kChunkSize : chunk;
+    }
+
+    bool ReadExactly(void* data, size_t size) {
+        size_t read = 0;
+        if (!Check(fs_->Read(data, size, &read), false)) return false;
+        if (read != size) {
+            Fail();
+            return false;
+        }
+        return true;
+    }
+
+    // Index unusable: carry on in the same operation as a rebuild
+    void StartRebuild() {
+        operation_ = Operation::RebuildIndex;
+        index_.Clear(module_tag_);
+        step_ = Step::ScanOpenDir;
+    }
+
+    void Finish(Status status) {
+        status_ = status;
+        step_ = Step::Idle;
+    }
+
+    // Release whatever is open and report the failure
+    void Fail() {
+        if (step_ == Step::ScanReadDir) {
+            fs_->CloseDir();
+        } else {
+            fs_->Close();
+        }
+        Finish(Status::Failed);
+    }
+
+    bool Check(FileSystem::Result res, bool exists_ok) {
+        if (res == FileSystem::Result::Ok) return true;
+        if (exists_ok && res == FileSystem::Result::Exists) return true;
+        if (res == FileSystem::Result::NoCard) {
+            mounted_ = false;
+            Finish(Status::NoCard);
+            return false;
+        }
+        Fail();
+        return false;
+    }
+
+    // "<name>.bin" -> "<name>", false for other files (index.idx, ...)
+    static bool PresetNameFromFile(const char* file_name, char* name) {
+        size_t len = strlen(file_name);
+        if (len <= 4 || strcmp(file_name + len - 4, ".bin") != 0) return false;
+        len -= 4;
+        if (len >= kPresetNameLength) len = kPresetNameLength - 1;
+        memcpy(name, file_name, len);
+        name[len] = '\0';
+        return true;
+    }
 };
 
 } // namespace mutables_ui
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "parameter.h"
+#include "preset_format.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Interpolates parameter values between preset corners at block rate.
+// Line layout: two presets A-B along X. XY layout: four presets at the
+// corners of a square (A bottom-left, B bottom-right, C top-left, D top-right).
+// Continuous values are blended with bilinear weights in one flat loop over
+// contiguous arrays; Enum/Toggle/Integer values (bank, engine, ...) jump to
+// the nearest corner when the position crosses the middle.
+//
+// Only the audio callback enables and disables the morph (on commands from
+// the main loop), so it never changes state under a Process() call. The
+// main loop loads corners while IsEnabled() is false and no enable is
+// queued; the position may be written from anywhere. A parameter the user
+// edits during a morph is held: the morph leaves it alone until it is
+// enabled again.
+class PresetMorph {
+public:
+    enum class Layout {
+        Line,
+        XY
+    };
+
+    static constexpr int kNumCorners = 4;
+
+    PresetMorph()
+        : count_(0)
+        , discrete_count_(0)
+        , layout_(Layout::Line)
+        , enabled_(false)
+        , x_(0.0f)
+        , y_(0.0f)
+        , last_corner_(-1)
+        , held_() {}
+
+    // Main loop, morph disabled (or audio stopped).
+    // `params` only provides the parameter types.
+    void Init(const Parameter* params, size_t count) {
+        count_ = count < kMaxParameters ? count : kMaxParameters;
+        discrete_count_ = 0;
+        for (size_t i = 0; i < count_; i++) {
+            if (params[i].type == ParamType::Enum
+                || params[i].type == ParamType::Toggle
+                || params[i].type == ParamType::Integer) {
+                discrete_[discrete_count_++] = static_cast<uint8_t>(i);
+            }
+        }
+    }
+
+    // Main loop, morph disabled. Line layout uses corners 0 and 1 only.
+    void SetCorner(int corner, const PresetRecord& record) {
+        if (corner < 0 || corner >= kNumCorners) return;
+        size_t n = record.param_count < count_ ? record.param_count : count_;
+        for (size_t i = 0; i < n; i++) {
+            corners_[corner][i] = record.values[i];
+        }
+        // Missing values (older or shorter records) repeat corner A
+        for (size_t i = n; i < count_; i++) {
+            corners_[corner][i] = corner > 0 ? corners_[0][i] : 0.0f;
+        }
+    }
+
+    void SetLayout(Layout layout) {
+        layout_ = layout;
+        if (layout == Layout::Line) {
+            // Collapse Y so the XY code path gives the A-B line
+            for (size_t i = 0; i < count_; i++) {
+                corners_[2][i] = corners_[0][i];
+                corners_[3][i] = corners_[1][i];
+            }
+        }
+    }
+
+    // Audio callback, or main loop with audio stopped. Enabling releases
+    // held parameters.
+    void SetEnabled(bool enabled) {
+        last_corner_ = -1;
+        if (enabled) {
+            for (size_t i = 0; i < kMaxParameters; i++) held_[i] = false;
+        }
+        enabled_.store(enabled, std::memory_order_release);
+    }
+
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_acquire);
+    }
+
+    Layout GetLayout() const { return layout_; }
+
+    // Any thread: position from CV or MIDI CC, 0.0 to 1.0
+    void SetPosition(float x, float y) {
+        x_.store(x, std::memory_order_relaxed);
+        y_.store(y, std::memory_order_relaxed);
+    }
+
+    void SetX(float x) { x_.store(x, std::memory_order_relaxed); }
+    void SetY(float y) { y_.store(y, std::memory_order_relaxed); }
+
+    // Audio callback, once per block. Writes count values to out.
+    // Returns true when the discrete values switched corner, so the module
+    // can resync state that depends on them (engine lists, ...).
+    bool Process(float* out) {
+        float x = Clamp01(x_.load(std::memory_order_relaxed));
+        float y = layout_ == Layout::XY ? Clamp01(y_.load(std::memory_order_relaxed)) : 0.0f;
+
+        float w0 = (1.0f - x) * (1.0f - y);
+        float w1 = x * (1.0f - y);
+        float w2 = (1.0f - x) * y;
+        float w3 = x * y;
+
+        const float* a = corners_[0];
+        const float* b = corners_[1];
+        const float* c = corners_[2];
+        const float* d = corners_[3];
+        for (size_t i = 0; i < count_; i++) {
+            out[i] = w0 * a[i] + w1 * b[i] + w2 * c[i] + w3 * d[i];
+        }
+
+        // Discrete values come from the nearest corner
+        int corner = (x >= 0.5f ? 1 : 0) + (y >= 0.5f ? 2 : 0);
+        const float* nearest = corners_[corner];
+        for (size_t i = 0; i < discrete_count_; i++) {
+            out[discrete_[i]] = nearest[discrete_[i]];
+        }
+
+        bool switched = corner != last_corner_;
+        last_corner_ = corner;
+        return switched;
+    }
+
+    // Audio callback: a user edit to parameter `index` wins over the morph
+    void Hold(size_t index) {
+        if (index < kMaxParameters && IsEnabled()) held_[index] = true;
+    }
+
+    bool IsHeld(size_t index) const { return held_[index]; }
+
+    size_t GetCount() const { return count_; }
+
+private:
+    static float Clamp01(float v) {
+        return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    }
+
+    alignas(16) float corners_[kNumCorners][kMaxParameters];
+    uint8_t discrete_[kMaxParameters];
+    size_t count_;
+    size_t discrete_count_;
+    Layout layout_;
+    std::atomic<bool> enabled_;
+    std::atomic<float> x_;
+    std::atomic<float> y_;
+    int last_corner_;
+    bool held_[kMaxParameters];          // Edited by the user during this morph
+};
+
+} // namespace mutables_ui
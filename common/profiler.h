@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace mutables_ui {
+
+// Table of named counters for on-target profiling.
+// Entries are registered once at init, then updated from anywhere with
+// their id. Values written from the audio callback and read from the main
+// loop are not synchronized: a report may mix two updates, which is fine
+// for statistics but not for control data.
+class Profiler {
+public:
+    static constexpr int kMaxEntries = 24;
+
+    struct Entry {
+        const char* name;
+        const char* unit;
+        uint32_t last;
+        uint32_t max;
+        uint32_t count;
+        uint64_t sum;
+    };
+
+    Profiler() : entry_count_(0) {}
+
+    // Returns the entry id, or -1 when the table is full
+    int Register(const char* name, const char* unit) {
+        if (entry_count_ >= kMaxEntries) return -1;
+        Entry& e = entries_[entry_count_];
+        e.name = name;
+        e.unit = unit;
+        e.last = 0;
+        e.max = 0;
+        e.count = 0;
+        e.sum = 0;
+        return entry_count_++;
+    }
+
+    // Record one sample (durations, per-block costs, ...)
+    void Record(int id, uint32_t value) {
+        if (id < 0 || id >= entry_count_) return;
+        Entry& e = entries_[id];
+        e.last = value;
+        if (value > e.max) e.max = value;
+        e.count++;
+        e.sum += value;
+    }
+
+    // Overwrite a gauge (bytes used, totals computed elsewhere, ...)
+    void Set(int id, uint32_t value) {
+        if (id < 0 || id >= entry_count_) return;
+        Entry& e = entries_[id];
+        e.last = value;
+        if (value > e.max) e.max = value;
+    }
+
+    // Average of recorded samples (the current value for gauges)
+    uint32_t GetAverage(int id) const {
+        if (id < 0 || id >= entry_count_) return 0;
+        if (entries_[id].count == 0) return entries_[id].last;
+        return static_cast<uint32_t>(entries_[id].sum / entries_[id].count);
+    }
+
+    const Entry& GetEntry(int id) const { return entries_[id]; }
+    int GetEntryCount() const { return entry_count_; }
+
+    // Find an entry by name, -1 if absent
+    int Find(const char* name) const {
+        for (int i = 0; i < entry_count_; i++) {
+            if (strcmp(entries_[i].name, name) == 0) return i;
+        }
+        return -1;
+    }
+
+    // Clear accumulated samples, keep registrations
+    void ResetStats() {
+        for (int i = 0; i < entry_count_; i++) {
+            entries_[i].last = 0;
+            entries_[i].max = 0;
+            entries_[i].count = 0;
+            entries_[i].sum = 0;
+        }
+    }
+
+    // Print one line per entry through `print(const char* line)`
+    template <typename PrintFn>
+    void Report(PrintFn print) const {
+        char line[64];
+        for (int i = 0; i < entry_count_; i++) {
+            const Entry& e = entries_[i];
+            snprintf(line, sizeof(line), "%-14s last %lu avg %lu max %lu %s",
+                     e.name,
+                     static_cast<unsigned long>(e.last),
+                     static_cast<unsigned long>(GetAverage(i)),
+                     static_cast<unsigned long>(e.max),
+                     e.unit);
+            print(line);
+        }
+    }
+
+private:
+    Entry entries_[kMaxEntries];
+    int entry_count_;
+};
+
+} // namespace mutables_ui
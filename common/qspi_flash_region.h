@@ -0,0 +1,240 @@
+#pragma once
+
+#include "daisy_patch.h"
+#include "flash_region.h"
+
+namespace mutables_ui {
+
+#ifdef MUTABLES_XIP_QSPI
+// Runs from RAM: placed in .RamFunc, which the linker script loads with
+// .data and the startup code copies out of QSPI
+#define MUTABLES_RAM_FUNC __attribute__((section(".RamFunc"), noinline, long_call))
+#define MUTABLES_RAM_INLINE __attribute__((always_inline)) static inline
+
+// Sector erase and page program on the chip the firmware executes from
+// (APP_TYPE = BOOT_QSPI). From leaving memory-mapped mode until returning
+// to it nothing may be fetched from QSPI, so each operation is a RAM
+// function that drives the QUADSPI registers itself (libDaisy and the HAL
+// live in QSPI) with interrupts masked (so do the handlers and the vector
+// table). The memory-mapped configuration libDaisy set up is saved and
+// restored as found, continuous read mode included.
+//
+// Interrupts stay masked for one operation: a 4KB sector erase (tens of
+// ms, a few hundred worst case on the IS25LP parts) or one 256-byte page
+// (under 1 ms). Code between operations runs from QSPI as usual. No
+// jump tables, library calls or constant data outside the functions.
+struct QspiXip {
+    static constexpr uint32_t kPageSize = 256;
+
+    // Chip commands (IS25LP064A / IS25LP080D, single line)
+    static constexpr uint32_t kWriteEnable = 0x06;
+    static constexpr uint32_t kReadStatus = 0x05;
+    static constexpr uint32_t kSectorErase = 0x20;
+    static constexpr uint32_t kPageProgram = 0x02;
+    static constexpr uint8_t kStatusBusy = 0x01;
+
+    // Status polls before giving up on an erase (over 1 s) or a page, and
+    // register polls before giving up on the peripheral
+    static constexpr uint32_t kEraseTimeout = 1u << 22;
+    static constexpr uint32_t kProgramTimeout = 1u << 16;
+    static constexpr uint32_t kFlagTimeout = 1u << 16;
+
+    // Erase the 4KB sector at chip address address
+    MUTABLES_RAM_FUNC static bool EraseSector(uint32_t address) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint32_t mapped_ccr = QUADSPI->CCR;
+        uint32_t mapped_abr = QUADSPI->ABR;
+        LeaveMemoryMapped(mapped_ccr);
+
+        bool ok = WriteEnable();
+        if (ok) {
+            WaitIdle();
+            QUADSPI->CCR = kSectorErase | QUADSPI_CCR_IMODE_0 | QUADSPI_CCR_ADMODE_0 | QUADSPI_CCR_ADSIZE_1;
+            QUADSPI->AR = address;
+            ok = WaitComplete() && WaitReady(kEraseTimeout);
+        }
+
+        EnterMemoryMapped(mapped_ccr, mapped_abr);
+        __set_PRIMASK(primask);
+        return ok;
+    }
+
+    // Program size bytes (at most to the end of the page) from RAM at data
+    MUTABLES_RAM_FUNC static bool ProgramPage(uint32_t address, const uint8_t* data, uint32_t size) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint32_t mapped_ccr = QUADSPI->CCR;
+        uint32_t mapped_abr = QUADSPI->ABR;
+        LeaveMemoryMapped(mapped_ccr);
+
+        bool ok = WriteEnable();
+        if (ok) {
+            WaitIdle();
+            QUADSPI->DLR = size - 1;
+            QUADSPI->CCR = kPageProgram | QUADSPI_CCR_IMODE_0 | QUADSPI_CCR_ADMODE_0 | QUADSPI_CCR_ADSIZE_1
+                         | QUADSPI_CCR_DMODE_0;
+            QUADSPI->AR = address;
+            volatile uint8_t* dr = reinterpret_cast<volatile uint8_t*>(&QUADSPI->DR);
+            for (uint32_t i = 0; i < size && ok; i++) {
+                ok = WaitFlag(QUADSPI_SR_FTF);
+                if (ok) *dr = data[i];
+            }
+            ok = ok && WaitComplete() && WaitReady(kProgramTimeout);
+        }
+
+        EnterMemoryMapped(mapped_ccr, mapped_abr);
+        __set_PRIMASK(primask);
+        return ok;
+    }
+
+    // False if the linker left the functions above in QSPI
+    static bool InRam() {
+        uintptr_t address = reinterpret_cast<uintptr_t>(&EraseSector);
+        return address < 0x90000000 || address >= 0xA0000000;
+    }
+
+private:
+    MUTABLES_RAM_INLINE void WaitIdle() {
+        while (QUADSPI->SR & QUADSPI_SR_BUSY) {}
+    }
+
+    MUTABLES_RAM_INLINE bool WaitFlag(uint32_t flag) {
+        for (uint32_t n = 0; n < kFlagTimeout; n++) {
+            if (QUADSPI->SR & flag) return true;
+        }
+        return false;
+    }
+
+    // Transfer complete, flag cleared for the next command
+    MUTABLES_RAM_INLINE bool WaitComplete() {
+        if (!WaitFlag(QUADSPI_SR_TCF)) return false;
+        QUADSPI->FCR = QUADSPI_FCR_CTCF;
+        return true;
+    }
+
+    MUTABLES_RAM_INLINE void LeaveMemoryMapped(uint32_t mapped_ccr) {
+        QUADSPI->CR |= QUADSPI_CR_ABORT;
+        while (QUADSPI->CR & QUADSPI_CR_ABORT) {}
+        WaitIdle();
+        // Continuous read (instruction sent once, mode bits as alternate
+        // bytes): the chip expects another address, not a command. One read
+        // in the same format with mode bits 0 takes it out of that mode.
+        if ((mapped_ccr & QUADSPI_CCR_SIOO) && (mapped_ccr & QUADSPI_CCR_ABMODE)) {
+            QUADSPI->ABR = 0;
+            QUADSPI->DLR = 0;
+            QUADSPI->CCR = (mapped_ccr & ~(QUADSPI_CCR_FMODE | QUADSPI_CCR_SIOO | QUADSPI_CCR_IMODE
+                                           | QUADSPI_CCR_INSTRUCTION))
+                         | QUADSPI_CCR_FMODE_0;
+            QUADSPI->AR = 0;
+            if (WaitComplete()) (void)*reinterpret_cast<volatile uint8_t*>(&QUADSPI->DR);
+            WaitIdle();
+        }
+    }
+
+    MUTABLES_RAM_INLINE void EnterMemoryMapped(uint32_t mapped_ccr, uint32_t mapped_abr) {
+        WaitIdle();
+        QUADSPI->FCR = QUADSPI_FCR_CTEF | QUADSPI_FCR_CTCF | QUADSPI_FCR_CSMF | QUADSPI_FCR_CTOF;
+        QUADSPI->ABR = mapped_abr;
+        QUADSPI->CCR = mapped_ccr;
+        __DSB();
+        __ISB();
+    }
+
+    MUTABLES_RAM_INLINE bool WriteEnable() {
+        WaitIdle();
+        QUADSPI->CCR = kWriteEnable | QUADSPI_CCR_IMODE_0;
+        return WaitComplete();
+    }
+
+    MUTABLES_RAM_INLINE bool WaitReady(uint32_t timeout) {
+        for (uint32_t n = 0; n < timeout; n++) {
+            WaitIdle();
+            QUADSPI->DLR = 0;
+            QUADSPI->CCR = kReadStatus | QUADSPI_CCR_IMODE_0 | QUADSPI_CCR_DMODE_0 | QUADSPI_CCR_FMODE_0;
+            if (!WaitComplete()) return false;
+            uint8_t status = *reinterpret_cast<volatile uint8_t*>(&QUADSPI->DR);
+            if (!(status & kStatusBusy)) return true;
+        }
+        return false;
+    }
+};
+#endif
+
+// FlashRegion over a reserved range of the Daisy QSPI flash. Reads go
+// through the memory-mapped window. Writes go through the libDaisy driver,
+// or through QspiXip on builds that execute from QSPI, since the driver
+// reinitialises the peripheral and would pull the code out from under
+// itself.
+class QspiFlashRegion : public FlashRegion {
+public:
+    static constexpr uint32_t kMappedBase = 0x90000000;
+    static constexpr uint32_t kMappedSize = 0x10000000;
+    static constexpr size_t kSectorSize = 4096;
+
+    QspiFlashRegion() : qspi_(nullptr), offset_(0), size_(0) {}
+
+    // offset and size must be sector aligned, and clear of the firmware image
+    void Init(daisy::QSPIHandle* qspi, uint32_t offset, size_t size) {
+        qspi_ = qspi;
+        offset_ = offset;
+        size_ = size;
+    }
+
+    // Memory-mapped address from the driver (0x90000000 + offset on target)
+    const uint8_t* GetData() const override {
+        return static_cast<const uint8_t*>(qspi_->GetData(offset_));
+    }
+
+    size_t GetSize() const override { return size_; }
+    size_t GetSectorSize() const override { return kSectorSize; }
+
+    bool EraseSector(size_t offset) override {
+        if (!qspi_ || offset >= size_) return false;
+        uint32_t address = offset_ + (offset & ~(kSectorSize - 1));
+#ifdef MUTABLES_XIP_QSPI
+        bool ok = QspiXip::EraseSector(address);
+        InvalidateMapped(address, kSectorSize);
+        return ok;
+#else
+        return qspi_->EraseSector(kMappedBase + address) == daisy::QSPIHandle::Result::OK;
+#endif
+    }
+
+    // data must not point into the QSPI window itself
+    bool Program(size_t offset, const void* data, size_t size) override {
+        if (!qspi_ || offset + size > size_) return false;
+        uint32_t address = offset_ + offset;
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        if (reinterpret_cast<uintptr_t>(bytes) - kMappedBase < kMappedSize) return false;
+#ifdef MUTABLES_XIP_QSPI
+        bool ok = true;
+        for (size_t done = 0; done < size && ok;) {
+            uint32_t page_left = QspiXip::kPageSize - ((address + done) & (QspiXip::kPageSize - 1));
+            uint32_t chunk = size - done < page_left ? static_cast<uint32_t>(size - done) : page_left;
+            ok = QspiXip::ProgramPage(address + done, bytes + done, chunk);
+            done += chunk;
+        }
+        InvalidateMapped(address, size);
+        return ok;
+#else
+        return qspi_->Write(kMappedBase + address, size, const_cast<uint8_t*>(bytes))
+            == daisy::QSPIHandle::Result::OK;
+#endif
+    }
+
+private:
+#ifdef MUTABLES_XIP_QSPI
+    // Drop cached lines of the window so reads see the new contents
+    static void InvalidateMapped(uint32_t address, size_t size) {
+        SCB_InvalidateDCache_by_Addr(reinterpret_cast<uint32_t*>(kMappedBase + address),
+                                     static_cast<int32_t>(size));
+    }
+#endif
+
+    daisy::QSPIHandle* qspi_;
+    uint32_t offset_;
+    size_t size_;
+};
+
+} // namespace mutables_ui
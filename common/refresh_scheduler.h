@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// Decides when the main loop should redraw the OLED.
+// - Full rate (~60 Hz) while something moves: encoder, CV, value changes
+// - A few Hz once nothing happened for a while
+// - No redraw at all while the audio callback is heavily loaded
+// It also estimates how much main-loop time was saved compared with the
+// previous fixed 60 Hz refresh, from the measured cost of each redraw.
+class RefreshScheduler {
+public:
+    static constexpr uint32_t kActiveIntervalMs = 16;    // ~60 Hz
+    static constexpr uint32_t kIdleIntervalMs = 250;     // 4 Hz
+    static constexpr uint32_t kIdleTimeoutMs = 1500;     // Activity to idle
+    static constexpr float kSuspendLoad = 0.9f;          // Stop redrawing above
+    static constexpr float kResumeLoad = 0.8f;           // Resume below
+
+    RefreshScheduler()
+        : start_ms_(0)
+        , last_render_ms_(0)
+        , last_activity_ms_(0)
+        , suspended_(false)
+        , dirty_(true)
+        , pending_activity_(false)
+        , render_count_(0)
+        , render_cost_us_(0) {}
+
+    void Init(uint32_t now_ms) {
+        start_ms_ = now_ms;
+        last_render_ms_ = now_ms;
+        last_activity_ms_ = now_ms;
+        suspended_ = false;
+        dirty_ = true;
+        render_count_ = 0;
+        render_cost_us_ = 0;
+    }
+
+    // Main loop: encoder turned/pressed, page or value changed
+    void NotifyActivity(uint32_t now_ms) {
+        last_activity_ms_ = now_ms;
+        dirty_ = true;
+    }
+
+    // Audio callback: CV moved a parameter. Picked up by the next
+    // ShouldRender() call, never blocks.
+    void NotifyActivityFromAudio() {
+        pending_activity_.store(true, std::memory_order_relaxed);
+    }
+
+    // audio_load: 0.0 to 1.0, from the audio callback CPU meter
+    bool ShouldRender(uint32_t now_ms, float audio_load) {
+        if (pending_activity_.exchange(false, std::memory_order_relaxed)) {
+            NotifyActivity(now_ms);
+        }
+
+        if (suspended_) {
+            suspended_ = audio_load > kResumeLoad;
+        } else {
+            suspended_ = audio_load > kSuspendLoad;
+        }
+        if (suspended_) return false;
+
+        uint32_t elapsed = now_ms - last_render_ms_;
+        if (elapsed < kActiveIntervalMs) return false;
+        if (dirty_) return true;
+        return elapsed >= GetIntervalMs(now_ms);
+    }
+
+    // Call after each redraw with its measured duration
+    void OnRendered(uint32_t now_ms, uint32_t cost_us) {
+        last_render_ms_ = now_ms;
+        dirty_ = false;
+        render_count_++;
+        // Running average of the redraw cost
+        if (render_cost_us_ == 0) {
+            render_cost_us_ = cost_us;
+        } else {
+            render_cost_us_ = (render_cost_us_ * 7 + cost_us) / 8;
+        }
+    }
+
+    uint32_t GetIntervalMs(uint32_t now_ms) const {
+        bool idle = (now_ms - last_activity_ms_) > kIdleTimeoutMs;
+        return idle ? kIdleIntervalMs : kActiveIntervalMs;
+    }
+
+    uint32_t GetLastRenderMs() const { return last_render_ms_; }
+    bool IsSuspended() const { return suspended_; }
+    uint32_t GetRenderCount() const { return render_count_; }
+    uint32_t GetRenderCostUs() const { return render_cost_us_; }
+
+    // Redraws skipped versus a fixed kActiveIntervalMs refresh since Init()
+    uint32_t GetSkippedCount(uint32_t now_ms) const {
+        uint32_t baseline = (now_ms - start_ms_) / kActiveIntervalMs;
+        return baseline > render_count_ ? baseline - render_count_ : 0;
+    }
+
+    // Main-loop time saved since Init(), in milliseconds
+    uint32_t GetSavedMs(uint32_t now_ms) const {
+        uint64_t saved_us = static_cast<uint64_t>(GetSkippedCount(now_ms)) * render_cost_us_;
+        return static_cast<uint32_t>(saved_us / 1000);
+    }
+
+private:
+    uint32_t start_ms_;
+    uint32_t last_render_ms_;
+    uint32_t last_activity_ms_;
+    bool suspended_;
+    bool dirty_;
+    std::atomic<bool> pending_activity_;
+    uint32_t render_count_;
+    uint32_t render_cost_us_;
+};
+
+} // namespace mutables_ui
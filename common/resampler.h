@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef MUTABLES_USE_CMSIS_DSP
+#include "arm_math.h"
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace mutables_ui {
+
+// Dot product of two float arrays, the inner loop of the resampler:
+// CMSIS-DSP on target, SSE on x86 hosts, plain C elsewhere
+inline float DotProduct(const float* a, const float* b, size_t size) {
+#ifdef MUTABLES_USE_CMSIS_DSP
+    float32_t result;
+    arm_dot_prod_f32(a, b, static_cast<uint32_t>(size), &result);
+    return result;
+#elif defined(__SSE__)
+    __m128 sum = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    float result = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < size; i++) {
+        result += a[i] * b[i];
+    }
+    return result;
+#else
+    float result = 0.0f;
+    for (size_t i = 0; i < size; i++) {
+        result += a[i] * b[i];
+    }
+    return result;
+#endif
+}
+
+// Modified Bessel function of the first kind, order 0 (Kaiser window)
+inline float BesselI0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    float half = 0.5f * x;
+    for (int k = 1; k < 32; k++) {
+        term *= (half / static_cast<float>(k)) * (half / static_cast<float>(k));
+        sum += term;
+        if (term < sum * 1e-9f) break;
+    }
+    return sum;
+}
+
+// Filter length per polyphase branch; longer filters have a wider
+// passband and a deeper stopband
+enum class ResamplerQuality {
+    Fast,       // 8 taps
+    Balanced,   // 16 taps
+    High        // 32 taps
+};
+
+// Rational sample-rate converter (up by L, down by M) with a polyphase
+// windowed-sinc lowpass. Coefficients are designed in Init; Process() is
+// allocation free and keeps its history across calls, so a stream can be
+// fed in blocks of any size. Ratios up to kMaxPhases/1 cover the Mutable
+// rates against 48 kHz (32k: 2/3, 96k: 2/1, 24k: 1/2).
+class PolyphaseResampler {
+public:
+    static constexpr int kMaxPhases = 4;
+    static constexpr int kMaxTaps = 32;
+
+    PolyphaseResampler() : up_(1), down_(1), taps_(0), phase_(0), position_(0) {}
+
+    // Returns false if the ratio is not supported
+    bool Init(int up, int down, ResamplerQuality quality) {
+        int divisor = Gcd(up, down);
+        up /= divisor;
+        down /= divisor;
+        if (up < 1 || down < 1 || up > kMaxPhases || down > kMaxPhases) return false;
+        up_ = up;
+        down_ = down;
+
+        float beta;
+        float passband;
+        switch (quality) {
+            case ResamplerQuality::Fast:     taps_ = 8;  beta = 5.0f; passband = 0.80f; break;
+            case ResamplerQuality::Balanced: taps_ = 16; beta = 7.0f; passband = 0.88f; break;
+            default:                         taps_ = 32; beta = 9.0f; passband = 0.92f; break;
+        }
+
+        // Prototype at the upsampled rate, cut below the lower Nyquist
+        int length = taps_ * up_;
+        float cutoff = 0.5f * passband / static_cast<float>(up_ > down_ ? up_ : down_);
+        float center = 0.5f * static_cast<float>(length - 1);
+        float window_norm = 1.0f / BesselI0(beta);
+        float sum = 0.0f;
+        float prototype[kMaxPhases * kMaxTaps];
+        for (int n = 0; n < length; n++) {
+            float t = static_cast<float>(n) - center;
+            float x = 2.0f * cutoff * t;
+            float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf(kPi * x) / (kPi * x);
+            float r = t / (center + 0.5f);
+            float window = BesselI0(beta * sqrtf(fmaxf(0.0f, 1.0f - r * r))) * window_norm;
+            prototype[n] = 2.0f * cutoff * sinc * window;
+            sum += prototype[n];
+        }
+
+        // Branch p holds taps p, p + L, ..., oldest sample first, scaled for
+        // unity DC gain after the zero stuffing
+        float gain = static_cast<float>(up_) / sum;
+        for (int p = 0; p < up_; p++) {
+            for (int j = 0; j < taps_; j++) {
+                coefficients_[p][j] = prototype[(taps_ - 1 - j) * up_ + p] * gain;
+            }
+        }
+        Reset();
+        return true;
+    }
+
+    void Reset() {
+        for (float& sample : history_) sample = 0.0f;
+        phase_ = 0;
+        position_ = 0;
+    }
+
+    // Upper bound of Process() output for `size` input samples
+    size_t GetMaxOutput(size_t size) const {
+        return (size * up_ + down_ - 1) / down_ + 1;
+    }
+
+    // Returns the number of samples written to out
+    size_t Process(const float* in, size_t size, float* out) {
+        size_t produced = 0;
+        for (size_t i = 0; i < size; i++) {
+            // History twice in a row, so the window is always contiguous
+            history_[position_] = in[i];
+            history_[position_ + taps_] = in[i];
+            position_ = position_ + 1 == taps_ ? 0 : position_ + 1;
+            const float* window = history_ + position_;
+            while (phase_ < up_) {
+                out[produced++] = DotProduct(window, coefficients_[phase_], taps_);
+                phase_ += down_;
+            }
+            phase_ -= up_;
+        }
+        return produced;
+    }
+
+    int GetUp() const { return up_; }
+    int GetDown() const { return down_; }
+    int GetTaps() const { return taps_; }
+
+    // Group delay in output samples
+    float GetLatency() const {
+        return 0.5f * static_cast<float>(taps_ * up_ - 1) / static_cast<float>(down_);
+    }
+
+private:
+    static constexpr float kPi = 3.14159265358979f;
+
+    static int Gcd(int a, int b) {
+        while (b != 0) {
+            int t = a % b;
+            a = b;
+            b = t;
+        }
+        return a > 0 ? a : 1;
+    }
+
+    int up_;
+    int down_;
+    int taps_;
+    int phase_;
+    int position_;
+    float coefficients_[kMaxPhases][kMaxTaps];
+    float history_[2 * kMaxTaps];
+};
+
+// Arbitrary-ratio converter, for rates with no small L/M against 48 kHz
+// (44.1 kHz is 147/160). The windowed-sinc lowpass is tabulated at
+// kTablePhases fractional positions between two input samples. Each output
+// interpolates linearly between the two nearest rows, at a position that
+// advances by the input/output rate ratio in 32.32 fixed point. Costs two
+// dot products per output, about twice a PolyphaseResampler of the same
+// quality. The output count per call varies by one around the ratio.
+class FractionalResampler {
+public:
+    static constexpr int kTablePhases = 128;
+    static constexpr int kMaxTaps = 32;
+    static constexpr int kMaxRatio = 4;     // Either way, as PolyphaseResampler
+
+    FractionalResampler() : taps_(0), step_(0), position_(0), history_position_(0), latency_(0.0f) {}
+
+    // Returns false if the ratio is out of range
+    bool Init(int out_rate, int in_rate, ResamplerQuality quality) {
+        if (out_rate < 1 || in_rate < 1 || out_rate > in_rate * kMaxRatio || in_rate > out_rate * kMaxRatio) {
+            return false;
+        }
+        step_ = (static_cast<uint64_t>(in_rate) << 32) / static_cast<uint64_t>(out_rate);
+
+        float beta;
+        float passband;
+        switch (quality) {
+            case ResamplerQuality::Fast:     taps_ = 8;  beta = 5.0f; passband = 0.80f; break;
+            case ResamplerQuality::Balanced: taps_ = 16; beta = 7.0f; passband = 0.88f; break;
+            default:                         taps_ = 32; beta = 9.0f; passband = 0.92f; break;
+        }
+
+        // Cut below the lower Nyquist, in cycles per input sample. Row p
+        // puts the output p / kTablePhases of a sample after the middle of
+        // the window, oldest sample first; every row has unity DC gain.
+        float ratio = static_cast<float>(out_rate) / static_cast<float>(in_rate);
+        float cutoff = 0.5f * passband * (ratio < 1.0f ? ratio : 1.0f);
+        float half = 0.5f * static_cast<float>(taps_);
+        float window_norm = 1.0f / BesselI0(beta);
+        for (int p = 0; p <= kTablePhases; p++) {
+            float fraction = static_cast<float>(p) / static_cast<float>(kTablePhases);
+            float sum = 0.0f;
+            for (int j = 0; j < taps_; j++) {
+                float t = static_cast<float>(j) - (half - 1.0f) - fraction;
+                float x = 2.0f * cutoff * t;
+                float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf(kPi * x) / (kPi * x);
+                float r = t / half;
+                float window = BesselI0(beta * sqrtf(fmaxf(0.0f, 1.0f - r * r))) * window_norm;
+                table_[p][j] = sinc * window;
+                sum += table_[p][j];
+            }
+            for (int j = 0; j < taps_; j++) table_[p][j] /= sum;
+        }
+        latency_ = half * ratio;
+        Reset();
+        return true;
+    }
+
+    void Reset() {
+        for (float& sample : history_) sample = 0.0f;
+        position_ = 0;
+        history_position_ = 0;
+    }
+
+    // Upper bound of Process() output for `size` input samples
+    size_t GetMaxOutput(size_t size) const {
+        return static_cast<size_t>((static_cast<uint64_t>(size) << 32) / step_) + 2;
+    }
+
+    // Returns the number of samples written to out
+    size_t Process(const float* in, size_t size, float* out) {
+        const uint64_t one = 1ull << 32;
+        size_t produced = 0;
+        for (size_t i = 0; i < size; i++) {
+            // History twice in a row, so the window is always contiguous
+            history_[history_position_] = in[i];
+            history_[history_position_ + taps_] = in[i];
+            history_position_ = history_position_ + 1 == taps_ ? 0 : history_position_ + 1;
+            const float* window = history_ + history_position_;
+            while (position_ < one) {
+                uint32_t fraction = static_cast<uint32_t>(position_);
+                int row = static_cast<int>(fraction >> (32 - kTableBits));
+                float blend = static_cast<float>(fraction & kBlendMask) * kBlendScale;
+                float a = DotProduct(window, table_[row], taps_);
+                float b = DotProduct(window, table_[row + 1], taps_);
+                out[produced++] = a + (b - a) * blend;
+                position_ += step_;
+            }
+            position_ -= one;
+        }
+        return produced;
+    }
+
+    int GetTaps() const { return taps_; }
+
+    // Group delay in output samples
+    float GetLatency() const { return latency_; }
+
+private:
+    static constexpr float kPi = 3.14159265358979f;
+    static constexpr int kTableBits = 7;
+    static_assert((1 << kTableBits) == kTablePhases, "kTableBits must match kTablePhases");
+    static constexpr uint32_t kBlendMask = (1u << (32 - kTableBits)) - 1;
+    static constexpr float kBlendScale = 1.0f / static_cast<float>(1u << (32 - kTableBits));
+
+    int taps_;
+    uint64_t step_;             // Input samples per output, 32.32
+    uint64_t position_;         // Next output past the window middle, 32.32
+    int history_position_;
+    float latency_;
+    float table_[kTablePhases + 1][kMaxTaps];
+    float history_[2 * kMaxTaps];
+};
+
+} // namespace mutables_ui
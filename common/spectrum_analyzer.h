@@ -0,0 +1,270 @@
+#pragma once
+
+#include "audio_tap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef MUTABLES_USE_CMSIS_DSP
+#include "arm_math.h"
+#endif
+
+namespace mutables_ui {
+
+// Spectrum analyzer for the display page.
+// The audio callback only copies samples into a lock-free tap. The FFT,
+// windowing and log-binning run from the main loop when it has spare time.
+// FFT size and frame rate follow the measured idle CPU: the analyzer takes
+// at most a fraction of the idle time, shrinks the FFT or slows down when
+// that budget is exceeded, and pauses under heavy audio load.
+class SpectrumAnalyzer {
+public:
+    static constexpr size_t kMinFftSize = 256;
+    static constexpr size_t kMaxFftSize = 1024;
+    static constexpr int kNumBands = 32;
+
+    SpectrumAnalyzer()
+        : sample_rate_(48000.0f)
+        , fft_size_(kMaxFftSize)
+        , frame_interval_us_(kMinFrameIntervalUs)
+        , last_frame_us_(0)
+        , frame_cost_us_(0.0f)
+        , paused_(false) {}
+
+    void Init(float sample_rate) {
+        sample_rate_ = sample_rate;
+
+        // Shared tables at max size, smaller FFTs index them with a stride
+        for (size_t i = 0; i < kMaxFftSize; i++) {
+            float phase = 2.0f * kPi * static_cast<float>(i) / kMaxFftSize;
+            window_[i] = 0.5f - 0.5f * cosf(phase);
+        }
+        for (size_t i = 0; i < kMaxFftSize / 2; i++) {
+            float phase = 2.0f * kPi * static_cast<float>(i) / kMaxFftSize;
+            cos_[i] = cosf(phase);
+            sin_[i] = sinf(phase);
+        }
+        for (int b = 0; b < kNumBands; b++) {
+            bands_[b] = 0.0f;
+        }
+
+        frame_cost_us_ = 0.0f;
+        frame_interval_us_ = kMinFrameIntervalUs;
+        paused_ = false;
+        SetFftSize(kMaxFftSize);
+    }
+
+    // Audio callback side
+    void Capture(const float* in, size_t size) {
+        tap_.Write(in, size);
+    }
+
+    // Main loop side
+    // idle_fraction: 0.0 (no spare CPU) to 1.0 (fully idle)
+    // Returns true when a new frame was computed; the caller should then
+    // report how long this call took with ReportFrameCost().
+    bool Process(uint32_t now_us, float idle_fraction) {
+        paused_ = idle_fraction < kMinIdleFraction;
+        if (paused_) return false;
+
+        if (now_us - last_frame_us_ < frame_interval_us_) return false;
+        if (!tap_.ReadLatest(time_, fft_size_)) return false;
+        last_frame_us_ = now_us;
+
+        for (size_t i = 0, stride = kMaxFftSize / fft_size_; i < fft_size_; i++) {
+            time_[i] *= window_[i * stride];
+        }
+
+        ComputePowerSpectrum();
+        UpdateBands();
+        Adapt(idle_fraction);
+        return true;
+    }
+
+    // Measured duration of the last Process() call that returned true
+    void ReportFrameCost(uint32_t cost_us) {
+        // Smooth to avoid flipping sizes on a single interrupted frame
+        if (frame_cost_us_ <= 0.0f) {
+            frame_cost_us_ = static_cast<float>(cost_us);
+        } else {
+            frame_cost_us_ += 0.2f * (static_cast<float>(cost_us) - frame_cost_us_);
+        }
+    }
+
+    // Band level, 0.0 (floor) to 1.0 (full scale), low to high frequency
+    float GetBand(int band) const {
+        if (band < 0 || band >= kNumBands) return 0.0f;
+        return bands_[band];
+    }
+
+    size_t GetFftSize() const { return fft_size_; }
+    uint32_t GetFrameIntervalUs() const { return frame_interval_us_; }
+    bool IsPaused() const { return paused_; }
+
+private:
+    static constexpr float kPi = 3.14159265358979f;
+    static constexpr float kLowestFrequency = 40.0f;
+    static constexpr float kFloorDb = -72.0f;
+    static constexpr float kFallPerSecond = 1.5f;     // Bar release, full scale per second
+
+    // Adaptation policy
+    static constexpr float kIdleShare = 0.25f;        // Part of idle time we may use
+    static constexpr float kMinIdleFraction = 0.1f;   // Below this, stop analysing
+    static constexpr uint32_t kMinFrameIntervalUs = 33333;   // 30 fps
+    static constexpr uint32_t kMaxFrameIntervalUs = 100000;  // 10 fps before shrinking FFT
+
+    AudioTap<kMaxFftSize * 2> tap_;
+
+    float sample_rate_;
+    size_t fft_size_;
+    uint32_t frame_interval_us_;
+    uint32_t last_frame_us_;
+    float frame_cost_us_;
+    bool paused_;
+
+    float time_[kMaxFftSize];
+    float power_[kMaxFftSize / 2];
+    float window_[kMaxFftSize];
+    float cos_[kMaxFftSize / 2];
+    float sin_[kMaxFftSize / 2];
+    float bands_[kNumBands];
+    uint16_t band_lo_[kNumBands];
+    uint16_t band_hi_[kNumBands];
+
+#ifdef MUTABLES_USE_CMSIS_DSP
+    arm_rfft_fast_instance_f32 rfft_;
+    float spectrum_[kMaxFftSize];
+#endif
+
+    void SetFftSize(size_t size) {
+        fft_size_ = size;
+
+#ifdef MUTABLES_USE_CMSIS_DSP
+        arm_rfft_fast_init_f32(&rfft_, static_cast<uint16_t>(size));
+#endif
+
+        // Log-spaced band edges from kLowestFrequency to Nyquist
+        float bin_hz = sample_rate_ / static_cast<float>(size);
+        float ratio = (sample_rate_ * 0.5f) / kLowestFrequency;
+        int max_bin = static_cast<int>(size / 2) - 1;
+        for (int b = 0; b < kNumBands; b++) {
+            float f_lo = kLowestFrequency * powf(ratio, static_cast<float>(b) / kNumBands);
+            float f_hi = kLowestFrequency * powf(ratio, static_cast<float>(b + 1) / kNumBands);
+            int lo = std::clamp(static_cast<int>(f_lo / bin_hz), 1, max_bin);
+            int hi = std::clamp(static_cast<int>(f_hi / bin_hz), lo + 1, max_bin + 1);
+            band_lo_[b] = static_cast<uint16_t>(lo);
+            band_hi_[b] = static_cast<uint16_t>(hi);
+        }
+    }
+
+    void ComputePowerSpectrum() {
+        size_t half = fft_size_ / 2;
+
+#ifdef MUTABLES_USE_CMSIS_DSP
+        arm_rfft_fast_f32(&rfft_, time_, spectrum_, 0);
+        power_[0] = spectrum_[0] * spectrum_[0];
+        arm_cmplx_mag_squared_f32(spectrum_ + 2, power_ + 1, half - 1);
+#else
+        // Real FFT of size N as a complex FFT of size N/2 over the
+        // interleaved samples, followed by the split step
+        ComplexFft(time_, half);
+
+        size_t stride = kMaxFftSize / fft_size_;
+        for (size_t k = 0; k < half; k++) {
+            size_t c = (half - k) & (half - 1);
+            float zr = time_[2 * k];
+            float zi = time_[2 * k + 1];
+            float cr = time_[2 * c];
+            float ci = -time_[2 * c + 1];
+
+            float even_r = 0.5f * (zr + cr);
+            float even_i = 0.5f * (zi + ci);
+            float odd_r = 0.5f * (zi - ci);
+            float odd_i = -0.5f * (zr - cr);
+
+            float wr = cos_[k * stride];
+            float wi = -sin_[k * stride];
+            float re = even_r + wr * odd_r - wi * odd_i;
+            float im = even_i + wr * odd_i + wi * odd_r;
+            power_[k] = re * re + im * im;
+        }
+#endif
+    }
+
+#ifndef MUTABLES_USE_CMSIS_DSP
+    // In-place iterative radix-2 FFT on `size` interleaved complex values
+    void ComplexFft(float* data, size_t size) {
+        for (size_t i = 1, j = 0; i < size; i++) {
+            size_t bit = size >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(data[2 * i], data[2 * j]);
+                std::swap(data[2 * i + 1], data[2 * j + 1]);
+            }
+        }
+
+        for (size_t len = 2; len <= size; len <<= 1) {
+            size_t half = len >> 1;
+            size_t step = kMaxFftSize / len;
+            for (size_t i = 0; i < size; i += len) {
+                for (size_t j = 0; j < half; j++) {
+                    float wr = cos_[j * step];
+                    float wi = -sin_[j * step];
+                    float* a = &data[2 * (i + j)];
+                    float* b = &data[2 * (i + j + half)];
+                    float tr = b[0] * wr - b[1] * wi;
+                    float ti = b[0] * wi + b[1] * wr;
+                    b[0] = a[0] - tr;
+                    b[1] = a[1] - ti;
+                    a[0] += tr;
+                    a[1] += ti;
+                }
+            }
+        }
+    }
+#endif
+
+    void UpdateBands() {
+        // Hann window: a full-scale sine peaks at |X| = N / 4
+        float norm_db = 20.0f * log10f(4.0f / static_cast<float>(fft_size_));
+        float fall = kFallPerSecond * static_cast<float>(frame_interval_us_) * 1e-6f;
+
+        for (int b = 0; b < kNumBands; b++) {
+            float peak = 0.0f;
+            for (int k = band_lo_[b]; k < band_hi_[b]; k++) {
+                peak = std::max(peak, power_[k]);
+            }
+            float db = 10.0f * log10f(peak + 1e-20f) + norm_db;
+            float level = std::clamp((db - kFloorDb) / -kFloorDb, 0.0f, 1.0f);
+            bands_[b] = std::max(level, bands_[b] - fall);
+        }
+    }
+
+    void Adapt(float idle_fraction) {
+        if (frame_cost_us_ <= 0.0f) return;
+
+        // Frame interval that keeps us within our share of the idle time
+        float budget = idle_fraction * kIdleShare;
+        float interval = std::max(static_cast<float>(kMinFrameIntervalUs), frame_cost_us_ / budget);
+
+        if (interval > kMaxFrameIntervalUs && fft_size_ > kMinFftSize) {
+            // Too slow at this size: halve the FFT (cost ~ N log N)
+            SetFftSize(fft_size_ / 2);
+            frame_cost_us_ *= 0.45f;
+            interval = std::max(static_cast<float>(kMinFrameIntervalUs), frame_cost_us_ / budget);
+        } else if (fft_size_ < kMaxFftSize
+                   && frame_cost_us_ * 2.5f / budget < kMinFrameIntervalUs) {
+            // Enough headroom to double the size and keep full frame rate
+            SetFftSize(fft_size_ * 2);
+            frame_cost_us_ *= 2.2f;
+        }
+
+        frame_interval_us_ = static_cast<uint32_t>(std::min(interval, 4.0f * kMaxFrameIntervalUs));
+    }
+};
+
+} // namespace mutables_ui
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "flash_region.h"
+#include "preset_format.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace mutables_ui {
+
+// One entry of the state log: a PresetRecord stamped with a sequence number
+struct StateEntry {
+    uint32_t sequence;
+    uint32_t sequence_check;          // ~sequence
+    PresetRecord record;
+};
+
+// Log-structured store for the current parameter state.
+// Each write appends an entry to the next slot of the region, used as a
+// ring of sectors: erases rotate over every sector (wear leveling) and the
+// sector holding the newest entry is never the one erased. At Init the valid
+// entry with the highest sequence number wins, so a write cut short by power
+// loss fails its CRC and the previous state is used.
+//
+// Modules of a multi-module image share the log: entries of every module
+// count for the ring position, Get() returns the newest of this store's
+// module. A module tag of 0 matches any module.
+//
+// Write-behind: Submit() only takes a copy. Poll() writes once the state has
+// been pending for kWriteBehindMs and at most every kMinIntervalMs, so a
+// burst of edits ends up as a single entry. Each Poll() performs at most one
+// flash operation (a sector erase or an entry program), and none unless the
+// caller says flash may be written now.
+class StateStore {
+public:
+    static constexpr uint32_t kWriteBehindMs = 1000;
+    static constexpr uint32_t kMinIntervalMs = 3000;
+    static constexpr size_t kSlotStride = (sizeof(StateEntry) + 15) & ~size_t(15);
+
+    StateStore()
+        : flash_(nullptr)
+        , module_tag_(0)
+        , slots_per_sector_(0)
+        , slot_count_(0)
+        , latest_(-1)
+        , own_(-1)
+        , next_(0)
+        , sequence_(0)
+        , next_erased_(false)
+        , dirty_(false)
+        , pending_since_(0)
+        , last_write_(0)
+        , written_crc_(0)
+        , write_count_(0)
+        , erase_count_(0) {}
+
+    // Scan the region for the newest valid entry. Needs at least two sectors.
+    bool Init(FlashRegion* flash, uint32_t module_tag) {
+        flash_ = flash;
+        module_tag_ = module_tag;
+        slots_per_sector_ = flash->GetSectorSize() / kSlotStride;
+        slot_count_ = slots_per_sector_ * (flash->GetSize() / flash->GetSectorSize());
+        if (slots_per_sector_ == 0 || slot_count_ < 2 * slots_per_sector_) {
+            slot_count_ = 0;
+            return false;
+        }
+
+        latest_ = -1;
+        own_ = -1;
+        sequence_ = 0;
+        uint32_t own_sequence = 0;
+        for (size_t slot = 0; slot < slot_count_; slot++) {
+            const StateEntry* entry = EntryAt(slot);
+            if (!IsValid(*entry, 0)) continue;
+            if (latest_ < 0 || entry->sequence > sequence_) {
+                latest_ = static_cast<int>(slot);
+                sequence_ = entry->sequence;
+            }
+            if (IsValid(*entry, module_tag_) && (own_ < 0 || entry->sequence > own_sequence)) {
+                own_ = static_cast<int>(slot);
+                own_sequence = entry->sequence;
+            }
+        }
+
+        next_ = latest_ < 0 ? 0 : NextSlot(latest_);
+        next_erased_ = false;
+        if (next_ % slots_per_sector_ != 0 && !IsBlank(next_)) {
+            // Partly programmed by a cut write: continue in the next sector
+            next_ = NextSlot(next_ - (next_ % slots_per_sector_) + slots_per_sector_ - 1);
+        }
+
+        // Compared against the newest entry of any module, so the state of a
+        // module just switched to is logged and comes back at power-up
+        dirty_ = false;
+        written_crc_ = latest_ < 0 ? 0 : EntryAt(latest_)->record.crc;
+        return true;
+    }
+
+    // Newest stored state of the module, read in place, nullptr if none
+    const PresetRecord* Get() const {
+        return own_ < 0 ? nullptr : &EntryAt(own_)->record;
+    }
+
+    // Main loop: current state (capture it with PresetCapture)
+    void Submit(const PresetRecord& record, uint32_t now) {
+        if (record.crc == written_crc_) {
+            dirty_ = false;  // Back to what is stored
+            return;
+        }
+        if (dirty_ && record.crc == pending_.record.crc) return;
+        if (!dirty_) pending_since_ = now;
+        pending_.record = record;
+        dirty_ = true;
+    }
+
+    // True when the next Poll() would touch the flash
+    bool WantsWrite(uint32_t now) const {
+        return slot_count_ > 0
+            && dirty_
+            && now - pending_since_ >= kWriteBehindMs
+            && (write_count_ == 0 || now - last_write_ >= kMinIntervalMs);
+    }
+
+    // Main loop: erase or program if due. Returns true when flash was used.
+    bool Poll(uint32_t now, bool flash_writable) {
+        if (!flash_writable || !WantsWrite(now)) return false;
+
+        size_t sector = flash_->GetSectorSize();
+        if (next_ % slots_per_sector_ == 0 && !next_erased_) {
+            // Entering a sector: erase it first, it holds the oldest entries
+            flash_->EraseSector((next_ / slots_per_sector_) * sector);
+            next_erased_ = true;
+            erase_count_++;
+            return true;
+        }
+
+        pending_.sequence = sequence_ + 1;
+        pending_.sequence_check = ~pending_.sequence;
+        size_t slot = next_;
+        bool ok = flash_->Program(SlotOffset(slot), &pending_, sizeof(pending_))
+               && IsValid(*EntryAt(slot), module_tag_);
+
+        write_count_++;
+        last_write_ = now;  // Also paces retries after a failed write
+        next_ = NextSlot(slot);
+        next_erased_ = false;
+        if (ok) {
+            latest_ = static_cast<int>(slot);
+            own_ = latest_;
+            sequence_ = pending_.sequence;
+            written_crc_ = pending_.record.crc;
+            dirty_ = false;
+        }
+        return true;
+    }
+
+    bool IsDirty() const { return dirty_; }
+    uint32_t GetWriteCount() const { return write_count_; }
+    uint32_t GetEraseCount() const { return erase_count_; }
+    uint32_t GetSequence() const { return sequence_; }
+    size_t GetSlotCount() const { return slot_count_; }
+
+private:
+    const StateEntry* EntryAt(size_t slot) const {
+        return reinterpret_cast<const StateEntry*>(flash_->GetData() + SlotOffset(slot));
+    }
+
+    size_t SlotOffset(size_t slot) const {
+        return (slot / slots_per_sector_) * flash_->GetSectorSize()
+             + (slot % slots_per_sector_) * kSlotStride;
+    }
+
+    size_t NextSlot(size_t slot) const {
+        return (slot + 1) % slot_count_;
+    }
+
+    bool IsValid(const StateEntry& entry, uint32_t module_tag) const {
+        return entry.sequence_check == ~entry.sequence
+            && entry.sequence != 0xFFFFFFFF
+            && PresetIsValid(entry.record, module_tag);
+    }
+
+    bool IsBlank(size_t slot) const {
+        const uint8_t* bytes = flash_->GetData() + SlotOffset(slot);
+        for (size_t i = 0; i < kSlotStride; i++) {
+            if (bytes[i] != 0xFF) return false;
+        }
+        return true;
+    }
+
+    FlashRegion* flash_;
+    uint32_t module_tag_;
+    size_t slots_per_sector_;
+    size_t slot_count_;
+
+    int latest_;              // Slot of the newest valid entry, -1 if none
+    int own_;                 // Slot of the newest entry of module_tag_
+    size_t next_;             // Slot the next entry goes to
+    uint32_t sequence_;
+    bool next_erased_;
+
+    StateEntry pending_;
+    bool dirty_;
+    uint32_t pending_since_;
+    uint32_t last_write_;
+    uint32_t written_crc_;
+
+    uint32_t write_count_;
+    uint32_t erase_count_;
+};
+
+} // namespace mutables_ui
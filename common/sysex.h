@@ -0,0 +1,253 @@
+#pragma once
+
+#include "preset_bank.h"
+#include "preset_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace mutables_ui {
+
+// SysEx bulk dump/restore of the current state and the QSPI preset slots.
+//
+// Every message fits the 128-byte SysEx buffer of the MIDI driver:
+//   F0 7D 4D 49 <command> ... F7       (7D = non-commercial ID, "MI")
+//   01 <what>                          dump request: 0 state, 1 bank, 2 both
+//   10 <target> <slot> <chunk> <count> <payload>
+//                                      record chunk, target 0 state / 1 slot,
+//                                      payload = 56 raw bytes, 7-bit encoded
+//   20 <target> <slot> <status>        ack after a record, status 0 = ok
+// A record is 544 bytes, sent as 10 chunks. Restoring a bank, the sender
+// waits for the ack of each slot: storing a slot erases flash.
+//
+// Payload encoding: each group of up to 7 bytes becomes one byte holding
+// their top bits (bit i = byte i) followed by the 7 low bits of each byte.
+
+static constexpr uint8_t kSysexId = 0x7D;
+static constexpr uint8_t kSysexTag0 = 0x4D;   // 'M'
+static constexpr uint8_t kSysexTag1 = 0x49;   // 'I'
+
+static constexpr size_t kSysexChunkBytes = 56;
+static constexpr size_t kSysexChunkCount =
+    (sizeof(PresetRecord) + kSysexChunkBytes - 1) / kSysexChunkBytes;
+static constexpr size_t kSysexMaxMessage = 128;
+static constexpr size_t kSysexAckSize = 9;     // Header, target, slot, status, F7
+
+enum class SysexCommand : uint8_t {
+    DumpRequest = 0x01,
+    Chunk = 0x10,
+    Ack = 0x20
+};
+
+enum class SysexTarget : uint8_t {
+    State = 0,
+    Slot = 1
+};
+
+// 7 bytes in, 8 out. Returns the encoded size.
+inline size_t SysexEncode(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t written = 0;
+    for (size_t group = 0; group < size; group += 7) {
+        size_t n = size - group < 7 ? size - group : 7;
+        uint8_t& msbs = out[written++];
+        msbs = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint8_t byte = in[group + i];
+            msbs |= (byte >> 7) << i;
+            out[written++] = byte & 0x7F;
+        }
+    }
+    return written;
+}
+
+// Inverse of SysexEncode. Returns the decoded size.
+inline size_t SysexDecode(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t written = 0;
+    for (size_t group = 0; group < size; group += 8) {
+        uint8_t msbs = in[group];
+        size_t n = size - group - 1 < 7 ? size - group - 1 : 7;
+        for (size_t i = 0; i < n; i++) {
+            out[written++] = in[group + 1 + i] | (((msbs >> i) & 1) << 7);
+        }
+    }
+    return written;
+}
+
+inline size_t SysexWriteHeader(uint8_t* out, SysexCommand command) {
+    out[0] = 0xF0;
+    out[1] = kSysexId;
+    out[2] = kSysexTag0;
+    out[3] = kSysexTag1;
+    out[4] = static_cast<uint8_t>(command);
+    return 5;
+}
+
+inline size_t SysexAck(uint8_t (&out)[kSysexAckSize], SysexTarget target, uint8_t slot, bool ok) {
+    size_t n = SysexWriteHeader(out, SysexCommand::Ack);
+    out[n++] = static_cast<uint8_t>(target);
+    out[n++] = slot;
+    out[n++] = ok ? 0 : 1;
+    out[n++] = 0xF7;
+    return n;
+}
+
+// Produces the dump one message at a time, so the caller can pace them
+// through its TX ring. Bank records are read in place from flash.
+class SysexDumper {
+public:
+    SysexDumper() : bank_(nullptr), send_state_(false), next_slot_(0), chunk_(0), active_(false) {}
+
+    // what: 0 state, 1 bank, 2 both. The state record is copied.
+    void Begin(uint8_t what, const PresetRecord& state, const PresetBank* bank) {
+        state_ = state;
+        bank_ = bank;
+        send_state_ = what == 0 || what == 2;
+        next_slot_ = (what == 1 || what == 2) && bank ? 0 : PresetBank::kMaxSlots;
+        chunk_ = 0;
+        active_ = true;
+        current_ = nullptr;
+        Advance();
+    }
+
+    bool IsActive() const { return active_; }
+
+    // Next message into out (kSysexMaxMessage bytes), 0 once the dump is done
+    size_t NextMessage(uint8_t* out) {
+        if (!active_) return 0;
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(current_);
+        size_t offset = chunk_ * kSysexChunkBytes;
+        size_t size = sizeof(PresetRecord) - offset;
+        if (size > kSysexChunkBytes) size = kSysexChunkBytes;
+
+        size_t n = SysexWriteHeader(out, SysexCommand::Chunk);
+        out[n++] = static_cast<uint8_t>(current_target_);
+        out[n++] = current_slot_;
+        out[n++] = static_cast<uint8_t>(chunk_);
+        out[n++] = static_cast<uint8_t>(kSysexChunkCount);
+        n += SysexEncode(bytes + offset, size, out + n);
+        out[n++] = 0xF7;
+
+        if (++chunk_ == kSysexChunkCount) {
+            chunk_ = 0;
+            Advance();
+        }
+        return n;
+    }
+
+private:
+    // Select the next record to send, or finish
+    void Advance() {
+        if (send_state_) {
+            send_state_ = false;
+            current_ = &state_;
+            current_target_ = SysexTarget::State;
+            current_slot_ = 0;
+            return;
+        }
+        while (next_slot_ < BankSlotCount()) {
+            int slot = next_slot_++;
+            const PresetRecord* record = bank_->Get(slot);
+            if (record) {
+                current_ = record;
+                current_target_ = SysexTarget::Slot;
+                current_slot_ = static_cast<uint8_t>(slot);
+                return;
+            }
+        }
+        active_ = false;
+    }
+
+    int BankSlotCount() const { return bank_ ? bank_->GetSlotCount() : 0; }
+
+    PresetRecord state_;
+    const PresetBank* bank_;
+    bool send_state_;
+    int next_slot_;
+    size_t chunk_;
+    bool active_;
+
+    const PresetRecord* current_;
+    SysexTarget current_target_;
+    uint8_t current_slot_;
+};
+
+// Parses incoming messages one at a time, assembling at most one record.
+// Work per message is bounded by the message size (<= 128 bytes).
+class SysexReceiver {
+public:
+    enum class Result {
+        None,           // Not ours, or chunk accepted
+        DumpRequest,    // GetRequest() holds what to dump
+        Record,         // GetRecord() valid, for GetTarget()/GetSlot()
+        Error           // Out of order chunk or bad record, assembly reset
+    };
+
+    SysexReceiver() : module_tag_(0), expected_chunk_(0), target_(SysexTarget::State), slot_(0), request_(0) {}
+
+    void Init(uint32_t module_tag) {
+        module_tag_ = module_tag;
+        expected_chunk_ = 0;
+    }
+
+    // data/size: the message without F0 and F7
+    Result Parse(const uint8_t* data, size_t size) {
+        if (size < 4 || data[0] != kSysexId || data[1] != kSysexTag0 || data[2] != kSysexTag1) {
+            return Result::None;
+        }
+        SysexCommand command = static_cast<SysexCommand>(data[3]);
+        data += 4;
+        size -= 4;
+
+        if (command == SysexCommand::DumpRequest) {
+            request_ = size > 0 ? data[0] : 0;
+            return Result::DumpRequest;
+        }
+        if (command != SysexCommand::Chunk || size < 4) return Result::None;
+
+        SysexTarget target = static_cast<SysexTarget>(data[0]);
+        uint8_t slot = data[1];
+        uint8_t chunk = data[2];
+        uint8_t count = data[3];
+        data += 4;
+        size -= 4;
+
+        if (chunk == 0) {
+            expected_chunk_ = 0;
+            target_ = target;
+            slot_ = slot;
+        }
+        size_t offset = chunk * kSysexChunkBytes;
+        size_t expected_size = sizeof(PresetRecord) - offset;
+        if (expected_size > kSysexChunkBytes) expected_size = kSysexChunkBytes;
+        if (chunk != expected_chunk_ || target != target_ || slot != slot_
+            || count != kSysexChunkCount
+            || size != expected_size + (expected_size + 6) / 7) {
+            expected_chunk_ = 0;
+            return Result::Error;
+        }
+
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&record_);
+        SysexDecode(data, size, bytes + offset);
+        expected_chunk_++;
+
+        if (expected_chunk_ < kSysexChunkCount) return Result::None;
+        expected_chunk_ = 0;
+        return PresetIsValid(record_, module_tag_) ? Result::Record : Result::Error;
+    }
+
+    uint8_t GetRequest() const { return request_; }
+    SysexTarget GetTarget() const { return target_; }
+    uint8_t GetSlot() const { return slot_; }
+    const PresetRecord& GetRecord() const { return record_; }
+
+private:
+    uint32_t module_tag_;
+    PresetRecord record_;
+    size_t expected_chunk_;
+    SysexTarget target_;
+    uint8_t slot_;
+    uint8_t request_;
+};
+
+} // namespace mutables_ui
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 
 namespace mutables_ui {
@@ -8,7 +9,12 @@ enum class UIState {
     Navigate,       // Encoder rotation scrolls parameters
     EditValue,      // Encoder rotation changes value
     Submenu,        // CV mapping options (Navigate mode)
-    SubmenuEdit     // Editing submenu values
+    SubmenuEdit,    // Editing submenu values
+    Spectrum,       // Spectrum analyzer page (after the last module page)
+    SaveName,       // Preset name character input
+    LoadBrowser,    // Preset list
+    SlotSelect,     // QSPI preset slot to store to
+    ModuleSelect    // Modules in the image
 };
 
 enum class SubmenuItem {
@@ -20,24 +26,80 @@ enum class SubmenuItem {
 
 struct MenuState {
     UIState state;
-    int selected_param;
-    int param_count;
+    int selected_param;       // Selected row (parameter or action row)
+    int param_count;          // Module parameters, listed first
     int scroll_offset;
     
+    // One page per module in the chain, each listing that module's
+    // parameters; param_count is the shown module's
+    int module_page;
+    int module_count;
+    
     // Submenu state
     SubmenuItem selected_submenu_item;
     int submenu_param_index;  // Which parameter's submenu we're in
     
+    // Preset name entry (SaveName)
+    static constexpr const char* NAME_CHARS = "abcdefghijklmnopqrstuvwxyz0123456789-_.";
+    static constexpr int NAME_CHAR_COUNT = 39;
+    static constexpr int MAX_NAME_LENGTH = 15;
+    char preset_name[MAX_NAME_LENGTH + 1];
+    int name_cursor;
+    
+    // Preset list (LoadBrowser)
+    int selected_preset;
+    
+    // QSPI preset slot (SlotSelect)
+    int selected_slot;
+    
+    // Module list (ModuleSelect) for the current page's slot: the image's
+    // entries (replace the slot's module), the same entries as "+" rows
+    // (add a module after the last slot) while the chain has room, and
+    // a remove row on pages after the first
+    int selected_module;
+    int module_entry_count;
+    bool module_can_add;
+    bool module_can_remove;
+    
     // Display settings - 64px screen / 14px line spacing (Font_7x10) = 4 visible parameters
     static constexpr int VISIBLE_PARAMS = 4;
     
+    // Undo/redo steps available, shown on the Undo and Redo rows
+    int undo_count;
+    int redo_count;
+    
+    // Action rows after the parameters: Save, Load, Slot, Undo, Redo, Module
+    static constexpr int ACTION_ROWS = 6;
+    
     MenuState() 
         : state(UIState::Navigate)
         , selected_param(0)
         , param_count(0)
         , scroll_offset(0)
+        , module_page(0)
+        , module_count(1)
         , selected_submenu_item(SubmenuItem::CVSource)
-        , submenu_param_index(-1) {}
+        , submenu_param_index(-1)
+        , name_cursor(0)
+        , selected_preset(0)
+        , selected_slot(0)
+        , selected_module(0)
+        , module_entry_count(0)
+        , module_can_add(false)
+        , module_can_remove(false)
+        , undo_count(0)
+        , redo_count(0) {
+        preset_name[0] = '\0';
+    }
+    
+    int RowCount() const { return param_count + ACTION_ROWS; }
+    bool IsParamRow(int row) const { return row >= 0 && row < param_count; }
+    bool IsSaveRow(int row) const { return row == param_count; }
+    bool IsLoadRow(int row) const { return row == param_count + 1; }
+    bool IsSlotRow(int row) const { return row == param_count + 2; }
+    bool IsUndoRow(int row) const { return row == param_count + 3; }
+    bool IsRedoRow(int row) const { return row == param_count + 4; }
+    bool IsModuleRow(int row) const { return row == param_count + 5; }
     
     void ScrollToSelected() {
         if (selected_param < scroll_offset) {
@@ -49,7 +111,7 @@ struct MenuState {
     
     void NextParam() {
         selected_param++;
-        if (selected_param >= param_count) {
+        if (selected_param >= RowCount()) {
             selected_param = 0;
             scroll_offset = 0;
         } else {
@@ -60,7 +122,7 @@ struct MenuState {
     void PrevParam() {
         selected_param--;
         if (selected_param < 0) {
-            selected_param = param_count - 1;
+            selected_param = RowCount() - 1;
             scroll_offset = selected_param - VISIBLE_PARAMS + 1;
             if (scroll_offset < 0) scroll_offset = 0;
         } else {
@@ -79,6 +141,95 @@ struct MenuState {
         state = UIState::Navigate;
     }
     
+    // Scrolling past either end of a module page moves to the neighbouring
+    // page; the spectrum page sits after the last one
+    bool HasPage(bool forward) const {
+        return forward ? module_page + 1 < module_count : module_page > 0;
+    }
+    
+    void EnterPage(int page, int page_param_count, bool forward) {
+        module_page = page;
+        param_count = page_param_count;
+        state = UIState::Navigate;
+        if (forward) {
+            selected_param = 0;
+            scroll_offset = 0;
+        } else {
+            selected_param = RowCount() - 1;
+            scroll_offset = 0;
+            ScrollToSelected();
+        }
+    }
+    
+    void EnterSpectrum() {
+        state = UIState::Spectrum;
+    }
+    
+    void BeginNameEntry() {
+        preset_name[0] = NAME_CHARS[0];
+        preset_name[1] = '\0';
+        name_cursor = 0;
+        state = UIState::SaveName;
+    }
+    
+    // Step the character under the cursor through NAME_CHARS
+    void CycleNameChar(int increment) {
+        int index = 0;
+        while (index < NAME_CHAR_COUNT && NAME_CHARS[index] != preset_name[name_cursor]) index++;
+        index = ((index + increment) % NAME_CHAR_COUNT + NAME_CHAR_COUNT) % NAME_CHAR_COUNT;
+        preset_name[name_cursor] = NAME_CHARS[index];
+    }
+    
+    void NextNameChar() {
+        if (name_cursor + 1 >= MAX_NAME_LENGTH) return;
+        name_cursor++;
+        preset_name[name_cursor] = NAME_CHARS[0];
+        preset_name[name_cursor + 1] = '\0';
+    }
+    
+    void BeginLoadBrowser() {
+        selected_preset = 0;
+        state = UIState::LoadBrowser;
+    }
+    
+    void MovePreset(int increment, int preset_count) {
+        if (preset_count <= 0) return;
+        selected_preset = std::clamp(selected_preset + increment, 0, preset_count - 1);
+    }
+    
+    void BeginSlotSelect() {
+        state = UIState::SlotSelect;
+    }
+    
+    void MoveSlot(int increment, int slot_count) {
+        if (slot_count <= 0) return;
+        selected_slot = std::clamp(selected_slot + increment, 0, slot_count - 1);
+    }
+    
+    void BeginModuleSelect(int current_entry, int entry_count, bool can_add, bool can_remove) {
+        module_entry_count = entry_count;
+        module_can_add = can_add;
+        module_can_remove = can_remove;
+        selected_module = current_entry;
+        state = UIState::ModuleSelect;
+    }
+    
+    int ModuleRowCount() const {
+        return module_entry_count * (module_can_add ? 2 : 1) + (module_can_remove ? 1 : 0);
+    }
+    bool IsAddModuleRow(int row) const {
+        return module_can_add && row >= module_entry_count && row < 2 * module_entry_count;
+    }
+    bool IsRemoveModuleRow(int row) const { return module_can_remove && row == ModuleRowCount() - 1; }
+    // Image entry of a replace or add row
+    int ModuleRowEntry(int row) const { return module_entry_count > 0 ? row % module_entry_count : 0; }
+    
+    void MoveModule(int increment) {
+        int row_count = ModuleRowCount();
+        if (row_count <= 0) return;
+        selected_module = std::clamp(selected_module + increment, 0, row_count - 1);
+    }
+    
     bool IsInSubmenu() const {
         return state == UIState::Submenu || state == UIState::SubmenuEdit;
     }
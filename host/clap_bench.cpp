@@ -0,0 +1,206 @@
+// Plaits CLAP plugin cost through its public entry point, as a host would
+// load it: one instance at 48 kHz in 256-sample blocks, N held notes,
+// stepping through every bank and engine (one per second of audio).
+// - x realtime: seconds of audio rendered per second of CPU time
+// - instances/core: instances one core runs in realtime, at 70% load to
+//   leave headroom for the host
+//
+// Build and run: make -C host plaits.clap clap_bench && host/clap_bench host/plaits.clap
+
+#include <clap/clap.h>
+
+#include <dlfcn.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const double kSampleRate = 48000.0;
+const uint32_t kBlockSize = 256;
+const int kBanks = 3;
+const int kEngines = 8;
+const int kPolyphonies[] = {1, 4, 8};
+const double kLoad = 0.7;
+
+// Plaits parameter ids (PlaitsPort parameter order)
+const clap_id kBankParam = 0;
+const clap_id kEngineParam = 1;
+
+const clap_host_t kHost = {
+    CLAP_VERSION_INIT,
+    nullptr,
+    "clap_bench",
+    "mutables_daisies",
+    "",
+    "1.0.0",
+    [](const clap_host_t*, const char*) -> const void* { return nullptr; },
+    [](const clap_host_t*) {},
+    [](const clap_host_t*) {},
+    [](const clap_host_t*) {},
+};
+
+// Events of one block, in time order
+struct EventList {
+    std::vector<clap_event_note_t> notes;
+    std::vector<clap_event_param_value_t> params;
+    std::vector<const clap_event_header_t*> order;
+    clap_input_events_t in;
+
+    EventList() {
+        in.ctx = this;
+        in.size = [](const clap_input_events_t* list) {
+            return static_cast<uint32_t>(static_cast<const EventList*>(list->ctx)->order.size());
+        };
+        in.get = [](const clap_input_events_t* list, uint32_t index) {
+            return static_cast<const EventList*>(list->ctx)->order[index];
+        };
+    }
+
+    void Clear() {
+        notes.clear();
+        params.clear();
+        order.clear();
+    }
+
+    void Note(uint16_t type, int32_t id, int16_t key) {
+        clap_event_note_t note = {};
+        note.header = {sizeof(note), 0, CLAP_CORE_EVENT_SPACE_ID, type, 0};
+        note.note_id = id;
+        note.port_index = 0;
+        note.channel = 0;
+        note.key = key;
+        note.velocity = 0.8;
+        notes.push_back(note);
+    }
+
+    void Param(clap_id id, double value) {
+        clap_event_param_value_t param = {};
+        param.header = {sizeof(param), 0, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_PARAM_VALUE, 0};
+        param.param_id = id;
+        param.note_id = -1;
+        param.port_index = -1;
+        param.channel = -1;
+        param.key = -1;
+        param.value = value;
+        params.push_back(param);
+    }
+
+    // After the last Note()/Param() of the block: vectors no longer move
+    const clap_input_events_t* Finish() {
+        for (const auto& param : params) order.push_back(&param.header);
+        for (const auto& note : notes) order.push_back(&note.header);
+        return &in;
+    }
+};
+
+bool PushEvent(const clap_output_events_t*, const clap_event_header_t*) {
+    return true;
+}
+
+// CPU seconds to render kBanks * kEngines seconds with `polyphony` notes
+double Run(const clap_plugin_factory_t* factory, const char* id, int polyphony) {
+    const clap_plugin_t* plugin = factory->create_plugin(factory, &kHost, id);
+    if (!plugin || !plugin->init(plugin) || !plugin->activate(plugin, kSampleRate, kBlockSize, kBlockSize)) {
+        return -1.0;
+    }
+    plugin->start_processing(plugin);
+
+    std::vector<float> buffers(4 * kBlockSize);
+    float* out[2] = {&buffers[0], &buffers[kBlockSize]};
+    float* aux[2] = {&buffers[2 * kBlockSize], &buffers[3 * kBlockSize]};
+    clap_audio_buffer_t ports[2] = {};
+    ports[0].data32 = out;
+    ports[0].channel_count = 2;
+    ports[1].data32 = aux;
+    ports[1].channel_count = 2;
+    clap_output_events_t out_events = {nullptr, PushEvent};
+
+    clap_process_t process = {};
+    process.steady_time = 0;
+    process.frames_count = kBlockSize;
+    process.audio_outputs = ports;
+    process.audio_outputs_count = 2;
+    process.out_events = &out_events;
+
+    EventList events;
+    const int blocks_per_engine = static_cast<int>(kSampleRate) / kBlockSize;
+    volatile float sink = 0.0f;
+    double seconds = 0.0;
+    int32_t note_id = 0;
+
+    for (int engine = 0; engine < kBanks * kEngines; engine++) {
+        for (int block = 0; block < blocks_per_engine; block++) {
+            events.Clear();
+            if (block == 0) {
+                events.Param(kBankParam, engine / kEngines);
+                events.Param(kEngineParam, engine % kEngines);
+                // Retrigger the chord on each engine, a fifth-stacked spread
+                for (int n = 0; n < polyphony; n++) {
+                    if (engine > 0) events.Note(CLAP_EVENT_NOTE_OFF, note_id - polyphony + n, 0);
+                }
+                for (int n = 0; n < polyphony; n++) {
+                    events.Note(CLAP_EVENT_NOTE_ON, note_id++, static_cast<int16_t>(36 + 7 * n));
+                }
+            }
+            process.in_events = events.Finish();
+
+            auto start = std::chrono::steady_clock::now();
+            plugin->process(plugin, &process);
+            auto end = std::chrono::steady_clock::now();
+            seconds += std::chrono::duration<double>(end - start).count();
+            sink = sink + out[0][0];
+            process.steady_time += kBlockSize;
+        }
+    }
+
+    plugin->stop_processing(plugin);
+    plugin->deactivate(plugin);
+    plugin->destroy(plugin);
+    return seconds;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "plaits.clap";
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        fprintf(stderr, "%s\n", dlerror());
+        return 1;
+    }
+    auto entry = static_cast<const clap_plugin_entry_t*>(dlsym(library, "clap_entry"));
+    if (!entry || !entry->init(path)) {
+        fprintf(stderr, "%s: no clap_entry\n", path);
+        return 1;
+    }
+    auto factory = static_cast<const clap_plugin_factory_t*>(entry->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    if (!factory || factory->get_plugin_count(factory) == 0) {
+        fprintf(stderr, "%s: no plugin\n", path);
+        return 1;
+    }
+    const clap_plugin_descriptor_t* descriptor = factory->get_plugin_descriptor(factory, 0);
+
+    printf("%s (%s)\n", descriptor->name, descriptor->id);
+    printf("%-9s %12s %12s %15s\n", "voices", "us/block", "x realtime", "instances/core");
+    double audio = kBanks * kEngines * (static_cast<int>(kSampleRate) / kBlockSize) * kBlockSize / kSampleRate;
+    for (int polyphony : kPolyphonies) {
+        double seconds = Run(factory, descriptor->id, polyphony);
+        if (seconds < 0.0) {
+            fprintf(stderr, "%s: could not start the plugin\n", path);
+            return 1;
+        }
+        double blocks = audio * kSampleRate / kBlockSize;
+        double realtime = audio / seconds;
+        printf("%-9d %12.2f %12.1f %15d\n", polyphony, seconds / blocks * 1e6, realtime,
+               static_cast<int>(realtime * kLoad));
+    }
+    printf("%d engines x 1 s at %.0f Hz in %u-sample blocks, %.0f%% load per core\n",
+           kBanks * kEngines, kSampleRate, kBlockSize, kLoad * 100.0);
+
+    entry->deinit();
+    dlclose(library);
+    return 0;
+}
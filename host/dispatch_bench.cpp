@@ -0,0 +1,141 @@
+// Audio-callback dispatch cost: the per-block module work of the firmware
+// (CV mappings, gate, Process, effective values) called through the
+// ModuleBase vtable, against ModuleHarness bound to the concrete type.
+// - GainModule: trivial DSP with inline definitions, so the difference is
+//   the dispatch and what inlining removes
+// - PlaitsPort: the real module, Process defined out of line
+//
+// Build and run: make -C host dispatch_bench && host/dispatch_bench
+
+#include "plaits_port.h"
+#include "../common/cv_input.h"
+#include "../common/module_base.h"
+#include "../common/module_harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace mutables_ui;
+using mutables_plaits::PlaitsPort;
+
+namespace {
+
+const float kSampleRate = 48000.0f;
+const size_t kBlockSize = 24;
+const int kBlocks = 200000;
+const int kPlaitsBlocks = 20000;
+const int kRepeats = 5;
+
+class GainModule final : public ModuleBase {
+public:
+    const char* GetName() const override { return "Gain"; }
+    const char* GetShortName() const override { return "gain"; }
+
+    void Init(float sample_rate) override {
+        (void)sample_rate;
+        for (size_t i = 0; i < kNumParams; i++) {
+            params_[i] = Parameter("Gain", 0.0f, 1.0f);
+            params_[i].value = 0.5f;
+            params_[i].cv_mapping.cv_input = static_cast<int8_t>(i % 4);
+            params_[i].cv_mapping.active = i < 4;
+        }
+    }
+
+    void Process(float** in, float** out, size_t size) override {
+        float gain = params_[0].value;
+        for (size_t i = 0; i < size; i++) {
+            out[0][i] = in[0][i] * gain;
+            out[1][i] = in[1][i] * gain;
+        }
+    }
+
+    Parameter* GetParameters() override { return params_; }
+    size_t GetParameterCount() const override { return kNumParams; }
+    void ProcessGate(int gate_index, bool state) override { gate_ = gate_index == 0 && state; }
+
+private:
+    static constexpr size_t kNumParams = 9;  // As many as Plaits
+    Parameter params_[kNumParams];
+    bool gate_ = false;
+};
+
+struct Buffers {
+    float in[4][kBlockSize];
+    float out[4][kBlockSize];
+    float* ins[4];
+    float* outs[4];
+    float effective[kMaxParameters];
+
+    Buffers() {
+        for (int c = 0; c < 4; c++) {
+            std::fill(in[c], in[c] + kBlockSize, 0.25f);
+            ins[c] = in[c];
+            outs[c] = out[c];
+        }
+    }
+};
+
+// Per-block work of the audio callback through ModuleBase, as ModuleChain
+// does it
+void RunVirtual(ModuleBase* module, CVInputBank& cv, Buffers& b, int blocks) {
+    for (int n = 0; n < blocks; n++) {
+        cv.UpdateRawValues(0.5f, 0.5f, 0.5f, (n & 1) ? 0.6f : 0.4f);
+        ApplyCvModulation(module->GetParameters(), module->GetParameterCount(), cv);
+        module->ProcessGate(0, n & 64);
+        module->Process(b.ins, b.outs, kBlockSize);
+        module->GetEffectiveValues(b.effective, kMaxParameters);
+    }
+}
+
+// The same through the harness
+template <typename Module>
+void RunHarness(Module& module, CVInputBank& cv, Buffers& b, int blocks) {
+    ModuleHarness<Module> harness(module);
+    for (int n = 0; n < blocks; n++) {
+        cv.UpdateRawValues(0.5f, 0.5f, 0.5f, (n & 1) ? 0.6f : 0.4f);
+        harness.ApplyCv(cv);
+        harness.ProcessGate(0, n & 64);
+        harness.Process(b.ins, b.outs, kBlockSize);
+        harness.GetEffectiveValues(b.effective, kMaxParameters);
+    }
+}
+
+template <typename F>
+double BestNsPerBlock(F run, int blocks) {
+    double best = 1e30;
+    for (int r = 0; r < kRepeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / blocks);
+    }
+    return best;
+}
+
+template <typename Module>
+void Compare(const char* name, int blocks) {
+    Module* module = new Module;
+    module->Init(kSampleRate);
+    // Through a volatile pointer the compiler cannot see the dynamic type
+    ModuleBase* volatile base = module;
+    CVInputBank cv;
+    Buffers buffers;
+
+    double virtual_ns = BestNsPerBlock([&] { RunVirtual(base, cv, buffers, blocks); }, blocks);
+    double harness_ns = BestNsPerBlock([&] { RunHarness(*module, cv, buffers, blocks); }, blocks);
+    printf("%-8s %12.1f %12.1f %+9.1f%%\n", name, virtual_ns, harness_ns,
+           100.0 * (harness_ns / virtual_ns - 1.0));
+    delete module;
+}
+
+} // namespace
+
+int main() {
+    printf("%-8s %12s %12s %10s\n", "module", "virtual ns", "harness ns", "change");
+    Compare<GainModule>("gain", kBlocks);
+    Compare<PlaitsPort>("plaits", kPlaitsBlocks);
+    printf("per %zu-sample block, best of %d\n", kBlockSize, kRepeats);
+    return 0;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+// Plaits engine and parameter grids for the batch tools (sample_export,
+// sound_index): grid points, engine names, and one-shot rendering through
+// PlaitsSynth.
+
+#include "plaits_synth.h"
+#include "../common/preset_format.h"
+#include "stmlib/utils/random.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace mutables_host {
+
+constexpr uint32_t kGridSampleRate = 48000;
+constexpr int kNumBanks = 3;
+constexpr int kEnginesPerBank = 8;
+constexpr int kNumEngines = kNumBanks * kEnginesPerBank;
+
+// PlaitsPort parameter order
+constexpr size_t kBankParam = 0;
+constexpr size_t kEngineParam = 1;
+constexpr size_t kHarmonicsParam = 2;
+constexpr size_t kTimbreParam = 3;
+constexpr size_t kMorphParam = 4;
+
+// One engine, note and knob setting. Hashed as raw bytes for the RNG
+// seed: keep the layout.
+struct GridPoint {
+    int engine;                          // 0-23: bank * 8 + engine
+    int note;
+    float harmonics;
+    float timbre;
+    float morph;
+};
+
+// Engines x notes x harmonics x timbre x morph, engine-major so one
+// engine's points are adjacent
+struct EngineGrid {
+    std::vector<int> engines;
+    std::vector<int> notes;
+    std::vector<float> harmonics;
+    std::vector<float> timbre;
+    std::vector<float> morph;
+
+    // Every engine, and `steps` evenly spaced values for any knob without
+    // a list
+    void FillDefaults(int steps) {
+        if (engines.empty()) {
+            for (int e = 0; e < kNumEngines; e++) engines.push_back(e);
+        }
+        for (std::vector<float>* knob : {&harmonics, &timbre, &morph}) {
+            if (!knob->empty()) continue;
+            for (int s = 0; s < steps; s++) {
+                knob->push_back(steps > 1 ? static_cast<float>(s) / (steps - 1) : 0.5f);
+            }
+        }
+    }
+
+    bool IsValid() const {
+        for (int engine : engines) if (engine < 0 || engine >= kNumEngines) return false;
+        for (int note : notes) if (note < 0 || note > 127) return false;
+        return GetCount() > 0;
+    }
+
+    size_t GetCount() const {
+        return engines.size() * notes.size() * harmonics.size() * timbre.size() * morph.size();
+    }
+
+    GridPoint Get(size_t index) const {
+        GridPoint point;
+        point.morph = morph[index % morph.size()];
+        index /= morph.size();
+        point.timbre = timbre[index % timbre.size()];
+        index /= timbre.size();
+        point.harmonics = harmonics[index % harmonics.size()];
+        index /= harmonics.size();
+        point.note = notes[index % notes.size()];
+        index /= notes.size();
+        point.engine = engines[index];
+        return point;
+    }
+};
+
+// Engine labels as the menu shows them, per bank
+struct EngineNames {
+    std::string bank[kNumEngines];
+    std::string engine[kNumEngines];
+
+    EngineNames() {
+        mutables_plaits::PlaitsPort reference;
+        reference.Init(static_cast<float>(kGridSampleRate));
+        mutables_ui::Parameter* params = reference.GetParameters();
+        for (int b = 0; b < kNumBanks; b++) {
+            params[kBankParam].value = static_cast<float>(b);
+            reference.OnParametersLoaded();
+            for (int e = 0; e < kEnginesPerBank; e++) {
+                bank[b * kEnginesPerBank + e] = params[kBankParam].GetEnumLabel();
+                engine[b * kEnginesPerBank + e] = params[kEngineParam].enum_labels[e];
+            }
+        }
+    }
+};
+
+// 60 = C4, sharps as "s" for file names
+inline std::string NoteName(int note) {
+    static const char* const names[] = {"C", "Cs", "D", "Ds", "E", "F", "Fs", "G", "Gs", "A", "As", "B"};
+    return names[note % 12] + std::to_string(note / 12 - 1);
+}
+
+// Comma-separated numbers
+template <typename T>
+bool ParseList(const char* text, std::vector<T>& values) {
+    values.clear();
+    for (const char* p = text; *p;) {
+        char* end;
+        double value = strtod(p, &end);
+        if (end == p || (*end && *end != ',')) return false;
+        values.push_back(static_cast<T>(value));
+        p = *end ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+// A Plaits preset saved on the SD card (<module>/presets/*.bin)
+inline bool LoadPlaitsPreset(const char* path, mutables_ui::PresetRecord& record) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    bool ok = fread(&record, sizeof(record), 1, file) == 1;
+    fclose(file);
+    return ok && mutables_ui::PresetIsValid(record, mutables_ui::ModuleTag("plaits"));
+}
+
+// Renders the one-shot of `point`: the note held for `gate` seconds, then
+// until the voice is silent, `length` seconds at most. Mono OUT goes to
+// sink(samples, count), which returns false to stop. stmlib::Random is
+// seeded from the point, so a point always renders the same samples.
+// Returns the frame count, or -1 if the sink failed.
+template <typename Sink>
+int64_t RenderOneShot(const GridPoint& point, const mutables_ui::PresetRecord* preset,
+                      double gate_seconds, double length_seconds, Sink sink) {
+    constexpr size_t kChunk = 1024;
+    constexpr uint32_t kRandomSeed = 0x21;
+    using mutables_plaits::PlaitsSynth;
+
+    stmlib::Random::Seed(mutables_ui::Crc32(&point, sizeof(point), kRandomSeed));
+    PlaitsSynth synth;
+    if (!synth.Init(static_cast<float>(kGridSampleRate), 1)) return -1;
+    if (preset) {
+        for (size_t i = 0; i < std::min<size_t>(preset->param_count, synth.GetParameterCount()); i++) {
+            synth.SetParameter(0, i, preset->values[i]);
+        }
+    }
+    synth.SetParameter(0, kBankParam, static_cast<float>(point.engine / kEnginesPerBank));
+    synth.SetParameter(0, kEngineParam, static_cast<float>(point.engine % kEnginesPerBank));
+    synth.SetParameter(0, kHarmonicsParam, point.harmonics);
+    synth.SetParameter(0, kTimbreParam, point.timbre);
+    synth.SetParameter(0, kMorphParam, point.morph);
+    synth.NoteOn(0, PlaitsSynth::kAnyNote, 0, static_cast<int16_t>(point.note), 1.0f);
+
+    float left[kChunk];
+    float right[kChunk];
+    uint64_t latency = synth.GetLatency();
+    uint64_t gate = latency + static_cast<uint64_t>(gate_seconds * kGridSampleRate);
+    uint64_t length = latency + static_cast<uint64_t>(length_seconds * kGridSampleRate);
+    uint64_t frame = 0;
+    int64_t written = 0;
+    while (frame < length && (frame <= gate || !synth.IsIdle())) {
+        uint64_t end = std::min<uint64_t>(frame + kChunk, length);
+        if (frame < gate && gate < end) end = gate;  // Release on a chunk boundary
+        if (end == gate) synth.NoteOff(static_cast<uint32_t>(end - frame), PlaitsSynth::kAnyNote, 0,
+                                       static_cast<int16_t>(point.note));
+        size_t count = static_cast<size_t>(end - frame);
+        synth.Render(left, right, nullptr, nullptr, count);
+        // The first `latency` frames precede the note
+        size_t skip = frame < latency ? static_cast<size_t>(std::min<uint64_t>(latency - frame, count)) : 0;
+        if (!sink(left + skip, count - skip)) return -1;
+        written += count - skip;
+        frame = end;
+    }
+    return written;
+}
+
+} // namespace mutables_host
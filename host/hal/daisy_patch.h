@@ -0,0 +1,456 @@
+#pragma once
+
+// Host stand-in for the parts of libDaisy used by the ports, so firmware
+// sources (plaits/main.cpp, common/*) build unmodified on Linux.
+// Time is virtual: it only moves in System::Delay(), which also runs the
+// audio callback for every block period crossed and applies the scripted
+// inputs that fall due (see sim.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+struct FontDef {
+    uint8_t FontWidth;
+    uint8_t FontHeight;
+    const uint16_t* data;
+};
+
+extern FontDef Font_6x8;
+extern FontDef Font_7x10;
+extern FontDef Font_11x18;
+extern FontDef Font_16x26;
+
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+// Linker sections of the Daisy memory regions, plain memory on the host
+#define DTCM_MEM_SECTION
+#define DSY_SDRAM_BSS
+
+namespace daisy {
+
+class System {
+public:
+    static uint32_t GetNow();        // Virtual ms
+    static uint32_t GetUs();         // Virtual us, plus real time since the last Delay()
+    static uint32_t GetTick();       // GetUs() at GetTickFreq()
+    static uint32_t GetTickFreq() { return 200000000; }
+    static void Delay(uint32_t ms);
+    static void DelayUs(uint32_t us);
+};
+
+// 128x64 monochrome framebuffer. Characters are drawn as solid cells
+// (glyph width minus 1 by height minus 2), enough to tell layouts apart.
+class OledDisplay {
+public:
+    static constexpr int kWidth = 128;
+    static constexpr int kHeight = 64;
+
+    OledDisplay() : cursor_x_(0), cursor_y_(0), update_count_(0) { Fill(false); }
+
+    uint16_t Width() const { return kWidth; }
+    uint16_t Height() const { return kHeight; }
+
+    void Fill(bool on) { memset(pixels_, on ? 1 : 0, sizeof(pixels_)); }
+
+    void DrawPixel(int x, int y, bool on) {
+        if (x < 0 || y < 0 || x >= kWidth || y >= kHeight) return;
+        pixels_[y][x] = on ? 1 : 0;
+    }
+
+    void DrawLine(int x1, int y1, int x2, int y2, bool on) {
+        int dx = x2 > x1 ? x2 - x1 : x1 - x2;
+        int dy = y2 > y1 ? y1 - y2 : y2 - y1;
+        int sx = x1 < x2 ? 1 : -1;
+        int sy = y1 < y2 ? 1 : -1;
+        int err = dx + dy;
+        while (true) {
+            DrawPixel(x1, y1, on);
+            if (x1 == x2 && y1 == y2) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x1 += sx; }
+            if (e2 <= dx) { err += dx; y1 += sy; }
+        }
+    }
+
+    void DrawRect(int x1, int y1, int x2, int y2, bool on, bool fill = false) {
+        if (fill) {
+            for (int y = y1; y <= y2; y++) DrawLine(x1, y, x2, y, on);
+        } else {
+            DrawLine(x1, y1, x2, y1, on);
+            DrawLine(x1, y2, x2, y2, on);
+            DrawLine(x1, y1, x1, y2, on);
+            DrawLine(x2, y1, x2, y2, on);
+        }
+    }
+
+    void SetCursor(int x, int y) {
+        cursor_x_ = x;
+        cursor_y_ = y;
+    }
+
+    char WriteChar(char ch, FontDef font, bool on) {
+        if (ch != ' ') {
+            DrawRect(cursor_x_, cursor_y_ + 1, cursor_x_ + font.FontWidth - 2,
+                     cursor_y_ + font.FontHeight - 2, on, true);
+        }
+        cursor_x_ += font.FontWidth;
+        return ch;
+    }
+
+    char WriteString(const char* str, FontDef font, bool on) {
+        while (*str) {
+            WriteChar(*str++, font, on);
+        }
+        return 0;
+    }
+
+    void Update() {
+        memcpy(shown_, pixels_, sizeof(pixels_));
+        update_count_++;
+    }
+
+    // Last frame sent with Update()
+    bool GetPixel(int x, int y) const { return shown_[y][x] != 0; }
+    uint32_t GetUpdateCount() const { return update_count_; }
+
+private:
+    uint8_t pixels_[kHeight][kWidth];
+    uint8_t shown_[kHeight][kWidth] = {};
+    int cursor_x_;
+    int cursor_y_;
+    uint32_t update_count_;
+};
+
+// MIDI
+
+static constexpr size_t SYSEX_BUFFER_LEN = 128;
+
+enum MidiMessageType {
+    NoteOff,
+    NoteOn,
+    PolyphonicKeyPressure,
+    ControlChange,
+    ProgramChange,
+    ChannelPressure,
+    PitchBend,
+    SystemCommon,
+    SystemRealTime,
+    ChannelMode,
+    MessageLast
+};
+
+enum SystemCommonType {
+    SystemExclusive,
+    MTCQuarterFrame,
+    SongPositionPointer,
+    SongSelect,
+    SCUndefined0,
+    SCUndefined1,
+    TuneRequest,
+    SysExEnd,
+    SystemCommonLast
+};
+
+struct NoteOnEvent { int channel; uint8_t note; uint8_t velocity; };
+struct NoteOffEvent { int channel; uint8_t note; uint8_t velocity; };
+struct ControlChangeEvent { int channel; uint8_t control_number; uint8_t value; };
+struct ProgramChangeEvent { int channel; uint8_t program; };
+struct SystemExclusiveEvent { int length; int channel; uint8_t data[SYSEX_BUFFER_LEN]; };
+
+struct MidiEvent {
+    MidiMessageType type;
+    int channel;
+    uint8_t data[2];
+    uint8_t sysex_data[SYSEX_BUFFER_LEN];
+    uint8_t sysex_message_len;
+    SystemCommonType sc_type;
+
+    NoteOnEvent AsNoteOn() { return NoteOnEvent{channel, data[0], data[1]}; }
+    NoteOffEvent AsNoteOff() { return NoteOffEvent{channel, data[0], data[1]}; }
+    ControlChangeEvent AsControlChange() { return ControlChangeEvent{channel, data[0], data[1]}; }
+    ProgramChangeEvent AsProgramChange() { return ProgramChangeEvent{channel, data[0]}; }
+    SystemExclusiveEvent AsSystemExclusive() {
+        SystemExclusiveEvent event;
+        event.length = sysex_message_len;
+        event.channel = channel;
+        memcpy(event.data, sysex_data, SYSEX_BUFFER_LEN);
+        return event;
+    }
+};
+
+// Scripted events arrive with Inject(); Listen() makes them visible like
+// the UART parser would. Sent bytes are kept for inspection.
+class MidiUartHandler {
+public:
+    void StartReceive() {}
+    void Listen() {
+        while (!incoming_.empty()) {
+            events_.push_back(incoming_.front());
+            incoming_.pop_front();
+        }
+    }
+    bool HasEvents() const { return !events_.empty(); }
+    MidiEvent PopEvent() {
+        MidiEvent event = events_.front();
+        events_.pop_front();
+        return event;
+    }
+    void SendMessage(uint8_t* bytes, size_t size) {
+        sent_.insert(sent_.end(), bytes, bytes + size);
+    }
+
+    void Inject(const MidiEvent& event) { incoming_.push_back(event); }
+    const std::vector<uint8_t>& GetSent() const { return sent_; }
+
+private:
+    std::deque<MidiEvent> incoming_;
+    std::deque<MidiEvent> events_;
+    std::vector<uint8_t> sent_;
+};
+
+// Controls: set by the script, latched by ProcessAllControls()
+
+class Encoder {
+public:
+    Encoder() : increment_(0), pending_(0), pressed_(false), held_(false), was_held_(false) {}
+
+    int32_t Increment() const { return increment_; }
+    bool RisingEdge() const { return held_ && !was_held_; }
+    bool FallingEdge() const { return !held_ && was_held_; }
+    bool Pressed() const { return held_; }
+
+    void Debounce() {
+        increment_ = pending_;
+        pending_ = 0;
+        was_held_ = held_;
+        held_ = pressed_;
+    }
+
+    void SimTurn(int steps) { pending_ += steps; }
+    void SimPress(bool pressed) { pressed_ = pressed; }
+
+private:
+    int32_t increment_;
+    int32_t pending_;
+    bool pressed_;
+    bool held_;
+    bool was_held_;
+};
+
+class GateIn {
+public:
+    GateIn() : state_(false), prev_(false), trig_(false) {}
+    bool State() const { return state_; }
+    bool Trig() const { return trig_; }
+
+    void Latch() {
+        trig_ = state_ && !prev_;
+        prev_ = state_;
+    }
+    void SimSet(bool state) { state_ = state; }
+
+private:
+    bool state_;
+    bool prev_;
+    bool trig_;
+};
+
+namespace AudioHandle {
+typedef const float* const* InputBuffer;
+typedef float** OutputBuffer;
+typedef void (*AudioCallback)(InputBuffer in, OutputBuffer out, size_t size);
+}
+
+struct SaiHandle {
+    struct Config {
+        enum class SampleRate { SAI_8KHZ, SAI_16KHZ, SAI_32KHZ, SAI_48KHZ, SAI_96KHZ };
+    };
+};
+
+// Same interface as libDaisy, measured in real (host) time against the
+// block period
+class CpuLoadMeter {
+public:
+    void Init(float sample_rate, int block_size, float smoothing_cutoff_hz = 1.0f);
+    void OnBlockStart();
+    void OnBlockEnd();
+    float GetAvgCpuLoad() const { return avg_; }
+    float GetMinCpuLoad() const { return min_; }
+    float GetMaxCpuLoad() const { return max_; }
+    void Reset();
+
+private:
+    float block_us_ = 500.0f;
+    float coeff_ = 0.01f;
+    float avg_ = 0.0f;
+    float min_ = 1.0f;
+    float max_ = 0.0f;
+    int64_t start_ns_ = 0;
+};
+
+// 8 MB QSPI in RAM, addressed like the memory-mapped chip (0x90000000)
+class QSPIHandle {
+public:
+    enum Result { OK, ERR };
+    static constexpr uint32_t kBase = 0x90000000;
+    static constexpr size_t kSize = 8 * 1024 * 1024;
+
+    QSPIHandle() : memory_(kSize, 0xFF), erase_count_(0), program_count_(0) {}
+
+    Result Erase(uint32_t start, uint32_t end) {
+        for (uint32_t a = start; a < end; a += 4096) {
+            if (EraseSector(a) != OK) return ERR;
+        }
+        return OK;
+    }
+
+    Result EraseSector(uint32_t address) {
+        uint32_t offset = (address - kBase) & ~4095u;
+        if (offset >= kSize) return ERR;
+        memset(&memory_[offset], 0xFF, 4096);
+        erase_count_++;
+        return OK;
+    }
+
+    Result Write(uint32_t address, uint32_t size, uint8_t* buffer) {
+        uint32_t offset = address - kBase;
+        if (offset + size > kSize) return ERR;
+        for (uint32_t i = 0; i < size; i++) {
+            memory_[offset + i] &= buffer[i];  // NOR: program clears bits
+        }
+        program_count_++;
+        return OK;
+    }
+
+    void* GetData(uint32_t offset = 0) { return &memory_[offset]; }
+
+    std::vector<uint8_t>& GetMemory() { return memory_; }
+    uint32_t GetEraseCount() const { return erase_count_; }
+    uint32_t GetProgramCount() const { return program_count_; }
+
+private:
+    std::vector<uint8_t> memory_;
+    uint32_t erase_count_;
+    uint32_t program_count_;
+};
+
+class DaisySeed {
+public:
+    DaisySeed() : led_(false) {}
+
+    QSPIHandle qspi;
+
+    void SetLed(bool state);
+    bool GetLed() const { return led_; }
+
+    static void StartLog(bool wait_for_pc = false) { (void)wait_for_pc; }
+    static void PrintLine(const char* format, ...);
+    static void Print(const char* format, ...);
+
+private:
+    bool led_;
+};
+
+class GPIO {
+public:
+    enum class Mode { INPUT, OUTPUT, OPEN_DRAIN, ANALOG };
+    void Init(int pin, Mode mode) { (void)pin; (void)mode; }
+    void Write(bool state) { state_ = state; }
+    bool Read() const { return state_; }
+
+private:
+    bool state_ = false;
+};
+
+class DaisyPatch {
+public:
+    enum Ctrl { CTRL_1, CTRL_2, CTRL_3, CTRL_4, CTRL_LAST };
+    enum GateInput { GATE_IN_1, GATE_IN_2, GATE_IN_LAST };
+
+    DaisyPatch();
+
+    void Init(bool boost = false);
+    void SetAudioBlockSize(size_t size) { block_size_ = size; }
+    void SetAudioSampleRate(SaiHandle::Config::SampleRate rate);
+    float AudioSampleRate() const { return sample_rate_; }
+    size_t AudioBlockSize() const { return block_size_; }
+    float AudioCallbackRate() const { return sample_rate_ / block_size_; }
+
+    void StartAdc() {}
+    void StopAdc() {}
+    void StartAudio(AudioHandle::AudioCallback cb);
+    void ChangeAudioCallback(AudioHandle::AudioCallback cb) { callback_ = cb; }
+    void StopAudio();
+
+    void ProcessAnalogControls() {}
+    void ProcessDigitalControls();
+    void ProcessAllControls() {
+        ProcessAnalogControls();
+        ProcessDigitalControls();
+    }
+
+    float GetKnobValue(Ctrl k) const { return knobs_[k]; }
+
+    OledDisplay display;
+    MidiUartHandler midi;
+    Encoder encoder;
+    GateIn gate_input[GATE_IN_LAST];
+    DaisySeed seed;
+
+    // Simulator side
+    void SimSetKnob(int k, float value) { knobs_[k] = value; }
+    AudioHandle::AudioCallback SimGetCallback() const { return callback_; }
+
+private:
+    float knobs_[CTRL_LAST];
+    float sample_rate_;
+    size_t block_size_;
+    AudioHandle::AudioCallback callback_;
+};
+
+// SD card: FatFS calls are served from a host directory (MUTABLES_SIM_SD)
+
+class SdmmcHandler {
+public:
+    enum class Result { OK, ERROR };
+    enum class BusWidth { BITS_1, BITS_4 };
+    enum class Speed { SLOW, MEDIUM_SLOW, STANDARD, FAST, VERY_FAST };
+    struct Config {
+        Speed speed;
+        BusWidth width;
+        bool clock_powersave;
+        void Defaults() {
+            speed = Speed::STANDARD;
+            width = BusWidth::BITS_4;
+            clock_powersave = false;
+        }
+    };
+    Result Init(const Config& config) { (void)config; return Result::OK; }
+};
+
+} // namespace daisy
+
+#include "fatfs.h"
+
+namespace daisy {
+
+class FatFSInterface {
+public:
+    enum class Result { OK, ERR_TOO_MANY_VOLUMES, ERR_NO_MEDIA_SELECTED, ERR_GENERIC };
+    struct Config {
+        enum Media : uint8_t { MEDIA_SD = 0x01, MEDIA_USB = 0x02 };
+        uint8_t media;
+    };
+    Result Init(const uint8_t media) { (void)media; return Result::OK; }
+    FATFS& GetSDFileSystem() { return sd_fs_; }
+    const char* GetSDPath() const { return "0:/"; }
+
+private:
+    FATFS sd_fs_;
+};
+
+} // namespace daisy
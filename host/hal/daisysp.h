@@ -0,0 +1,6 @@
+#pragma once
+
+// DaisySP is not used by the host builds; the namespace is enough for
+// `using namespace daisysp;` in firmware sources.
+namespace daisysp {
+}
@@ -0,0 +1,183 @@
+// FatFS calls served from the host directory named by MUTABLES_SIM_SD.
+// Without it there is no card: a forced f_mount() fails, and after a
+// deferred one (opt 0) the first call that needs the volume does, as in
+// FatFS. Every call that touches the card blocks the main loop for
+// MUTABLES_SIM_SD_LATENCY_US of virtual time (see sim.h).
+
+#include "fatfs.h"
+#include "sim.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string& SdRoot() {
+    static const std::string root = [] {
+        const char* value = getenv("MUTABLES_SIM_SD");
+        return std::string(value ? value : "");
+    }();
+    return root;
+}
+
+std::string HostPath(const char* path) {
+    std::string p(path);
+    if (p.compare(0, 2, "0:") == 0) p = p.substr(2);
+    if (p.empty() || p[0] != '/') p = "/" + p;
+    return SdRoot() + p;
+}
+
+bool CardPresent() {
+    std::error_code ec;
+    return !SdRoot().empty() && fs::is_directory(SdRoot(), ec);
+}
+
+// Calls that start from a path: FatFS brings the volume up here after a
+// deferred mount
+FRESULT VolumeCall() {
+    mutables_host::Sim::Get().OnSdCall();
+    return CardPresent() ? FR_OK : FR_NOT_READY;
+}
+
+FRESULT FromErrno(int error) {
+    switch (error) {
+        case ENOENT: return FR_NO_FILE;
+        case ENOTDIR: return FR_NO_PATH;
+        case EEXIST: return FR_EXIST;
+        case EACCES: return FR_DENIED;
+        default: return FR_DISK_ERR;
+    }
+}
+
+} // namespace
+
+FRESULT f_mount(FATFS* fs, const char* path, BYTE opt) {
+    (void)path;
+    fs->mounted = true;
+    if (opt == 0) return FR_OK;  // Registered only, no card access
+    return VolumeCall();
+}
+
+FRESULT f_mkdir(const char* path) {
+    if (FRESULT res = VolumeCall()) return res;
+    std::error_code ec;
+    std::string host = HostPath(path);
+    if (fs::exists(host, ec)) return FR_EXIST;
+    if (!fs::create_directory(host, ec)) return ec ? FromErrno(ec.value()) : FR_EXIST;
+    return FR_OK;
+}
+
+FRESULT f_open(FIL* fp, const char* path, BYTE mode) {
+    if (FRESULT res = VolumeCall()) return res;
+    std::string host = HostPath(path);
+    const char* fmode = "rb";
+    if ((mode & FA_WRITE) && (mode & FA_CREATE_ALWAYS)) fmode = "wb";
+    else if (mode & FA_WRITE) fmode = "r+b";
+
+    fp->file = fopen(host.c_str(), fmode);
+    if (!fp->file && (mode & FA_OPEN_ALWAYS) && errno == ENOENT) {
+        fp->file = fopen(host.c_str(), "w+b");
+    }
+    if (!fp->file) return FromErrno(errno);
+
+    fseek(fp->file, 0, SEEK_END);
+    fp->obj_size = static_cast<FSIZE_t>(ftell(fp->file));
+    fseek(fp->file, 0, SEEK_SET);
+    fp->fptr = 0;
+    return FR_OK;
+}
+
+FRESULT f_close(FIL* fp) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!fp->file) return FR_INVALID_OBJECT;
+    fclose(fp->file);
+    fp->file = nullptr;
+    return FR_OK;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!fp->file) return FR_INVALID_OBJECT;
+    *br = static_cast<UINT>(fread(buff, 1, btr, fp->file));
+    fp->fptr += *br;
+    return ferror(fp->file) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!fp->file) return FR_INVALID_OBJECT;
+    *bw = static_cast<UINT>(fwrite(buff, 1, btw, fp->file));
+    fp->fptr += *bw;
+    if (fp->fptr > fp->obj_size) fp->obj_size = fp->fptr;
+    return ferror(fp->file) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!fp->file) return FR_INVALID_OBJECT;
+    if (fseek(fp->file, static_cast<long>(ofs), SEEK_SET) != 0) return FR_DISK_ERR;
+    fp->fptr = ofs;
+    return FR_OK;
+}
+
+FRESULT f_sync(FIL* fp) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!fp->file) return FR_INVALID_OBJECT;
+    fflush(fp->file);
+    return FR_OK;
+}
+
+FRESULT f_unlink(const char* path) {
+    if (FRESULT res = VolumeCall()) return res;
+    return remove(HostPath(path).c_str()) == 0 ? FR_OK : FromErrno(errno);
+}
+
+FRESULT f_rename(const char* path_old, const char* path_new) {
+    if (FRESULT res = VolumeCall()) return res;
+    return rename(HostPath(path_old).c_str(), HostPath(path_new).c_str()) == 0
+        ? FR_OK : FromErrno(errno);
+}
+
+FRESULT f_opendir(DIR* dp, const char* path) {
+    if (FRESULT res = VolumeCall()) return res;
+    std::error_code ec;
+    auto* it = new fs::directory_iterator(HostPath(path), ec);
+    if (ec) {
+        delete it;
+        return FR_NO_PATH;
+    }
+    dp->handle = it;
+    return FR_OK;
+}
+
+FRESULT f_closedir(DIR* dp) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!dp->handle) return FR_INVALID_OBJECT;
+    delete static_cast<fs::directory_iterator*>(dp->handle);
+    dp->handle = nullptr;
+    return FR_OK;
+}
+
+FRESULT f_readdir(DIR* dp, FILINFO* fno) {
+    mutables_host::Sim::Get().OnSdCall();
+    if (!dp->handle) return FR_INVALID_OBJECT;
+    auto& it = *static_cast<fs::directory_iterator*>(dp->handle);
+    if (it == fs::directory_iterator()) {
+        fno->fname[0] = '\0';
+        return FR_OK;
+    }
+    std::error_code ec;
+    const fs::directory_entry& entry = *it;
+    snprintf(fno->fname, sizeof(fno->fname), "%s", entry.path().filename().c_str());
+    bool is_dir = entry.is_directory(ec);
+    fno->fattrib = is_dir ? AM_DIR : 0;
+    fno->fsize = is_dir ? 0 : static_cast<FSIZE_t>(entry.file_size(ec));
+    it.increment(ec);
+    return FR_OK;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// FatFS API subset over the host file system, rooted at the simulator's SD
+// directory. Same names and result codes as ff.h.
+
+#include <cstdint>
+#include <cstdio>
+
+typedef unsigned int UINT;
+typedef unsigned char BYTE;
+typedef uint32_t DWORD;
+typedef uint32_t FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED,
+    FR_EXIST,
+    FR_INVALID_OBJECT,
+    FR_WRITE_PROTECTED,
+    FR_INVALID_DRIVE,
+    FR_NOT_ENABLED,
+    FR_NO_FILESYSTEM
+} FRESULT;
+
+#define FA_READ          0x01
+#define FA_WRITE         0x02
+#define FA_OPEN_EXISTING 0x00
+#define FA_CREATE_NEW    0x04
+#define FA_CREATE_ALWAYS 0x08
+#define FA_OPEN_ALWAYS   0x10
+#define FA_OPEN_APPEND   0x30
+
+#define AM_RDO 0x01
+#define AM_HID 0x02
+#define AM_SYS 0x04
+#define AM_DIR 0x10
+#define AM_ARC 0x20
+
+struct FATFS {
+    bool mounted = false;
+};
+
+struct FIL {
+    FILE* file = nullptr;
+    FSIZE_t fptr = 0;
+    FSIZE_t obj_size = 0;
+};
+
+struct DIR {
+    void* handle = nullptr;
+};
+
+struct FILINFO {
+    FSIZE_t fsize;
+    BYTE fattrib;
+    char fname[256];
+};
+
+FRESULT f_mount(FATFS* fs, const char* path, BYTE opt);
+FRESULT f_mkdir(const char* path);
+FRESULT f_open(FIL* fp, const char* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_sync(FIL* fp);
+FRESULT f_unlink(const char* path);
+FRESULT f_rename(const char* path_old, const char* path_new);
+FRESULT f_opendir(DIR* dp, const char* path);
+FRESULT f_closedir(DIR* dp);
+FRESULT f_readdir(DIR* dp, FILINFO* fno);
+
+#define f_size(fp) ((fp)->obj_size)
+#define f_tell(fp) ((fp)->fptr)
@@ -0,0 +1,473 @@
+#include "sim.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+FontDef Font_6x8 = {6, 8, nullptr};
+FontDef Font_7x10 = {7, 10, nullptr};
+FontDef Font_11x18 = {11, 18, nullptr};
+FontDef Font_16x26 = {16, 26, nullptr};
+
+namespace mutables_host {
+
+namespace {
+
+const char* Env(const char* name) {
+    const char* value = getenv(name);
+    return value && value[0] ? value : nullptr;
+}
+
+} // namespace
+
+Sim& Sim::Get() {
+    static Sim sim;
+    return sim;
+}
+
+Sim::Sim()
+    : patch_(nullptr)
+    , now_us_(0)
+    , duration_us_(5000000)
+    , realtime_(false)
+    , real_start_ns_(RealNs())
+    , audio_running_(false)
+    , block_period_us_(500)
+    , next_block_us_(0)
+    , record_(false)
+    , next_event_(0)
+    , blocks_(0)
+    , first_block_real_ns_(-1)
+    , first_block_us_(0)
+    , first_sound_us_(0)
+    , led_us_(0)
+    , callback_ns_total_(0)
+    , callback_ns_max_(0)
+    , sd_latency_us_(0)
+    , sd_calls_(0)
+    , tick_has_sd_(false)
+    , tick_start_us_(0)
+    , tick_start_real_ns_(-1)
+    , tick_start_advance_ns_(0)
+    , advance_real_ns_(0)
+    , tick_ns_max_(0)
+    , tick_sd_ns_max_(0)
+    , callback_sd_ns_max_(0) {
+    if (const char* duration = Env("MUTABLES_SIM_DURATION_MS")) {
+        duration_us_ = strtoull(duration, nullptr, 10) * 1000;
+    }
+    if (const char* realtime = Env("MUTABLES_SIM_REALTIME")) {
+        realtime_ = atoi(realtime) != 0;
+    }
+    if (const char* script = Env("MUTABLES_SIM_SCRIPT")) {
+        LoadScript(script);
+    }
+    if (const char* wav = Env("MUTABLES_SIM_WAV")) {
+        wav_path_ = wav;
+        record_ = true;
+    }
+    if (const char* qspi = Env("MUTABLES_SIM_QSPI")) {
+        qspi_path_ = qspi;
+    }
+    if (const char* midi_out = Env("MUTABLES_SIM_MIDI_OUT")) {
+        midi_out_path_ = midi_out;
+    }
+    if (const char* latency = Env("MUTABLES_SIM_SD_LATENCY_US")) {
+        sd_latency_us_ = strtoull(latency, nullptr, 10);
+    }
+}
+
+int64_t Sim::RealNs() {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+void Sim::Attach(daisy::DaisyPatch* patch) {
+    patch_ = patch;
+    if (!qspi_path_.empty()) {
+        std::ifstream file(qspi_path_, std::ios::binary);
+        std::vector<uint8_t>& memory = patch->seed.qspi.GetMemory();
+        file.read(reinterpret_cast<char*>(memory.data()), memory.size());
+    }
+}
+
+void Sim::StartAudio() {
+    block_period_us_ = static_cast<uint64_t>(
+        std::llround(1e6 * patch_->AudioBlockSize() / patch_->AudioSampleRate()));
+    for (int c = 0; c < 4; c++) {
+        in_[c].assign(patch_->AudioBlockSize(), 0.0f);
+        out_[c].assign(patch_->AudioBlockSize(), 0.0f);
+    }
+    // First DMA half-transfer one block period after the start
+    next_block_us_ = now_us_ + block_period_us_;
+    audio_running_ = true;
+}
+
+void Sim::StopAudio() {
+    audio_running_ = false;
+}
+
+void Sim::OnLed(bool state) {
+    if (state && led_us_ == 0) led_us_ = now_us_ > 0 ? now_us_ : 1;
+}
+
+void Sim::OnSdCall() {
+    sd_calls_++;
+    tick_has_sd_ = true;
+    if (sd_latency_us_ > 0) Advance(sd_latency_us_);
+}
+
+void Sim::MainLoopDelay(uint64_t us) {
+    // The first tick starts at the first delay, after the boot code
+    if (tick_start_real_ns_ >= 0) {
+        int64_t tick_ns = static_cast<int64_t>(now_us_ - tick_start_us_) * 1000
+                        + (RealNs() - tick_start_real_ns_) - (advance_real_ns_ - tick_start_advance_ns_);
+        tick_ns_max_ = std::max(tick_ns_max_, tick_ns);
+        if (tick_has_sd_) tick_sd_ns_max_ = std::max(tick_sd_ns_max_, tick_ns);
+    }
+    tick_has_sd_ = false;
+    Advance(us);
+    tick_start_us_ = now_us_;
+    tick_start_real_ns_ = RealNs();
+    tick_start_advance_ns_ = advance_real_ns_;
+}
+
+void Sim::Advance(uint64_t us) {
+    int64_t advance_start = RealNs();
+    uint64_t target = now_us_ + us;
+    while (true) {
+        uint64_t next = target;
+        if (audio_running_ && next_block_us_ < next) next = next_block_us_;
+        if (next_event_ < events_.size() && events_[next_event_].time_us < next) {
+            next = events_[next_event_].time_us;
+        }
+        if (next > duration_us_) next = duration_us_;
+
+        if (realtime_ && next > now_us_) {
+            int64_t wait_ns = static_cast<int64_t>(next) * 1000 - (RealNs() - real_start_ns_);
+            if (wait_ns > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ns));
+        }
+        now_us_ = next;
+
+        while (next_event_ < events_.size() && events_[next_event_].time_us <= now_us_) {
+            Apply(events_[next_event_++]);
+        }
+        if (audio_running_ && next_block_us_ <= now_us_) {
+            RunBlock();
+            next_block_us_ += block_period_us_;
+        }
+        if (now_us_ >= duration_us_) Finish();
+        if (now_us_ >= target && !(audio_running_ && next_block_us_ <= now_us_)) break;
+    }
+    advance_real_ns_ += RealNs() - advance_start;
+}
+
+void Sim::RunBlock() {
+    daisy::AudioHandle::AudioCallback callback = patch_->SimGetCallback();
+    if (!callback) return;
+
+    size_t size = patch_->AudioBlockSize();
+    const float* in[4] = {in_[0].data(), in_[1].data(), in_[2].data(), in_[3].data()};
+    float* out[4] = {out_[0].data(), out_[1].data(), out_[2].data(), out_[3].data()};
+
+    int64_t start = RealNs();
+    callback(in, out, size);
+    int64_t elapsed = RealNs() - start;
+
+    if (blocks_ == 0) {
+        first_block_real_ns_ = start;
+        first_block_us_ = now_us_;
+    }
+    blocks_++;
+    callback_ns_total_ += elapsed;
+    callback_ns_max_ = std::max(callback_ns_max_, elapsed);
+    if (tick_has_sd_) callback_sd_ns_max_ = std::max(callback_sd_ns_max_, elapsed);
+
+    for (size_t i = 0; i < size; i++) {
+        if (first_sound_us_ == 0 && (std::fabs(out[0][i]) > 1e-4f || std::fabs(out[1][i]) > 1e-4f)) {
+            first_sound_us_ = now_us_;
+        }
+        if (record_) {
+            for (int c = 0; c < 4; c++) recording_.push_back(out[c][i]);
+        }
+    }
+}
+
+void Sim::LoadScript(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "sim: cannot open script %s\n", path);
+        exit(1);
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        double time_ms;
+        Event event;
+        if (!(tokens >> time_ms >> event.command)) continue;
+        event.time_us = static_cast<uint64_t>(time_ms * 1000.0);
+        std::string arg;
+        while (tokens >> arg) event.args.push_back(arg);
+        events_.push_back(event);
+    }
+    std::stable_sort(events_.begin(), events_.end(),
+                     [](const Event& a, const Event& b) { return a.time_us < b.time_us; });
+}
+
+void Sim::Apply(const Event& event) {
+    auto arg = [&](size_t i) { return i < event.args.size() ? event.args[i] : std::string("0"); };
+    auto num = [&](size_t i) { return atof(arg(i).c_str()); };
+
+    daisy::MidiEvent midi = {};
+    midi.channel = 0;
+    const std::string& command = event.command;
+
+    if (command == "knob") {
+        int k = static_cast<int>(num(0)) - 1;
+        if (k >= 0 && k < daisy::DaisyPatch::CTRL_LAST) patch_->SimSetKnob(k, static_cast<float>(num(1)));
+    } else if (command == "gate") {
+        int g = static_cast<int>(num(0)) - 1;
+        if (g >= 0 && g < daisy::DaisyPatch::GATE_IN_LAST) patch_->gate_input[g].SimSet(num(1) != 0.0);
+    } else if (command == "turn") {
+        patch_->encoder.SimTurn(static_cast<int>(num(0)));
+    } else if (command == "press") {
+        patch_->encoder.SimPress(true);
+    } else if (command == "release") {
+        patch_->encoder.SimPress(false);
+    } else if (command == "note_on" || command == "note_off" || command == "cc") {
+        midi.type = command == "note_on" ? daisy::NoteOn
+                  : command == "note_off" ? daisy::NoteOff : daisy::ControlChange;
+        midi.data[0] = static_cast<uint8_t>(num(0));
+        midi.data[1] = static_cast<uint8_t>(num(1));
+        patch_->midi.Inject(midi);
+    } else if (command == "pc") {
+        midi.type = daisy::ProgramChange;
+        midi.data[0] = static_cast<uint8_t>(num(0));
+        patch_->midi.Inject(midi);
+    } else if (command == "sysex") {
+        midi.type = daisy::SystemCommon;
+        midi.sc_type = daisy::SystemExclusive;
+        size_t n = std::min(event.args.size(), daisy::SYSEX_BUFFER_LEN);
+        for (size_t i = 0; i < n; i++) {
+            midi.sysex_data[i] = static_cast<uint8_t>(strtoul(event.args[i].c_str(), nullptr, 16));
+        }
+        midi.sysex_message_len = static_cast<uint8_t>(n);
+        patch_->midi.Inject(midi);
+    } else if (command == "screenshot") {
+        WriteScreenshot(arg(0).c_str());
+    } else if (command == "end") {
+        Finish();
+    } else {
+        fprintf(stderr, "sim: unknown command '%s'\n", command.c_str());
+    }
+}
+
+void Sim::Finish() {
+    if (record_) WriteWav(wav_path_.c_str());
+    if (!qspi_path_.empty() && patch_) {
+        std::ofstream file(qspi_path_, std::ios::binary);
+        const std::vector<uint8_t>& memory = patch_->seed.qspi.GetMemory();
+        file.write(reinterpret_cast<const char*>(memory.data()), memory.size());
+    }
+    if (!midi_out_path_.empty() && patch_) {
+        std::ofstream file(midi_out_path_, std::ios::binary);
+        const std::vector<uint8_t>& sent = patch_->midi.GetSent();
+        file.write(reinterpret_cast<const char*>(sent.data()), sent.size());
+    }
+
+    double block_us = static_cast<double>(block_period_us_);
+    double avg_us = blocks_ ? callback_ns_total_ / 1000.0 / blocks_ : 0.0;
+    double max_us = callback_ns_max_ / 1000.0;
+    printf("sim: %.1f ms virtual, %llu audio blocks of %.0f us\n",
+           now_us_ / 1000.0, static_cast<unsigned long long>(blocks_), block_us);
+    printf("sim: first audio block at %.1f ms, first sound at %.1f ms, LED marker at %.1f ms (virtual)\n",
+           first_block_us_ / 1000.0, first_sound_us_ / 1000.0, led_us_ / 1000.0);
+    printf("sim: host time from start to first audio block %.2f ms\n",
+           first_block_real_ns_ < 0 ? 0.0 : first_block_real_ns_ / 1e6);
+    printf("sim: callback avg %.1f us (%.1f%%), max %.1f us (%.1f%%)\n",
+           avg_us, 100.0 * avg_us / block_us, max_us, 100.0 * max_us / block_us);
+    if (patch_) {
+        printf("sim: %u display frames, %zu MIDI bytes sent, %u QSPI erases\n",
+               patch_->display.GetUpdateCount(), patch_->midi.GetSent().size(),
+               patch_->seed.qspi.GetEraseCount());
+    }
+    printf("sim: main-loop tick max %.2f ms", tick_ns_max_ / 1e6);
+    if (sd_calls_ > 0) {
+        printf("; %u SD calls of %llu us, tick max %.2f ms and callback max %.1f us while on the card",
+               sd_calls_, static_cast<unsigned long long>(sd_latency_us_), tick_sd_ns_max_ / 1e6,
+               callback_sd_ns_max_ / 1000.0);
+    }
+    printf("\n");
+    fflush(stdout);
+    exit(0);
+}
+
+void Sim::WriteWav(const char* path) const {
+    FILE* file = fopen(path, "wb");
+    if (!file) return;
+    uint32_t sample_rate = patch_ ? static_cast<uint32_t>(patch_->AudioSampleRate()) : 48000;
+    uint16_t channels = 4;
+    uint32_t data_bytes = static_cast<uint32_t>(recording_.size() * sizeof(float));
+    auto u32 = [&](uint32_t v) { fwrite(&v, 4, 1, file); };
+    auto u16 = [&](uint16_t v) { fwrite(&v, 2, 1, file); };
+    fwrite("RIFF", 1, 4, file);
+    u32(36 + data_bytes);
+    fwrite("WAVEfmt ", 1, 8, file);
+    u32(16);
+    u16(3);  // IEEE float
+    u16(channels);
+    u32(sample_rate);
+    u32(sample_rate * channels * sizeof(float));
+    u16(channels * sizeof(float));
+    u16(32);
+    fwrite("data", 1, 4, file);
+    u32(data_bytes);
+    fwrite(recording_.data(), sizeof(float), recording_.size(), file);
+    fclose(file);
+}
+
+void Sim::WriteScreenshot(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file || !patch_) return;
+    fprintf(file, "P1\n%d %d\n", daisy::OledDisplay::kWidth, daisy::OledDisplay::kHeight);
+    for (int y = 0; y < daisy::OledDisplay::kHeight; y++) {
+        for (int x = 0; x < daisy::OledDisplay::kWidth; x++) {
+            fputc(patch_->display.GetPixel(x, y) ? '1' : '0', file);
+        }
+        fputc('\n', file);
+    }
+    fclose(file);
+}
+
+} // namespace mutables_host
+
+using mutables_host::Sim;
+
+// libDaisy stand-ins
+
+namespace daisy {
+
+namespace {
+uint64_t last_us = 0;
+}
+
+uint32_t System::GetNow() {
+    return static_cast<uint32_t>(Sim::Get().GetNowUs() / 1000);
+}
+
+// Virtual time plus the real time spent since the clock last moved, so
+// code timing itself with GetUs()/GetTick() measures host CPU time
+uint32_t System::GetUs() {
+    static int64_t anchor_ns = 0;
+    static uint64_t anchor_virtual = ~0ull;
+    uint64_t now = Sim::Get().GetNowUs();
+    if (now != anchor_virtual) {
+        anchor_virtual = now;
+        anchor_ns = Sim::RealNs();
+    }
+    uint64_t us = now + static_cast<uint64_t>((Sim::RealNs() - anchor_ns) / 1000);
+    if (us < last_us) us = last_us;
+    last_us = us;
+    return static_cast<uint32_t>(us);
+}
+
+uint32_t System::GetTick() {
+    return GetUs() * (GetTickFreq() / 1000000);
+}
+
+void System::Delay(uint32_t ms) {
+    Sim::Get().MainLoopDelay(static_cast<uint64_t>(ms) * 1000);
+}
+
+void System::DelayUs(uint32_t us) {
+    Sim::Get().Advance(us);
+}
+
+void CpuLoadMeter::Init(float sample_rate, int block_size, float smoothing_cutoff_hz) {
+    block_us_ = 1e6f * block_size / sample_rate;
+    coeff_ = 1.0f - std::exp(-2.0f * 3.14159265f * smoothing_cutoff_hz * block_size / sample_rate);
+    Reset();
+}
+
+void CpuLoadMeter::OnBlockStart() {
+    start_ns_ = Sim::RealNs();
+}
+
+void CpuLoadMeter::OnBlockEnd() {
+    float load = (Sim::RealNs() - start_ns_) / 1000.0f / block_us_;
+    avg_ += coeff_ * (load - avg_);
+    min_ = std::min(min_, load);
+    max_ = std::max(max_, load);
+}
+
+void CpuLoadMeter::Reset() {
+    avg_ = 0.0f;
+    min_ = 1.0f;
+    max_ = 0.0f;
+}
+
+void DaisySeed::SetLed(bool state) {
+    led_ = state;
+    Sim::Get().OnLed(state);
+}
+
+void DaisySeed::PrintLine(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+void DaisySeed::Print(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+DaisyPatch::DaisyPatch()
+    : sample_rate_(48000.0f)
+    , block_size_(48)
+    , callback_(nullptr) {
+    for (float& knob : knobs_) knob = 0.0f;
+}
+
+void DaisyPatch::Init(bool boost) {
+    (void)boost;
+    Sim::Get().Attach(this);
+}
+
+void DaisyPatch::SetAudioSampleRate(SaiHandle::Config::SampleRate rate) {
+    switch (rate) {
+        case SaiHandle::Config::SampleRate::SAI_8KHZ: sample_rate_ = 8000.0f; break;
+        case SaiHandle::Config::SampleRate::SAI_16KHZ: sample_rate_ = 16000.0f; break;
+        case SaiHandle::Config::SampleRate::SAI_32KHZ: sample_rate_ = 32000.0f; break;
+        case SaiHandle::Config::SampleRate::SAI_48KHZ: sample_rate_ = 48000.0f; break;
+        case SaiHandle::Config::SampleRate::SAI_96KHZ: sample_rate_ = 96000.0f; break;
+    }
+}
+
+void DaisyPatch::StartAudio(AudioHandle::AudioCallback cb) {
+    callback_ = cb;
+    Sim::Get().StartAudio();
+}
+
+void DaisyPatch::StopAudio() {
+    Sim::Get().StopAudio();
+}
+
+void DaisyPatch::ProcessDigitalControls() {
+    encoder.Debounce();
+    for (GateIn& gate : gate_input) gate.Latch();
+}
+
+} // namespace daisy
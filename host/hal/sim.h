@@ -0,0 +1,115 @@
+#pragma once
+
+#include "daisy_patch.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mutables_host {
+
+// Drives the host HAL: virtual clock, audio blocks, scripted inputs and
+// the end-of-run report. Configured from the environment because the
+// firmware's main() takes no arguments:
+//
+//   MUTABLES_SIM_SCRIPT       input script (see below), optional
+//   MUTABLES_SIM_DURATION_MS  run length in virtual ms (default 5000)
+//   MUTABLES_SIM_WAV          write the 4 outputs as a float WAV
+//   MUTABLES_SIM_SD           directory served as the SD card (none: no card)
+//   MUTABLES_SIM_SD_LATENCY_US  virtual time each SD card call blocks for
+//   MUTABLES_SIM_QSPI         QSPI image, loaded at Init and saved at the end
+//   MUTABLES_SIM_MIDI_OUT     write the bytes sent on MIDI out at the end
+//   MUTABLES_SIM_REALTIME     1: pace the virtual clock to wall time
+//
+// Script lines are "<time_ms> <command> <args>", '#' starts a comment:
+//   knob <1-4> <0..1>      gate <1-2> <0|1>
+//   turn <steps>           press / release
+//   note_on <note> <vel>   note_off <note>
+//   cc <number> <value>    pc <program>
+//   sysex <hex bytes>      (without F0/F7)
+//   screenshot <file.pbm>  end
+class Sim {
+public:
+    static Sim& Get();
+
+    void Attach(daisy::DaisyPatch* patch);
+    void StartAudio();
+    void StopAudio();
+
+    // Move the virtual clock, running every audio block and script event
+    // that falls due on the way
+    void Advance(uint64_t us);
+
+    uint64_t GetNowUs() const { return now_us_; }
+
+    // Real nanoseconds since process start (host clock)
+    static int64_t RealNs();
+
+    void OnLed(bool state);
+
+    // Main loop: an SD card call, which blocks it for the card latency
+    // while audio blocks keep running
+    void OnSdCall();
+    // Main loop: System::Delay() at the end of each pass, which closes one
+    // tick for the report and starts the next after the delay
+    void MainLoopDelay(uint64_t us);
+
+private:
+    struct Event {
+        uint64_t time_us;
+        std::string command;
+        std::vector<std::string> args;
+    };
+
+    Sim();
+    void LoadScript(const char* path);
+    void Apply(const Event& event);
+    void RunBlock();
+    void Finish();
+    void WriteWav(const char* path) const;
+    void WriteScreenshot(const char* path) const;
+
+    daisy::DaisyPatch* patch_;
+    uint64_t now_us_;
+    uint64_t duration_us_;
+    bool realtime_;
+    int64_t real_start_ns_;
+
+    bool audio_running_;
+    uint64_t block_period_us_;
+    uint64_t next_block_us_;
+    std::vector<float> in_[4];
+    std::vector<float> out_[4];
+    std::vector<float> recording_;   // Interleaved 4 channels
+    bool record_;
+
+    std::vector<Event> events_;
+    size_t next_event_;
+
+    std::string wav_path_;
+    std::string qspi_path_;
+    std::string midi_out_path_;
+
+    // Report
+    uint64_t blocks_;
+    int64_t first_block_real_ns_;
+    uint64_t first_block_us_;
+    uint64_t first_sound_us_;
+    uint64_t led_us_;
+    int64_t callback_ns_total_;
+    int64_t callback_ns_max_;
+
+    // Main-loop ticks: virtual time (SD latency) plus host CPU time outside
+    // Advance(), and what happened while SD calls were in progress
+    uint64_t sd_latency_us_;
+    uint32_t sd_calls_;
+    bool tick_has_sd_;
+    uint64_t tick_start_us_;
+    int64_t tick_start_real_ns_;
+    int64_t tick_start_advance_ns_;
+    int64_t advance_real_ns_;          // Host time spent inside Advance()
+    int64_t tick_ns_max_;
+    int64_t tick_sd_ns_max_;
+    int64_t callback_sd_ns_max_;
+};
+
+} // namespace mutables_host
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace mutables_host {
+
+// Standard MIDI File reader for the offline renderers: the channel events
+// a synth needs, per track, with times in seconds from the tempo map.
+//
+// - Formats 0, 1 and 2. A format 0 file is split into one track per MIDI
+//   channel, so every part gets its own stem.
+// - Tempo changes in any track apply to all (format 1 conductor track).
+//   SMPTE time division is supported.
+// - Kept: notes (note on with velocity 0 is a note off), pitch bend and
+//   all-notes-off / all-sound-off. Other events are skipped.
+class MidiFile {
+public:
+    enum class EventType : uint8_t { NoteOn, NoteOff, PitchBend, AllNotesOff };
+
+    struct Event {
+        double seconds;
+        EventType type;
+        uint8_t channel;
+        uint8_t key;        // Note events
+        uint8_t velocity;   // Note events
+        float bend;         // PitchBend: -1 to 1
+    };
+
+    struct Track {
+        std::string name;
+        std::vector<Event> events;  // In time order
+        size_t note_count = 0;
+    };
+
+    bool Load(const char* path) {
+        tracks_.clear();
+        error_.clear();
+        FILE* file = fopen(path, "rb");
+        if (!file) return Fail("cannot open file");
+        std::vector<uint8_t> data;
+        uint8_t chunk[4096];
+        for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;) data.insert(data.end(), chunk, chunk + n);
+        fclose(file);
+        return Parse(data);
+    }
+
+    const std::vector<Track>& GetTracks() const { return tracks_; }
+    const std::string& GetError() const { return error_; }
+
+    // Time of the last event of any track
+    double GetLength() const {
+        double length = 0.0;
+        for (const Track& track : tracks_) {
+            if (!track.events.empty()) length = std::max(length, track.events.back().seconds);
+        }
+        return length;
+    }
+
+private:
+    struct RawEvent {
+        uint64_t tick;
+        uint8_t status;
+        uint8_t data1;
+        uint8_t data2;
+    };
+
+    struct RawTrack {
+        std::string name;
+        std::vector<RawEvent> events;
+    };
+
+    struct Tempo {
+        uint64_t tick;
+        uint32_t us_per_quarter;
+    };
+
+    std::vector<Track> tracks_;
+    std::string error_;
+
+    bool Fail(const char* message) {
+        error_ = message;
+        tracks_.clear();
+        return false;
+    }
+
+    static uint32_t Be(const uint8_t* p, int bytes) {
+        uint32_t value = 0;
+        for (int i = 0; i < bytes; i++) value = (value << 8) | p[i];
+        return value;
+    }
+
+    // Variable-length quantity; false past `end`
+    static bool ReadVarLen(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            if (p >= end) return false;
+            uint8_t byte = *p++;
+            value = (value << 7) | (byte & 0x7F);
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool Parse(const std::vector<uint8_t>& data) {
+        const uint8_t* p = data.data();
+        const uint8_t* end = p + data.size();
+        if (data.size() < 14 || std::string(reinterpret_cast<const char*>(p), 4) != "MThd") {
+            return Fail("not a Standard MIDI File");
+        }
+        uint32_t header_length = Be(p + 4, 4);
+        uint16_t format = static_cast<uint16_t>(Be(p + 8, 2));
+        uint16_t track_count = static_cast<uint16_t>(Be(p + 10, 2));
+        uint16_t division = static_cast<uint16_t>(Be(p + 12, 2));
+        if (header_length < 6 || format > 2 || division == 0) return Fail("unsupported header");
+        p += 8 + header_length;
+
+        std::vector<RawTrack> raw;
+        std::vector<Tempo> tempos;
+        while (raw.size() < track_count && p + 8 <= end) {
+            uint32_t length = Be(p + 4, 4);
+            bool is_track = std::string(reinterpret_cast<const char*>(p), 4) == "MTrk";
+            p += 8;
+            if (length > static_cast<size_t>(end - p)) return Fail("truncated track");
+            if (is_track) {
+                raw.emplace_back();
+                if (!ParseTrack(p, p + length, raw.back(), tempos)) return Fail("corrupt track");
+            }
+            p += length;
+        }
+        if (raw.size() < track_count) return Fail("missing tracks");
+
+        if (format == 0 && !raw.empty()) raw = SplitByChannel(raw[0]);
+        std::stable_sort(tempos.begin(), tempos.end(),
+                         [](const Tempo& a, const Tempo& b) { return a.tick < b.tick; });
+        for (const RawTrack& track : raw) {
+            tracks_.push_back(Convert(track, tempos, division));
+        }
+        return true;
+    }
+
+    static bool ParseTrack(const uint8_t* p, const uint8_t* end, RawTrack& track, std::vector<Tempo>& tempos) {
+        uint64_t tick = 0;
+        uint8_t running = 0;
+        while (p < end) {
+            uint32_t delta;
+            if (!ReadVarLen(p, end, delta) || p >= end) return false;
+            tick += delta;
+
+            uint8_t status = *p;
+            if (status == 0xFF) {
+                if (p + 2 > end) return false;
+                uint8_t type = p[1];
+                p += 2;
+                uint32_t length;
+                if (!ReadVarLen(p, end, length) || length > static_cast<size_t>(end - p)) return false;
+                if (type == 0x51 && length == 3) tempos.push_back(Tempo{tick, Be(p, 3)});
+                if (type == 0x03 && track.name.empty()) track.name.assign(reinterpret_cast<const char*>(p), length);
+                if (type == 0x2F) return true;
+                p += length;
+                running = 0;
+                continue;
+            }
+            if (status == 0xF0 || status == 0xF7) {
+                p++;
+                uint32_t length;
+                if (!ReadVarLen(p, end, length) || length > static_cast<size_t>(end - p)) return false;
+                p += length;
+                running = 0;
+                continue;
+            }
+
+            if (status & 0x80) {
+                running = status;
+                p++;
+            } else if (!running) {
+                return false;  // Data byte without a status
+            }
+            uint8_t kind = running & 0xF0;
+            int size = (kind == 0xC0 || kind == 0xD0) ? 1 : 2;
+            if (p + size > end) return false;
+            RawEvent event{tick, running, p[0], static_cast<uint8_t>(size == 2 ? p[1] : 0)};
+            p += size;
+            if (kind == 0x80 || kind == 0x90 || kind == 0xE0 || kind == 0xB0) track.events.push_back(event);
+        }
+        return true;
+    }
+
+    static std::vector<RawTrack> SplitByChannel(const RawTrack& track) {
+        std::vector<RawTrack> channels(16);
+        for (const RawEvent& event : track.events) channels[event.status & 0x0F].events.push_back(event);
+        std::vector<RawTrack> used;
+        for (int c = 0; c < 16; c++) {
+            if (channels[c].events.empty()) continue;
+            channels[c].name = (track.name.empty() ? std::string("ch") : track.name + " ch") + std::to_string(c + 1);
+            used.push_back(channels[c]);
+        }
+        return used;
+    }
+
+    // Ticks to seconds through the tempo map (120 BPM until the first tempo)
+    static Track Convert(const RawTrack& raw, const std::vector<Tempo>& tempos, uint16_t division) {
+        double seconds_per_tick = 0.0;
+        bool smpte = division & 0x8000;
+        if (smpte) {
+            int fps = 256 - (division >> 8);  // Two's complement -24, -25, -29, -30
+            seconds_per_tick = 1.0 / ((fps == 29 ? 29.97 : fps) * (division & 0xFF));
+        }
+
+        Track track;
+        track.name = raw.name;
+        size_t tempo = 0;
+        uint64_t tempo_tick = 0;
+        double tempo_seconds = 0.0;
+        uint32_t us_per_quarter = 500000;
+        for (const RawEvent& event : raw.events) {
+            double seconds;
+            if (smpte) {
+                seconds = event.tick * seconds_per_tick;
+            } else {
+                while (tempo < tempos.size() && tempos[tempo].tick <= event.tick) {
+                    tempo_seconds += (tempos[tempo].tick - tempo_tick) * us_per_quarter * 1e-6 / division;
+                    tempo_tick = tempos[tempo].tick;
+                    us_per_quarter = tempos[tempo].us_per_quarter;
+                    tempo++;
+                }
+                seconds = tempo_seconds + (event.tick - tempo_tick) * us_per_quarter * 1e-6 / division;
+            }
+
+            Event out{seconds, EventType::NoteOn, static_cast<uint8_t>(event.status & 0x0F),
+                      event.data1, event.data2, 0.0f};
+            switch (event.status & 0xF0) {
+                case 0x90:
+                    out.type = event.data2 > 0 ? EventType::NoteOn : EventType::NoteOff;
+                    break;
+                case 0x80:
+                    out.type = EventType::NoteOff;
+                    break;
+                case 0xE0:
+                    out.type = EventType::PitchBend;
+                    out.bend = ((event.data2 << 7 | event.data1) - 8192) / 8192.0f;
+                    break;
+                case 0xB0:
+                    if (event.data1 != 120 && event.data1 != 123) continue;
+                    out.type = EventType::AllNotesOff;
+                    break;
+                default:
+                    continue;
+            }
+            track.note_count += out.type == EventType::NoteOn;
+            track.events.push_back(out);
+        }
+        return track;
+    }
+};
+
+} // namespace mutables_host
@@ -0,0 +1,297 @@
+// Offline stem renderer: every track of a Standard MIDI File through its
+// own PlaitsSynth (PlaitsPort voices, plaits_synth.h), one stereo 32-bit
+// float WAV per track, rendered on all cores.
+//
+// - Tracks are jobs on a WorkerPool, longest first. Each job seeds
+//   stmlib::Random from its track number, so stems are bit-identical
+//   whatever the worker count (the checksum printed at the end shows it).
+// - A preset (a .bin from the SD card, <module>/presets/) sets the
+//   parameters of every track; notes play the voices as in the plugin.
+//   Pitch bend is +-2 semitones.
+// - Stems start at MIDI time 0: the re-blocker latency is dropped.
+// - Realtime factor: song length / wall time. --scaling renders the song
+//   with 1, 2, 4 ... workers and reports the speedup of each.
+//
+// Build and run: make -C host midi_render && host/midi_render song.mid --out stems
+
+#include "engine_grid.h"
+#include "plaits_synth.h"
+#include "midi_file.h"
+#include "wav_file.h"
+#include "worker_pool.h"
+#include "../common/preset_format.h"
+#include "stmlib/utils/random.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace mutables_ui;
+using mutables_host::LoadPlaitsPreset;
+using mutables_host::MidiFile;
+using mutables_host::WavWriter;
+using mutables_host::WorkerPool;
+using mutables_plaits::PlaitsSynth;
+
+namespace {
+
+const uint32_t kSampleRate = 48000;
+const size_t kChunk = 1024;              // Frames per Render() call
+const uint32_t kRandomSeed = 0x21;
+const float kBendRange = 2.0f;           // Semitones
+
+struct Options {
+    const char* midi_path = nullptr;
+    const char* preset_path = nullptr;
+    std::string out_dir = ".";
+    int workers = 0;
+    int voices = 1;
+    double tail = 2.0;                   // Seconds after the last event
+    bool scaling = false;
+};
+
+// Per track, written by the worker that rendered it
+struct StemResult {
+    bool done;
+    uint64_t frames;
+    uint32_t crc;                        // Of the samples
+    uint32_t dropped;                    // Events PlaitsSynth could not queue
+    double seconds;                      // CPU time of the render
+};
+
+struct SampleEvent {
+    uint64_t frame;
+    const MidiFile::Event* event;
+};
+
+std::string StemPath(const Options& options, size_t track, const std::string& name) {
+    std::string clean;
+    for (char c : name) clean += isalnum(static_cast<unsigned char>(c)) || c == '-' ? c : '_';
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%02zu", track + 1);
+    return options.out_dir + "/" + prefix + (clean.empty() ? "" : "_" + clean) + ".wav";
+}
+
+bool RenderTrack(const Options& options, const MidiFile::Track& track, const PresetRecord* preset,
+                 const std::string& path, uint32_t seed, StemResult& result) {
+    std::clock_t start = std::clock();  // Workers are single-threaded processes
+    stmlib::Random::Seed(seed);
+
+    PlaitsSynth synth;
+    if (!synth.Init(static_cast<float>(kSampleRate), options.voices)) return false;
+    if (preset) {
+        for (size_t i = 0; i < std::min<size_t>(preset->param_count, synth.GetParameterCount()); i++) {
+            synth.SetParameter(0, i, preset->values[i]);
+        }
+    }
+
+    std::vector<SampleEvent> events;
+    for (const MidiFile::Event& event : track.events) {
+        events.push_back(SampleEvent{static_cast<uint64_t>(llround(event.seconds * kSampleRate)), &event});
+    }
+    uint64_t length = (events.empty() ? 0 : events.back().frame) + static_cast<uint64_t>(options.tail * kSampleRate);
+
+    WavWriter wav;
+    if (!wav.Open(path.c_str(), kSampleRate, 2)) return false;
+
+    float left[kChunk];
+    float right[kChunk];
+    const float* channels[2] = {left, right};
+    float bend[16] = {};
+    uint64_t frame = 0;                    // Rendered, including latency
+    uint64_t latency = synth.GetLatency();
+    size_t next = 0;
+    uint32_t crc = 0;
+    while (frame < length + latency) {
+        uint64_t end = std::min<uint64_t>(frame + kChunk, length + latency);
+        // Stay within the synth's event queue
+        if (next + PlaitsSynth::kMaxPending / 2 < events.size()) {
+            end = std::min(end, std::max(frame + 1, events[next + PlaitsSynth::kMaxPending / 2].frame));
+        }
+        for (; next < events.size() && events[next].frame < end; next++) {
+            const MidiFile::Event& event = *events[next].event;
+            uint32_t time = static_cast<uint32_t>(events[next].frame > frame ? events[next].frame - frame : 0);
+            int16_t channel = event.channel;
+            switch (event.type) {
+                case MidiFile::EventType::NoteOn:
+                    synth.NoteOn(time, PlaitsSynth::kAnyNote, channel, event.key, event.velocity / 127.0f);
+                    if (bend[channel] != 0.0f) {
+                        synth.SetExpression(time, PlaitsSynth::kAnyNote, channel, event.key,
+                                            PlaitsSynth::Expression::Tuning, bend[channel]);
+                    }
+                    break;
+                case MidiFile::EventType::NoteOff:
+                    synth.NoteOff(time, PlaitsSynth::kAnyNote, channel, event.key);
+                    break;
+                case MidiFile::EventType::PitchBend:
+                    bend[channel] = event.bend * kBendRange;
+                    synth.SetExpression(time, PlaitsSynth::kAnyNote, channel, PlaitsSynth::kAnyNote,
+                                        PlaitsSynth::Expression::Tuning, bend[channel]);
+                    break;
+                case MidiFile::EventType::AllNotesOff:
+                    synth.NoteOff(time, PlaitsSynth::kAnyNote, channel, PlaitsSynth::kAnyNote);
+                    break;
+            }
+        }
+
+        size_t count = static_cast<size_t>(end - frame);
+        synth.Render(left, right, nullptr, nullptr, count);
+        // The first `latency` frames precede MIDI time 0
+        size_t skip = frame < latency ? static_cast<size_t>(std::min<uint64_t>(latency - frame, count)) : 0;
+        const float* written[2] = {channels[0] + skip, channels[1] + skip};
+        if (!wav.Write(written, count - skip)) return false;
+        crc = Crc32(left + skip, (count - skip) * sizeof(float), crc);
+        crc = Crc32(right + skip, (count - skip) * sizeof(float), crc);
+        frame = end;
+    }
+    if (!wav.Close()) return false;
+
+    result.frames = wav.GetFrameCount();
+    result.crc = crc;
+    result.dropped = synth.GetDroppedEventCount();
+    result.seconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+    result.done = true;
+    return true;
+}
+
+// All tracks with notes on `workers` workers; wall time in seconds, or a
+// negative value on failure
+double RenderSong(const Options& options, const MidiFile& midi, const std::vector<size_t>& order,
+                  const PresetRecord* preset, int workers, std::vector<StemResult>& results) {
+    WorkerPool pool(workers);
+    StemResult* shared = pool.Share<StemResult>(order.size());
+    if (!shared) return -1.0;
+    const std::vector<MidiFile::Track>& tracks = midi.GetTracks();
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = pool.Run(order.size(), [&](size_t job, int) {
+        size_t track = order[job];
+        std::string path = StemPath(options, track, tracks[track].name);
+        if (RenderTrack(options, tracks[track], preset, path, kRandomSeed + static_cast<uint32_t>(track), shared[job])) {
+            return true;
+        }
+        fprintf(stderr, "%s: could not write\n", path.c_str());
+        return false;
+    });
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    results.assign(shared, shared + order.size());
+    return ok ? wall : -1.0;
+}
+
+uint32_t SongCrc(const std::vector<StemResult>& results) {
+    uint32_t crc = 0;
+    for (const StemResult& result : results) crc = Crc32(&result.crc, sizeof(result.crc), crc);
+    return crc;
+}
+
+void Usage() {
+    fprintf(stderr,
+            "usage: midi_render FILE.mid [--preset FILE.bin] [--out DIR] [--workers N]\n"
+            "                   [--voices N] [--tail SECONDS] [--scaling]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--preset" && has_value) options.preset_path = argv[++i];
+        else if (arg == "--out" && has_value) options.out_dir = argv[++i];
+        else if (arg == "--workers" && has_value) options.workers = atoi(argv[++i]);
+        else if (arg == "--voices" && has_value) options.voices = atoi(argv[++i]);
+        else if (arg == "--tail" && has_value) options.tail = atof(argv[++i]);
+        else if (arg == "--scaling") options.scaling = true;
+        else if (arg[0] != '-' && !options.midi_path) options.midi_path = argv[i];
+        else {
+            Usage();
+            return 2;
+        }
+    }
+    if (!options.midi_path || options.voices < 1 || options.voices > PlaitsSynth::kMaxVoices) {
+        Usage();
+        return 2;
+    }
+
+    MidiFile midi;
+    if (!midi.Load(options.midi_path)) {
+        fprintf(stderr, "%s: %s\n", options.midi_path, midi.GetError().c_str());
+        return 1;
+    }
+    PresetRecord preset;
+    if (options.preset_path && !LoadPlaitsPreset(options.preset_path, preset)) {
+        fprintf(stderr, "%s: not a valid Plaits preset\n", options.preset_path);
+        return 1;
+    }
+    mkdir(options.out_dir.c_str(), 0755);
+
+    // Tracks with notes, the busiest first so the last job to start is short
+    const std::vector<MidiFile::Track>& tracks = midi.GetTracks();
+    std::vector<size_t> order;
+    for (size_t t = 0; t < tracks.size(); t++) {
+        if (tracks[t].note_count > 0) order.push_back(t);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return tracks[a].events.size() > tracks[b].events.size();
+    });
+    if (order.empty()) {
+        fprintf(stderr, "%s: no notes\n", options.midi_path);
+        return 1;
+    }
+
+    const PresetRecord* preset_used = options.preset_path ? &preset : nullptr;
+    double song = midi.GetLength() + options.tail;
+    std::vector<StemResult> results;
+
+    if (options.scaling) {
+        int max_workers = WorkerPool(options.workers).GetWorkerCount();
+        printf("%-8s %10s %12s %9s %10s\n", "workers", "wall s", "x realtime", "speedup", "crc");
+        double base = 0.0;
+        uint32_t reference = 0;
+        bool identical = true;
+        for (int workers = 1;; workers = std::min(workers * 2, max_workers)) {
+            double wall = RenderSong(options, midi, order, preset_used, workers, results);
+            if (wall < 0.0) return 1;
+            if (workers == 1) {
+                base = wall;
+                reference = SongCrc(results);
+            }
+            identical = identical && SongCrc(results) == reference;
+            printf("%-8d %10.3f %12.1f %9.2f %10.8x\n", workers, wall, song / wall, base / wall, SongCrc(results));
+            if (workers == max_workers) break;
+        }
+        printf("%zu stems, %.1f s song: %s\n", order.size(), song,
+               identical ? "bit-identical at every worker count" : "OUTPUT DIFFERS BETWEEN WORKER COUNTS");
+        return identical ? 0 : 1;
+    }
+
+    WorkerPool probe(options.workers);
+    double wall = RenderSong(options, midi, order, preset_used, probe.GetWorkerCount(), results);
+    if (wall < 0.0) return 1;
+
+    printf("%-32s %10s %12s %8s\n", "stem", "length s", "x realtime", "crc");
+    double cpu = 0.0;
+    for (size_t job = 0; job < order.size(); job++) {
+        const StemResult& result = results[job];
+        size_t track = order[job];
+        std::string path = StemPath(options, track, tracks[track].name);
+        double length = static_cast<double>(result.frames) / kSampleRate;
+        printf("%-32s %10.2f %12.1f %8.8x\n", path.substr(path.rfind('/') + 1).c_str(), length,
+               length / result.seconds, result.crc);
+        if (result.dropped) printf("  %u events dropped\n", result.dropped);
+        cpu += result.seconds;
+    }
+    printf("%zu stems, %.1f s song in %.2f s on %d workers: %.1fx realtime (%.2f cores busy), crc %08x\n",
+           order.size(), song, wall, probe.GetWorkerCount(), song / wall, cpu / wall, SongCrc(results));
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Module switching as the firmware does it (ModuleSwitcher over the memory
+// regions): time per switch and the memory each module needs per region,
+// then chains built from the Module row (slots added, replaced, removed)
+// and where their memory lands once DTCM is full.
+// - Plaits: the real module
+// - Table: a stand-in with a 16 KB lookup table, for the DTCM copy
+//
+// Build and run: make -C host module_switch_bench && host/module_switch_bench
+
+#include "plaits_port.h"
+#include "../common/arena.h"
+#include "../common/module_base.h"
+#include "../common/module_chain.h"
+#include "../common/module_registry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace mutables_ui;
+using mutables_plaits::PlaitsPort;
+
+namespace {
+
+const float kSampleRate = 48000.0f;
+const size_t kBlockSize = 24;
+const int kSwitches = 200;
+
+// Same sizes as plaits/main.cpp
+const size_t kRegionSizes[MemoryRegions::kCount] = {80 * 1024, 64 * 1024, 8 * 1024 * 1024};
+
+const size_t kTableSize = 4096;
+float table[kTableSize];
+
+ModuleSwitcher modules;
+
+// Reads its table through the fast-RAM copy made on activation
+class TableModule final : public ModuleBase {
+public:
+    const char* GetName() const override { return "Table"; }
+    const char* GetShortName() const override { return "table"; }
+
+    void Init(float sample_rate) override {
+        (void)sample_rate;
+        table_ = static_cast<const float*>(modules.GetTable(0));
+        params_[0] = Parameter("Index", 0.0f, 1.0f);
+    }
+
+    void Process(float** in, float** out, size_t size) override {
+        (void)in;
+        size_t index = static_cast<size_t>(params_[0].value * (kTableSize - 1));
+        for (size_t i = 0; i < size; i++) {
+            out[0][i] = table_[index];
+        }
+    }
+
+    Parameter* GetParameters() override { return params_; }
+    size_t GetParameterCount() const override { return 1; }
+
+private:
+    const float* table_ = nullptr;
+    Parameter params_[1];
+};
+
+const LookupTable kTables[] = {{table, sizeof(table)}};
+
+const ModuleEntry kModules[] = {
+    MakeModuleEntry<PlaitsPort>("Plaits", "plaits"),
+    MakeModuleEntry<TableModule>("Table", "table", kTables, 1),
+};
+const int kModuleCount = sizeof(kModules) / sizeof(kModules[0]);
+
+
+} // namespace
+
+int main() {
+    for (size_t i = 0; i < kTableSize; i++) {
+        table[i] = static_cast<float>(i) / kTableSize;
+    }
+
+    MemoryRegions memory;
+    ModuleChain chain;
+    for (int r = 0; r < MemoryRegions::kCount; r++) {
+        memory.Init(static_cast<MemoryRegion>(r), new uint8_t[kRegionSizes[r]], kRegionSizes[r]);
+    }
+    modules.Init(kModules, kModuleCount, &memory, &chain, kSampleRate, kBlockSize);
+
+    double min_us[kModuleCount];
+    double max_us[kModuleCount];
+    double total_us[kModuleCount];
+    size_t bytes[kModuleCount][MemoryRegions::kCount];
+    std::fill(min_us, min_us + kModuleCount, 1e30);
+    std::fill(max_us, max_us + kModuleCount, 0.0);
+    std::fill(total_us, total_us + kModuleCount, 0.0);
+
+    // Alternate so every switch tears down the other module
+    for (int n = 0; n < kSwitches * kModuleCount; n++) {
+        int index = n % kModuleCount;
+        auto start = std::chrono::steady_clock::now();
+        ModuleBase* module = modules.Activate(index);
+        auto end = std::chrono::steady_clock::now();
+        if (!module) {
+            printf("%s does not fit the memory regions\n", modules.GetName(index));
+            return 1;
+        }
+        double us = std::chrono::duration<double, std::micro>(end - start).count();
+        min_us[index] = std::min(min_us[index], us);
+        max_us[index] = std::max(max_us[index], us);
+        total_us[index] += us;
+        for (int r = 0; r < MemoryRegions::kCount; r++) {
+            bytes[index][r] = memory.Get(static_cast<MemoryRegion>(r)).GetUsed();
+        }
+    }
+
+    printf("%-8s %10s %10s %10s %10s %10s %10s\n", "module", "min us", "avg us", "max us",
+           "dtcm", "sram", "sdram");
+    for (int i = 0; i < kModuleCount; i++) {
+        printf("%-8s %10.1f %10.1f %10.1f %10zu %10zu %10zu\n", modules.GetName(i), min_us[i],
+               total_us[i] / kSwitches, max_us[i], bytes[i][0], bytes[i][1], bytes[i][2]);
+    }
+    for (int r = 0; r < MemoryRegions::kCount; r++) {
+        MemoryRegion region = static_cast<MemoryRegion>(r);
+        printf("%-5s peak %8zu of %8zu bytes\n", MemoryRegions::GetName(region),
+               modules.GetPeakBytes(region), kRegionSizes[r]);
+    }
+    printf("%d switches per module, %u failed allocations\n", kSwitches, memory.GetFailedCount());
+
+    // Chains: add slots until full, then replace and remove one. Every
+    // step rebuilds all slots; slot 0 keeps its edited value throughout.
+    struct Step {
+        const char* name;
+        int slot;   // -1: remove slot 1
+        int index;
+    };
+    const Step kSteps[] = {
+        {"+ Plaits", 1, 0},
+        {"+ Table", 2, 1},
+        {"+ Plaits", 3, 0},
+        {"2 = Plaits", 2, 0},
+        {"- 1", -1, 0},
+    };
+    modules.Activate(0);
+    Parameter* active = modules.GetActive()->GetParameters();
+    active[0].value = 0.25f;
+    printf("\n%-12s %6s %8s %10s %10s %10s\n", "chain", "slots", "us", "dtcm", "sram", "sdram");
+    for (const Step& step : kSteps) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = step.slot < 0 ? modules.RemoveSlot(1) : modules.SetSlot(step.slot, step.index);
+        auto end = std::chrono::steady_clock::now();
+        if (!ok || modules.GetActive()->GetParameters()[0].value != 0.25f) {
+            printf("%s failed\n", step.name);
+            return 1;
+        }
+        printf("%-12s %6d %8.1f %10zu %10zu %10zu\n", step.name, modules.GetSlotCount(),
+               std::chrono::duration<double, std::micro>(end - start).count(),
+               memory.Get(MemoryRegion::Dtcm).GetUsed(), memory.Get(MemoryRegion::Sram).GetUsed(),
+               memory.Get(MemoryRegion::Sdram).GetUsed());
+    }
+    printf("%u failed allocations\n", memory.GetFailedCount());
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Per-block cost of the preset morph in the audio callback: PresetMorph
+// Process() and the copy into the parameters, as in plaits/main.cpp, with
+// the position moving every block. Line and XY layouts, for PlaitsPort's
+// 9 parameters and for kMaxParameters, with none or half of them held by
+// user edits.
+//
+// Build and run: make -C host morph_bench && host/morph_bench
+
+#include "../common/preset_morph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace mutables_ui;
+
+namespace {
+
+const size_t kBlockSize = 24;
+const double kBlockNs = kBlockSize / 48000.0 * 1e9;
+const int kBlocks = 1000000;
+const int kRepeats = 5;
+
+// Same mix of types as PlaitsPort: Bank and Engine discrete, the rest
+// continuous
+void MakeParams(Parameter* params, size_t count) {
+    static const char* labels[] = {"a", "b", "c"};
+    for (size_t i = 0; i < count; i++) {
+        params[i] = i < 2 ? Parameter("enum", labels, 3) : Parameter("knob");
+    }
+}
+
+void MakeCorner(PresetRecord& record, const Parameter* params, size_t count, float offset) {
+    Parameter corner[kMaxParameters];
+    for (size_t i = 0; i < count; i++) {
+        corner[i] = params[i];
+        corner[i].value = params[i].type == ParamType::Enum ? offset * 2.0f : offset + i * 0.01f;
+    }
+    PresetCapture(record, "corner", 0, corner, count);
+}
+
+// One audio callback's worth, copied from main.cpp
+void RunBlocks(PresetMorph& morph, Parameter* params, size_t count, int blocks) {
+    for (int n = 0; n < blocks; n++) {
+        morph.SetPosition((n & 1023) / 1023.0f, (n & 511) / 511.0f);
+        float morphed[kMaxParameters];
+        bool switched = morph.Process(morphed);
+        size_t morph_count = std::min(count, morph.GetCount());
+        for (size_t i = 0; i < morph_count; i++) {
+            bool follows_cv = params[i].cv_mapping.active && params[i].cv_mapping.cv_input >= 0;
+            if (!follows_cv && !morph.IsHeld(i)) {
+                params[i].value = morphed[i];
+            }
+        }
+        // The module reads the values next (and resyncs if switched)
+        asm volatile("" : : "r"(params), "r"(switched) : "memory");
+    }
+}
+
+double BestNsPerBlock(PresetMorph& morph, Parameter* params, size_t count) {
+    double best = 1e30;
+    for (int r = 0; r < kRepeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+        RunBlocks(morph, params, count, kBlocks);
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / kBlocks);
+    }
+    return best;
+}
+
+void Measure(PresetMorph::Layout layout, size_t count, bool hold_half) {
+    Parameter params[kMaxParameters];
+    MakeParams(params, count);
+    static PresetMorph morph;
+    morph.SetEnabled(false);
+    morph.Init(params, count);
+    for (int c = 0; c < PresetMorph::kNumCorners; c++) {
+        PresetRecord record;
+        MakeCorner(record, params, count, c * 0.25f);
+        morph.SetCorner(c, record);
+    }
+    morph.SetLayout(layout);
+    morph.SetEnabled(true);
+    if (hold_half) {
+        for (size_t i = 0; i < count; i += 2) morph.Hold(i);
+    }
+
+    double ns = BestNsPerBlock(morph, params, count);
+    printf("%-6s %6zu %6s %10.1f %9.3f%%\n", layout == PresetMorph::Layout::XY ? "xy" : "line", count,
+           hold_half ? "half" : "none", ns, 100.0 * ns / kBlockNs);
+}
+
+} // namespace
+
+int main() {
+    printf("%-6s %6s %6s %10s %10s\n", "layout", "params", "held", "ns/block", "of block");
+    for (PresetMorph::Layout layout : {PresetMorph::Layout::Line, PresetMorph::Layout::XY}) {
+        for (size_t count : {size_t(9), kMaxParameters}) {
+            Measure(layout, count, false);
+            Measure(layout, count, true);
+        }
+    }
+    printf("per %zu-sample block (%.0f us at 48 kHz), best of %d runs of %d blocks\n", kBlockSize, kBlockNs / 1e3,
+           kRepeats, kBlocks);
+    return 0;
+}
@@ -0,0 +1,379 @@
+// Golden-audio and performance regression check for PlaitsPort:
+// - every engine renders a fixed scenario (note sequence, parameter sweeps)
+//   through PlaitsPort::Process in firmware-sized blocks
+// - sound: output hash against the golden file; on a hash mismatch the
+//   long-term spectrum must still match within kBandToleranceDb
+// - cost: best-of-N ns/sample against a machine-local baseline, fails when
+//   an engine is slower by more than the threshold
+// Results of every run are written as JSON.
+//
+// Build and run: make -C host check-perf
+//   make -C host golden-update    accept the current sound as golden
+//   make -C host perf-baseline    accept the current cost as baseline
+
+#include "plaits_port.h"
+#include "stmlib/utils/random.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef PERF_BUILD_FLAGS
+#define PERF_BUILD_FLAGS ""
+#endif
+
+using mutables_plaits::PlaitsPort;
+
+namespace {
+
+const float kSampleRate = 48000.0f;
+const size_t kBlockSize = 24;            // Firmware audio block
+const size_t kScenarioBlocks = 4000;     // 2 s
+const int kRepeats = 5;
+const uint32_t kRandomSeed = 0x21;
+const float kBandToleranceDb = 1.0f;
+
+const int kNumBanks = 3;
+const int kEnginesPerBank = 8;
+
+const size_t kFftSize = 1024;
+const size_t kFftHop = 2048;
+const int kNumBands = 16;
+
+struct Result {
+    std::string name;
+    int bank;
+    int engine;
+    uint64_t hash;
+    double ns_per_sample;
+    std::vector<float> bands;   // Output then aux, dB
+};
+
+// Scenario: a note every 250 ms (150 ms gate) over four octaves, with
+// harmonics rising, timbre falling and morph going up and back down
+void Render(PlaitsPort& port, std::vector<float>* out, std::vector<float>* aux) {
+    static const uint8_t kNotes[] = {36, 48, 55, 60, 63, 67, 72, 84};
+    const size_t note_blocks = 500;
+    const size_t gate_blocks = 300;
+
+    mutables_ui::Parameter* params = port.GetParameters();
+    float out_block[kBlockSize];
+    float aux_block[kBlockSize];
+    float* outs[2] = {out_block, aux_block};
+    float silence[kBlockSize] = {};
+    float* ins[4] = {silence, silence, silence, silence};
+
+    uint8_t note = 0;
+    for (size_t block = 0; block < kScenarioBlocks; block++) {
+        float t = static_cast<float>(block) / kScenarioBlocks;
+        params[2].value = 0.1f + 0.8f * t;
+        params[3].value = 0.9f - 0.8f * t;
+        params[4].value = t < 0.5f ? 2.0f * t : 2.0f - 2.0f * t;
+
+        if (block % note_blocks == 0) {
+            note = kNotes[(block / note_blocks) % sizeof(kNotes)];
+            port.NoteOn(note, 100);
+        } else if (block % note_blocks == gate_blocks) {
+            port.NoteOff(note, 0);
+        }
+
+        port.Process(ins, outs, kBlockSize);
+        if (out) {
+            out->insert(out->end(), out_block, out_block + kBlockSize);
+            aux->insert(aux->end(), aux_block, aux_block + kBlockSize);
+        }
+    }
+}
+
+void SelectEngine(PlaitsPort& port, int bank, int engine) {
+    mutables_ui::Parameter* params = port.GetParameters();
+    params[0].value = static_cast<float>(bank);
+    params[1].value = static_cast<float>(engine);
+    port.OnParametersLoaded();
+}
+
+uint64_t Hash(const std::vector<float>& out, const std::vector<float>& aux) {
+    // Outputs are 16-bit frames scaled to float: hash the integer samples,
+    // saturated like the codec (a full-scale +1.0 would wrap to -32768)
+    auto to_int16 = [](float x) {
+        return static_cast<int16_t>(std::clamp(lrintf(x * 32768.0f), -32768L, 32767L));
+    };
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < out.size(); i++) {
+        int16_t samples[2] = {to_int16(out[i]), to_int16(aux[i])};
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(samples);
+        for (size_t b = 0; b < sizeof(samples); b++) {
+            hash = (hash ^ bytes[b]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void Fft(std::vector<float>& re, std::vector<float>& im) {
+    size_t n = re.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double angle = -2.0 * M_PI / len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t k = 0; k < len / 2; k++) {
+                float wr = static_cast<float>(cos(angle * k));
+                float wi = static_cast<float>(sin(angle * k));
+                size_t a = i + k;
+                size_t b = a + len / 2;
+                float xr = re[b] * wr - im[b] * wi;
+                float xi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+}
+
+// Long-term spectrum in log-spaced bands (40 Hz - 20 kHz), dB
+void Bands(const std::vector<float>& signal, std::vector<float>& bands) {
+    std::vector<double> power(kFftSize / 2, 0.0);
+    std::vector<float> re(kFftSize);
+    std::vector<float> im(kFftSize);
+    for (size_t start = 0; start + kFftSize <= signal.size(); start += kFftHop) {
+        for (size_t i = 0; i < kFftSize; i++) {
+            float window = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * i / kFftSize);
+            re[i] = signal[start + i] * window;
+            im[i] = 0.0f;
+        }
+        Fft(re, im);
+        for (size_t i = 0; i < kFftSize / 2; i++) {
+            power[i] += re[i] * re[i] + im[i] * im[i];
+        }
+    }
+    float bin_hz = kSampleRate / kFftSize;
+    for (int b = 0; b < kNumBands; b++) {
+        float f_lo = 40.0f * powf(500.0f, static_cast<float>(b) / kNumBands);
+        float f_hi = 40.0f * powf(500.0f, static_cast<float>(b + 1) / kNumBands);
+        size_t lo = std::max<size_t>(1, static_cast<size_t>(f_lo / bin_hz));
+        size_t hi = std::max(lo + 1, std::min(kFftSize / 2, static_cast<size_t>(f_hi / bin_hz)));
+        double sum = 0.0;
+        for (size_t i = lo; i < hi; i++) sum += power[i];
+        float db = 10.0f * log10f(static_cast<float>(sum) + 1e-12f);
+        bands.push_back(std::round(db * 100.0f) / 100.0f);
+    }
+}
+
+double NowNs() {
+    using namespace std::chrono;
+    return static_cast<double>(
+        duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+Result RunScenario(int bank, int engine) {
+    Result result;
+    result.bank = bank;
+    result.engine = engine;
+    result.ns_per_sample = 1e30;
+
+    // Run 0 captures the output for the hash and bands, untimed; the
+    // kRepeats runs after it are all timed
+    for (int run = 0; run <= kRepeats; run++) {
+        // Fresh port and RNG each time: identical work in every run
+        stmlib::Random::Seed(kRandomSeed);
+        PlaitsPort* port = new PlaitsPort;
+        port->Init(kSampleRate);
+        SelectEngine(*port, bank, engine);
+
+        if (run == 0) {
+            std::vector<float> out;
+            std::vector<float> aux;
+            out.reserve(kScenarioBlocks * kBlockSize);
+            aux.reserve(kScenarioBlocks * kBlockSize);
+            mutables_ui::Parameter* params = port->GetParameters();
+            result.name = std::string(params[0].GetEnumLabel()) + "/" + params[1].GetEnumLabel();
+            Render(*port, &out, &aux);
+            result.hash = Hash(out, aux);
+            Bands(out, result.bands);
+            Bands(aux, result.bands);
+        } else {
+            double start = NowNs();
+            Render(*port, nullptr, nullptr);
+            double elapsed = NowNs() - start;
+            result.ns_per_sample = std::min(result.ns_per_sample,
+                                            elapsed / (kScenarioBlocks * kBlockSize));
+        }
+        delete port;
+    }
+    return result;
+}
+
+// JSON with one scenario per line, so the reader below stays a line scanner
+
+bool WriteJson(const char* path, const std::vector<Result>& results) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "perf_check: cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"build_flags\": \"%s\",\n", PERF_BUILD_FLAGS);
+    fprintf(file, "  \"sample_rate\": %.0f,\n", kSampleRate);
+    fprintf(file, "  \"block_size\": %zu,\n", kBlockSize);
+    fprintf(file, "  \"samples_per_scenario\": %zu,\n", kScenarioBlocks * kBlockSize);
+    fprintf(file, "  \"scenarios\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"bank\": %d, \"engine\": %d, "
+                      "\"hash\": \"%016llx\", \"ns_per_sample\": %.2f, \"bands\": [",
+                r.name.c_str(), r.bank, r.engine,
+                static_cast<unsigned long long>(r.hash), r.ns_per_sample);
+        for (size_t b = 0; b < r.bands.size(); b++) {
+            fprintf(file, "%s%.2f", b ? ", " : "", r.bands[b]);
+        }
+        fprintf(file, "]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+bool ReadJson(const char* path, std::map<std::string, Result>& results) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    char line[2048];
+    while (fgets(line, sizeof(line), file)) {
+        const char* name = strstr(line, "\"name\": \"");
+        const char* hash = strstr(line, "\"hash\": \"");
+        const char* ns = strstr(line, "\"ns_per_sample\": ");
+        const char* bands = strstr(line, "\"bands\": [");
+        if (!name || !hash || !ns || !bands) continue;
+
+        Result r;
+        name += 9;
+        r.name.assign(name, strchr(name, '"') - name);
+        r.hash = strtoull(hash + 9, nullptr, 16);
+        r.ns_per_sample = strtod(ns + 17, nullptr);
+        const char* p = bands + 10;
+        while (*p && *p != ']') {
+            char* end;
+            float value = strtof(p, &end);
+            if (end == p) break;
+            r.bands.push_back(value);
+            p = end;
+            while (*p == ',' || *p == ' ') p++;
+        }
+        results[r.name] = r;
+    }
+    fclose(file);
+    return true;
+}
+
+float MaxBandDifference(const Result& a, const Result& b) {
+    if (a.bands.size() != b.bands.size()) return 1e9f;
+    float max = 0.0f;
+    for (size_t i = 0; i < a.bands.size(); i++) {
+        max = std::max(max, std::fabs(a.bands[i] - b.bands[i]));
+    }
+    return max;
+}
+
+void Usage() {
+    fprintf(stderr,
+            "usage: perf_check [--golden FILE] [--baseline FILE] [--out FILE]\n"
+            "                  [--threshold PERCENT] [--update-golden] [--update-baseline]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* golden_path = "perf/golden.json";
+    const char* baseline_path = "perf/baseline.json";
+    const char* out_path = "build/perf_results.json";
+    double threshold = 10.0;
+    bool update_golden = false;
+    bool update_baseline = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--golden" && has_value) golden_path = argv[++i];
+        else if (arg == "--baseline" && has_value) baseline_path = argv[++i];
+        else if (arg == "--out" && has_value) out_path = argv[++i];
+        else if (arg == "--threshold" && has_value) threshold = atof(argv[++i]);
+        else if (arg == "--update-golden") update_golden = true;
+        else if (arg == "--update-baseline") update_baseline = true;
+        else {
+            Usage();
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    for (int bank = 0; bank < kNumBanks; bank++) {
+        for (int engine = 0; engine < kEnginesPerBank; engine++) {
+            results.push_back(RunScenario(bank, engine));
+        }
+    }
+    if (!WriteJson(out_path, results)) return 2;
+    if (update_golden && !WriteJson(golden_path, results)) return 2;
+    if (update_baseline && !WriteJson(baseline_path, results)) return 2;
+
+    std::map<std::string, Result> golden;
+    std::map<std::string, Result> baseline;
+    bool have_golden = ReadJson(golden_path, golden);
+    bool have_baseline = ReadJson(baseline_path, baseline);
+
+    int failures = 0;
+    printf("%-16s %10s %10s %8s  %s\n", "scenario", "ns/sample", "baseline", "change", "sound");
+    for (const Result& r : results) {
+        char change[16] = "-";
+        char base[16] = "-";
+        auto b = baseline.find(r.name);
+        if (b != baseline.end()) {
+            double percent = 100.0 * (r.ns_per_sample / b->second.ns_per_sample - 1.0);
+            snprintf(base, sizeof(base), "%.2f", b->second.ns_per_sample);
+            snprintf(change, sizeof(change), "%+.1f%%", percent);
+            if (percent > threshold) failures++;
+        }
+
+        const char* sound = "no golden";
+        auto g = golden.find(r.name);
+        if (g != golden.end()) {
+            if (g->second.hash == r.hash) {
+                sound = "identical";
+            } else if (MaxBandDifference(g->second, r) <= kBandToleranceDb) {
+                sound = "spectrum within tolerance";
+            } else {
+                sound = "CHANGED";
+                failures++;
+            }
+        }
+        printf("%-16s %10.2f %10s %8s  %s\n", r.name.c_str(), r.ns_per_sample, base, change, sound);
+    }
+
+    printf("results: %s\n", out_path);
+    if (!have_golden) {
+        printf("no golden file %s: run make golden-update\n", golden_path);
+        failures++;
+    }
+    if (!have_baseline) {
+        printf("no baseline %s: cost not compared (make perf-baseline)\n", baseline_path);
+    }
+    if (failures) {
+        printf("FAILED: %d regression(s), threshold %.1f%%\n", failures, threshold);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
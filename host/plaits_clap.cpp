@@ -0,0 +1,400 @@
+// CLAP plugin of the firmware's PlaitsPort, for Linux hosts. The DSP is the
+// module itself, run through ModuleBase by PlaitsSynth (plaits_synth.h):
+// - polyphonic, up to kVoices PlaitsPort instances
+// - CLAP notes (note ids, note expressions) and MIDI notes on one note port
+// - OUT on the main stereo port, AUX on a second stereo port
+// - the Parameter table as automatable parameters, saved as a PresetRecord
+// - fixed 24-sample blocks behind a re-blocker, reported as latency
+// - voices at 48 kHz, resampled at any host rate from 12 to 192 kHz
+//   (44.1 kHz included), the converter's delay added to the latency
+//
+// Nothing allocates or locks in process(): voices are built in activate().
+// Parameter values shared with the main thread are atomics.
+//
+// Build: make -C host plaits.clap CLAP_DIR=<clap checkout>, then copy
+// host/plaits.clap to ~/.clap/
+
+#include "plaits_synth.h"
+#include "../common/preset_format.h"
+
+#include <clap/clap.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace mutables_ui;
+using mutables_plaits::PlaitsPort;
+using mutables_plaits::PlaitsSynth;
+
+namespace {
+
+const int kVoices = 8;
+
+const char* const kFeatures[] = {
+    CLAP_PLUGIN_FEATURE_INSTRUMENT,
+    CLAP_PLUGIN_FEATURE_SYNTHESIZER,
+    CLAP_PLUGIN_FEATURE_STEREO,
+    nullptr
+};
+
+const clap_plugin_descriptor_t kDescriptor = {
+    CLAP_VERSION_INIT,
+    "org.mutables-daisies.plaits-port",
+    "Plaits Port",
+    "mutables_daisies",
+    "",
+    "",
+    "",
+    "1.0.0",
+    "The Daisy Patch Plaits port, polyphonic",
+    kFeatures
+};
+
+class PlaitsClap {
+public:
+    explicit PlaitsClap(const clap_host_t* host) : host_(host), active_(false), state_loaded_(false) {
+        plugin_.desc = &kDescriptor;
+        plugin_.plugin_data = this;
+        plugin_.init = [](const clap_plugin_t* p) { return Self(p)->Init(); };
+        plugin_.destroy = [](const clap_plugin_t* p) { delete Self(p); };
+        plugin_.activate = [](const clap_plugin_t* p, double sample_rate, uint32_t, uint32_t) {
+            return Self(p)->Activate(sample_rate);
+        };
+        plugin_.deactivate = [](const clap_plugin_t* p) { Self(p)->active_ = false; };
+        plugin_.start_processing = [](const clap_plugin_t*) { return true; };
+        plugin_.stop_processing = [](const clap_plugin_t*) {};
+        plugin_.reset = [](const clap_plugin_t* p) { Self(p)->synth_.Reset(); };
+        plugin_.process = [](const clap_plugin_t* p, const clap_process_t* process) {
+            return Self(p)->Process(process);
+        };
+        plugin_.get_extension = [](const clap_plugin_t*, const char* id) { return GetExtension(id); };
+        plugin_.on_main_thread = [](const clap_plugin_t*) {};
+    }
+
+    const clap_plugin_t* GetPlugin() const { return &plugin_; }
+
+private:
+    const clap_host_t* host_;
+    clap_plugin_t plugin_;
+    PlaitsSynth synth_;
+    bool active_;
+
+    // Main-thread copy of the module's parameters: names, ranges, enum
+    // labels and defaults. The current values live in values_.
+    PlaitsPort reference_;
+    size_t param_count_ = 0;
+    float defaults_[kMaxParameters] = {};
+    std::atomic<float> values_[kMaxParameters];
+    std::atomic<bool> state_loaded_;  // Values replaced, resend to the synth
+
+    static PlaitsClap* Self(const clap_plugin_t* plugin) {
+        return static_cast<PlaitsClap*>(plugin->plugin_data);
+    }
+
+    bool Init() {
+        reference_.Init(48000.0f);
+        param_count_ = std::min(reference_.GetParameterCount(), kMaxParameters);
+        for (size_t i = 0; i < param_count_; i++) {
+            defaults_[i] = reference_.GetParameters()[i].value;
+            values_[i].store(defaults_[i]);
+        }
+        return true;
+    }
+
+    // Fails at host rates the 48 kHz voices cannot be converted to
+    bool Activate(double sample_rate) {
+        if (!synth_.Init(static_cast<float>(sample_rate), kVoices)) return false;
+        for (size_t i = 0; i < param_count_; i++) {
+            synth_.SetParameter(0, i, values_[i].load());
+        }
+        active_ = true;
+        return true;
+    }
+
+    clap_process_status Process(const clap_process_t* process) {
+        if (process->audio_outputs_count < 1 || process->audio_outputs[0].channel_count < 2) {
+            return CLAP_PROCESS_ERROR;
+        }
+        if (state_loaded_.exchange(false)) {
+            for (size_t i = 0; i < param_count_; i++) {
+                synth_.SetParameter(0, i, values_[i].load());
+            }
+        }
+
+        const clap_input_events_t* in = process->in_events;
+        uint32_t count = in->size(in);
+        for (uint32_t i = 0; i < count; i++) {
+            HandleEvent(in->get(in, i));
+        }
+
+        float** main = process->audio_outputs[0].data32;
+        float* aux_left = nullptr;
+        float* aux_right = nullptr;
+        if (process->audio_outputs_count > 1 && process->audio_outputs[1].channel_count >= 2) {
+            aux_left = process->audio_outputs[1].data32[0];
+            aux_right = process->audio_outputs[1].data32[1];
+        }
+        synth_.Render(main[0], main[1], aux_left, aux_right, process->frames_count);
+
+        PlaitsSynth::NoteEnd end;
+        while (synth_.PopNoteEnd(end)) {
+            clap_event_note_t note = {};
+            note.header = {sizeof(note), 0, CLAP_CORE_EVENT_SPACE_ID, CLAP_EVENT_NOTE_END, 0};
+            note.note_id = end.note_id;
+            note.port_index = 0;
+            note.channel = end.channel;
+            note.key = end.key;
+            process->out_events->try_push(process->out_events, &note.header);
+        }
+        return synth_.IsIdle() ? CLAP_PROCESS_SLEEP : CLAP_PROCESS_CONTINUE;
+    }
+
+    void HandleEvent(const clap_event_header_t* header) {
+        if (header->space_id != CLAP_CORE_EVENT_SPACE_ID) return;
+        uint32_t time = header->time;
+        switch (header->type) {
+            case CLAP_EVENT_NOTE_ON: {
+                auto note = reinterpret_cast<const clap_event_note_t*>(header);
+                synth_.NoteOn(time, note->note_id, note->channel, note->key, static_cast<float>(note->velocity));
+                break;
+            }
+            case CLAP_EVENT_NOTE_OFF: {
+                auto note = reinterpret_cast<const clap_event_note_t*>(header);
+                synth_.NoteOff(time, note->note_id, note->channel, note->key);
+                break;
+            }
+            case CLAP_EVENT_NOTE_CHOKE: {
+                auto note = reinterpret_cast<const clap_event_note_t*>(header);
+                synth_.NoteChoke(time, note->note_id, note->channel, note->key);
+                break;
+            }
+            case CLAP_EVENT_NOTE_EXPRESSION: {
+                auto expression = reinterpret_cast<const clap_event_note_expression_t*>(header);
+                PlaitsSynth::Expression target;
+                switch (expression->expression_id) {
+                    case CLAP_NOTE_EXPRESSION_VOLUME:     target = PlaitsSynth::Expression::Volume; break;
+                    case CLAP_NOTE_EXPRESSION_PAN:        target = PlaitsSynth::Expression::Pan; break;
+                    case CLAP_NOTE_EXPRESSION_TUNING:     target = PlaitsSynth::Expression::Tuning; break;
+                    case CLAP_NOTE_EXPRESSION_BRIGHTNESS: target = PlaitsSynth::Expression::Brightness; break;
+                    case CLAP_NOTE_EXPRESSION_PRESSURE:   target = PlaitsSynth::Expression::Pressure; break;
+                    default: return;
+                }
+                synth_.SetExpression(time, expression->note_id, expression->channel, expression->key,
+                                     target, static_cast<float>(expression->value));
+                break;
+            }
+            case CLAP_EVENT_PARAM_VALUE: {
+                auto param = reinterpret_cast<const clap_event_param_value_t*>(header);
+                if (param->param_id >= param_count_) break;
+                float value = static_cast<float>(param->value);
+                values_[param->param_id].store(value);
+                synth_.SetParameter(time, param->param_id, value);
+                break;
+            }
+            case CLAP_EVENT_MIDI: {
+                auto midi = reinterpret_cast<const clap_event_midi_t*>(header);
+                uint8_t status = midi->data[0] & 0xF0;
+                int16_t channel = midi->data[0] & 0x0F;
+                if (status == 0x90 && midi->data[2] > 0) {
+                    synth_.NoteOn(time, PlaitsSynth::kAnyNote, channel, midi->data[1], midi->data[2] / 127.0f);
+                } else if (status == 0x80 || status == 0x90) {
+                    synth_.NoteOff(time, PlaitsSynth::kAnyNote, channel, midi->data[1]);
+                } else if (status == 0xB0 && midi->data[1] == 123) {
+                    synth_.NoteOff(time, PlaitsSynth::kAnyNote, channel, PlaitsSynth::kAnyNote);  // All notes off
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // Parameter events outside process(): values only, the synth takes them
+    // on activation or from state_loaded_
+    void Flush(const clap_input_events_t* in) {
+        uint32_t count = in->size(in);
+        for (uint32_t i = 0; i < count; i++) {
+            const clap_event_header_t* header = in->get(in, i);
+            if (header->space_id != CLAP_CORE_EVENT_SPACE_ID || header->type != CLAP_EVENT_PARAM_VALUE) continue;
+            auto param = reinterpret_cast<const clap_event_param_value_t*>(header);
+            if (param->param_id < param_count_) {
+                values_[param->param_id].store(static_cast<float>(param->value));
+            }
+        }
+        state_loaded_.store(true);
+    }
+
+    // The reference parameters at the current values, so enum labels follow
+    // the selected bank
+    const Parameter* SyncReference() {
+        Parameter* params = reference_.GetParameters();
+        for (size_t i = 0; i < param_count_; i++) {
+            params[i].value = std::clamp(values_[i].load(), params[i].min, params[i].max);
+        }
+        reference_.OnParametersLoaded();
+        return params;
+    }
+
+    bool GetParamInfo(uint32_t index, clap_param_info_t* info) {
+        if (index >= param_count_) return false;
+        const Parameter& param = reference_.GetParameters()[index];
+        memset(info, 0, sizeof(*info));
+        info->id = index;
+        info->flags = CLAP_PARAM_IS_AUTOMATABLE;
+        if (param.type == ParamType::Enum) info->flags |= CLAP_PARAM_IS_STEPPED | CLAP_PARAM_IS_ENUM;
+        snprintf(info->name, sizeof(info->name), "%s", param.name);
+        info->min_value = param.min;
+        info->max_value = param.max;
+        info->default_value = defaults_[index];
+        return true;
+    }
+
+    bool ValueToText(clap_id id, double value, char* text, uint32_t size) {
+        if (id >= param_count_) return false;
+        const Parameter& param = SyncReference()[id];
+        int index = static_cast<int>(value + 0.5);
+        if (param.type == ParamType::Enum && param.enum_labels && index >= 0 && index < param.enum_count) {
+            snprintf(text, size, "%s", param.enum_labels[index]);
+        } else {
+            snprintf(text, size, "%.3f", value);
+        }
+        return true;
+    }
+
+    bool TextToValue(clap_id id, const char* text, double* value) {
+        if (id >= param_count_) return false;
+        const Parameter& param = SyncReference()[id];
+        for (int i = 0; param.type == ParamType::Enum && param.enum_labels && i < param.enum_count; i++) {
+            if (strcmp(text, param.enum_labels[i]) == 0) {
+                *value = i;
+                return true;
+            }
+        }
+        char* end;
+        *value = strtod(text, &end);
+        return end != text;
+    }
+
+    bool SaveState(const clap_ostream_t* stream) {
+        PresetRecord record;
+        PresetCapture(record, "clap", ModuleTag(reference_.GetShortName()), SyncReference(), param_count_);
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+        for (size_t done = 0; done < sizeof(record);) {
+            int64_t written = stream->write(stream, bytes + done, sizeof(record) - done);
+            if (written <= 0) return false;
+            done += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool LoadState(const clap_istream_t* stream) {
+        PresetRecord record;
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&record);
+        for (size_t done = 0; done < sizeof(record);) {
+            int64_t read = stream->read(stream, bytes + done, sizeof(record) - done);
+            if (read <= 0) return false;
+            done += static_cast<size_t>(read);
+        }
+        if (!PresetIsValid(record, ModuleTag(reference_.GetShortName()))) return false;
+
+        Parameter* params = reference_.GetParameters();
+        PresetApply(record, params, param_count_);
+        for (size_t i = 0; i < param_count_; i++) {
+            values_[i].store(params[i].value);
+        }
+        state_loaded_.store(true);
+
+        auto host_params = static_cast<const clap_host_params_t*>(host_->get_extension(host_, CLAP_EXT_PARAMS));
+        if (host_params) host_params->rescan(host_, CLAP_PARAM_RESCAN_VALUES | CLAP_PARAM_RESCAN_TEXT);
+        return true;
+    }
+
+    static const void* GetExtension(const char* id) {
+        static const clap_plugin_params_t params = {
+            [](const clap_plugin_t* p) { return static_cast<uint32_t>(Self(p)->param_count_); },
+            [](const clap_plugin_t* p, uint32_t index, clap_param_info_t* info) {
+                return Self(p)->GetParamInfo(index, info);
+            },
+            [](const clap_plugin_t* p, clap_id id, double* value) {
+                if (id >= Self(p)->param_count_) return false;
+                *value = Self(p)->values_[id].load();
+                return true;
+            },
+            [](const clap_plugin_t* p, clap_id id, double value, char* text, uint32_t size) {
+                return Self(p)->ValueToText(id, value, text, size);
+            },
+            [](const clap_plugin_t* p, clap_id id, const char* text, double* value) {
+                return Self(p)->TextToValue(id, text, value);
+            },
+            [](const clap_plugin_t* p, const clap_input_events_t* in, const clap_output_events_t*) {
+                Self(p)->Flush(in);
+            },
+        };
+        static const clap_plugin_audio_ports_t audio_ports = {
+            [](const clap_plugin_t*, bool is_input) { return is_input ? 0u : 2u; },
+            [](const clap_plugin_t*, uint32_t index, bool is_input, clap_audio_port_info_t* info) {
+                if (is_input || index > 1) return false;
+                info->id = index;
+                snprintf(info->name, sizeof(info->name), "%s", index == 0 ? "Out" : "Aux");
+                info->flags = index == 0 ? CLAP_AUDIO_PORT_IS_MAIN : 0;
+                info->channel_count = 2;
+                info->port_type = CLAP_PORT_STEREO;
+                info->in_place_pair = CLAP_INVALID_ID;
+                return true;
+            },
+        };
+        static const clap_plugin_note_ports_t note_ports = {
+            [](const clap_plugin_t*, bool is_input) { return is_input ? 1u : 0u; },
+            [](const clap_plugin_t*, uint32_t index, bool is_input, clap_note_port_info_t* info) {
+                if (!is_input || index != 0) return false;
+                info->id = 0;
+                info->supported_dialects = CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI;
+                info->preferred_dialect = CLAP_NOTE_DIALECT_CLAP;
+                snprintf(info->name, sizeof(info->name), "%s", "Notes");
+                return true;
+            },
+        };
+        static const clap_plugin_latency_t latency = {
+            [](const clap_plugin_t* p) { return static_cast<uint32_t>(Self(p)->synth_.GetLatency()); },
+        };
+        static const clap_plugin_state_t state = {
+            [](const clap_plugin_t* p, const clap_ostream_t* stream) { return Self(p)->SaveState(stream); },
+            [](const clap_plugin_t* p, const clap_istream_t* stream) { return Self(p)->LoadState(stream); },
+        };
+
+        if (strcmp(id, CLAP_EXT_PARAMS) == 0) return &params;
+        if (strcmp(id, CLAP_EXT_AUDIO_PORTS) == 0) return &audio_ports;
+        if (strcmp(id, CLAP_EXT_NOTE_PORTS) == 0) return &note_ports;
+        if (strcmp(id, CLAP_EXT_LATENCY) == 0) return &latency;
+        if (strcmp(id, CLAP_EXT_STATE) == 0) return &state;
+        return nullptr;
+    }
+};
+
+const clap_plugin_factory_t kFactory = {
+    [](const clap_plugin_factory_t*) { return 1u; },
+    [](const clap_plugin_factory_t*, uint32_t index) {
+        return index == 0 ? &kDescriptor : nullptr;
+    },
+    [](const clap_plugin_factory_t*, const clap_host_t* host, const char* plugin_id) -> const clap_plugin_t* {
+        if (!clap_version_is_compatible(host->clap_version) || strcmp(plugin_id, kDescriptor.id) != 0) {
+            return nullptr;
+        }
+        return (new PlaitsClap(host))->GetPlugin();
+    },
+};
+
+} // namespace
+
+extern "C" CLAP_EXPORT const clap_plugin_entry_t clap_entry = {
+    CLAP_VERSION_INIT,
+    [](const char*) { return true; },
+    []() {},
+    [](const char* factory_id) -> const void* {
+        return strcmp(factory_id, CLAP_PLUGIN_FACTORY_ID) == 0 ? &kFactory : nullptr;
+    },
+};
@@ -0,0 +1,489 @@
+#pragma once
+
+// Polyphonic PlaitsPort for host builds (CLAP plugin, offline renderers):
+// one PlaitsPort per voice, driven through the ModuleBase event form.
+//
+// - Voices are found by note id, else by channel and key, like CLAP notes.
+//   A new note takes a free voice, else the oldest released one, else the
+//   oldest held one.
+// - Note expressions act per voice: volume and pan on the voice's output,
+//   tuning on its Transpose, brightness on Timbre, pressure on Morph.
+//   Velocity scales the voice's Level (the LPG), as CV would on the module.
+// - Everything renders in fixed 24-sample blocks, the firmware block size,
+//   behind a re-blocker: any host block size makes the same PlaitsPort
+//   calls, at the cost of one block of latency (GetLatency()).
+// - The voices always run at 48 kHz, the rate the Plaits DSP assumes. At
+//   another host rate the voice mix is converted (resampler.h): by
+//   PolyphaseResampler for ratios up to 4/1, by FractionalResampler for
+//   the rest (44.1 and 88.2 kHz), which adds its group delay to the
+//   latency. A voice block then plays as a varying number of host
+//   samples. Rates more than 4 times off 48 kHz are refused by Init().
+//
+// Init() allocates. The note, parameter and Render() calls are
+// allocation-free and lock-free, for the audio thread. Events are queued
+// with a time relative to the next Render() call, in time order.
+//
+// stmlib::Random, used by the noise-based engines, is process-wide: voices
+// of every synth in a process draw from one generator. Callers that need
+// bit-identical output seed it (stmlib::Random::Seed) and render from one
+// thread per process.
+
+#include "plaits_port.h"
+#include "../common/module_event.h"
+#include "../common/parameter.h"
+#include "../common/resampler.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace mutables_plaits {
+
+class PlaitsSynth {
+public:
+    static constexpr size_t kBlockSize = 24;        // As plaits/main.cpp
+    static constexpr int kMaxVoices = 16;
+    static constexpr size_t kMaxPending = 512;      // Events per Render() call
+    static constexpr size_t kMaxVoiceEvents = 64;   // Per voice and block
+    static constexpr int kAnyNote = -1;             // Note id, channel or key wildcard
+    static constexpr uint32_t kNativeRate = 48000;  // Rate the voices run at
+    static constexpr size_t kMaxHostBlock = kBlockSize * mutables_ui::PolyphaseResampler::kMaxPhases + 2;
+
+    enum class Expression {
+        Volume,         // Linear gain, 0-4
+        Pan,            // 0 left, 0.5 center, 1 right
+        Tuning,         // Semitones
+        Brightness,     // 0-1, 0.5 neutral
+        Pressure        // 0-1
+    };
+
+    // A voice that went silent or was stolen, for CLAP NOTE_END
+    struct NoteEnd {
+        int32_t note_id;
+        int16_t channel;
+        int16_t key;
+    };
+
+    PlaitsSynth() : voice_count_(0), sample_rate_(48000.0f), conversion_(Conversion::None),
+                    host_block_(kBlockSize), pending_count_(0), ready_count_(kBlockSize), collected_(0),
+                    age_(0), end_head_(0), end_tail_(0), dropped_(0) {}
+
+    // Allocates the voices; not for the audio thread. False for a voice
+    // count out of range, or a host rate with no conversion from 48 kHz.
+    bool Init(float sample_rate, int voice_count) {
+        if (voice_count < 1 || voice_count > kMaxVoices) return false;
+        uint32_t host_rate = static_cast<uint32_t>(sample_rate + 0.5f);
+        conversion_ = Conversion::None;
+        host_block_ = kBlockSize;
+        if (host_rate != kNativeRate) {
+            const mutables_ui::ResamplerQuality quality = mutables_ui::ResamplerQuality::High;
+            if (resamplers_[0].Init(host_rate, kNativeRate, quality)) {
+                for (mutables_ui::PolyphaseResampler& resampler : resamplers_) {
+                    resampler.Init(host_rate, kNativeRate, quality);
+                }
+                conversion_ = Conversion::Polyphase;
+            } else {
+                for (mutables_ui::FractionalResampler& resampler : fractional_) {
+                    if (!resampler.Init(host_rate, kNativeRate, quality)) return false;
+                }
+                conversion_ = Conversion::Fractional;
+            }
+            // Exact for Polyphase: the reduced ratio's denominator is at
+            // most 4, which divides the block size. The average otherwise.
+            host_block_ = (kBlockSize * host_rate + kNativeRate / 2) / kNativeRate;
+        }
+        voice_count_ = voice_count;
+        sample_rate_ = sample_rate;
+        for (int v = 0; v < voice_count_; v++) {
+            voices_[v].module.reset(new PlaitsPort);
+            voices_[v].module->Init(static_cast<float>(kNativeRate));
+        }
+        const mutables_ui::Parameter* params = voices_[0].module->GetParameters();
+        param_count_ = voices_[0].module->GetParameterCount();
+        for (size_t i = 0; i < param_count_; i++) {
+            values_[i] = params[i].value;
+        }
+        Reset();
+        return true;
+    }
+
+    // Silence every voice and drop queued events
+    void Reset() {
+        for (mutables_ui::PolyphaseResampler& resampler : resamplers_) resampler.Reset();
+        for (mutables_ui::FractionalResampler& resampler : fractional_) resampler.Reset();
+        for (int v = 0; v < voice_count_; v++) {
+            Voice& voice = voices_[v];
+            voice.state = VoiceState::Free;
+            voice.events.Clear();
+            ResetExpressions(voice);
+            voice.module->NoteOff(static_cast<uint8_t>(voice.key), 0);
+        }
+        memset(ready_, 0, sizeof(ready_));
+        ready_count_ = host_block_;
+        pending_count_ = 0;
+        collected_ = 0;
+        end_head_ = end_tail_ = 0;
+    }
+
+    void NoteOn(uint32_t time, int32_t note_id, int16_t channel, int16_t key, float velocity) {
+        Queue(PendingEvent{time, PendingType::NoteOn, note_id, channel, key, 0, velocity});
+    }
+
+    void NoteOff(uint32_t time, int32_t note_id, int16_t channel, int16_t key) {
+        Queue(PendingEvent{time, PendingType::NoteOff, note_id, channel, key, 0, 0.0f});
+    }
+
+    // Cut without release
+    void NoteChoke(uint32_t time, int32_t note_id, int16_t channel, int16_t key) {
+        Queue(PendingEvent{time, PendingType::Choke, note_id, channel, key, 0, 0.0f});
+    }
+
+    void SetExpression(uint32_t time, int32_t note_id, int16_t channel, int16_t key,
+                       Expression expression, float value) {
+        Queue(PendingEvent{time, PendingType::Expression, note_id, channel, key,
+                           static_cast<uint16_t>(expression), value});
+    }
+
+    // Every voice, in parameter units
+    void SetParameter(uint32_t time, size_t index, float value) {
+        if (index >= param_count_) return;
+        Queue(PendingEvent{time, PendingType::Parameter, kAnyNote, kAnyNote, kAnyNote,
+                           static_cast<uint16_t>(index), value});
+    }
+
+    // Renders `frames` samples of OUT (panned to left/right) and AUX
+    // (aux_left/aux_right, may be null), consuming the queued events
+    void Render(float* left, float* right, float* aux_left, float* aux_right, size_t frames) {
+        size_t position = 0;
+        size_t next = 0;
+        while (position < frames) {
+            size_t count = ready_count_ - collected_;
+            if (count > frames - position) count = frames - position;
+            for (; next < pending_count_ && pending_[next].time < position + count; next++) {
+                uint32_t time = pending_[next].time > position ? pending_[next].time : position;
+                Dispatch(pending_[next], NativeTime(collected_ + time - position));
+            }
+            memcpy(left + position, ready_[0] + collected_, count * sizeof(float));
+            memcpy(right + position, ready_[1] + collected_, count * sizeof(float));
+            if (aux_left) memcpy(aux_left + position, ready_[2] + collected_, count * sizeof(float));
+            if (aux_right) memcpy(aux_right + position, ready_[3] + collected_, count * sizeof(float));
+            collected_ += count;
+            position += count;
+            if (collected_ == ready_count_) {
+                RenderBlock();
+                collected_ = 0;
+            }
+        }
+        // Events past the end of this call land where rendering stopped
+        for (; next < pending_count_; next++) {
+            Dispatch(pending_[next], NativeTime(collected_));
+        }
+        pending_count_ = 0;
+    }
+
+    // Oldest ended note first, false when there is none
+    bool PopNoteEnd(NoteEnd& end) {
+        if (end_tail_ == end_head_) return false;
+        end = ends_[end_tail_ % kMaxVoices];
+        end_tail_++;
+        return true;
+    }
+
+    // No voice sounding and nothing queued
+    bool IsIdle() const {
+        if (pending_count_ > 0) return false;
+        for (int v = 0; v < voice_count_; v++) {
+            if (voices_[v].state != VoiceState::Free) return false;
+        }
+        return true;
+    }
+
+    int GetActiveVoiceCount() const {
+        int count = 0;
+        for (int v = 0; v < voice_count_; v++) {
+            count += voices_[v].state != VoiceState::Free;
+        }
+        return count;
+    }
+
+    // In host samples: the re-blocker's block, plus the converter's delay
+    size_t GetLatency() const {
+        switch (conversion_) {
+            case Conversion::Polyphase:
+                return host_block_ + static_cast<size_t>(resamplers_[0].GetLatency() + 0.5f);
+            case Conversion::Fractional:
+                return host_block_ + static_cast<size_t>(fractional_[0].GetLatency() + 0.5f);
+            default:
+                return kBlockSize;
+        }
+    }
+    int GetVoiceCount() const { return voice_count_; }
+    float GetSampleRate() const { return sample_rate_; }
+    size_t GetParameterCount() const { return param_count_; }
+    float GetParameter(size_t index) const { return index < param_count_ ? values_[index] : 0.0f; }
+    uint32_t GetDroppedEventCount() const { return dropped_; }
+
+private:
+    enum class VoiceState { Free, Held, Released };
+
+    enum class Conversion { None, Polyphase, Fractional };
+
+    enum class PendingType : uint8_t { NoteOn, NoteOff, Choke, Expression, Parameter };
+
+    struct PendingEvent {
+        uint32_t time;
+        PendingType type;
+        int32_t note_id;
+        int16_t channel;
+        int16_t key;
+        uint16_t index;     // Expression or parameter
+        float value;        // Velocity (0-1), expression or parameter value
+    };
+
+    struct Voice {
+        std::unique_ptr<PlaitsPort> module;
+        VoiceState state = VoiceState::Free;
+        int32_t note_id = kAnyNote;
+        int16_t channel = 0;
+        int16_t key = 60;
+        uint32_t age = 0;
+        float velocity = 1.0f;
+        float gain = 1.0f;
+        float pan = 0.5f;
+        float tuning = 0.0f;
+        float brightness = 0.5f;
+        float pressure = 0.0f;
+        int silent_blocks = 0;
+        mutables_ui::EventBuffer<kMaxVoiceEvents> events;
+    };
+
+    // Parameters the expressions and velocity act on
+    static constexpr uint16_t kTimbre = 3;
+    static constexpr uint16_t kMorph = 4;
+    static constexpr uint16_t kTranspose = 5;
+    static constexpr uint16_t kLevel = 8;
+    static constexpr float kSilence = 1e-4f;        // -80 dB
+    static constexpr int kSilentBlocks = 40;        // 20 ms at 48 kHz
+
+    Voice voices_[kMaxVoices];
+    int voice_count_;
+    float sample_rate_;
+    Conversion conversion_;                         // None when the host runs at kNativeRate
+    size_t host_block_;                             // Host samples per 24-sample voice block, on average
+    mutables_ui::PolyphaseResampler resamplers_[4]; // Mix to the host rate, per output
+    mutables_ui::FractionalResampler fractional_[4];
+    size_t param_count_ = 0;
+    float values_[mutables_ui::kMaxParameters] = {};
+    PendingEvent pending_[kMaxPending];
+    size_t pending_count_;
+    float ready_[4][kMaxHostBlock];                 // OUT L/R, AUX L/R of the block being played
+    size_t ready_count_;                            // Host samples in ready_
+    size_t collected_;                              // Samples played from ready_
+    uint32_t age_;
+    NoteEnd ends_[kMaxVoices];
+    uint32_t end_head_;
+    uint32_t end_tail_;
+    uint32_t dropped_;
+
+    void Queue(const PendingEvent& event) {
+        if (pending_count_ >= kMaxPending) {
+            dropped_++;
+            return;
+        }
+        pending_[pending_count_++] = event;
+    }
+
+    // Host sample offset in the block being collected to voice samples
+    uint16_t NativeTime(size_t offset) const {
+        return static_cast<uint16_t>(offset * kBlockSize / ready_count_);
+    }
+
+    static bool Matches(const Voice& voice, const PendingEvent& event) {
+        if (voice.state == VoiceState::Free) return false;
+        if (event.note_id != kAnyNote && voice.note_id != kAnyNote) return voice.note_id == event.note_id;
+        return (event.channel == kAnyNote || event.channel == voice.channel)
+            && (event.key == kAnyNote || event.key == voice.key);
+    }
+
+    static void ResetExpressions(Voice& voice) {
+        voice.gain = 1.0f;
+        voice.pan = 0.5f;
+        voice.tuning = 0.0f;
+        voice.brightness = 0.5f;
+        voice.pressure = 0.0f;
+    }
+
+    void Dispatch(const PendingEvent& event, uint16_t time) {
+        switch (event.type) {
+            case PendingType::NoteOn:
+                StartNote(event, time);
+                break;
+            case PendingType::NoteOff:
+                for (int v = 0; v < voice_count_; v++) {
+                    Voice& voice = voices_[v];
+                    if (voice.state == VoiceState::Held && Matches(voice, event)) {
+                        voice.state = VoiceState::Released;
+                        voice.silent_blocks = 0;
+                        AddEvent(voice, mutables_ui::ModuleEvent::NoteOff(time, static_cast<uint8_t>(voice.key), 0));
+                    }
+                }
+                break;
+            case PendingType::Choke:
+                for (int v = 0; v < voice_count_; v++) {
+                    if (Matches(voices_[v], event)) {
+                        AddEvent(voices_[v], mutables_ui::ModuleEvent::NoteOff(time, static_cast<uint8_t>(voices_[v].key), 0));
+                        voices_[v].state = VoiceState::Free;
+                    }
+                }
+                break;
+            case PendingType::Expression:
+                for (int v = 0; v < voice_count_; v++) {
+                    if (Matches(voices_[v], event)) {
+                        SetExpression(voices_[v], static_cast<Expression>(event.index), event.value, time);
+                    }
+                }
+                break;
+            case PendingType::Parameter:
+                values_[event.index] = event.value;
+                for (int v = 0; v < voice_count_; v++) {
+                    AddEvent(voices_[v], mutables_ui::ModuleEvent::SetParameter(
+                        time, event.index, VoiceValue(voices_[v], event.index)));
+                }
+                break;
+        }
+    }
+
+    void StartNote(const PendingEvent& event, uint16_t time) {
+        Voice* voice = nullptr;
+        for (int v = 0; v < voice_count_ && !voice; v++) {
+            if (voices_[v].state == VoiceState::Held && Matches(voices_[v], event)) voice = &voices_[v];
+        }
+        for (int v = 0; v < voice_count_ && !voice; v++) {
+            if (voices_[v].state == VoiceState::Free) voice = &voices_[v];
+        }
+        if (!voice) voice = Oldest(VoiceState::Released);
+        if (!voice) voice = Oldest(VoiceState::Held);
+
+        // A held voice keeps its gate high: drop it for one sample so the
+        // new note triggers
+        bool retrigger = voice->state == VoiceState::Held;
+        if (voice->state != VoiceState::Free && !Matches(*voice, event)) {
+            EndNote(*voice);  // Stolen
+        }
+        if (retrigger) {
+            AddEvent(*voice, mutables_ui::ModuleEvent::NoteOff(time, static_cast<uint8_t>(voice->key), 0));
+        }
+        voice->state = VoiceState::Held;
+        voice->note_id = event.note_id;
+        voice->channel = event.channel;
+        voice->key = event.key < 0 ? 0 : event.key > 127 ? 127 : event.key;
+        voice->age = age_++;
+        voice->velocity = event.value;
+        voice->silent_blocks = 0;
+        ResetExpressions(*voice);
+        for (uint16_t index : {kTimbre, kMorph, kTranspose, kLevel}) {
+            AddEvent(*voice, mutables_ui::ModuleEvent::SetParameter(time, index, VoiceValue(*voice, index)));
+        }
+        uint8_t velocity = static_cast<uint8_t>(1.0f + event.value * 126.0f);
+        AddEvent(*voice, mutables_ui::ModuleEvent::NoteOn(time + retrigger, static_cast<uint8_t>(voice->key), velocity));
+    }
+
+    Voice* Oldest(VoiceState state) {
+        Voice* oldest = nullptr;
+        for (int v = 0; v < voice_count_; v++) {
+            if (voices_[v].state == state && (!oldest || voices_[v].age < oldest->age)) oldest = &voices_[v];
+        }
+        return oldest;
+    }
+
+    void SetExpression(Voice& voice, Expression expression, float value, uint16_t time) {
+        uint16_t index = 0;
+        switch (expression) {
+            case Expression::Volume:     voice.gain = value; return;
+            case Expression::Pan:        voice.pan = value; return;
+            case Expression::Tuning:     voice.tuning = value; index = kTranspose; break;
+            case Expression::Brightness: voice.brightness = value; index = kTimbre; break;
+            case Expression::Pressure:   voice.pressure = value; index = kMorph; break;
+        }
+        AddEvent(voice, mutables_ui::ModuleEvent::SetParameter(time, index, VoiceValue(voice, index)));
+    }
+
+    // Parameter value for one voice: the global value plus its expressions
+    float VoiceValue(const Voice& voice, uint16_t index) const {
+        float value = values_[index];
+        switch (index) {
+            case kTimbre:    value += voice.brightness - 0.5f; break;
+            case kMorph:     value += voice.pressure; break;
+            case kTranspose: value += voice.tuning / 24.0f; break;  // Transpose spans +-12 semitones
+            case kLevel:     value *= voice.velocity; break;
+            default: break;
+        }
+        return value;  // Clamped to the range by the event
+    }
+
+    void AddEvent(Voice& voice, const mutables_ui::ModuleEvent& event) {
+        if (!voice.events.Add(event)) dropped_++;
+    }
+
+    void EndNote(Voice& voice) {
+        if (end_head_ - end_tail_ < static_cast<uint32_t>(kMaxVoices)) {
+            ends_[end_head_ % kMaxVoices] = NoteEnd{voice.note_id, voice.channel, voice.key};
+            end_head_++;
+        }
+        voice.state = VoiceState::Free;
+    }
+
+    void RenderBlock() {
+        memset(ready_, 0, sizeof(ready_));
+        float out[kBlockSize];
+        float aux[kBlockSize];
+        float unused[kBlockSize];
+        float* outs[mutables_ui::kModuleChannels] = {out, aux, unused, unused};
+
+        for (int v = 0; v < voice_count_; v++) {
+            Voice& voice = voices_[v];
+            if (voice.state == VoiceState::Free) {
+                // Keep parameters current without rendering
+                mutables_ui::EventList events = voice.events.GetList();
+                for (size_t i = 0; i < events.GetCount(); i++) {
+                    voice.module->HandleEvent(events[i]);
+                }
+                voice.events.Clear();
+                continue;
+            }
+
+            voice.module->Process(voice.events.GetList(), nullptr, outs, kBlockSize);
+            voice.events.Clear();
+
+            // Linear balance, unity at the center
+            float left = voice.gain * std::fmin(1.0f, 2.0f * (1.0f - voice.pan));
+            float right = voice.gain * std::fmin(1.0f, 2.0f * voice.pan);
+            float peak = 0.0f;
+            for (size_t i = 0; i < kBlockSize; i++) {
+                ready_[0][i] += left * out[i];
+                ready_[1][i] += right * out[i];
+                ready_[2][i] += left * aux[i];
+                ready_[3][i] += right * aux[i];
+                peak = std::fmax(peak, std::fabs(out[i]) + std::fabs(aux[i]));
+            }
+
+            if (voice.state == VoiceState::Released) {
+                voice.silent_blocks = peak < kSilence ? voice.silent_blocks + 1 : 0;
+                if (voice.silent_blocks >= kSilentBlocks) EndNote(voice);
+            }
+        }
+
+        // The mix is at 48 kHz so far
+        ready_count_ = kBlockSize;
+        for (int c = 0; c < 4 && conversion_ != Conversion::None; c++) {
+            float native[kBlockSize];
+            memcpy(native, ready_[c], sizeof(native));
+            ready_count_ = conversion_ == Conversion::Polyphase
+                ? resamplers_[c].Process(native, kBlockSize, ready_[c])
+                : fractional_[c].Process(native, kBlockSize, ready_[c]);
+        }
+    }
+};
+
+} // namespace mutables_plaits
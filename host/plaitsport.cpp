@@ -0,0 +1,159 @@
+// libplaitsport.so: the C API of plaitsport.h over one PlaitsPort.
+//
+// Events wait in a queue sorted by frame. Each 24-frame block takes the
+// events due before its end, as a ModuleEvent list for the event form of
+// PlaitsPort::Process(), and renders into the caller's buffers. Only a
+// block cut short by the end of a call goes through `tail`, whose rest is
+// played by the next call.
+
+#include "plaitsport.h"
+#include "plaits_port.h"
+#include "../common/module_event.h"
+#include "stmlib/utils/random.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+using mutables_ui::ModuleEvent;
+
+struct plaitsport {
+    static constexpr size_t kBlockSize = PLAITSPORT_BLOCK_SIZE;
+    static constexpr size_t kMaxPending = 1024;
+
+    struct Pending {
+        uint32_t frame;                  // From the start of the next render
+        ModuleEvent event;
+    };
+
+    mutables_plaits::PlaitsPort port;
+    Pending pending[kMaxPending];
+    size_t pending_count = 0;
+    ModuleEvent block_events[kMaxPending];
+    float tail[2][kBlockSize];           // OUT, AUX of the last block rendered
+    size_t tail_played = kBlockSize;     // Frames of tail already played
+    float unused[kBlockSize];            // AUX when the caller has no buffer
+    uint32_t dropped = 0;
+
+    plaitsport_status Queue(uint32_t frame, const ModuleEvent& event) {
+        if (pending_count >= kMaxPending) {
+            dropped++;
+            return PLAITSPORT_ERROR_QUEUE_FULL;
+        }
+        // Stable: after events of the same frame
+        size_t i = pending_count++;
+        while (i > 0 && pending[i - 1].frame > frame) {
+            pending[i] = pending[i - 1];
+            i--;
+        }
+        pending[i] = Pending{frame, event};
+        return PLAITSPORT_OK;
+    }
+
+    // One block at `base`, with the events due before its end; `consumed`
+    // counts the pending events taken so far
+    void RenderBlock(float* out, float* aux, uint32_t base, size_t& consumed) {
+        size_t count = 0;
+        for (; consumed < pending_count && pending[consumed].frame < base + kBlockSize; consumed++) {
+            ModuleEvent event = pending[consumed].event;
+            // Late events, which fell in a tail already played, open the block
+            event.time = static_cast<uint16_t>(pending[consumed].frame > base ? pending[consumed].frame - base : 0);
+            block_events[count++] = event;
+        }
+        float* outs[mutables_ui::kModuleChannels] = {out, aux ? aux : unused, unused, unused};
+        port.Process(mutables_ui::EventList(block_events, count), nullptr, outs, kBlockSize);
+    }
+
+    void Render(float* out, float* aux, uint32_t frames) {
+        uint32_t position = 0;
+        if (tail_played < kBlockSize) {
+            uint32_t count = std::min<uint32_t>(static_cast<uint32_t>(kBlockSize - tail_played), frames);
+            memcpy(out, tail[0] + tail_played, count * sizeof(float));
+            if (aux) memcpy(aux, tail[1] + tail_played, count * sizeof(float));
+            tail_played += count;
+            position = count;
+        }
+
+        size_t consumed = 0;
+        for (; position + kBlockSize <= frames; position += kBlockSize) {
+            RenderBlock(out + position, aux ? aux + position : nullptr, position, consumed);
+        }
+        if (position < frames) {
+            RenderBlock(tail[0], tail[1], position, consumed);
+            tail_played = frames - position;
+            memcpy(out + position, tail[0], tail_played * sizeof(float));
+            if (aux) memcpy(aux + position, tail[1], tail_played * sizeof(float));
+        }
+
+        // The rest move to the next call's frames. Ones inside the tail
+        // (a call shorter than the tail renders no block) become late.
+        for (size_t i = consumed; i < pending_count; i++) {
+            uint32_t frame = pending[i].frame > frames ? pending[i].frame - frames : 0;
+            pending[i - consumed] = Pending{frame, pending[i].event};
+        }
+        pending_count -= consumed;
+    }
+};
+
+uint32_t plaitsport_api_version(void) { return PLAITSPORT_API_VERSION; }
+
+plaitsport* plaitsport_create(void) {
+    plaitsport* instance = new (std::nothrow) plaitsport;
+    if (instance) instance->port.Init(static_cast<float>(PLAITSPORT_SAMPLE_RATE));
+    return instance;
+}
+
+void plaitsport_destroy(plaitsport* instance) { delete instance; }
+
+uint32_t plaitsport_param_count(const plaitsport* instance) {
+    return instance ? static_cast<uint32_t>(instance->port.GetParameterCount()) : 0;
+}
+
+plaitsport_status plaitsport_param_info_get(const plaitsport* instance, uint32_t index, plaitsport_param_info* info) {
+    if (!instance || !info || index >= instance->port.GetParameterCount()) return PLAITSPORT_ERROR_ARGUMENT;
+    // GetParameters() is not const; reading does not change the port
+    const mutables_ui::Parameter& param = const_cast<plaitsport*>(instance)->port.GetParameters()[index];
+    info->name = param.name;
+    info->min = param.min;
+    info->max = param.max;
+    info->value = param.value;
+    info->step_count = param.type == mutables_ui::ParamType::Enum ? param.enum_count : 0;
+    return PLAITSPORT_OK;
+}
+
+const char* plaitsport_param_label(const plaitsport* instance, uint32_t index, uint32_t step) {
+    if (!instance || index >= instance->port.GetParameterCount()) return nullptr;
+    const mutables_ui::Parameter& param = const_cast<plaitsport*>(instance)->port.GetParameters()[index];
+    if (param.type != mutables_ui::ParamType::Enum || !param.enum_labels || step >= param.enum_count) return nullptr;
+    return param.enum_labels[step];
+}
+
+plaitsport_status plaitsport_set_param(plaitsport* instance, uint32_t frame, uint32_t index, float value) {
+    if (!instance || index >= instance->port.GetParameterCount()) return PLAITSPORT_ERROR_ARGUMENT;
+    return instance->Queue(frame, ModuleEvent::SetParameter(0, static_cast<uint16_t>(index), value));
+}
+
+plaitsport_status plaitsport_note_on(plaitsport* instance, uint32_t frame, uint8_t note, uint8_t velocity) {
+    if (!instance || note > 127 || velocity == 0 || velocity > 127) return PLAITSPORT_ERROR_ARGUMENT;
+    return instance->Queue(frame, ModuleEvent::NoteOn(0, note, velocity));
+}
+
+plaitsport_status plaitsport_note_off(plaitsport* instance, uint32_t frame, uint8_t note) {
+    if (!instance || note > 127) return PLAITSPORT_ERROR_ARGUMENT;
+    return instance->Queue(frame, ModuleEvent::NoteOff(0, note, 0));
+}
+
+plaitsport_status plaitsport_gate(plaitsport* instance, uint32_t frame, int high) {
+    if (!instance) return PLAITSPORT_ERROR_ARGUMENT;
+    return instance->Queue(frame, ModuleEvent::Gate(0, 0, high != 0));
+}
+
+plaitsport_status plaitsport_render(plaitsport* instance, float* out, float* aux, uint32_t frames) {
+    if (!instance || (!out && frames > 0)) return PLAITSPORT_ERROR_ARGUMENT;
+    instance->Render(out, aux, frames);
+    return PLAITSPORT_OK;
+}
+
+uint32_t plaitsport_dropped_events(const plaitsport* instance) { return instance ? instance->dropped : 0; }
+
+void plaitsport_seed_random(uint32_t seed) { stmlib::Random::Seed(seed); }
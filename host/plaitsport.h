@@ -0,0 +1,103 @@
+/*
+ * C API of libplaitsport.so: the Plaits port, built from the same sources
+ * as the firmware, for test and batch tools in any language.
+ *
+ * An instance is one module: OUT and AUX at 48 kHz, the menu parameters,
+ * MIDI-style notes and the TRIG gate. Events are queued with a frame
+ * offset relative to the next plaitsport_render() call, which renders
+ * straight into the caller's buffers.
+ *
+ *   plaitsport* p = plaitsport_create();
+ *   plaitsport_set_param(p, 0, 2, 0.3f);      // Harmonics
+ *   plaitsport_note_on(p, 0, 60, 100);
+ *   plaitsport_note_off(p, 24000, 60);
+ *   plaitsport_render(p, out, aux, 48000);
+ *   plaitsport_destroy(p);
+ *
+ * - plaitsport_create() allocates; nothing else does.
+ * - The DSP runs in 24-frame blocks like the firmware. Render sizes that
+ *   are a multiple of 24 are exact. Otherwise the rest of the last block
+ *   is played at the start of the next call, and events falling inside
+ *   it take effect at the next block.
+ * - Notes and gates take effect at the nearest 24-frame block boundary,
+ *   parameters at the start of their block: Plaits reads them once per
+ *   block.
+ * - An instance is not thread-safe; separate instances may render on
+ *   separate threads. The noise generator of the noise-based engines is
+ *   shared by every instance in the process, so bit-identical output
+ *   needs plaitsport_seed_random() and one rendering thread per process.
+ *
+ * The ABI only grows: functions and enum values are added, never changed.
+ * PLAITSPORT_API_VERSION is bumped with every addition.
+ */
+
+#ifndef PLAITSPORT_H_
+#define PLAITSPORT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAITSPORT_API_VERSION 1
+#define PLAITSPORT_SAMPLE_RATE 48000
+#define PLAITSPORT_BLOCK_SIZE 24
+
+#define PLAITSPORT_API __attribute__((visibility("default")))
+
+typedef struct plaitsport plaitsport;
+
+typedef enum {
+    PLAITSPORT_OK = 0,
+    PLAITSPORT_ERROR_ARGUMENT = -1,     /* Bad index, note or null pointer */
+    PLAITSPORT_ERROR_QUEUE_FULL = -2    /* Event dropped; render to drain */
+} plaitsport_status;
+
+typedef struct {
+    const char* name;
+    float min;
+    float max;
+    float value;                        /* Current, in parameter units */
+    uint32_t step_count;                /* 0: continuous; enum label count */
+} plaitsport_param_info;
+
+/* PLAITSPORT_API_VERSION of the loaded library */
+PLAITSPORT_API uint32_t plaitsport_api_version(void);
+
+/* NULL if out of memory */
+PLAITSPORT_API plaitsport* plaitsport_create(void);
+PLAITSPORT_API void plaitsport_destroy(plaitsport* instance);
+
+/* Parameters in menu order (0 Bank, 1 Engine, 2 Harmonics ...) */
+PLAITSPORT_API uint32_t plaitsport_param_count(const plaitsport* instance);
+PLAITSPORT_API plaitsport_status plaitsport_param_info_get(const plaitsport* instance, uint32_t index,
+                                                           plaitsport_param_info* info);
+/* Label of an enum step, NULL if none. Engine labels follow the bank. */
+PLAITSPORT_API const char* plaitsport_param_label(const plaitsport* instance, uint32_t index, uint32_t step);
+
+/* Events at `frame` of the next render; later frames carry over. At most
+ * 1024 are queued at once. */
+PLAITSPORT_API plaitsport_status plaitsport_set_param(plaitsport* instance, uint32_t frame, uint32_t index,
+                                                      float value);
+PLAITSPORT_API plaitsport_status plaitsport_note_on(plaitsport* instance, uint32_t frame, uint8_t note,
+                                                    uint8_t velocity);
+PLAITSPORT_API plaitsport_status plaitsport_note_off(plaitsport* instance, uint32_t frame, uint8_t note);
+/* TRIG input: high (nonzero) or low */
+PLAITSPORT_API plaitsport_status plaitsport_gate(plaitsport* instance, uint32_t frame, int high);
+
+/* Renders `frames` samples of OUT into `out` and AUX into `aux` (may be
+ * NULL), applying the events queued for them */
+PLAITSPORT_API plaitsport_status plaitsport_render(plaitsport* instance, float* out, float* aux, uint32_t frames);
+
+/* Events lost to a full queue since creation */
+PLAITSPORT_API uint32_t plaitsport_dropped_events(const plaitsport* instance);
+
+/* Seeds the process-wide noise generator */
+PLAITSPORT_API void plaitsport_seed_random(uint32_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLAITSPORT_H_ */
@@ -0,0 +1,222 @@
+// Host round trip of the binary preset record (common/preset_format.h)
+// through the QSPI preset slots (common/preset_bank.h):
+// - round trip: capture, store, read back in place from flash, apply; the
+//   parameters must come back as captured
+// - rejection: a flipped bit, another version, magic or module and an empty
+//   slot must all read back as no preset
+// - power loss: a store cut at random points must leave the slot empty or
+//   holding the new record, never a corrupt one that is accepted
+//
+// Build and run: make -C host preset_bank_sim && host/preset_bank_sim
+
+#include "sim_flash_region.h"
+#include "../common/preset_bank.h"
+#include <cstdio>
+
+using namespace mutables_ui;
+using mutables_host::SimFlashRegion;
+
+namespace {
+
+const size_t kRegionSize = 0x20000;     // 32 slots of one sector
+const size_t kSectorSize = 4096;
+const uint32_t kTag = ModuleTag("plaits");
+const size_t kParamCount = 9;           // PlaitsPort's menu
+
+uint32_t rng_state = 12345;
+
+uint32_t Random() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+void MakeParams(Parameter* params, float seed) {
+    for (size_t i = 0; i < kParamCount; i++) {
+        params[i] = Parameter("p");
+        params[i].value = (seed + i * 0.1f) - static_cast<int>(seed + i * 0.1f);
+        params[i].cv_mapping.cv_input = static_cast<int8_t>(i % 5) - 1;
+        params[i].cv_mapping.active = i % 2 == 0;
+        params[i].cv_mapping.attenuverter = 1.0f - i * 0.2f;
+        params[i].cv_mapping.origin_offset = i * 0.1f;
+    }
+}
+
+bool SameParams(const Parameter* a, const Parameter* b) {
+    for (size_t i = 0; i < kParamCount; i++) {
+        if (a[i].value != b[i].value ||
+            a[i].cv_mapping.cv_input != b[i].cv_mapping.cv_input ||
+            a[i].cv_mapping.active != b[i].cv_mapping.active ||
+            a[i].cv_mapping.attenuverter != b[i].cv_mapping.attenuverter ||
+            a[i].cv_mapping.origin_offset != b[i].cv_mapping.origin_offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Check(bool condition, const char* what) {
+    if (!condition) printf("  FAILED: %s\n", what);
+    return condition;
+}
+
+bool RunRoundTrip() {
+    SimFlashRegion flash;
+    flash.Init(kRegionSize, kSectorSize);
+    PresetBank bank;
+    bank.Init(&flash, kTag);
+
+    bool ok = true;
+    int slots = bank.GetSlotCount();
+    for (int slot = 0; slot < slots; slot++) {
+        Parameter captured[kParamCount];
+        MakeParams(captured, slot * 0.37f);
+        PresetRecord record;
+        PresetCapture(record, "a name longer than the field", kTag, captured, kParamCount);
+        ok &= Check(PresetIsValid(record, kTag), "captured record is valid");
+        ok &= Check(bank.Store(slot, record), "store");
+
+        // In place: the record is the flash itself, no copy
+        const PresetRecord* stored = bank.Get(slot);
+        ok &= Check(stored != nullptr, "stored record reads back");
+        if (!stored) continue;
+        ok &= Check(reinterpret_cast<const uint8_t*>(stored) >= flash.GetData() &&
+                    reinterpret_cast<const uint8_t*>(stored) < flash.GetData() + flash.GetSize(),
+                    "read in place from flash");
+        ok &= Check(stored->name[kPresetNameLength - 1] == '\0' &&
+                    strncmp(stored->name, "a name longer than the field", kPresetNameLength - 1) == 0,
+                    "name truncated and terminated");
+
+        Parameter applied[kParamCount];
+        MakeParams(applied, 0.5f);
+        PresetApply(*stored, applied, kParamCount);
+        ok &= Check(SameParams(captured, applied), "applied parameters match the captured ones");
+    }
+
+    // Out-of-range values from another firmware are clamped on apply
+    Parameter params[kParamCount];
+    MakeParams(params, 0.0f);
+    PresetRecord record;
+    PresetCapture(record, "range", kTag, params, kParamCount);
+    record.values[0] = 7.0f;
+    record.mappings[1].cv_input = 9;
+    record.crc = PresetChecksum(record);
+    PresetApply(record, params, kParamCount);
+    ok &= Check(params[0].value == params[0].max && params[1].cv_mapping.cv_input == -1,
+                "out-of-range fields clamped");
+
+    printf("round trip: %d slots captured, stored, read in place and applied: %s\n", slots, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+bool RunRejection() {
+    SimFlashRegion flash;
+    flash.Init(kRegionSize, kSectorSize);
+    PresetBank bank;
+    bank.Init(&flash, kTag);
+
+    Parameter params[kParamCount];
+    MakeParams(params, 0.25f);
+    PresetRecord good;
+    PresetCapture(good, "good", kTag, params, kParamCount);
+
+    bool ok = Check(bank.Get(0) == nullptr, "empty slot rejected");
+
+    // Single-bit errors over the whole record (every 7th bit) fail the CRC
+    int missed = 0;
+    int flips = 0;
+    for (size_t bit = 0; bit < sizeof(PresetRecord) * 8; bit += 7) {
+        PresetRecord corrupt = good;
+        reinterpret_cast<uint8_t*>(&corrupt)[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+        bank.Store(0, corrupt);
+        missed += bank.Get(0) != nullptr;
+        flips++;
+    }
+    ok &= Check(missed == 0, "bit flips rejected");
+
+    // Well-formed records that are not for this firmware or module
+    PresetRecord other = good;
+    other.version = kPresetVersion + 1;
+    other.crc = PresetChecksum(other);
+    bank.Store(1, other);
+    ok &= Check(bank.Get(1) == nullptr, "other version rejected");
+
+    other = good;
+    other.magic = ~kPresetMagic;
+    other.crc = PresetChecksum(other);
+    bank.Store(2, other);
+    ok &= Check(bank.Get(2) == nullptr, "bad magic rejected");
+
+    other = good;
+    other.param_count = kMaxParameters + 1;
+    other.crc = PresetChecksum(other);
+    bank.Store(3, other);
+    ok &= Check(bank.Get(3) == nullptr, "oversized parameter count rejected");
+
+    PresetCapture(other, "other", ModuleTag("braids"), params, kParamCount);
+    bank.Store(4, other);
+    ok &= Check(bank.Get(4) == nullptr, "other module rejected");
+    ok &= Check(PresetIsValid(other, 0), "any module accepted with tag 0");
+
+    // A bit cleared in flash after the store, as by a disturbed program
+    bank.Store(5, good);
+    size_t offset = 5 * kSectorSize + offsetof(PresetRecord, values);
+    while (flash.GetData()[offset] == 0) offset++;
+    uint8_t byte = flash.GetData()[offset] & (flash.GetData()[offset] - 1);  // Lowest set bit cleared
+    flash.Program(offset, &byte, 1);
+    ok &= Check(bank.Get(5) == nullptr, "bit cleared in flash rejected");
+
+    ok &= Check(bank.Store(6, good) && bank.Get(6) != nullptr, "good record accepted next to bad ones");
+
+    printf("rejection: %d bit flips, version, magic, count, module, in-flash damage: %s\n", flips,
+           ok ? "ok" : "FAILED");
+    return ok;
+}
+
+bool RunPowerLoss() {
+    SimFlashRegion flash;
+    flash.Init(kRegionSize, kSectorSize);
+    PresetBank bank;
+    bank.Init(&flash, kTag);
+
+    const int trials = 2000;
+    int cuts = 0;
+    int bad = 0;
+    for (int trial = 0; trial < trials; trial++) {
+        Parameter params[kParamCount];
+        MakeParams(params, (trial % 100) / 100.0f);
+        PresetRecord record;
+        PresetCapture(record, "cut", kTag, params, kParamCount);
+
+        int slot = trial % bank.GetSlotCount();
+        bool cut = Random() & 1;
+        if (cut) flash.ArmPowerLoss(Random() % (sizeof(PresetRecord) + kSectorSize));
+        bank.Store(slot, record);
+        if (flash.IsDead()) cuts++;
+        flash.PowerCycle();
+
+        // Reboot: empty (erased or refused) or exactly the new record
+        PresetBank reboot;
+        reboot.Init(&flash, kTag);
+        const PresetRecord* stored = reboot.Get(slot);
+        if (stored && memcmp(stored, &record, sizeof(record)) != 0) {
+            printf("  trial %d: slot %d accepted a damaged record\n", trial, slot);
+            bad++;
+        }
+        if (!cut && !stored) {
+            printf("  trial %d: uninterrupted store lost\n", trial);
+            bad++;
+        }
+    }
+
+    printf("power loss: %d stores, %d cut, %d bad reads\n", trials, cuts, bad);
+    return bad == 0;
+}
+
+} // namespace
+
+int main() {
+    bool ok = RunRoundTrip();
+    ok = RunRejection() && ok;
+    ok = RunPowerLoss() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// PolyphaseResampler presets per ratio, and FractionalResampler for the
+// 44.1 kHz ratios it has none for: cost per output sample and conversion
+// quality.
+// - gain: level of a 1 kHz sine after conversion (passband accuracy)
+// - residual: everything but that sine, relative to it (images, aliases,
+//   rounding)
+// - reject: level of a tone between the output and input Nyquist
+//   frequencies, which a downsampler must remove (blank when upsampling)
+//
+// Build and run: make -C host resampler_bench && host/resampler_bench
+
+#include "resampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace mutables_ui;
+
+namespace {
+
+const int kRepeats = 5;
+const size_t kBlockSize = 24;
+const double kPi = 3.14159265358979323846;
+
+struct Ratio {
+    int from;
+    int to;
+};
+
+const Ratio kRatios[] = {
+    {48000, 32000}, {32000, 48000},
+    {48000, 96000}, {96000, 48000},
+    {48000, 24000}, {24000, 48000},
+    {48000, 44100}, {44100, 48000},
+};
+
+const ResamplerQuality kQualities[] = {
+    ResamplerQuality::Fast, ResamplerQuality::Balanced, ResamplerQuality::High
+};
+const char* const kQualityNames[] = {"fast", "balanced", "high"};
+
+const size_t kMaxOutput = kBlockSize * PolyphaseResampler::kMaxPhases + 2;
+
+// Ratios PolyphaseResampler has no L/M for
+bool IsFractional(const Ratio& ratio) {
+    PolyphaseResampler probe;
+    return !probe.Init(ratio.to, ratio.from, ResamplerQuality::Fast);
+}
+
+// Convert one second of a sine in blocks, as the audio callback would
+template <typename Resampler>
+std::vector<float> Convert(const Ratio& ratio, ResamplerQuality quality, double frequency) {
+    Resampler resampler;
+    resampler.Init(ratio.to, ratio.from, quality);
+    std::vector<float> out;
+    float in[kBlockSize];
+    float block[kMaxOutput];
+    for (int n = 0; n < ratio.from; n += kBlockSize) {
+        for (size_t i = 0; i < kBlockSize; i++) {
+            in[i] = static_cast<float>(0.5 * sin(2.0 * kPi * frequency * (n + i) / ratio.from));
+        }
+        size_t produced = resampler.Process(in, kBlockSize, block);
+        out.insert(out.end(), block, block + produced);
+    }
+    return out;
+}
+
+// Amplitude of `frequency` and RMS of the rest, over whole periods after
+// the filter has settled
+void Analyze(const std::vector<float>& signal, double rate, double frequency,
+             double& amplitude, double& residual) {
+    size_t start = signal.size() / 4;
+    // Shortest run of whole periods in whole samples (10 at 44.1 kHz)
+    size_t periods = 1;
+    while (fabs(fmod(periods * rate / frequency, 1.0)) > 1e-9) periods++;
+    size_t period = static_cast<size_t>(periods * rate / frequency + 0.5);
+    size_t length = ((signal.size() - start) / period) * period;
+    double c = 0.0, s = 0.0, power = 0.0;
+    for (size_t i = 0; i < length; i++) {
+        double x = signal[start + i];
+        double phase = 2.0 * kPi * frequency * static_cast<double>(start + i) / rate;
+        c += x * cos(phase);
+        s += x * sin(phase);
+        power += x * x;
+    }
+    c *= 2.0 / length;
+    s *= 2.0 / length;
+    amplitude = sqrt(c * c + s * s);
+    residual = sqrt(std::max(0.0, power / length - 0.5 * amplitude * amplitude));
+}
+
+double Db(double x) {
+    return 20.0 * log10(std::max(x, 1e-7));
+}
+
+template <typename Resampler>
+double NsPerOutputSample(const Ratio& ratio, ResamplerQuality quality) {
+    Resampler resampler;
+    resampler.Init(ratio.to, ratio.from, quality);
+    std::vector<float> noise(ratio.from);
+    uint32_t seed = 1;
+    for (float& x : noise) {
+        seed = seed * 1664525u + 1013904223u;
+        x = static_cast<float>(seed >> 8) / 16777216.0f - 0.5f;
+    }
+    float block[kMaxOutput];
+    volatile float sink = 0.0f;
+
+    double best = 1e30;
+    for (int r = 0; r < kRepeats; r++) {
+        size_t produced = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n + kBlockSize <= noise.size(); n += kBlockSize) {
+            size_t count = resampler.Process(&noise[n], kBlockSize, block);
+            sink = sink + block[0];
+            produced += count;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        best = std::min(best, ns / produced);
+    }
+    return best;
+}
+
+template <typename Resampler>
+void Report(const Ratio& ratio, int q) {
+    ResamplerQuality quality = kQualities[q];
+    Resampler probe;
+    probe.Init(ratio.to, ratio.from, quality);
+
+    double amplitude, residual;
+    Analyze(Convert<Resampler>(ratio, quality, 1000.0), ratio.to, 1000.0, amplitude, residual);
+
+    char reject[16] = "";
+    if (ratio.to < ratio.from) {
+        double tone = 0.25 * (ratio.to + ratio.from);  // Between the Nyquists
+        std::vector<float> out = Convert<Resampler>(ratio, quality, tone);
+        double power = 0.0;
+        for (size_t i = out.size() / 4; i < out.size(); i++) power += out[i] * out[i];
+        double rms = sqrt(power / (out.size() - out.size() / 4));
+        snprintf(reject, sizeof(reject), "%9.1f", Db(rms / (0.5 / sqrt(2.0))));
+    }
+
+    char name[40];
+    snprintf(name, sizeof(name), "%.4g>%.4g%s", ratio.from / 1000.0, ratio.to / 1000.0,
+             IsFractional(ratio) ? " frac" : "");
+    printf("%-14s %-9s %5d %9.2f %9.3f %11.1f %9s\n", name, kQualityNames[q],
+           probe.GetTaps(), NsPerOutputSample<Resampler>(ratio, quality),
+           Db(amplitude / 0.5), Db(residual / amplitude * sqrt(2.0)), reject);
+}
+
+} // namespace
+
+int main() {
+    printf("%-14s %-9s %5s %9s %9s %11s %9s\n", "ratio", "quality", "taps", "ns/out",
+           "gain dB", "residual dB", "reject dB");
+    for (const Ratio& ratio : kRatios) {
+        for (int q = 0; q < 3; q++) {
+            if (IsFractional(ratio)) {
+                Report<FractionalResampler>(ratio, q);
+            } else {
+                Report<PolyphaseResampler>(ratio, q);
+            }
+        }
+    }
+    printf("1 s of audio in %zu-sample blocks, best of %d\n", kBlockSize, kRepeats);
+    return 0;
+}
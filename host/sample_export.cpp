@@ -0,0 +1,282 @@
+// Sample-pack exporter: every Plaits engine over a grid of notes and
+// harmonics/timbre/morph values, one mono 32-bit float one-shot per grid
+// point, rendered on all cores.
+//
+// - A one-shot is a note held for --gate seconds, then rendered until the
+//   voice is silent or --length seconds have passed (engine_grid.h).
+// - Each WAV carries its settings: INAM is the name, ICMT the engine and
+//   parameter values, and a smpl chunk gives samplers the root key.
+//   index.csv lists every file of the pack with its settings.
+// - Jobs are work-stolen across worker processes (worker_pool.h), one
+//   engine's renders next to each other. Samples are streamed to disk.
+// - Resumable: a one-shot is written to a .part file and renamed when
+//   complete, and finished files are skipped. Each job seeds
+//   stmlib::Random from its settings, so a resumed pack, or one rendered
+//   on any number of workers, matches a pack rendered in one go.
+// - --scaling renders the first --limit jobs with 1, 2, 4 ... workers and
+//   reports renders per second and the speedup of each.
+//
+// Build and run: make -C host sample_export && host/sample_export --out pack
+
+#include "engine_grid.h"
+#include "wav_file.h"
+#include "worker_pool.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace mutables_ui;
+using namespace mutables_host;
+
+namespace {
+
+const size_t kScalingJobs = 240;         // --scaling without --limit
+
+struct Options {
+    std::string out_dir = "pack";
+    EngineGrid grid;
+    int steps = 5;                       // Values per knob without a list
+    const char* preset_path = nullptr;
+    double gate = 0.5;                   // Seconds
+    double length = 4.0;                 // Seconds, at most
+    int workers = 0;
+    size_t limit = 0;                    // Jobs, 0 for the whole grid
+    bool force = false;
+    bool scaling = false;
+};
+
+enum class JobStatus : uint8_t { Pending, Rendered, Skipped, Failed };
+
+struct JobResult {
+    JobStatus status;
+    uint32_t frames;
+    double seconds;                      // CPU time of the render
+};
+
+std::string Clean(const std::string& text) {
+    std::string clean;
+    for (char c : text) clean += isalnum(static_cast<unsigned char>(c)) || c == '-' ? c : '_';
+    return clean;
+}
+
+std::string EngineDir(const EngineNames& names, int engine) {
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%02d_", engine + 1);
+    return prefix + Clean(names.engine[engine]);
+}
+
+// Relative to the pack directory
+std::string JobPath(const EngineNames& names, const GridPoint& job) {
+    char values[48];
+    snprintf(values, sizeof(values), "_h%03d_t%03d_m%03d", static_cast<int>(lroundf(job.harmonics * 100.0f)),
+             static_cast<int>(lroundf(job.timbre * 100.0f)), static_cast<int>(lroundf(job.morph * 100.0f)));
+    return EngineDir(names, job.engine) + "/" + Clean(names.engine[job.engine]) + "_" + NoteName(job.note)
+         + values + ".wav";
+}
+
+std::string JobComment(const EngineNames& names, const GridPoint& job) {
+    char comment[160];
+    snprintf(comment, sizeof(comment), "bank=%s engine=%s note=%d harmonics=%.3f timbre=%.3f morph=%.3f",
+             names.bank[job.engine].c_str(), names.engine[job.engine].c_str(), job.note,
+             job.harmonics, job.timbre, job.morph);
+    return comment;
+}
+
+bool FileExists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+bool RenderJob(const Options& options, const EngineNames& names, const PresetRecord* preset,
+               const GridPoint& job, JobResult& result) {
+    std::string path = options.out_dir + "/" + JobPath(names, job);
+    if (!options.force && FileExists(path)) {
+        result.status = JobStatus::Skipped;
+        return true;
+    }
+    std::clock_t start = std::clock();
+
+    std::string name = Clean(names.engine[job.engine]) + " " + NoteName(job.note);
+    std::string comment = JobComment(names, job);
+    WavInfo info;
+    info.name = name.c_str();
+    info.comment = comment.c_str();
+    info.software = "mutables_daisies sample_export";
+    info.root_key = job.note;
+
+    std::string part = path + ".part";
+    WavWriter wav;
+    if (!wav.Open(part.c_str(), kGridSampleRate, 1, &info)) return false;
+    int64_t frames = RenderOneShot(job, preset, options.gate, options.length,
+                                   [&](const float* samples, size_t count) { return wav.Write(samples, count); });
+    if (frames < 0 || !wav.Close() || rename(part.c_str(), path.c_str()) != 0) return false;
+
+    result.status = JobStatus::Rendered;
+    result.frames = static_cast<uint32_t>(frames);
+    result.seconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+    return true;
+}
+
+// Renders jobs [0, count); wall time in seconds, or a negative value on failure
+double RenderPack(const Options& options, const EngineNames& names, size_t count,
+                  const PresetRecord* preset, int workers, std::vector<JobResult>& results, uint32_t& steals) {
+    WorkerPool pool(workers);
+    JobResult* shared = pool.Share<JobResult>(count);
+    if (!shared) return -1.0;
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = pool.Run(count, [&](size_t index, int) {
+        GridPoint job = options.grid.Get(index);
+        if (RenderJob(options, names, preset, job, shared[index])) {
+            return true;
+        }
+        shared[index].status = JobStatus::Failed;
+        fprintf(stderr, "%s: could not write\n", JobPath(names, job).c_str());
+        return false;
+    });
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    results.assign(shared, shared + count);
+    steals = pool.GetStealCount();
+    return ok ? wall : -1.0;
+}
+
+bool WriteIndex(const Options& options, const EngineNames& names, size_t count) {
+    std::string path = options.out_dir + "/index.csv";
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    fprintf(file, "file,bank,engine,note,harmonics,timbre,morph\n");
+    for (size_t i = 0; i < count; i++) {
+        GridPoint job = options.grid.Get(i);
+        fprintf(file, "%s,%s,%s,%d,%.3f,%.3f,%.3f\n", JobPath(names, job).c_str(),
+                names.bank[job.engine].c_str(), names.engine[job.engine].c_str(), job.note,
+                job.harmonics, job.timbre, job.morph);
+    }
+    return fclose(file) == 0;
+}
+
+bool MakeDirectories(const Options& options, const EngineNames& names) {
+    mkdir(options.out_dir.c_str(), 0755);
+    for (int engine : options.grid.engines) {
+        std::string dir = options.out_dir + "/" + EngineDir(names, engine);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+void Usage() {
+    fprintf(stderr,
+            "usage: sample_export [--out DIR] [--engines LIST] [--notes LIST] [--steps N]\n"
+            "                     [--harmonics LIST] [--timbre LIST] [--morph LIST]\n"
+            "                     [--preset FILE.bin] [--gate SECONDS] [--length SECONDS]\n"
+            "                     [--workers N] [--limit JOBS] [--force] [--scaling]\n"
+            "LIST: comma-separated; engines 0-23, knob values 0-1\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    EngineGrid& grid = options.grid;
+    bool ok = true;
+    for (int i = 1; i < argc && ok; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--out" && has_value) options.out_dir = argv[++i];
+        else if (arg == "--engines" && has_value) ok = ParseList(argv[++i], grid.engines);
+        else if (arg == "--notes" && has_value) ok = ParseList(argv[++i], grid.notes);
+        else if (arg == "--steps" && has_value) options.steps = atoi(argv[++i]);
+        else if (arg == "--harmonics" && has_value) ok = ParseList(argv[++i], grid.harmonics);
+        else if (arg == "--timbre" && has_value) ok = ParseList(argv[++i], grid.timbre);
+        else if (arg == "--morph" && has_value) ok = ParseList(argv[++i], grid.morph);
+        else if (arg == "--preset" && has_value) options.preset_path = argv[++i];
+        else if (arg == "--gate" && has_value) options.gate = atof(argv[++i]);
+        else if (arg == "--length" && has_value) options.length = atof(argv[++i]);
+        else if (arg == "--workers" && has_value) options.workers = atoi(argv[++i]);
+        else if (arg == "--limit" && has_value) options.limit = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--force") options.force = true;
+        else if (arg == "--scaling") options.scaling = true;
+        else ok = false;
+    }
+
+    if (grid.notes.empty()) grid.notes = {36, 48, 60, 72, 84};
+    grid.FillDefaults(options.steps);
+    if (!ok || options.steps < 1 || !grid.IsValid() || options.gate <= 0.0 || options.length < options.gate) {
+        Usage();
+        return 2;
+    }
+
+    PresetRecord preset;
+    if (options.preset_path && !LoadPlaitsPreset(options.preset_path, preset)) {
+        fprintf(stderr, "%s: not a valid Plaits preset\n", options.preset_path);
+        return 1;
+    }
+    const PresetRecord* preset_used = options.preset_path ? &preset : nullptr;
+
+    EngineNames names;
+    size_t count = grid.GetCount();
+    if (options.scaling && options.limit == 0) options.limit = kScalingJobs;
+    if (options.limit > 0) count = std::min(count, options.limit);
+    if (!MakeDirectories(options, names)) {
+        fprintf(stderr, "%s: cannot create the pack directories\n", options.out_dir.c_str());
+        return 1;
+    }
+
+    std::vector<JobResult> results;
+    uint32_t steals = 0;
+
+    if (options.scaling) {
+        options.force = true;
+        int max_workers = WorkerPool(options.workers).GetWorkerCount();
+        printf("%-8s %10s %10s %12s %9s %7s\n", "workers", "wall s", "renders/s", "x realtime", "speedup", "steals");
+        double base = 0.0;
+        for (int workers = 1;; workers = std::min(workers * 2, max_workers)) {
+            double wall = RenderPack(options, names, count, preset_used, workers, results, steals);
+            if (wall < 0.0) return 1;
+            if (workers == 1) base = wall;
+            double audio = 0.0;
+            for (const JobResult& result : results) audio += static_cast<double>(result.frames) / kGridSampleRate;
+            printf("%-8d %10.3f %10.1f %12.1f %9.2f %7u\n", workers, wall, count / wall, audio / wall,
+                   base / wall, steals);
+            if (workers == max_workers) break;
+        }
+        printf("%zu one-shots of %zu in the grid\n", count, grid.GetCount());
+        return 0;
+    }
+
+    WorkerPool probe(options.workers);
+    double wall = RenderPack(options, names, count, preset_used, probe.GetWorkerCount(), results, steals);
+    size_t rendered = 0;
+    size_t skipped = 0;
+    double audio = 0.0;
+    double cpu = 0.0;
+    for (const JobResult& result : results) {
+        rendered += result.status == JobStatus::Rendered;
+        skipped += result.status == JobStatus::Skipped;
+        audio += static_cast<double>(result.frames) / kGridSampleRate;
+        cpu += result.seconds;
+    }
+    if (!WriteIndex(options, names, count)) {
+        fprintf(stderr, "%s: cannot write index.csv\n", options.out_dir.c_str());
+        return 1;
+    }
+
+    printf("%zu one-shots: %zu rendered, %zu already done, %zu failed\n", count, rendered, skipped,
+           count - rendered - skipped);
+    if (rendered > 0 && wall > 0.0) {
+        printf("%.1f s in %.2f s on %d workers: %.1f renders/s, %.1fx realtime (%.2f cores busy, %u steals)\n",
+               audio, wall, probe.GetWorkerCount(), rendered / wall, audio / wall, cpu / wall, steals);
+    }
+    return wall < 0.0 ? 1 : 0;
+}
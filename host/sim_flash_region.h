@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../common/flash_region.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mutables_host {
+
+// RAM model of a NOR flash region: erase sets a sector to 0xFF, program can
+// only clear bits. Counts erases per sector for wear estimates, and can
+// simulate a power cut: after ArmPowerLoss(n), the operation that crosses
+// the n-th byte stops half way (a partial program, or a sector erase that
+// leaves junk) and every further call fails until PowerCycle().
+class SimFlashRegion : public mutables_ui::FlashRegion {
+public:
+    SimFlashRegion() : sector_size_(4096), budget_(-1), budget_before_(-1), dead_(false) {}
+
+    void Init(size_t size, size_t sector_size) {
+        sector_size_ = sector_size;
+        data_.assign(size, 0xFF);
+        erase_counts_.assign(size / sector_size, 0);
+        budget_ = -1;
+        dead_ = false;
+    }
+
+    const uint8_t* GetData() const override { return data_.data(); }
+    size_t GetSize() const override { return data_.size(); }
+    size_t GetSectorSize() const override { return sector_size_; }
+
+    bool EraseSector(size_t offset) override {
+        if (dead_ || offset >= data_.size()) return false;
+        size_t start = offset - offset % sector_size_;
+        erase_counts_[start / sector_size_]++;
+        if (Consume(sector_size_)) {
+            memset(&data_[start], 0xFF, sector_size_);
+            return true;
+        }
+        // Cut mid-erase: first half erased, second half scrambled
+        memset(&data_[start], 0xFF, sector_size_ / 2);
+        for (size_t i = sector_size_ / 2; i < sector_size_; i++) {
+            data_[start + i] &= static_cast<uint8_t>(i * 37);
+        }
+        return false;
+    }
+
+    bool Program(size_t offset, const void* data, size_t size) override {
+        if (dead_ || offset + size > data_.size()) return false;
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        size_t allowed = size;
+        if (!Consume(size)) {
+            allowed = static_cast<size_t>(budget_before_);
+        }
+        for (size_t i = 0; i < allowed; i++) {
+            data_[offset + i] &= bytes[i];
+        }
+        return allowed == size;
+    }
+
+    // Cut power after `bytes` more bytes have been erased or programmed
+    void ArmPowerLoss(long bytes) { budget_ = bytes; }
+
+    void PowerCycle() {
+        budget_ = -1;
+        dead_ = false;
+    }
+
+    bool IsDead() const { return dead_; }
+
+    uint32_t GetEraseCount(size_t sector) const { return erase_counts_[sector]; }
+    size_t GetSectorCount() const { return erase_counts_.size(); }
+
+private:
+    // Spend `bytes` of the power-loss budget, false when it runs out
+    bool Consume(size_t bytes) {
+        budget_before_ = budget_;
+        if (budget_ < 0) return true;
+        if (static_cast<long>(bytes) <= budget_) {
+            budget_ -= bytes;
+            return true;
+        }
+        dead_ = true;
+        budget_ = 0;
+        return false;
+    }
+
+    std::vector<uint8_t> data_;
+    std::vector<uint32_t> erase_counts_;
+    size_t sector_size_;
+    long budget_;
+    long budget_before_;
+    bool dead_;
+};
+
+} // namespace mutables_host
@@ -0,0 +1,230 @@
+#pragma once
+
+// Compact spectral descriptors of a one-shot for similarity search
+// (sound_index): spectral centroid and flatness, MFCC-style cepstral
+// bands, loudness, envelope times and the dominant frequency, from the
+// first second of the sound.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mutables_host {
+
+// Descriptor layout. Frequencies are octaves from 1 kHz, times octaves
+// from 1 s, so every dimension is roughly linear in what is heard.
+enum DescriptorDim : size_t {
+    kCentroidMean,
+    kCentroidDeviation,
+    kFlatnessMean,                       // 0 (tonal) to 1 (white noise)
+    kFlatnessDeviation,
+    kLoudness,                           // Mean cepstral c0
+    kCepstrum,                           // First of kCepstralCoefficients
+    kAttackTime = kCepstrum + 12,
+    kDecayTime,                          // Peak to -20 dB
+    kDominantFrequency,                  // Spectral peak at the envelope peak
+    kDescriptorSize
+};
+
+constexpr size_t kCepstralCoefficients = kAttackTime - kCepstrum;
+
+struct SoundDescriptor {
+    float values[kDescriptorSize];
+};
+
+// Short-time analysis: 2048-point Hann frames every 512 samples. Tables
+// are built once by Init(); Analyze() does not allocate.
+class DescriptorAnalyzer {
+public:
+    static constexpr size_t kFftSize = 2048;
+    static constexpr size_t kHop = 512;
+    static constexpr size_t kBins = kFftSize / 2;
+    static constexpr size_t kMelBands = 26;
+    static constexpr double kAnalysisSeconds = 1.0;
+
+    void Init(float sample_rate) {
+        sample_rate_ = sample_rate;
+        max_frames_ = static_cast<size_t>(kAnalysisSeconds * sample_rate / kHop) + 1;
+        window_.resize(kFftSize);
+        twiddles_.resize(kFftSize / 2);
+        for (size_t i = 0; i < kFftSize; i++) window_[i] = static_cast<float>(0.5 - 0.5 * cos(2.0 * M_PI * i / kFftSize));
+        for (size_t i = 0; i < kFftSize / 2; i++) twiddles_[i] = std::polar(1.0f, static_cast<float>(-2.0 * M_PI * i / kFftSize));
+        reversed_.resize(kFftSize);
+        size_t bits = 0;
+        while ((size_t(1) << bits) < kFftSize) bits++;
+        for (size_t i = 0; i < kFftSize; i++) {
+            size_t r = 0;
+            for (size_t b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+            reversed_[i] = static_cast<uint32_t>(r);
+        }
+
+        // Triangular mel filters from 40 Hz to 16 kHz (or Nyquist). Bin k
+        // lies between edges band_[k] and band_[k] + 1: weight_[k] goes to
+        // the filter rising there, the rest to the one falling.
+        double low = Mel(40.0);
+        double high = Mel(std::min(16000.0, sample_rate * 0.5));
+        double edges[kMelBands + 2];
+        for (size_t b = 0; b < kMelBands + 2; b++) edges[b] = Hz(low + (high - low) * b / (kMelBands + 1));
+        band_.assign(kBins, -1);
+        weight_.assign(kBins, 0.0f);
+        for (size_t k = 1; k < kBins; k++) {
+            double f = k * sample_rate / kFftSize;
+            for (size_t b = 0; b + 1 < kMelBands + 2; b++) {
+                if (f >= edges[b] && f < edges[b + 1]) {
+                    band_[k] = static_cast<int>(b);
+                    weight_[k] = static_cast<float>((f - edges[b]) / (edges[b + 1] - edges[b]));
+                    break;
+                }
+            }
+        }
+        dct_.resize(kCepstralCoefficients + 1);
+        for (size_t c = 0; c <= kCepstralCoefficients; c++) {
+            dct_[c].resize(kMelBands);
+            for (size_t b = 0; b < kMelBands; b++) {
+                dct_[c][b] = static_cast<float>(cos(M_PI * c * (b + 0.5) / kMelBands) / kMelBands);
+            }
+        }
+
+        spectrum_.resize(kFftSize);
+        power_.resize(kBins);
+        envelope_.resize(max_frames_);
+    }
+
+    // Descriptor of `count` mono samples at the Init() rate. Silence (and
+    // an empty buffer) gives all zeros.
+    SoundDescriptor Analyze(const float* samples, size_t count) {
+        SoundDescriptor descriptor = {};
+        count = std::min(count, static_cast<size_t>(kAnalysisSeconds * sample_rate_));
+        size_t frames = count == 0 ? 0 : std::min(max_frames_, (count + kHop - 1) / kHop);
+
+        double centroid = 0.0, centroid_sq = 0.0, flatness = 0.0, flatness_sq = 0.0;
+        double cepstrum[kCepstralCoefficients + 1] = {};
+        size_t voiced = 0;
+        float peak_energy = 0.0f;
+        size_t peak_frame = 0;
+        float peak_frequency = 0.0f;
+        for (size_t frame = 0; frame < frames; frame++) {
+            // Frames are centred on frame * kHop, zero-padded at the edges
+            ptrdiff_t start = static_cast<ptrdiff_t>(frame * kHop) - static_cast<ptrdiff_t>(kFftSize / 2);
+            for (size_t i = 0; i < kFftSize; i++) {
+                ptrdiff_t at = start + static_cast<ptrdiff_t>(i);
+                float x = at >= 0 && static_cast<size_t>(at) < count ? samples[at] : 0.0f;
+                spectrum_[reversed_[i]] = std::complex<float>(x * window_[i], 0.0f);
+            }
+            Transform();
+
+            double energy = 0.0, weighted = 0.0, log_sum = 0.0;
+            size_t peak_bin = 1;
+            for (size_t k = 1; k < kBins; k++) {
+                float p = std::norm(spectrum_[k]);
+                power_[k] = p;
+                energy += p;
+                weighted += p * k;
+                log_sum += log(p + 1e-20);
+                if (p > power_[peak_bin]) peak_bin = k;
+            }
+            envelope_[frame] = static_cast<float>(energy);
+            if (energy < kSilence) continue;
+
+            voiced++;
+            double hz = weighted / energy * sample_rate_ / kFftSize;
+            double octaves = log2(std::max(hz, 20.0) / 1000.0);
+            centroid += octaves;
+            centroid_sq += octaves * octaves;
+            double flat = exp(log_sum / (kBins - 1)) / (energy / (kBins - 1));
+            flatness += flat;
+            flatness_sq += flat * flat;
+
+            double mel[kMelBands + 2] = {};
+            for (size_t k = 1; k < kBins; k++) {
+                if (band_[k] < 0) continue;
+                mel[band_[k] + 1] += power_[k] * weight_[k];
+                mel[band_[k]] += power_[k] * (1.0f - weight_[k]);
+            }
+            for (size_t c = 0; c <= kCepstralCoefficients; c++) {
+                double sum = 0.0;
+                for (size_t b = 0; b < kMelBands; b++) sum += dct_[c][b] * log10(mel[b + 1] + 1e-10);
+                cepstrum[c] += sum;
+            }
+
+            if (envelope_[frame] > peak_energy) {
+                peak_energy = envelope_[frame];
+                peak_frame = frame;
+                peak_frequency = static_cast<float>(Interpolate(peak_bin) * sample_rate_ / kFftSize);
+            }
+        }
+        if (voiced == 0) return descriptor;
+
+        float* v = descriptor.values;
+        double mean = centroid / voiced;
+        v[kCentroidMean] = static_cast<float>(mean);
+        v[kCentroidDeviation] = static_cast<float>(sqrt(std::max(0.0, centroid_sq / voiced - mean * mean)));
+        mean = flatness / voiced;
+        v[kFlatnessMean] = static_cast<float>(mean);
+        v[kFlatnessDeviation] = static_cast<float>(sqrt(std::max(0.0, flatness_sq / voiced - mean * mean)));
+        v[kLoudness] = static_cast<float>(cepstrum[0] / voiced);
+        for (size_t c = 1; c <= kCepstralCoefficients; c++) {
+            v[kCepstrum + c - 1] = static_cast<float>(cepstrum[c] / voiced);
+        }
+
+        // Attack from the first audible frame, decay until 20 dB down (or
+        // the end of the analysis)
+        size_t onset = 0;
+        while (envelope_[onset] < kSilence) onset++;
+        size_t release = peak_frame;
+        while (release + 1 < frames && envelope_[release] > peak_energy * 0.01f) release++;
+        v[kAttackTime] = static_cast<float>(log2(FrameSeconds(peak_frame - onset)));
+        v[kDecayTime] = static_cast<float>(log2(FrameSeconds(release - peak_frame)));
+        v[kDominantFrequency] = static_cast<float>(log2(std::max(peak_frequency, 20.0f) / 1000.0f));
+        return descriptor;
+    }
+
+private:
+    // Frame energy (sum of bin powers) 80 dB below a full-scale sine
+    static constexpr double kSilence = 0.04;
+
+    float sample_rate_ = 48000.0f;
+    size_t max_frames_ = 0;
+    std::vector<float> window_;
+    std::vector<std::complex<float>> twiddles_;
+    std::vector<uint32_t> reversed_;
+    std::vector<int> band_;              // Lower mel edge of each bin, -1 outside the filters
+    std::vector<float> weight_;
+    std::vector<std::vector<float>> dct_;
+    std::vector<std::complex<float>> spectrum_;
+    std::vector<float> power_;
+    std::vector<float> envelope_;
+
+    static double Mel(double hz) { return 2595.0 * log10(1.0 + hz / 700.0); }
+    static double Hz(double mel) { return 700.0 * (pow(10.0, mel / 2595.0) - 1.0); }
+
+    // At least half a hop, so an instant attack is not log2(0)
+    double FrameSeconds(size_t frames) const { return (std::max<double>(frames, 0.5)) * kHop / sample_rate_; }
+
+    // In-place radix-2 FFT of the bit-reversed spectrum_
+    void Transform() {
+        for (size_t size = 2; size <= kFftSize; size *= 2) {
+            size_t stride = kFftSize / size;
+            for (size_t block = 0; block < kFftSize; block += size) {
+                for (size_t i = 0; i < size / 2; i++) {
+                    std::complex<float> odd = spectrum_[block + i + size / 2] * twiddles_[i * stride];
+                    spectrum_[block + i + size / 2] = spectrum_[block + i] - odd;
+                    spectrum_[block + i] += odd;
+                }
+            }
+        }
+    }
+
+    // Parabolic peak position from the log power around `bin`
+    double Interpolate(size_t bin) const {
+        if (bin < 2 || bin + 1 >= kBins) return bin;
+        double a = log(power_[bin - 1] + 1e-20), b = log(power_[bin] + 1e-20), c = log(power_[bin + 1] + 1e-20);
+        double d = a - 2.0 * b + c;
+        return d < 0.0 ? bin + 0.5 * (a - c) / d : bin;
+    }
+};
+
+} // namespace mutables_host
@@ -0,0 +1,261 @@
+// Sound-alike search over the Plaits parameter space: renders a grid of
+// engines, notes and harmonics/timbre/morph values, indexes a compact
+// spectral descriptor of each (sound_descriptors.h), and finds the
+// settings that sound closest to a reference WAV.
+//
+// - build: renders and analyzes the grid on all cores (worker_pool.h) and
+//   writes the index (sound_index.h), reporting renders per second. Each
+//   point is the note held for --gate seconds; the first second is
+//   analyzed.
+// - query: maps the index and prints the --count nearest settings to the
+//   first second of a WAV, with the search time.
+// - bench: queries the index with perturbed copies of its own entries,
+//   through the kd-tree and by a linear scan, and reports queries per
+//   second for both and whether they agree.
+//
+// Build and run: make -C host sound_index && host/sound_index build &&
+// host/sound_index query sample.wav
+
+#include "engine_grid.h"
+#include "sound_descriptors.h"
+#include "sound_index.h"
+#include "wav_file.h"
+#include "worker_pool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace mutables_ui;
+using namespace mutables_host;
+
+namespace {
+
+const size_t kMaxMatches = 64;
+
+struct Options {
+    std::string command;
+    std::string index_path = "plaits.psix";
+    std::string reference;               // query
+    EngineGrid grid;
+    int steps = 5;                       // Values per knob without a list
+    const char* preset_path = nullptr;
+    double gate = 0.5;                   // Seconds
+    int workers = 0;
+    size_t count = 5;                    // Matches
+    size_t queries = 10000;              // bench
+};
+
+struct JobTime {
+    float render;                        // CPU seconds
+    float analysis;
+};
+
+double Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double CpuSeconds(std::clock_t start) { return static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC; }
+
+int Build(const Options& options) {
+    PresetRecord preset;
+    if (options.preset_path && !LoadPlaitsPreset(options.preset_path, preset)) {
+        fprintf(stderr, "%s: not a valid Plaits preset\n", options.preset_path);
+        return 1;
+    }
+    const PresetRecord* preset_used = options.preset_path ? &preset : nullptr;
+
+    const EngineGrid& grid = options.grid;
+    size_t count = grid.GetCount();
+    WorkerPool pool(options.workers);
+    SoundDescriptor* descriptors = pool.Share<SoundDescriptor>(count);
+    JobTime* times = pool.Share<JobTime>(count);
+    if (!descriptors || !times) return 1;
+
+    // Copied into each worker; neither allocates per job
+    DescriptorAnalyzer analyzer;
+    analyzer.Init(static_cast<float>(kGridSampleRate));
+    std::vector<float> samples;
+    samples.reserve(static_cast<size_t>(DescriptorAnalyzer::kAnalysisSeconds * kGridSampleRate));
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = pool.Run(count, [&](size_t index, int) {
+        GridPoint point = grid.Get(index);
+        std::clock_t render_start = std::clock();
+        samples.clear();
+        int64_t frames = RenderOneShot(point, preset_used, options.gate, DescriptorAnalyzer::kAnalysisSeconds,
+                                       [&](const float* block, size_t size) {
+                                           samples.insert(samples.end(), block, block + size);
+                                           return true;
+                                       });
+        if (frames < 0) return false;
+        std::clock_t analysis_start = std::clock();
+        descriptors[index] = analyzer.Analyze(samples.data(), samples.size());
+        times[index].render = static_cast<float>(CpuSeconds(render_start) - CpuSeconds(analysis_start));
+        times[index].analysis = static_cast<float>(CpuSeconds(analysis_start));
+        return true;
+    });
+    double wall = Since(start);
+    if (!ok) {
+        fprintf(stderr, "rendering failed\n");
+        return 1;
+    }
+
+    std::vector<GridPoint> points(count);
+    for (size_t i = 0; i < count; i++) points[i] = grid.Get(i);
+    start = std::chrono::steady_clock::now();
+    if (!WriteSoundIndex(options.index_path.c_str(), descriptors, points.data(), count, kGridSampleRate)) {
+        fprintf(stderr, "%s: cannot write the index (or every point was silent)\n", options.index_path.c_str());
+        return 1;
+    }
+    double write = Since(start);
+
+    SoundIndex index;
+    if (!index.Open(options.index_path.c_str())) return 1;
+    double render = 0.0, analysis = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        render += times[i].render;
+        analysis += times[i].analysis;
+    }
+    printf("%zu points in %.2f s on %d workers: %.1f points/s (%.2f ms render, %.2f ms analysis each)\n",
+           count, wall, pool.GetWorkerCount(), count / wall, render / count * 1e3, analysis / count * 1e3);
+    printf("%s: %zu entries (%zu silent left out), %zu dims, tree and file written in %.1f ms\n",
+           options.index_path.c_str(), index.GetCount(), count - index.GetCount(), kDescriptorSize, write * 1e3);
+    return 0;
+}
+
+int Query(const Options& options) {
+    SoundIndex index;
+    if (!index.Open(options.index_path.c_str())) {
+        fprintf(stderr, "%s: not a sound index (run sound_index build)\n", options.index_path.c_str());
+        return 1;
+    }
+    std::vector<float> samples;
+    uint32_t sample_rate = 0;
+    if (!ReadWavMono(options.reference.c_str(), samples, sample_rate)) {
+        fprintf(stderr, "%s: not a readable WAV (PCM 16/24/32-bit or float)\n", options.reference.c_str());
+        return 1;
+    }
+
+    // Descriptors are in Hz and seconds, so the reference keeps its rate
+    auto start = std::chrono::steady_clock::now();
+    DescriptorAnalyzer analyzer;
+    analyzer.Init(static_cast<float>(sample_rate));
+    SoundDescriptor descriptor = analyzer.Analyze(samples.data(), samples.size());
+    double analysis = Since(start);
+
+    float query[kDescriptorSize];
+    index.Normalize(descriptor, query);
+    SoundMatch matches[kMaxMatches];
+    start = std::chrono::steady_clock::now();
+    size_t found = index.Search(query, matches, std::min(options.count, kMaxMatches));
+    double search = Since(start);
+
+    EngineNames names;
+    printf("%-3s %8s  %-12s %-14s %-5s %9s %7s %6s\n", "#", "distance", "bank", "engine", "note", "harmonics",
+           "timbre", "morph");
+    for (size_t i = 0; i < found; i++) {
+        const GridPoint& point = index.GetPoint(matches[i].entry);
+        printf("%-3zu %8.3f  %-12s %-14s %-5s %9.3f %7.3f %6.3f\n", i + 1, matches[i].distance,
+               names.bank[point.engine].c_str(), names.engine[point.engine].c_str(), NoteName(point.note).c_str(),
+               point.harmonics, point.timbre, point.morph);
+    }
+    printf("analysis %.2f ms, search %.1f us over %zu entries\n", analysis * 1e3, search * 1e6, index.GetCount());
+    return 0;
+}
+
+int Bench(const Options& options) {
+    auto start = std::chrono::steady_clock::now();
+    SoundIndex index;
+    if (!index.Open(options.index_path.c_str())) {
+        fprintf(stderr, "%s: not a sound index (run sound_index build)\n", options.index_path.c_str());
+        return 1;
+    }
+    double open = Since(start);
+
+    // Entries moved by a small deterministic offset, so the nearest match
+    // is usually, but not always, the entry itself
+    size_t k = std::min(options.count, kMaxMatches);
+    std::vector<float> queries(options.queries * kDescriptorSize);
+    uint32_t state = 1;
+    for (size_t q = 0; q < options.queries; q++) {
+        const float* entry = index.GetDescriptor(static_cast<uint32_t>(q * 7919 % index.GetCount()));
+        for (size_t d = 0; d < kDescriptorSize; d++) {
+            state = state * 1664525u + 1013904223u;
+            queries[q * kDescriptorSize + d] = entry[d] + (static_cast<float>(state >> 8) / 16777216.0f - 0.5f) * 0.2f;
+        }
+    }
+
+    std::vector<SoundMatch> tree(options.queries * k);
+    std::vector<SoundMatch> linear(options.queries * k);
+    start = std::chrono::steady_clock::now();
+    for (size_t q = 0; q < options.queries; q++) index.Search(&queries[q * kDescriptorSize], &tree[q * k], k);
+    double tree_time = Since(start);
+    start = std::chrono::steady_clock::now();
+    for (size_t q = 0; q < options.queries; q++) index.SearchLinear(&queries[q * kDescriptorSize], &linear[q * k], k);
+    double linear_time = Since(start);
+
+    // Ties may come back in another order, so compare distances
+    size_t mismatches = 0;
+    for (size_t i = 0; i < tree.size(); i++) mismatches += fabsf(tree[i].distance - linear[i].distance) > 1e-5f;
+
+    printf("%zu entries, %zu dims, opened in %.2f ms; %zu queries, %zu nearest\n", index.GetCount(),
+           kDescriptorSize, open * 1e3, options.queries, k);
+    printf("%-8s %12s %10s\n", "search", "queries/s", "us/query");
+    printf("%-8s %12.0f %10.2f\n", "kd-tree", options.queries / tree_time, tree_time / options.queries * 1e6);
+    printf("%-8s %12.0f %10.2f\n", "linear", options.queries / linear_time, linear_time / options.queries * 1e6);
+    printf("%.1fx faster, %s\n", linear_time / tree_time,
+           mismatches == 0 ? "same matches" : "MISMATCHED matches");
+    return mismatches == 0 ? 0 : 1;
+}
+
+void Usage() {
+    fprintf(stderr,
+            "usage: sound_index build [--index FILE] [--engines LIST] [--notes LIST] [--steps N]\n"
+            "                         [--harmonics LIST] [--timbre LIST] [--morph LIST]\n"
+            "                         [--preset FILE.bin] [--gate SECONDS] [--workers N]\n"
+            "       sound_index query REFERENCE.wav [--index FILE] [--count N]\n"
+            "       sound_index bench [--index FILE] [--queries N] [--count N]\n"
+            "LIST: comma-separated; engines 0-23, knob values 0-1\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    EngineGrid& grid = options.grid;
+    bool ok = argc >= 2;
+    if (ok) options.command = argv[1];
+    int first = 2;
+    if (options.command == "query" && argc >= 3) options.reference = argv[first++];
+    for (int i = first; i < argc && ok; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--index" && has_value) options.index_path = argv[++i];
+        else if (arg == "--engines" && has_value) ok = ParseList(argv[++i], grid.engines);
+        else if (arg == "--notes" && has_value) ok = ParseList(argv[++i], grid.notes);
+        else if (arg == "--steps" && has_value) options.steps = atoi(argv[++i]);
+        else if (arg == "--harmonics" && has_value) ok = ParseList(argv[++i], grid.harmonics);
+        else if (arg == "--timbre" && has_value) ok = ParseList(argv[++i], grid.timbre);
+        else if (arg == "--morph" && has_value) ok = ParseList(argv[++i], grid.morph);
+        else if (arg == "--preset" && has_value) options.preset_path = argv[++i];
+        else if (arg == "--gate" && has_value) options.gate = atof(argv[++i]);
+        else if (arg == "--workers" && has_value) options.workers = atoi(argv[++i]);
+        else if (arg == "--count" && has_value) options.count = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--queries" && has_value) options.queries = strtoul(argv[++i], nullptr, 10);
+        else ok = false;
+    }
+
+    if (grid.notes.empty()) grid.notes = {36, 48, 60, 72, 84};
+    grid.FillDefaults(options.steps);
+    ok = ok && options.steps >= 1 && grid.IsValid() && options.gate > 0.0 && options.count > 0;
+    if (ok && options.command == "build") return Build(options);
+    if (ok && options.command == "query" && !options.reference.empty()) return Query(options);
+    if (ok && options.command == "bench" && options.queries > 0) return Bench(options);
+    Usage();
+    return 2;
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+// On-disk index of Plaits grid points and their sound descriptors, with
+// exact k-nearest-neighbour search (sound_index).
+//
+// File layout, native endianness, every section 64-byte aligned:
+//   SoundIndexHeader
+//   float descriptors[count][kDescriptorSize]   normalized, in tree order
+//   uint8_t split_dims[count]                   kd-tree split per entry
+//   GridPoint points[count]                     settings, in tree order
+//
+// The kd-tree is implicit: the entries of a range [begin, end) are
+// partitioned around its middle entry on that entry's split dimension,
+// and the halves are the ranges either side. Small ranges are leaves,
+// scanned in full. The reader mmaps the file and searches it in place.
+
+#include "engine_grid.h"
+#include "sound_descriptors.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace mutables_host {
+
+constexpr uint32_t kSoundIndexVersion = 1;
+
+struct SoundIndexHeader {
+    char magic[4];                       // "PSIX"
+    uint32_t version;
+    uint32_t dims;                       // kDescriptorSize
+    uint32_t count;
+    uint32_t sample_rate;                // Of the rendered grid
+    uint32_t reserved;
+    uint64_t descriptors_offset;
+    uint64_t splits_offset;
+    uint64_t points_offset;
+    uint64_t file_size;
+    // Normalized value = (raw - mean) * scale: unit variance over the
+    // index, times the weight of the dimension
+    float mean[kDescriptorSize];
+    float scale[kDescriptorSize];
+};
+
+struct SoundMatch {
+    uint32_t entry;
+    float distance;                      // Euclidean, normalized space
+};
+
+// Relative importance of each descriptor dimension in the distance. The
+// twelve cepstral bands together count about as much as the centroid and
+// flatness together.
+inline float DescriptorWeight(size_t dim) {
+    if (dim >= kCepstrum && dim < kCepstrum + kCepstralCoefficients) return 0.5f;
+    return 1.0f;
+}
+
+namespace sound_index_internal {
+
+constexpr uint8_t kLeaf = 0xFF;
+constexpr uint32_t kLeafSize = 8;
+constexpr uint64_t kAlignment = 64;
+
+inline uint64_t Align(uint64_t offset) { return (offset + kAlignment - 1) & ~(kAlignment - 1); }
+
+// Squared distance, abandoning once past `limit`
+inline float Distance(const float* a, const float* b, float limit) {
+    float sum = 0.0f;
+    for (size_t d = 0; d < kDescriptorSize; d++) {
+        float delta = a[d] - b[d];
+        sum += delta * delta;
+        if (sum > limit) break;
+    }
+    return sum;
+}
+
+// Sorted by distance, at most `k` long
+struct Best {
+    SoundMatch* matches;
+    size_t k;
+    size_t size;
+
+    float Limit() const { return size < k ? FLT_MAX : matches[size - 1].distance; }
+
+    void Offer(uint32_t entry, float distance) {
+        if (size == k && distance >= matches[k - 1].distance) return;
+        size_t at = size < k ? size++ : k - 1;
+        while (at > 0 && matches[at - 1].distance > distance) {
+            matches[at] = matches[at - 1];
+            at--;
+        }
+        matches[at] = SoundMatch{entry, distance};
+    }
+};
+
+// Orders [begin, end) of `order` into the implicit tree
+inline void BuildTree(const std::vector<float>& values, std::vector<uint32_t>& order, std::vector<uint8_t>& splits,
+                      uint32_t begin, uint32_t end) {
+    if (end - begin <= kLeafSize) {
+        for (uint32_t i = begin; i < end; i++) splits[i] = kLeaf;
+        return;
+    }
+    // Split on the widest dimension of the range
+    float low[kDescriptorSize];
+    float high[kDescriptorSize];
+    std::fill(low, low + kDescriptorSize, FLT_MAX);
+    std::fill(high, high + kDescriptorSize, -FLT_MAX);
+    for (uint32_t i = begin; i < end; i++) {
+        const float* v = &values[order[i] * kDescriptorSize];
+        for (size_t d = 0; d < kDescriptorSize; d++) {
+            low[d] = std::min(low[d], v[d]);
+            high[d] = std::max(high[d], v[d]);
+        }
+    }
+    uint8_t dim = 0;
+    for (size_t d = 1; d < kDescriptorSize; d++) {
+        if (high[d] - low[d] > high[dim] - low[dim]) dim = static_cast<uint8_t>(d);
+    }
+    uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&](uint32_t a, uint32_t b) {
+                         float va = values[a * kDescriptorSize + dim];
+                         float vb = values[b * kDescriptorSize + dim];
+                         return va < vb || (va == vb && a < b);
+                     });
+    splits[middle] = dim;
+    BuildTree(values, order, splits, begin, middle);
+    BuildTree(values, order, splits, middle + 1, end);
+}
+
+inline bool WriteAll(FILE* file, const void* data, size_t size) { return fwrite(data, 1, size, file) == size; }
+
+inline bool Pad(FILE* file, uint64_t offset) {
+    static const uint8_t zeros[kAlignment] = {};
+    long at = ftell(file);
+    return at >= 0 && WriteAll(file, zeros, static_cast<size_t>(offset - static_cast<uint64_t>(at)));
+}
+
+} // namespace sound_index_internal
+
+// Normalizes the raw descriptors, builds the tree and writes the index.
+// Descriptors of silent points (all zeros) are left out.
+inline bool WriteSoundIndex(const char* path, const SoundDescriptor* descriptors, const GridPoint* points,
+                            size_t count, uint32_t sample_rate) {
+    using namespace sound_index_internal;
+    std::vector<uint32_t> order;
+    for (size_t i = 0; i < count; i++) {
+        const float* v = descriptors[i].values;
+        if (std::any_of(v, v + kDescriptorSize, [](float x) { return x != 0.0f; })) {
+            order.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    if (order.empty() || order.size() > UINT32_MAX) return false;
+    uint32_t n = static_cast<uint32_t>(order.size());
+
+    SoundIndexHeader header = {};
+    memcpy(header.magic, "PSIX", 4);
+    header.version = kSoundIndexVersion;
+    header.dims = kDescriptorSize;
+    header.count = n;
+    header.sample_rate = sample_rate;
+    for (size_t d = 0; d < kDescriptorSize; d++) {
+        double sum = 0.0, sum_sq = 0.0;
+        for (uint32_t i : order) {
+            sum += descriptors[i].values[d];
+            sum_sq += static_cast<double>(descriptors[i].values[d]) * descriptors[i].values[d];
+        }
+        double mean = sum / n;
+        double deviation = sqrt(std::max(0.0, sum_sq / n - mean * mean));
+        header.mean[d] = static_cast<float>(mean);
+        header.scale[d] = deviation > 1e-9 ? static_cast<float>(DescriptorWeight(d) / deviation) : 0.0f;
+    }
+
+    std::vector<float> values(static_cast<size_t>(n) * kDescriptorSize);
+    for (uint32_t i = 0; i < n; i++) {
+        for (size_t d = 0; d < kDescriptorSize; d++) {
+            values[i * kDescriptorSize + d] = (descriptors[order[i]].values[d] - header.mean[d]) * header.scale[d];
+        }
+    }
+    std::vector<uint32_t> tree(n);
+    std::iota(tree.begin(), tree.end(), 0u);
+    std::vector<uint8_t> splits(n);
+    BuildTree(values, tree, splits, 0, n);
+
+    header.descriptors_offset = Align(sizeof(header));
+    header.splits_offset = Align(header.descriptors_offset + static_cast<uint64_t>(n) * kDescriptorSize * sizeof(float));
+    header.points_offset = Align(header.splits_offset + n);
+    header.file_size = header.points_offset + static_cast<uint64_t>(n) * sizeof(GridPoint);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = WriteAll(file, &header, sizeof(header)) && Pad(file, header.descriptors_offset);
+    for (uint32_t i = 0; i < n && ok; i++) ok = WriteAll(file, &values[tree[i] * kDescriptorSize], kDescriptorSize * sizeof(float));
+    ok = ok && Pad(file, header.splits_offset) && WriteAll(file, splits.data(), n) && Pad(file, header.points_offset);
+    for (uint32_t i = 0; i < n && ok; i++) ok = WriteAll(file, &points[order[tree[i]]], sizeof(GridPoint));
+    return fclose(file) == 0 && ok;
+}
+
+// Read-only view of an index file, mapped in place
+class SoundIndex {
+public:
+    SoundIndex() : address_(nullptr), size_(0), header_(nullptr) {}
+    ~SoundIndex() { Close(); }
+
+    SoundIndex(const SoundIndex&) = delete;
+    SoundIndex& operator=(const SoundIndex&) = delete;
+
+    // False if the file is missing, truncated or of another version
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(SoundIndexHeader)) {
+            size_ = static_cast<size_t>(info.st_size);
+            void* address = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            address_ = address == MAP_FAILED ? nullptr : address;
+        }
+        close(fd);
+        if (!address_) return false;
+
+        header_ = static_cast<const SoundIndexHeader*>(address_);
+        const SoundIndexHeader& h = *header_;
+        uint64_t n = h.count;
+        bool ok = memcmp(h.magic, "PSIX", 4) == 0 && h.version == kSoundIndexVersion && h.dims == kDescriptorSize
+               && h.count > 0 && h.file_size == size_
+               && h.descriptors_offset + n * kDescriptorSize * sizeof(float) <= h.splits_offset
+               && h.splits_offset + n <= h.points_offset && h.points_offset + n * sizeof(GridPoint) <= size_;
+        if (!ok) {
+            Close();
+            return false;
+        }
+        madvise(address_, size_, MADV_WILLNEED);
+        return true;
+    }
+
+    void Close() {
+        if (address_) munmap(address_, size_);
+        address_ = nullptr;
+        header_ = nullptr;
+        size_ = 0;
+    }
+
+    size_t GetCount() const { return header_ ? header_->count : 0; }
+    uint32_t GetSampleRate() const { return header_->sample_rate; }
+    const GridPoint& GetPoint(uint32_t entry) const { return Points()[entry]; }
+    const float* GetDescriptor(uint32_t entry) const { return Descriptors() + entry * kDescriptorSize; }
+
+    void Normalize(const SoundDescriptor& raw, float* normalized) const {
+        for (size_t d = 0; d < kDescriptorSize; d++) {
+            normalized[d] = (raw.values[d] - header_->mean[d]) * header_->scale[d];
+        }
+    }
+
+    // The `k` entries nearest to a normalized query, nearest first, into
+    // `matches`; returns how many were found
+    size_t Search(const float* query, SoundMatch* matches, size_t k) const {
+        sound_index_internal::Best best = {matches, k, 0};
+        if (k > 0) Search(query, 0, header_->count, best);
+        Finish(best);
+        return best.size;
+    }
+
+    // The same by scanning every entry, for checking and benchmarking
+    size_t SearchLinear(const float* query, SoundMatch* matches, size_t k) const {
+        sound_index_internal::Best best = {matches, k, 0};
+        if (k > 0) Scan(query, 0, header_->count, best);
+        Finish(best);
+        return best.size;
+    }
+
+private:
+    void* address_;
+    size_t size_;
+    const SoundIndexHeader* header_;
+
+    const uint8_t* Bytes() const { return static_cast<const uint8_t*>(address_); }
+    const float* Descriptors() const { return reinterpret_cast<const float*>(Bytes() + header_->descriptors_offset); }
+    const uint8_t* Splits() const { return Bytes() + header_->splits_offset; }
+    const GridPoint* Points() const { return reinterpret_cast<const GridPoint*>(Bytes() + header_->points_offset); }
+
+    void Scan(const float* query, uint32_t begin, uint32_t end, sound_index_internal::Best& best) const {
+        for (uint32_t i = begin; i < end; i++) {
+            float distance = sound_index_internal::Distance(query, GetDescriptor(i), best.Limit());
+            best.Offer(i, distance);
+        }
+    }
+
+    void Search(const float* query, uint32_t begin, uint32_t end, sound_index_internal::Best& best) const {
+        if (end - begin <= sound_index_internal::kLeafSize) {
+            Scan(query, begin, end, best);
+            return;
+        }
+        uint32_t middle = begin + (end - begin) / 2;
+        uint8_t dim = Splits()[middle];
+        float delta = query[dim] - GetDescriptor(middle)[dim];
+        best.Offer(middle, sound_index_internal::Distance(query, GetDescriptor(middle), best.Limit()));
+        // Nearer half first; the other only if the splitting plane is
+        // closer than the worst match kept
+        if (delta < 0.0f) {
+            Search(query, begin, middle, best);
+            if (delta * delta < best.Limit()) Search(query, middle + 1, end, best);
+        } else {
+            Search(query, middle + 1, end, best);
+            if (delta * delta < best.Limit()) Search(query, begin, middle, best);
+        }
+    }
+
+    static void Finish(sound_index_internal::Best& best) {
+        for (size_t i = 0; i < best.size; i++) best.matches[i].distance = sqrtf(best.matches[i].distance);
+    }
+};
+
+} // namespace mutables_host
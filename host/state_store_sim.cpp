@@ -0,0 +1,149 @@
+// Host simulation of the QSPI state log (common/state_store.h):
+// - wear: an hour of bursty knob edits, flash writes paced and spread over
+//   every sector
+// - power loss: writes and erases cut at random points, the store must come
+//   back with the last committed state or the new one, never nothing
+//
+// Build and run: make -C host state_store_sim && host/state_store_sim
+
+#include "sim_flash_region.h"
+#include "../common/state_store.h"
+#include <cstdio>
+
+using namespace mutables_ui;
+using mutables_host::SimFlashRegion;
+
+namespace {
+
+const size_t kRegionSize = 0x10000;     // Same as STATE_FLASH_OFFSET/SIZE in plaits
+const size_t kSectorSize = 4096;
+const uint32_t kTag = ModuleTag("plaits");
+const uint32_t kCheckMs = 250;          // main.cpp capture interval
+
+uint32_t rng_state = 12345;
+
+uint32_t Random() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+void MakeState(PresetRecord& record, float value) {
+    Parameter params[2] = {Parameter("a"), Parameter("b")};
+    params[0].value = value;
+    params[1].value = 1.0f - value;
+    PresetCapture(record, "last", kTag, params, 2);
+}
+
+bool RunWear() {
+    SimFlashRegion flash;
+    flash.Init(kRegionSize, kSectorSize);
+    StateStore store;
+    store.Init(&flash, kTag);
+
+    const uint32_t duration_ms = 3600 * 1000;
+    float knob = 0.5f;
+    uint32_t last_write = 0;
+    uint32_t writes = 0;
+    uint32_t min_gap = 0xFFFFFFFF;
+    uint32_t edits = 0;
+
+    for (uint32_t now = 1; now < duration_ms; now++) {
+        // 2 s burst of turns every 10 s, one step every 20 ms
+        if (now % 10000 < 2000 && now % 20 == 0) {
+            knob += (Random() & 1) ? 0.01f : -0.01f;
+            edits++;
+        }
+        if (now % kCheckMs == 0) {
+            PresetRecord record;
+            MakeState(record, knob);
+            store.Submit(record, now);
+        }
+        uint32_t before = store.GetWriteCount();
+        store.Poll(now, true);
+        if (store.GetWriteCount() != before) {
+            if (writes > 0 && now - last_write < min_gap) min_gap = now - last_write;
+            last_write = now;
+            writes++;
+        }
+    }
+
+    uint32_t min_erase = 0xFFFFFFFF, max_erase = 0;
+    for (size_t s = 0; s < flash.GetSectorCount(); s++) {
+        uint32_t count = flash.GetEraseCount(s);
+        if (count < min_erase) min_erase = count;
+        if (count > max_erase) max_erase = count;
+    }
+    // 100k erase cycles per sector, spread by the ring
+    double hours = max_erase > 0 ? 100000.0 / max_erase : 0.0;
+
+    printf("wear: %u edits -> %u writes in 1 h, min gap %u ms, "
+           "erases per sector %u..%u, ~%.0f years of continuous editing\n",
+           edits, writes, min_gap, min_erase, max_erase, hours / (24 * 365));
+
+    bool ok = min_gap >= StateStore::kMinIntervalMs && max_erase - min_erase <= 1;
+    if (!ok) printf("wear: FAILED\n");
+    return ok;
+}
+
+bool RunPowerLoss() {
+    SimFlashRegion flash;
+    flash.Init(kRegionSize, kSectorSize);
+
+    const int trials = 2000;
+    float committed = -1.0f;
+    int failures = 0;
+    int cuts = 0;
+    uint32_t now = 0;
+
+    for (int trial = 0; trial < trials; trial++) {
+        StateStore store;
+        store.Init(&flash, kTag);
+
+        // Boot: must see the last committed state
+        const PresetRecord* stored = store.Get();
+        float seen = stored ? stored->values[0] : -1.0f;
+        if (seen != committed) {
+            printf("power loss: trial %d restored %f, expected %f\n", trial, seen, committed);
+            failures++;
+            committed = seen;
+        }
+
+        float value = (trial % 100) / 100.0f + 0.001f;
+        PresetRecord record;
+        MakeState(record, value);
+
+        // Cut somewhere inside this write (or its sector erase) half the time
+        bool cut = Random() & 1;
+        if (cut) {
+            flash.ArmPowerLoss(Random() % (sizeof(StateEntry) + kSectorSize));
+        }
+
+        now += 10000;
+        store.Submit(record, now);
+        for (uint32_t t = 0; t < 5000 && store.IsDirty() && !flash.IsDead(); t++) {
+            store.Poll(now + StateStore::kWriteBehindMs + t, true);
+        }
+        if (flash.IsDead()) {
+            cuts++;
+            // The cut write may or may not have completed
+            StateStore probe;
+            flash.PowerCycle();
+            probe.Init(&flash, kTag);
+            if (probe.Get() && probe.Get()->values[0] == value) committed = value;
+        } else if (!store.IsDirty()) {
+            committed = value;
+        }
+        flash.PowerCycle();
+    }
+
+    printf("power loss: %d trials, %d cut, %d bad restores\n", trials, cuts, failures);
+    return failures == 0;
+}
+
+} // namespace
+
+int main() {
+    bool ok = RunWear();
+    ok = RunPowerLoss() && ok;
+    return ok ? 0 : 1;
+}
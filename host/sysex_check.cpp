@@ -0,0 +1,273 @@
+// SysEx dump and restore through the firmware itself: plaits/main.cpp in
+// the simulator (plaits_sim), MIDI in from the script, MIDI out captured.
+// 1. Source unit: a parameter is edited and stored to QSPI slot 0 from the
+//    menu, another one edited after that, then a dump request (state and
+//    bank) is answered.
+// 2. Blank unit: the dumped state record is replayed, then the slot
+//    record, led by chunks 0, 1 and 3 (out of order). The receiver must
+//    refuse those with an error ack, then take the full record. A dump
+//    request follows.
+// 3. Checks: acks read state ok, slot error, slot ok, and the blank unit's
+//    dump holds the source's state and slot records byte for byte.
+//
+// Build and run: make -C host check-sysex
+//   host/sysex_check [path/to/plaits_sim]
+
+#include "../common/sysex.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace mutables_ui;
+
+namespace {
+
+const char* const kWorkDir = "build/sysex";
+const int kDurationMs = 3000;
+
+// Menu rows of Plaits (9 parameters, then the action rows)
+const int kSlotRow = 11;
+
+typedef std::vector<uint8_t> Message;  // Without F0 and F7
+
+struct Ack {
+    SysexTarget target;
+    uint8_t slot;
+    bool ok;
+};
+
+struct Dump {
+    std::vector<Ack> acks;
+    bool has_state = false;
+    PresetRecord state;
+    std::vector<int> slots;              // Slot numbers in dump order
+    std::vector<PresetRecord> records;   // Their records
+    std::vector<Message> chunks[2];      // Raw Chunk messages per target
+};
+
+std::string Path(const char* name) {
+    return std::string(kWorkDir) + "/" + name;
+}
+
+std::vector<Message> SplitMessages(const std::vector<uint8_t>& bytes) {
+    std::vector<Message> messages;
+    Message current;
+    bool inside = false;
+    for (uint8_t byte : bytes) {
+        if (byte == 0xF0) {
+            current.clear();
+            inside = true;
+        } else if (byte == 0xF7 && inside) {
+            messages.push_back(current);
+            inside = false;
+        } else if (inside) {
+            current.push_back(byte);
+        }
+    }
+    return messages;
+}
+
+// Acks and records of a MIDI out capture; records are assembled and
+// validated by the firmware's own receiver
+bool ReadDump(const std::string& path, Dump& dump) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        printf("FAIL: no MIDI out capture at %s\n", path.c_str());
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    SysexReceiver receiver;
+    receiver.Init(0);  // Any module
+    for (const Message& message : SplitMessages(bytes)) {
+        if (message.size() < 4 || message[0] != kSysexId) continue;
+        SysexCommand command = static_cast<SysexCommand>(message[3]);
+        if (command == SysexCommand::Ack && message.size() >= 7) {
+            dump.acks.push_back(Ack{static_cast<SysexTarget>(message[4]), message[5], message[6] == 0});
+            continue;
+        }
+        if (command != SysexCommand::Chunk || message.size() < 5) continue;
+        dump.chunks[message[4] == 0 ? 0 : 1].push_back(message);
+        switch (receiver.Parse(message.data(), message.size())) {
+            case SysexReceiver::Result::Record:
+                if (receiver.GetTarget() == SysexTarget::State) {
+                    dump.has_state = true;
+                    dump.state = receiver.GetRecord();
+                } else {
+                    dump.slots.push_back(receiver.GetSlot());
+                    dump.records.push_back(receiver.GetRecord());
+                }
+                break;
+            case SysexReceiver::Result::Error:
+                printf("FAIL: bad record in %s\n", path.c_str());
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+void WriteSysex(FILE* script, int time_ms, const Message& message) {
+    fprintf(script, "%d sysex", time_ms);
+    for (uint8_t byte : message) fprintf(script, " %02X", byte);
+    fprintf(script, "\n");
+}
+
+bool RunSim(const char* sim, const std::string& script, const std::string& midi_out) {
+    std::string command = "MUTABLES_SIM_SCRIPT=" + script + " MUTABLES_SIM_MIDI_OUT=" + midi_out
+                        + " MUTABLES_SIM_DURATION_MS=" + std::to_string(kDurationMs) + " " + sim
+                        + " > " + midi_out + ".log";
+    if (std::system(command.c_str()) != 0) {
+        printf("FAIL: %s (see %s.log)\n", command.c_str(), midi_out.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Encoder press and release at t; returns the time after
+int Click(FILE* script, int t) {
+    fprintf(script, "%d press\n%d release\n", t, t + 10);
+    return t + 10;
+}
+
+// Edit a parameter row by steps, store slot 0, edit another, dump
+bool WriteSourceScript(const std::string& path) {
+    FILE* script = fopen(path.c_str(), "w");
+    if (!script) return false;
+    int t = 10;
+    fprintf(script, "# Row 1 edited, stored to slot 0\n");
+    fprintf(script, "%d turn 1\n", t += 10);
+    t = Click(script, t + 10);
+    fprintf(script, "%d turn 7\n", t += 10);
+    t = Click(script, t + 10);
+    for (int row = 1; row < kSlotRow; row++) {
+        fprintf(script, "%d turn 1\n", t += 10);
+    }
+    t = Click(script, t + 10);
+    t = Click(script, t + 10);
+    fprintf(script, "# Row 2 edited after the store, for the state only\n");
+    for (int row = kSlotRow; row > 2; row--) {
+        fprintf(script, "%d turn -1\n", t += 10);
+    }
+    t = Click(script, t + 10);
+    fprintf(script, "%d turn 5\n", t += 10);
+    t = Click(script, t + 10);
+    t += 100;
+    fprintf(script, "%d sysex %02X %02X %02X %02X 02\n", t, kSysexId, kSysexTag0, kSysexTag1,
+            static_cast<int>(SysexCommand::DumpRequest));
+    fprintf(script, "%d end\n", t + 1000);
+    fclose(script);
+    return true;
+}
+
+// The source's records back in, with an out-of-order lead-in to the slot
+bool WriteRestoreScript(const std::string& path, const Dump& source) {
+    FILE* script = fopen(path.c_str(), "w");
+    if (!script) return false;
+    int t = 100;
+    for (const Message& chunk : source.chunks[0]) WriteSysex(script, t += 5, chunk);
+    t += 100;
+    const std::vector<Message>& slot = source.chunks[1];
+    fprintf(script, "# Chunks 0, 1, 3: refused at 3\n");
+    WriteSysex(script, t += 5, slot[0]);
+    WriteSysex(script, t += 5, slot[1]);
+    WriteSysex(script, t += 5, slot[3]);
+    t += 100;
+    for (size_t i = 0; i < kSysexChunkCount; i++) WriteSysex(script, t += 5, slot[i]);
+    t += 500;
+    fprintf(script, "%d sysex %02X %02X %02X %02X 02\n", t, kSysexId, kSysexTag0, kSysexTag1,
+            static_cast<int>(SysexCommand::DumpRequest));
+    fprintf(script, "%d end\n", t + 1000);
+    fclose(script);
+    return true;
+}
+
+bool SameBytes(const char* what, const PresetRecord& a, const PresetRecord& b) {
+    const uint8_t* x = reinterpret_cast<const uint8_t*>(&a);
+    const uint8_t* y = reinterpret_cast<const uint8_t*>(&b);
+    for (size_t i = 0; i < sizeof(PresetRecord); i++) {
+        if (x[i] != y[i]) {
+            printf("FAIL: %s differs at byte %zu (%02X, expected %02X)\n", what, i, y[i], x[i]);
+            return false;
+        }
+    }
+    printf("ok: %s restored byte for byte (%zu bytes)\n", what, sizeof(PresetRecord));
+    return true;
+}
+
+bool CheckAcks(const std::vector<Ack>& acks) {
+    const Ack expected[] = {
+        {SysexTarget::State, 0, true},
+        {SysexTarget::Slot, 0, false},
+        {SysexTarget::Slot, 0, true},
+    };
+    size_t count = sizeof(expected) / sizeof(expected[0]);
+    bool ok = acks.size() == count;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = acks[i].target == expected[i].target && acks[i].slot == expected[i].slot
+          && acks[i].ok == expected[i].ok;
+    }
+    if (!ok) {
+        printf("FAIL: acks");
+        for (const Ack& ack : acks) {
+            printf(" %s/%u/%s", ack.target == SysexTarget::State ? "state" : "slot", ack.slot,
+                   ack.ok ? "ok" : "error");
+        }
+        printf(", expected state/0/ok slot/0/error slot/0/ok\n");
+        return false;
+    }
+    printf("ok: acks state ok, slot error (out-of-order chunk), slot ok\n");
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* sim = argc > 1 ? argv[1] : "./plaits_sim";
+    std::string mkdir = std::string("mkdir -p ") + kWorkDir;
+    if (std::system(mkdir.c_str()) != 0) return 1;
+
+    Dump source;
+    if (!WriteSourceScript(Path("source.txt"))
+        || !RunSim(sim, Path("source.txt"), Path("source.syx"))
+        || !ReadDump(Path("source.syx"), source)) {
+        return 1;
+    }
+    if (!source.has_state || source.slots.size() != 1 || source.slots[0] != 0) {
+        printf("FAIL: source dump should hold the state and slot 0\n");
+        return 1;
+    }
+    if (memcmp(source.state.values, source.records[0].values, sizeof(source.state.values)) == 0) {
+        printf("FAIL: source state and slot 0 should differ\n");
+        return 1;
+    }
+
+    Dump restored;
+    if (!WriteRestoreScript(Path("restore.txt"), source)
+        || !RunSim(sim, Path("restore.txt"), Path("restore.syx"))
+        || !ReadDump(Path("restore.syx"), restored)) {
+        return 1;
+    }
+
+    bool ok = CheckAcks(restored.acks);
+    if (!restored.has_state) {
+        printf("FAIL: no state record in the restored unit's dump\n");
+        ok = false;
+    } else {
+        ok &= SameBytes("state record", source.state, restored.state);
+    }
+    if (restored.slots.size() != 1 || restored.slots[0] != 0) {
+        printf("FAIL: the restored unit should hold slot 0 only\n");
+        ok = false;
+    } else {
+        ok &= SameBytes("slot 0 record", source.records[0], restored.records[0]);
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+namespace mutables_host {
+
+// Metadata written ahead of the samples: a LIST/INFO chunk (name, comment,
+// software) and, with a root key, a smpl chunk samplers map from
+struct WavInfo {
+    const char* name = nullptr;         // INAM
+    const char* comment = nullptr;      // ICMT
+    const char* software = nullptr;     // ISFT
+    int root_key = -1;                  // MIDI unity note, -1 for none
+};
+
+// Streaming 32-bit float WAV writer for host tools. Frames go to the file
+// as they are rendered, so memory does not grow with the length. The
+// header holds placeholder sizes until Close() patches them.
+class WavWriter {
+public:
+    static constexpr uint16_t kMaxChannels = 8;
+
+    WavWriter() : file_(nullptr), channels_(0), frames_(0), data_size_offset_(0), failed_(false) {}
+    ~WavWriter() { Close(); }
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    bool Open(const char* path, uint32_t sample_rate, uint16_t channels, const WavInfo* info = nullptr) {
+        Close();
+        if (channels == 0 || channels > kMaxChannels) return false;
+        file_ = fopen(path, "wb");
+        if (!file_) return false;
+        channels_ = channels;
+        frames_ = 0;
+        failed_ = false;
+
+        fwrite("RIFF", 1, 4, file_);
+        U32(0);  // Patched by Close()
+        fwrite("WAVEfmt ", 1, 8, file_);
+        U32(16);
+        U16(3);  // IEEE float
+        U16(channels);
+        U32(sample_rate);
+        U32(sample_rate * channels * sizeof(float));
+        U16(static_cast<uint16_t>(channels * sizeof(float)));
+        U16(32);
+        if (info) WriteInfo(*info, sample_rate);
+        fwrite("data", 1, 4, file_);
+        data_size_offset_ = ftell(file_);
+        U32(0);  // Patched by Close()
+        return !ferror(file_);
+    }
+
+    // `frames` interleaved frames
+    bool Write(const float* interleaved, size_t frames) {
+        if (!file_) return false;
+        if (fwrite(interleaved, sizeof(float) * channels_, frames, file_) != frames) failed_ = true;
+        frames_ += frames;
+        return !failed_;
+    }
+
+    // One pointer per channel
+    bool Write(const float* const* channels, size_t frames) {
+        float block[kBlockFrames * kMaxChannels];
+        for (size_t done = 0; done < frames;) {
+            size_t count = frames - done < kBlockFrames ? frames - done : kBlockFrames;
+            for (size_t i = 0; i < count; i++) {
+                for (uint16_t c = 0; c < channels_; c++) {
+                    block[i * channels_ + c] = channels[c][done + i];
+                }
+            }
+            if (!Write(block, count)) return false;
+            done += count;
+        }
+        return true;
+    }
+
+    // Patches the sizes; false if any write failed
+    bool Close() {
+        if (!file_) return !failed_;
+        uint32_t data_bytes = static_cast<uint32_t>(frames_ * channels_ * sizeof(float));
+        long riff_bytes = ftell(file_) - 8;
+        if (fseek(file_, 4, SEEK_SET) == 0) U32(static_cast<uint32_t>(riff_bytes));
+        if (fseek(file_, data_size_offset_, SEEK_SET) == 0) U32(data_bytes);
+        if (ferror(file_)) failed_ = true;
+        if (fclose(file_) != 0) failed_ = true;
+        file_ = nullptr;
+        return !failed_;
+    }
+
+    bool IsOpen() const { return file_ != nullptr; }
+    uint64_t GetFrameCount() const { return frames_; }
+
+private:
+    static constexpr size_t kBlockFrames = 256;
+
+    FILE* file_;
+    uint16_t channels_;
+    uint64_t frames_;
+    long data_size_offset_;
+    bool failed_;
+
+    void U32(uint32_t v) { fwrite(&v, 4, 1, file_); }
+    void U16(uint16_t v) { fwrite(&v, 2, 1, file_); }
+
+    // Zero-terminated, padded to an even size
+    static uint32_t TextSize(const char* text) { return (static_cast<uint32_t>(strlen(text)) + 2) & ~1u; }
+
+    void Text(const char* id, const char* text) {
+        if (!text) return;
+        uint32_t size = TextSize(text);
+        fwrite(id, 1, 4, file_);
+        U32(size);
+        fwrite(text, 1, strlen(text), file_);
+        for (uint32_t i = static_cast<uint32_t>(strlen(text)); i < size; i++) fputc(0, file_);
+    }
+
+    void WriteInfo(const WavInfo& info, uint32_t sample_rate) {
+        if (info.root_key >= 0) {
+            fwrite("smpl", 1, 4, file_);
+            U32(36);
+            U32(0);                                 // Manufacturer
+            U32(0);                                 // Product
+            U32(1000000000u / sample_rate);         // Sample period, ns
+            U32(static_cast<uint32_t>(info.root_key));
+            U32(0);                                 // Pitch fraction
+            U32(0);                                 // SMPTE format
+            U32(0);                                 // SMPTE offset
+            U32(0);                                 // Loops
+            U32(0);                                 // Sampler data
+        }
+        uint32_t size = 4;
+        for (const char* text : {info.name, info.comment, info.software}) {
+            if (text) size += 8 + TextSize(text);
+        }
+        if (size == 4) return;
+        fwrite("LIST", 1, 4, file_);
+        U32(size);
+        fwrite("INFO", 1, 4, file_);
+        Text("INAM", info.name);
+        Text("ICMT", info.comment);
+        Text("ISFT", info.software);
+    }
+};
+
+// Whole-file WAV reader for analysis: PCM 16/24/32-bit or 32-bit float,
+// mixed down to mono. False for other formats or a malformed file.
+inline bool ReadWavMono(const char* path, std::vector<float>& samples, uint32_t& sample_rate) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;) data.insert(data.end(), chunk, chunk + n);
+    fclose(file);
+    if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0) return false;
+
+    auto u16 = [&](size_t at) { return static_cast<uint16_t>(data[at] | data[at + 1] << 8); };
+    auto u32 = [&](size_t at) { return static_cast<uint32_t>(u16(at) | u16(at + 2) << 16); };
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    const uint8_t* pcm = nullptr;
+    size_t pcm_bytes = 0;
+    for (size_t at = 12; at + 8 <= data.size();) {
+        uint32_t size = u32(at + 4);
+        size_t body = at + 8;
+        if (size > data.size() - body) size = static_cast<uint32_t>(data.size() - body);
+        if (memcmp(&data[at], "fmt ", 4) == 0 && size >= 16) {
+            format = u16(body);
+            channels = u16(body + 2);
+            sample_rate = u32(body + 4);
+            bits = u16(body + 14);
+            if (format == 0xFFFE && size >= 26) format = u16(body + 24);  // WAVE_FORMAT_EXTENSIBLE
+        } else if (memcmp(&data[at], "data", 4) == 0) {
+            pcm = &data[body];
+            pcm_bytes = size;
+        }
+        at = body + size + (size & 1);
+    }
+    bool is_float = format == 3 && bits == 32;
+    bool is_pcm = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+    if (!pcm || channels == 0 || sample_rate == 0 || !(is_float || is_pcm)) return false;
+
+    size_t width = bits / 8;
+    size_t frames = pcm_bytes / (width * channels);
+    samples.assign(frames, 0.0f);
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (uint16_t c = 0; c < channels; c++) {
+            const uint8_t* p = pcm + (i * channels + c) * width;
+            if (is_float) {
+                float value;
+                memcpy(&value, p, 4);
+                sum += value;
+            } else {
+                int32_t value = 0;
+                for (size_t b = 0; b < width; b++) value |= static_cast<int32_t>(p[b]) << (8 * (4 - width + b));
+                sum += static_cast<float>(value) / 2147483648.0f;  // Left-aligned to 32 bits
+            }
+        }
+        samples[i] = sum / channels;
+    }
+    return true;
+}
+
+} // namespace mutables_host
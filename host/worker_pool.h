@@ -0,0 +1,174 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace mutables_host {
+
+// Runs independent jobs on all cores for the batch renderers.
+//
+// Workers are forked processes, not threads: the eurorack DSP keeps
+// process-wide state (stmlib::Random), which threads would share and race
+// on. Each worker has its own copy, so a job that seeds it at its start
+// renders the same samples on any worker and with any worker count.
+//
+// Scheduling is work stealing. Each worker starts with a contiguous range
+// of job indices and takes jobs from its front. A worker whose range is
+// empty steals the back half of the largest range left. Jobs of similar
+// cost should be adjacent, longest first. Results come back through
+// Share()d memory or files.
+class WorkerPool {
+public:
+    // 0: one worker per hardware thread
+    explicit WorkerPool(int workers = 0) : steals_(0) {
+        workers_ = workers > 0 ? workers : static_cast<int>(std::thread::hardware_concurrency());
+        if (workers_ < 1) workers_ = 1;
+    }
+
+    ~WorkerPool() {
+        for (const Mapping& mapping : mappings_) munmap(mapping.address, mapping.size);
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int GetWorkerCount() const { return workers_; }
+
+    // Ranges taken from another worker during the last Run()
+    uint32_t GetStealCount() const { return steals_; }
+
+    // `count` value-initialized T visible to the workers and the caller,
+    // for results. Allocate before Run(); nullptr if the mapping fails.
+    template <typename T>
+    T* Share(size_t count) {
+        void* address = Map(count * sizeof(T));
+        if (!address) return nullptr;
+        T* items = static_cast<T*>(address);
+        for (size_t i = 0; i < count; i++) new (&items[i]) T();
+        return items;
+    }
+
+    // Calls job(index, worker) once for every index in [0, count); job
+    // returns false on failure. False if any job failed or a worker died.
+    // With one worker the jobs run in the calling process.
+    template <typename Job>
+    bool Run(size_t count, Job job) {
+        steals_ = 0;
+        if (workers_ == 1 || count <= 1) {
+            bool ok = true;
+            for (size_t i = 0; i < count; i++) ok = job(i, 0) && ok;
+            return ok;
+        }
+        if (count > UINT32_MAX) return false;
+
+        // One (begin, end) range per worker, then the steal and done counts
+        auto shared = static_cast<std::atomic<uint64_t>*>(Map((workers_ + 2) * sizeof(std::atomic<uint64_t>)));
+        if (!shared) return false;
+        std::atomic<uint64_t>* ranges = shared;
+        std::atomic<uint64_t>& steals = shared[workers_];
+        std::atomic<uint64_t>& done = shared[workers_ + 1];
+        for (int w = 0; w < workers_; w++) {
+            uint32_t begin = static_cast<uint32_t>(count * w / workers_);
+            uint32_t end = static_cast<uint32_t>(count * (w + 1) / workers_);
+            new (&ranges[w]) std::atomic<uint64_t>(Pack(begin, end));
+        }
+        new (&steals) std::atomic<uint64_t>(0);
+        new (&done) std::atomic<uint64_t>(0);
+
+        fflush(nullptr);  // Nothing buffered may be written twice
+        std::vector<pid_t> children;
+        for (int w = 0; w < workers_; w++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                bool ok = true;
+                for (uint32_t i; Next(ranges, w, steals, i);) {
+                    ok = job(i, w) && ok;
+                    done.fetch_add(1);
+                }
+                fflush(nullptr);
+                _exit(ok ? 0 : 1);
+            }
+            if (pid < 0) {
+                perror("fork");
+                break;
+            }
+            children.push_back(pid);
+        }
+
+        bool ok = !children.empty();
+        for (pid_t pid : children) {
+            int status = 0;
+            if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+        }
+        steals_ = static_cast<uint32_t>(steals.load());
+        return ok && done.load() == count;
+    }
+
+private:
+    struct Mapping {
+        void* address;
+        size_t size;
+    };
+
+    int workers_;
+    uint32_t steals_;
+    std::vector<Mapping> mappings_;
+
+    static uint64_t Pack(uint32_t begin, uint32_t end) { return static_cast<uint64_t>(begin) << 32 | end; }
+    static uint32_t Begin(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+    static uint32_t End(uint64_t range) { return static_cast<uint32_t>(range); }
+
+    // Next job of `worker`: the front of its range, else of a stolen one.
+    // False when every range is empty.
+    bool Next(std::atomic<uint64_t>* ranges, int worker, std::atomic<uint64_t>& steals, uint32_t& job) {
+        for (;;) {
+            uint64_t range = ranges[worker].load();
+            while (Begin(range) < End(range)) {
+                if (ranges[worker].compare_exchange_weak(range, Pack(Begin(range) + 1, End(range)))) {
+                    job = Begin(range);
+                    return true;
+                }
+            }
+
+            // Largest victim; a failed steal (the owner or another thief
+            // got there first) looks again
+            int victim = -1;
+            uint64_t victim_range = 0;
+            for (int w = 0; w < workers_; w++) {
+                uint64_t other = ranges[w].load();
+                uint32_t size = End(other) > Begin(other) ? End(other) - Begin(other) : 0;
+                if (w != worker && size > 0 && (victim < 0 || size > End(victim_range) - Begin(victim_range))) {
+                    victim = w;
+                    victim_range = other;
+                }
+            }
+            if (victim < 0) return false;
+            uint32_t begin = Begin(victim_range);
+            uint32_t end = End(victim_range);
+            uint32_t middle = begin + (end - begin) / 2;  // The victim keeps [begin, middle)
+            if (ranges[victim].compare_exchange_strong(victim_range, Pack(begin, middle))) {
+                steals.fetch_add(1);
+                // Only this worker refills its own empty range
+                ranges[worker].store(Pack(middle, end));
+            }
+        }
+    }
+
+    void* Map(size_t size) {
+        if (size == 0) size = 1;
+        void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) return nullptr;
+        mappings_.push_back(Mapping{address, size});
+        return address;
+    }
+};
+
+} // namespace mutables_host
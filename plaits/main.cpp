@@ -4,7 +4,24 @@
 #include "../common/parameter.h"
 #include "../common/ui_state.h"
 #include "../common/cv_input.h"
+#include "../common/command_queue.h"
 #include "../common/display.h"
+#include "../common/edit_history.h"
+#include "../common/fatfs_file_system.h"
+#include "../common/module_chain.h"
+#include "../common/module_event.h"
+#include "../common/module_registry.h"
+#include "../common/param_snapshot.h"
+#include "../common/preset_bank.h"
+#include "../common/preset_manager.h"
+#include "../common/preset_morph.h"
+#include "../common/profiler.h"
+#include "../common/qspi_flash_region.h"
+#include "../common/refresh_scheduler.h"
+#include "../common/spectrum_analyzer.h"
+#include "../common/state_store.h"
+#include "../common/sysex.h"
+#include <atomic>
 
 using namespace daisy;
 using namespace daisysp;
@@ -14,24 +31,232 @@ using namespace mutables_plaits;
 // Hardware
 DaisyPatch hw;
 
-// Module
-PlaitsPort plaits_module;
+// Modules in the image, picked from the Module row. The active module is
+// slot 0 of the chain and owns MIDI notes, presets and the saved state;
+// the Module row on a later page replaces, adds or removes the modules
+// after it. All of them are rebuilt in memory regions reset on every
+// change, get the gate and CV, and get a UI page each.
+const ModuleEntry MODULES[] = {
+    MakeModuleEntry<PlaitsPort>("Plaits", "plaits"),
+};
+
+// Active module outputs to jacks (channel, jack, gain): the first two
+// outputs (Plaits OUT/AUX) to OUT 1/2
+const ModuleChain::OutputRoute OUTPUT_ROUTES[] = {
+    {0, 0, 1.0f},
+    {1, 1, 1.0f},
+};
+
+// The first two outputs of every module after it, summed into OUT 3/4.
+// Silent while the chain holds the active module only.
+const ModuleChain::OutputRoute EXTRA_ROUTES[] = {
+    {0, 2, 1.0f},
+    {1, 3, 1.0f},
+};
+
+// Module memory per region (see arena.h). The stack lives at the top of
+// DTCM, so its arena leaves room for it.
+const size_t DTCM_ARENA_SIZE = 80 * 1024;
+const size_t SRAM_ARENA_SIZE = 64 * 1024;
+const size_t SDRAM_ARENA_SIZE = 8 * 1024 * 1024;
+alignas(32) uint8_t DTCM_MEM_SECTION dtcm_memory[DTCM_ARENA_SIZE];
+alignas(32) uint8_t sram_memory[SRAM_ARENA_SIZE];
+alignas(32) uint8_t DSY_SDRAM_BSS sdram_memory[SDRAM_ARENA_SIZE];
+MemoryRegions module_memory;
+ModuleSwitcher modules;
+ModuleBase* active_module = nullptr;
+ModuleChain chain;
+std::atomic<int> live_page(0);  // Page whose effective values are published
 
 // UI
 MenuState menu;
 Display display;
 CVInputBank cv_inputs;
+SpectrumAnalyzer spectrum;
+RefreshScheduler refresh;
+
+// Preset slots in the last 512KB of QSPI, recalled by MIDI program change
+const uint32_t PRESET_FLASH_OFFSET = 0x780000;
+const size_t PRESET_FLASH_SIZE = 0x80000;
+QspiFlashRegion preset_flash;
+PresetBank preset_bank;
+
+// Current parameter state, restored before audio starts and logged to a
+// wear-leveled QSPI region with write-behind (see state_store.h)
+const uint32_t STATE_FLASH_OFFSET = 0x770000;
+const size_t STATE_FLASH_SIZE = 0x10000;
+const uint32_t STATE_CHECK_MS = 250;
+QspiFlashRegion state_flash;
+StateStore state_store;
+static_assert(STATE_FLASH_OFFSET + STATE_FLASH_SIZE <= PRESET_FLASH_OFFSET, "Flash areas overlap");
+bool flash_writable = false;  // Set by the boot check
+PresetRecord state_record;
+uint32_t state_check_time = 0;
+
+#ifdef MUTABLES_XIP_QSPI
+// Load image end in QSPI: .data is the last section stored there, at
+// _sidata (libDaisy linker script)
+extern "C" uint32_t _sidata, _sdata, _edata;
+#endif
+
+// Writing the reserved areas must not hit the running firmware: the image
+// has to end below the state area (the lowest), and on XIP builds the
+// QspiXip routines have to be linked into RAM
+bool FlashWritesSafe() {
+#ifdef MUTABLES_XIP_QSPI
+    uintptr_t image_end = reinterpret_cast<uintptr_t>(&_sidata)
+                        + (reinterpret_cast<uintptr_t>(&_edata) - reinterpret_cast<uintptr_t>(&_sdata));
+    return image_end <= QspiFlashRegion::kMappedBase + STATE_FLASH_OFFSET && QspiXip::InRam();
+#else
+    return true;
+#endif
+}
+
+// Consecutive audio blocks with silent outputs. With APP_TYPE = BOOT_QSPI
+// the firmware executes from the QSPI chip, so state writes wait for 1 s
+// of silence and run with audio stopped.
+const float SILENCE_LEVEL = 0.0001f;  // -80 dBFS
+const uint32_t STATE_SILENT_BLOCKS = 2000;
+std::atomic<uint32_t> silent_blocks(0);
+
+// Boot splash, shown while audio already runs until timeout or first input
+const uint32_t BOOT_SPLASH_MS = 2800;
+bool boot_splash = true;
+uint32_t boot_splash_start = 0;
+
+// Time to first sound: the seed LED (PC7) goes high on the first audio
+// block, for a scope against reset; the System::GetUs() value goes to the
+// profiler
+volatile uint32_t first_audio_us = 0;
+
+// SD card presets, advanced a step at a time from the main loop
+SdmmcHandler sdcard;
+FatFSInterface fsi;
+FatFsFileSystem sd_fs;
+PresetManager preset_manager;
+bool preset_result_seen = false;
+uint32_t preset_result_time = 0;
+const uint32_t PRESET_RESULT_MS = 1000;
+
+// Preset morph: CC 1 morphs between preset slots 0 and 1 (X axis), CC 2
+// adds the Y axis over slots 2 and 3 when both are stored. Any preset load
+// ends the morph. An axis can follow a CV input instead (0-3, -1 = none);
+// moving it starts the morph like the CC. Unmap the parameter that input
+// drives, since the knob and CV are one ADC reading.
+// The audio callback switches the morph on and off through param_commands;
+// morph_requested is the main loop's view, including queued commands.
+const uint8_t MORPH_CC_X = 1;
+const uint8_t MORPH_CC_Y = 2;
+const int MORPH_CV_X = -1;
+const int MORPH_CV_Y = -1;
+const float MORPH_CV_MOVE = 0.02f;      // CV change that starts the morph
+PresetMorph preset_morph;
+bool morph_requested = false;
+std::atomic<bool> morph_cv_moved(false);
+float morph_cv_start[2] = {-1.0f, -1.0f};  // Audio callback: CV when last started
+
+// SysEx dump/restore of the state and preset slots (see sysex.h). Outgoing
+// bytes go through a TX ring drained at the UART rate, a few bytes per
+// main loop iteration so the blocking send stays short.
+const int SYSEX_MESSAGES_PER_TICK = 2;
+const uint32_t MIDI_TX_BYTES_PER_MS = 3;  // 31250 baud
+const size_t MIDI_TX_MAX_BURST = 8;
+const size_t MIDI_TX_SIZE = 1024;
+SysexDumper sysex_dumper;
+SysexReceiver sysex_receiver;
+SpscQueue<uint8_t, MIDI_TX_SIZE> midi_tx;
+bool sysex_store_pending = false;
+uint32_t midi_tx_time = 0;
+
+// Parameter changes applied by the audio callback at the next block start,
+// and the preset copies LoadPreset commands point to
+SpscQueue<ParamCommand, 32> param_commands;
+PresetPool<4> preset_copies;
+
+// Notes from the main loop, and the event list the audio callback builds
+// from them, parameter commands and the gate input for each block
+SpscQueue<ModuleEvent, 32> note_events;
+EventBuffer<64> block_events;
+
+// Encoder edits, undone/redone through param_commands
+EditHistory<512> edit_history;
+// Value being edited: sent as param_commands, since only the audio
+// callback writes parameter values
+float edit_value = 0.0f;
+
+// Effective (post-modulation) values published by the audio callback
+ParamSnapshot live_snapshot;
+float live_values[kMaxParameters];
+size_t live_value_count = 0;
+
+// Audio callback load, used to size idle-time work
+CpuLoadMeter cpu_meter;
+
+// Profiling counters, printed over the USB log in PROFILE=1 builds
+Profiler profiler;
+int prof_display_us = -1;
+int prof_display_saved_ms = -1;
+int prof_display_skipped = -1;
+int prof_morph = -1;
+int prof_boot_audio = -1;
+int prof_state_writes = -1;
+int prof_state_erases = -1;
+int prof_module_switch = -1;
+int prof_region_bytes[MemoryRegions::kCount] = {-1, -1, -1};
+int prof_alloc_fails = -1;
+int prof_module_ticks[ModuleChain::kMaxModules] = {-1, -1, -1, -1};
 
 // Encoder state
 bool encoder_button_last = false;
+bool skip_release = false;  // Release of the press that opened a page
 uint32_t encoder_press_time = 0;
 const uint32_t LONG_PRESS_MS = 500;
 
-// Audio buffers
-float* audio_in[4];
-float* audio_out[4];
+// Module shown on the current UI page
+ModuleBase* PageModule() {
+    return chain.GetModule(menu.module_page);
+}
+
+// Edit history entries carry the page in the index above kMaxParameters
+uint8_t HistoryIndex(int page, int param) {
+    return static_cast<uint8_t>(page * kMaxParameters + param);
+}
+
+void ApplyParamCommands() {
+    ParamCommand command;
+    while (param_commands.Pop(command)) {
+        switch (command.type) {
+            case ParamCommand::Type::SetValue:
+                // An edit during a morph takes the parameter out of it
+                if (chain.GetModule(command.module) == active_module) {
+                    preset_morph.Hold(command.index);
+                }
+                block_events.Add(ModuleEvent::SetParameter(0, command.index, command.value, command.module));
+                break;
+            case ParamCommand::Type::SetMorph:
+                preset_morph.SetEnabled(command.value != 0.0f);
+                break;
+            case ParamCommand::Type::LoadPreset:
+                PresetApply(*command.preset, active_module->GetParameters(),
+                            active_module->GetParameterCount());
+                active_module->OnParametersLoaded();
+                preset_copies.Release(command.preset);
+                break;
+        }
+    }
+}
 
 void AudioCallback(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, size_t size) {
+    cpu_meter.OnBlockStart();
+    
+    // Preset recalls and other queued changes land on a block boundary
+    block_events.Clear();
+    ApplyParamCommands();
+    ModuleEvent note;
+    while (note_events.Pop(note)) {
+        block_events.Add(note);
+    }
+    
     // Update CV inputs (knobs + CV)
     // DaisyPatch knobs are indexed 0-3, CV inputs are on ADC channels 0-3
     float cv1 = hw.GetKnobValue(DaisyPatch::CTRL_1);
@@ -46,43 +271,212 @@ void AudioCallback(AudioHandle::InputBuffer in, AudioHandle::OutputBuffer out, s
         std::clamp(cv4, 0.0f, 1.0f)
     );
     
-    // Update parameters from CV mappings
-    auto params = plaits_module.GetParameters();
-    size_t param_count = plaits_module.GetParameterCount();
-    for (size_t i = 0; i < param_count; i++) {
-        auto& param = params[i];
-        if (param.cv_mapping.active && param.cv_mapping.cv_input >= 0) {
-            // Read actual hardware knob position (knob + CV on DaisyPatch)
-            // Filtering is already applied in cv_inputs.GetFiltered()
-            float knob_value = cv_inputs.GetFiltered(param.cv_mapping.cv_input);
-            // Use minimal hysteresis to prevent noise (0.1% threshold)
-            param.SetNormalizedWithHysteresis(knob_value, 0.001f);
+    // Update parameters from CV mappings, on every module
+    if (chain.ApplyCv(cv_inputs)) {
+        refresh.NotifyActivityFromAudio();
+    }
+    
+    // Morph axes assigned to a CV follow it; moving one asks the main loop
+    // to start the morph
+    const int morph_cv[2] = {MORPH_CV_X, MORPH_CV_Y};
+    for (int axis = 0; axis < 2; axis++) {
+        if (morph_cv[axis] < 0) continue;
+        float position = cv_inputs.GetFiltered(morph_cv[axis]);
+        if (axis == 0) preset_morph.SetX(position);
+        else preset_morph.SetY(position);
+        if (morph_cv_start[axis] < 0.0f || preset_morph.IsEnabled()) {
+            morph_cv_start[axis] = position;
+        } else if (std::abs(position - morph_cv_start[axis]) >= MORPH_CV_MOVE) {
+            morph_cv_start[axis] = position;
+            morph_cv_moved.store(true, std::memory_order_relaxed);
+        }
+    }
+    
+    // Preset morph drives the set value of every parameter of the active
+    // module not following a CV, unless the user has edited it since the
+    // morph started
+    if (preset_morph.IsEnabled()) {
+        auto params = active_module->GetParameters();
+        size_t param_count = active_module->GetParameterCount();
+        uint32_t start = System::GetTick();
+        float morphed[kMaxParameters];
+        bool switched = preset_morph.Process(morphed);
+        size_t morph_count = std::min(param_count, preset_morph.GetCount());
+        for (size_t i = 0; i < morph_count; i++) {
+            bool follows_cv = params[i].cv_mapping.active && params[i].cv_mapping.cv_input >= 0;
+            if (!follows_cv && !preset_morph.IsHeld(i)) {
+                params[i].value = morphed[i];
+            }
         }
+        if (switched) {
+            active_module->OnParametersLoaded();
+        }
+        profiler.Record(prof_morph, System::GetTick() - start);
     }
     
-    // Process gate inputs
-    plaits_module.ProcessGate(0, hw.gate_input[0].State());
+    // Gate input level, to every module
+    block_events.Add(ModuleEvent::Gate(0, 0, hw.gate_input[0].State()));
     
-    // Setup audio pointers
-    for (size_t i = 0; i < 4; i++) {
-        audio_in[i] = (float*)in[i];
-        audio_out[i] = out[i];
+    // Process audio: modules render into the routed jacks, the rest are
+    // cleared by the chain
+    chain.Process(block_events.GetList(), in, out, size);
+    for (int m = 0; m < chain.GetModuleCount(); m++) {
+        profiler.Record(prof_module_ticks[m], chain.GetStats(m).last_ticks);
     }
     
-    // Clear all outputs first
+    // Publish what the DSP actually used this block for the display
+    float effective[kMaxParameters];
+    size_t effective_count = chain.GetEffectiveValues(live_page.load(std::memory_order_relaxed),
+                                                      effective, kMaxParameters);
+    live_snapshot.Publish(effective, effective_count);
+    
+    // Feed the spectrum page (copy only, analysis runs in the main loop)
+    spectrum.Capture(out[0], size);
+    
+    float peak = 0.0f;
     for (size_t i = 0; i < size; i++) {
-        out[0][i] = 0.0f;
-        out[1][i] = 0.0f;
-        out[2][i] = 0.0f;
-        out[3][i] = 0.0f;
+        peak = std::max(peak, std::max(std::abs(out[0][i]), std::abs(out[1][i])));
     }
+    uint32_t silent = silent_blocks.load(std::memory_order_relaxed);
+    silent_blocks.store(peak < SILENCE_LEVEL ? silent + 1 : 0, std::memory_order_relaxed);
     
-    // Process audio - Plaits writes to audio_out[0] and audio_out[1]
-    plaits_module.Process(audio_in, audio_out, size);
+    if (first_audio_us == 0) {
+        first_audio_us = System::GetUs();
+        hw.seed.SetLed(true);
+    }
+    
+    cpu_meter.OnBlockEnd();
+}
+
+// Show a module's parameter page, from its first or its last row
+void ShowModulePage(int page, bool forward) {
+    menu.EnterPage(page, chain.GetModule(page)->GetParameterCount(), forward);
+    live_page.store(page, std::memory_order_relaxed);
+    live_value_count = 0;  // Until the audio callback publishes this page
+}
+
+// Apply the state logged by UpdateLastState(), before audio starts
+bool RestoreLastState() {
+    const PresetRecord* record = state_store.Get();
+    if (!record) return false;
+    PresetApply(*record, active_module->GetParameters(), active_module->GetParameterCount());
+    active_module->OnParametersLoaded();
+    return true;
+}
+
+// Boot into the module whose state was logged last
+int LastModuleIndex() {
+    state_store.Init(&state_flash, 0);  // Any module
+    const PresetRecord* record = state_store.Get();
+    for (size_t i = 0; record && i < modules.GetCount(); i++) {
+        if (ModuleTag(modules.GetShortName(i)) == record->module_tag) {
+            return static_cast<int>(i);
+        }
+    }
+    return 0;
+}
+
+// Route the rebuilt chain's outputs to the jacks and record the build
+void RouteChain() {
+    chain.SetRoutes(0, OUTPUT_ROUTES, sizeof(OUTPUT_ROUTES) / sizeof(OUTPUT_ROUTES[0]));
+    for (int slot = 1; slot < chain.GetModuleCount(); slot++) {
+        chain.SetRoutes(slot, EXTRA_ROUTES, sizeof(EXTRA_ROUTES) / sizeof(EXTRA_ROUTES[0]));
+    }
+    profiler.Record(prof_module_switch, modules.GetSwitchTicks() / (System::GetTickFreq() / 1000000));
+    for (int r = 0; r < MemoryRegions::kCount; r++) {
+        profiler.Set(prof_region_bytes[r], module_memory.Get(static_cast<MemoryRegion>(r)).GetUsed());
+    }
+    profiler.Set(prof_alloc_fails, module_memory.GetFailedCount());
+}
+
+// Build the chain with a module in slot 0, with audio stopped. On failure
+// (out of memory) the previous chain is back.
+bool InstallModule(int index) {
+    ModuleBase* module = modules.Activate(index);
+    active_module = modules.GetActive();
+    RouteChain();
+    return module != nullptr;
+}
+
+// Point the state log, preset slots, SysEx and the UI at the active module
+// and restore its last state
+void BindModule() {
+    uint32_t tag = ModuleTag(active_module->GetShortName());
+    state_store.Init(&state_flash, tag);
+    preset_bank.Init(&preset_flash, tag);
+    sysex_receiver.Init(tag);
+    preset_morph.SetEnabled(false);  // Audio is stopped
+    morph_requested = false;
+    preset_morph.Init(active_module->GetParameters(), active_module->GetParameterCount());
+    edit_history.Clear();
+    menu.module_count = chain.GetModuleCount();
+    ShowModulePage(0, true);
+    RestoreLastState();
+}
+
+// Replace the active module. Not while SD preset I/O is in flight, it
+// works on the old module's presets.
+void SwitchModule(int index) {
+    if (index == modules.GetActiveIndex() || preset_manager.IsBusy()) return;
+    hw.StopAudio();
+    if (InstallModule(index)) {
+        BindModule();
+        preset_manager.Init(&sd_fs, active_module->GetShortName());
+        preset_manager.BeginLoadIndex();
+    }
+    hw.StartAudio(AudioCallback);
+}
+
+// Module list choice on a page after the first: replace that slot's
+// module, remove it, or add one (any page) after the last slot. The
+// active module keeps its values, presets and state log; the chain's
+// pages move, so edit history and a running morph are dropped.
+void EditChain(int page, int row) {
+    hw.StopAudio();
+    bool changed;
+    int show = page;
+    if (menu.IsRemoveModuleRow(row)) {
+        changed = modules.RemoveSlot(page);
+        show = page - 1;
+    } else if (menu.IsAddModuleRow(row)) {
+        show = modules.GetSlotCount();
+        changed = modules.SetSlot(show, menu.ModuleRowEntry(row));
+    } else {
+        changed = modules.SetSlot(page, menu.ModuleRowEntry(row));
+    }
+    active_module = modules.GetActive();
+    RouteChain();
+    preset_morph.SetEnabled(false);  // Audio is stopped
+    morph_requested = false;
+    preset_morph.Init(active_module->GetParameters(), active_module->GetParameterCount());
+    edit_history.Clear();
+    menu.module_count = chain.GetModuleCount();
+    ShowModulePage(changed ? show : std::min(page, menu.module_count - 1), true);
+    hw.StartAudio(AudioCallback);
+}
+
+// Flash erase/program from the main loop, refused if the boot check found
+// the reserved areas unsafe to write. On XIP builds audio stops for the
+// operation: QspiXip masks interrupts for each sector erase, which would
+// stall the callback that long. MIDI bytes arriving meanwhile wait in the
+// UART; a SysEx restore sends the next slot only after the ack.
+// Otherwise audio keeps running: it only applies copies of preset records,
+// never reads QSPI itself.
+template <typename Op>
+bool RunFlashWrite(Op op) {
+    if (!flash_writable) return false;
+#ifdef MUTABLES_XIP_QSPI
+    hw.StopAudio();
+    bool ok = op();
+    hw.StartAudio(AudioCallback);
+    return ok;
+#else
+    return op();
+#endif
 }
 
 void UpdateEncoder() {
-    auto params = plaits_module.GetParameters();
+    auto params = PageModule()->GetParameters();
     int encoder_increment = hw.encoder.Increment();
     bool encoder_button = hw.encoder.RisingEdge();
     bool encoder_held = hw.encoder.Pressed();
@@ -92,28 +486,90 @@ void UpdateEncoder() {
         encoder_press_time = System::GetNow();
     }
     
+    bool released = !encoder_held && encoder_button_last;
     bool long_press = false;
-    if (!encoder_held && encoder_button_last) {
+    if (released) {
         long_press = (System::GetNow() - encoder_press_time) > LONG_PRESS_MS;
     }
     
+    bool skip = released && skip_release;
+    if (released) skip_release = false;
+    if (skip) long_press = false;
+    bool short_release = released && !long_press && !skip;
+    
+    if (encoder_increment != 0 || encoder_button || encoder_held != encoder_button_last) {
+        refresh.NotifyActivity(System::GetNow());
+    }
+    
     encoder_button_last = encoder_held;
     
     // Handle encoder based on state
     switch (menu.state) {
         case UIState::Navigate:
-            if (encoder_increment > 0) menu.NextParam();
-            if (encoder_increment < 0) menu.PrevParam();
+            // Scrolling past either end of the list shows the next module
+            // page, after the last one the spectrum page
+            if (encoder_increment > 0) {
+                if (menu.selected_param == menu.RowCount() - 1) {
+                    if (menu.HasPage(true)) {
+                        ShowModulePage(menu.module_page + 1, true);
+                    } else {
+                        menu.EnterSpectrum();
+                    }
+                    break;
+                }
+                menu.NextParam();
+            }
+            if (encoder_increment < 0) {
+                if (menu.selected_param == 0) {
+                    if (menu.HasPage(false)) {
+                        ShowModulePage(menu.module_page - 1, false);
+                    } else {
+                        menu.EnterSpectrum();
+                    }
+                    break;
+                }
+                menu.PrevParam();
+            }
             
             if (encoder_button && !long_press) {
-                menu.state = UIState::EditValue;
-            } else if (long_press) {
+                if (menu.IsSaveRow(menu.selected_param)) {
+                    menu.BeginNameEntry();
+                    skip_release = true;
+                } else if (menu.IsUndoRow(menu.selected_param)
+                           || menu.IsRedoRow(menu.selected_param)) {
+                    uint8_t index;
+                    float value;
+                    bool undo = menu.IsUndoRow(menu.selected_param);
+                    if (undo ? edit_history.Undo(index, value) : edit_history.Redo(index, value)) {
+                        param_commands.Push(ParamCommand::SetValue(
+                            index % kMaxParameters, value, index / kMaxParameters));
+                    }
+                } else if (menu.IsSlotRow(menu.selected_param)) {
+                    menu.BeginSlotSelect();
+                    skip_release = true;
+                } else if (menu.IsModuleRow(menu.selected_param)) {
+                    menu.BeginModuleSelect(modules.GetSlotIndex(menu.module_page),
+                                           static_cast<int>(modules.GetCount()),
+                                           modules.GetSlotCount() < ModuleSwitcher::kMaxSlots,
+                                           menu.module_page > 0);
+                    skip_release = true;
+                } else if (menu.IsLoadRow(menu.selected_param)) {
+                    if (!preset_manager.GetIndex().IsValid()) {
+                        preset_manager.BeginLoadIndex();  // Card inserted after boot
+                    }
+                    menu.BeginLoadBrowser();
+                    skip_release = true;
+                } else {
+                    edit_value = params[menu.selected_param].value;
+                    menu.state = UIState::EditValue;
+                }
+            } else if (long_press && menu.IsParamRow(menu.selected_param)) {
                 menu.EnterSubmenu(menu.selected_param);
             }
             break;
             
         case UIState::EditValue: {
-            auto& param = params[menu.selected_param];
+            const auto& param = params[menu.selected_param];
             
             if (encoder_increment != 0) {
                 float step = 0.01f;
@@ -121,11 +577,15 @@ void UpdateEncoder() {
                     step = 1.0f;
                 }
                 
-                param.value += encoder_increment * step;
-                param.value = std::clamp(param.value, param.min, param.max);
+                float old_value = edit_value;
+                edit_value = std::clamp(edit_value + encoder_increment * step, param.min, param.max);
+                param_commands.Push(ParamCommand::SetValue(menu.selected_param, edit_value, menu.module_page));
+                edit_history.Record(HistoryIndex(menu.module_page, menu.selected_param),
+                                    old_value, edit_value);
             }
             
             if (encoder_button) {
+                edit_history.Seal();
                 menu.state = UIState::Navigate;
             }
             break;
@@ -141,36 +601,319 @@ void UpdateEncoder() {
         case UIState::SubmenuEdit:
             // TODO: Implement submenu editing
             break;
+            
+        case UIState::Spectrum:
+            if (encoder_increment > 0) ShowModulePage(0, true);
+            if (encoder_increment < 0) ShowModulePage(menu.module_count - 1, false);
+            break;
+            
+        case UIState::SaveName:
+            if (encoder_increment != 0) menu.CycleNameChar(encoder_increment);
+            if (short_release) menu.NextNameChar();
+            if (long_press) {
+                // Written in the background, progress shown by UpdateDisplay
+                PresetRecord record;
+                PresetCapture(record, menu.preset_name, ModuleTag(active_module->GetShortName()),
+                              active_module->GetParameters(), active_module->GetParameterCount());
+                preset_manager.BeginSave(menu.preset_name, record);
+                menu.state = UIState::Navigate;
+            }
+            break;
+            
+        case UIState::LoadBrowser:
+            if (encoder_increment != 0) {
+                menu.MovePreset(encoder_increment, preset_manager.GetListCount());
+            }
+            if (short_release && !preset_manager.IsBusy()) {
+                if (preset_manager.GetListCount() > 0) {
+                    preset_manager.BeginLoad(preset_manager.GetListName(menu.selected_preset));
+                }
+                menu.state = UIState::Navigate;
+            }
+            if (long_press) {
+                menu.state = UIState::Navigate;
+            }
+            break;
+            
+        case UIState::SlotSelect:
+            if (encoder_increment != 0) {
+                menu.MoveSlot(encoder_increment, preset_bank.GetSlotCount());
+            }
+            if (short_release) {
+                // Recalled by MIDI program change; slots 0-3 are the morph corners
+                char name[kPresetNameLength];
+                snprintf(name, sizeof(name), "slot %d", menu.selected_slot);
+                PresetRecord record;
+                PresetCapture(record, name, ModuleTag(active_module->GetShortName()),
+                              active_module->GetParameters(), active_module->GetParameterCount());
+                int slot = menu.selected_slot;
+                RunFlashWrite([slot, &record] { return preset_bank.Store(slot, record); });
+                menu.state = UIState::Navigate;
+            }
+            if (long_press) {
+                menu.state = UIState::Navigate;
+            }
+            break;
+            
+        case UIState::ModuleSelect:
+            if (encoder_increment != 0) {
+                menu.MoveModule(encoder_increment);
+            }
+            if (short_release) {
+                menu.state = UIState::Navigate;
+                int row = menu.selected_module;
+                if (menu.module_page == 0 && !menu.IsAddModuleRow(row)) {
+                    SwitchModule(menu.ModuleRowEntry(row));
+                } else {
+                    EditChain(menu.module_page, row);
+                }
+            }
+            if (long_press) {
+                menu.state = UIState::Navigate;
+            }
+            break;
+    }
+}
+
+// Load the morph corners from the preset slots and queue the enable.
+// Returns false if A or B is missing, or the last stop is still queued.
+bool StartMorph() {
+    if (morph_requested) return true;
+    if (preset_morph.IsEnabled()) return false;
+    
+    const PresetRecord* a = preset_bank.Get(0);
+    const PresetRecord* b = preset_bank.Get(1);
+    if (!a || !b) return false;
+    preset_morph.SetCorner(0, *a);
+    preset_morph.SetCorner(1, *b);
+    
+    const PresetRecord* c = preset_bank.Get(2);
+    const PresetRecord* d = preset_bank.Get(3);
+    if (c && d) {
+        preset_morph.SetCorner(2, *c);
+        preset_morph.SetCorner(3, *d);
+        preset_morph.SetLayout(PresetMorph::Layout::XY);
+    } else {
+        preset_morph.SetLayout(PresetMorph::Layout::Line);
+    }
+    
+    if (!param_commands.Push(ParamCommand::SetMorph(true))) return false;
+    morph_requested = true;
+    return true;
+}
+
+// Queue the end of the morph; the corners stay the audio callback's until
+// it has applied it
+void StopMorph() {
+    if (morph_requested && param_commands.Push(ParamCommand::SetMorph(false))) {
+        morph_requested = false;
+    }
+}
+
+// Queue a copy of record for the next block; false if every copy is still
+// waiting to be applied or the queue is full
+bool QueuePresetLoad(const PresetRecord& record) {
+    StopMorph();
+    const PresetRecord* copy = preset_copies.Copy(record);
+    if (!copy) return false;
+    if (!param_commands.Push(ParamCommand::LoadPreset(copy))) {
+        preset_copies.Release(copy);
+        return false;
+    }
+    return true;
+}
+
+bool QueueMidi(const uint8_t* bytes, size_t size) {
+    if (MIDI_TX_SIZE - midi_tx.Size() < size) return false;
+    for (size_t i = 0; i < size; i++) {
+        midi_tx.Push(bytes[i]);
+    }
+    return true;
+}
+
+void HandleSysex(const uint8_t* data, size_t size) {
+    uint8_t ack[kSysexAckSize];
+    switch (sysex_receiver.Parse(data, size)) {
+        case SysexReceiver::Result::DumpRequest: {
+            PresetRecord state;
+            PresetCapture(state, "state", ModuleTag(active_module->GetShortName()),
+                          active_module->GetParameters(), active_module->GetParameterCount());
+            sysex_dumper.Begin(sysex_receiver.GetRequest(), state, &preset_bank);
+            break;
+        }
+        case SysexReceiver::Result::Record:
+            if (sysex_receiver.GetTarget() == SysexTarget::State) {
+                bool ok = QueuePresetLoad(sysex_receiver.GetRecord());
+                QueueMidi(ack, SysexAck(ack, SysexTarget::State, 0, ok));
+            } else {
+                sysex_store_pending = true;  // Stored by UpdateSysex()
+            }
+            break;
+        case SysexReceiver::Result::Error:
+            QueueMidi(ack, SysexAck(ack, sysex_receiver.GetTarget(), sysex_receiver.GetSlot(), false));
+            break;
+        case SysexReceiver::Result::None:
+            break;
+    }
+}
+
+// Store a received slot, feed the dump into the TX ring, drain the ring
+void UpdateSysex(uint32_t now) {
+    uint8_t ack[kSysexAckSize];
+    if (sysex_store_pending) {
+        sysex_store_pending = false;
+        uint8_t slot = sysex_receiver.GetSlot();
+        bool ok = RunFlashWrite([slot] { return preset_bank.Store(slot, sysex_receiver.GetRecord()); });
+        QueueMidi(ack, SysexAck(ack, SysexTarget::Slot, slot, ok));
+    }
+    
+    if (sysex_dumper.IsActive() && MIDI_TX_SIZE - midi_tx.Size() >= kSysexMaxMessage) {
+        uint8_t message[kSysexMaxMessage];
+        QueueMidi(message, sysex_dumper.NextMessage(message));
+    }
+    
+    size_t budget = std::min<size_t>((now - midi_tx_time) * MIDI_TX_BYTES_PER_MS, MIDI_TX_MAX_BURST);
+    if (budget == 0) return;
+    midi_tx_time = now;
+    uint8_t bytes[MIDI_TX_MAX_BURST];
+    size_t count = 0;
+    while (count < budget && midi_tx.Pop(bytes[count])) {
+        count++;
+    }
+    if (count > 0) {
+        hw.midi.SendMessage(bytes, count);
     }
 }
 
 void ProcessMidi() {
-    // Process all pending MIDI messages from hw.midi (UART MIDI input jack)
-    while (hw.midi.HasEvents()) {
+    // Process pending MIDI messages from hw.midi (UART MIDI input jack),
+    // at most SYSEX_MESSAGES_PER_TICK SysEx chunks per call
+    int sysex_messages = 0;
+    while (hw.midi.HasEvents() && sysex_messages < SYSEX_MESSAGES_PER_TICK) {
         MidiEvent event = hw.midi.PopEvent();
         
         if (event.type == NoteOn) {
-            NoteOnEvent note = event.AsNoteOn();
-            if (note.velocity > 0) {
-                plaits_module.NoteOn(note.note, note.velocity);
-            } else {
-                // Note on with velocity 0 = note off
-                plaits_module.NoteOff(note.note, 0);
-            }
+            // Velocity 0 is a note off
+            NoteOnEvent on = event.AsNoteOn();
+            note_events.Push(on.velocity > 0 ? ModuleEvent::NoteOn(0, on.note, on.velocity)
+                                             : ModuleEvent::NoteOff(0, on.note, 0));
         } else if (event.type == NoteOff) {
-            NoteOffEvent note = event.AsNoteOff();
-            plaits_module.NoteOff(note.note, note.velocity);
+            NoteOffEvent off = event.AsNoteOff();
+            note_events.Push(ModuleEvent::NoteOff(0, off.note, off.velocity));
+        } else if (event.type == ControlChange) {
+            ControlChangeEvent cc = event.AsControlChange();
+            float position = cc.value / 127.0f;
+            if (cc.control_number == MORPH_CC_X) {
+                preset_morph.SetX(position);
+                StartMorph();
+            } else if (cc.control_number == MORPH_CC_Y) {
+                preset_morph.SetY(position);
+                StartMorph();
+            }
+        } else if (event.type == ProgramChange) {
+            // Record checked in place in QSPI, a copy applied at the next block
+            ProgramChangeEvent program = event.AsProgramChange();
+            const PresetRecord* preset = preset_bank.Get(program.program);
+            if (preset) {
+                QueuePresetLoad(*preset);
+            }
+        } else if (event.type == SystemCommon && event.sc_type == SystemExclusive) {
+            SystemExclusiveEvent sysex = event.AsSystemExclusive();
+            HandleSysex(sysex.data, sysex.length);
+            sysex_messages++;
+            if (sysex_store_pending) break;  // Record kept until stored
+        }
+    }
+}
+
+// Copy the latest effective values, returns true if any moved visibly
+bool UpdateLiveValues() {
+    float values[kMaxParameters];
+    size_t count = live_snapshot.Read(values, kMaxParameters);
+    if (count == 0) return false;
+    
+    bool changed = count != live_value_count;
+    for (size_t i = 0; i < count; i++) {
+        if (std::abs(values[i] - live_values[i]) > 0.002f) {
+            changed = true;
+        }
+        live_values[i] = values[i];
+    }
+    live_value_count = count;
+    return changed;
+}
+
+// Advance SD card preset I/O by one step and act on finished operations
+void UpdatePresets(uint32_t now) {
+    PresetManager::Status before = preset_manager.GetStatus();
+    preset_manager.Poll();
+    PresetManager::Status status = preset_manager.GetStatus();
+    if (status != before || preset_manager.IsBusy()) {
+        refresh.NotifyActivity(now);  // Progress or result to draw
+    }
+    
+    if (status == PresetManager::Status::Idle || status == PresetManager::Status::Busy) {
+        preset_result_seen = false;
+        return;
+    }
+    
+    PresetManager::Operation op = preset_manager.GetOperation();
+    if (!preset_result_seen) {
+        if (op == PresetManager::Operation::Load && status == PresetManager::Status::Done
+            && !QueuePresetLoad(preset_manager.GetLoaded())) {
+            return;  // Every copy still queued, try again next pass
         }
+        preset_result_seen = true;
+        preset_result_time = now;
+    }
+    
+    // A finished index is shown by the browser, other results for a moment
+    bool index_done = (op == PresetManager::Operation::LoadIndex || op == PresetManager::Operation::RebuildIndex)
+                   && status == PresetManager::Status::Done;
+    if (index_done || now - preset_result_time >= PRESET_RESULT_MS) {
+        preset_manager.Acknowledge();
+        refresh.NotifyActivity(now);
+    }
+}
+
+// Hand the current state to the store; it decides when to write
+void UpdateLastState(uint32_t now) {
+    if (now - state_check_time >= STATE_CHECK_MS && !preset_morph.IsEnabled()) {
+        state_check_time = now;
+        PresetCapture(state_record, "last", ModuleTag(active_module->GetShortName()),
+                      active_module->GetParameters(), active_module->GetParameterCount());
+        state_store.Submit(state_record, now);
     }
+    
+    if (!state_store.WantsWrite(now)) return;
+#ifdef MUTABLES_XIP_QSPI
+    // Audio stops during the write: only do it while the output is silent
+    if (silent_blocks.load(std::memory_order_relaxed) < STATE_SILENT_BLOCKS) return;
+#endif
+    RunFlashWrite([now] { return state_store.Poll(now, true); });
 }
 
 void UpdateDisplay() {
-    auto params = plaits_module.GetParameters();
+    auto params = PageModule()->GetParameters();
+    
+    PresetManager::Operation preset_op = preset_manager.GetOperation();
     
-    if (menu.IsInSubmenu() && menu.submenu_param_index >= 0) {
+    if (preset_op == PresetManager::Operation::Save || preset_op == PresetManager::Operation::Load) {
+        display.RenderPresetStatus(preset_manager);
+    } else if (menu.state == UIState::Spectrum) {
+        display.RenderSpectrum(spectrum);
+    } else if (menu.state == UIState::SaveName) {
+        display.RenderNameEntry(menu);
+    } else if (menu.state == UIState::LoadBrowser) {
+        display.RenderPresetList(menu, preset_manager);
+    } else if (menu.state == UIState::SlotSelect) {
+        display.RenderSlotList(menu, preset_bank);
+    } else if (menu.state == UIState::ModuleSelect) {
+        display.RenderModuleList(menu, modules);
+    } else if (menu.IsInSubmenu() && menu.submenu_param_index >= 0) {
         display.RenderSubmenu(menu, params[menu.submenu_param_index]);
     } else {
-        display.RenderMenu(menu, params);
+        display.RenderMenu(menu, params, live_value_count > 0 ? live_values : nullptr);
     }
 }
 
@@ -180,40 +923,137 @@ int main(void) {
     hw.SetAudioBlockSize(24); // Plaits block size
     hw.SetAudioSampleRate(SaiHandle::Config::SampleRate::SAI_48KHZ);
     
-    // Initialize module
-    plaits_module.Init(48000.0f);
+    spectrum.Init(48000.0f);
+    cpu_meter.Init(hw.AudioSampleRate(), hw.AudioBlockSize());
     
-    // Initialize UI
-    menu.param_count = plaits_module.GetParameterCount();
-    display.Init(&hw);
+    prof_display_us = profiler.Register("display", "us");
+    prof_display_saved_ms = profiler.Register("display saved", "ms");
+    prof_display_skipped = profiler.Register("display skip", "frames");
+    prof_morph = profiler.Register("morph", "ticks");
+    prof_boot_audio = profiler.Register("boot to audio", "us");
+    prof_state_writes = profiler.Register("state writes", "writes");
+    prof_state_erases = profiler.Register("state erases", "erases");
+    prof_module_switch = profiler.Register("module switch", "us");
+    for (int r = 0; r < MemoryRegions::kCount; r++) {
+        prof_region_bytes[r] = profiler.Register(MemoryRegions::GetName(static_cast<MemoryRegion>(r)), "bytes");
+    }
+    prof_alloc_fails = profiler.Register("alloc fails", "allocs");
+    static const char* const slot_names[ModuleChain::kMaxModules] = {"slot 0", "slot 1", "slot 2", "slot 3"};
+    for (int m = 0; m < ModuleChain::kMaxModules; m++) {
+        prof_module_ticks[m] = profiler.Register(slot_names[m], "ticks");
+    }
     
-    // Show boot screen
-    display.RenderBootScreen("PLAITS");
-    System::Delay(2800);
+    // Build the module used last and everything the audio callback touches.
+    // Last state and preset slots are read in place from memory-mapped flash.
+    module_memory.Init(MemoryRegion::Dtcm, dtcm_memory, DTCM_ARENA_SIZE);
+    module_memory.Init(MemoryRegion::Sram, sram_memory, SRAM_ARENA_SIZE);
+    module_memory.Init(MemoryRegion::Sdram, sdram_memory, SDRAM_ARENA_SIZE);
+    modules.Init(MODULES, sizeof(MODULES) / sizeof(MODULES[0]), &module_memory,
+                 &chain, hw.AudioSampleRate(), hw.AudioBlockSize());
+    flash_writable = FlashWritesSafe();  // Read-only otherwise: no last state or slot writes
+    state_flash.Init(&hw.seed.qspi, STATE_FLASH_OFFSET, STATE_FLASH_SIZE);
+    preset_flash.Init(&hw.seed.qspi, PRESET_FLASH_OFFSET, PRESET_FLASH_SIZE);
+    if (!InstallModule(LastModuleIndex())) {
+        InstallModule(0);
+    }
+    BindModule();
     
-    // Start audio
+    // Start audio right away, the rest of the setup runs alongside it
     hw.StartAdc();
     hw.StartAudio(AudioCallback);
     hw.midi.StartReceive();
     
+    // Show boot screen until BOOT_SPLASH_MS or the first encoder input
+    display.Init(&hw);
+    display.RenderBootScreen(modules.GetName(modules.GetActiveIndex()));
+    boot_splash_start = System::GetNow();
+    
+#ifdef MUTABLES_PROFILE
+    hw.seed.StartLog(false);
+#endif
+    
+    // SD card, preset index read in the background
+    SdmmcHandler::Config sd_config;
+    sd_config.Defaults();
+    sdcard.Init(sd_config);
+    fsi.Init(FatFSInterface::Config::MEDIA_SD);
+    sd_fs.Init(&fsi.GetSDFileSystem());
+    preset_manager.Init(&sd_fs, active_module->GetShortName());
+    preset_manager.BeginLoadIndex();
+    
     // Main loop
-    uint32_t last_display_update = 0;
+    refresh.Init(System::GetNow());
+    uint32_t last_report = 0;
     while(1) {
         // Process MIDI
         hw.midi.Listen();
         ProcessMidi();
+        if (morph_cv_moved.exchange(false, std::memory_order_relaxed)) {
+            StartMorph();
+        }
         
         // Process hardware controls (encoder, gates, etc.) - run fast for encoder responsiveness
         hw.ProcessAllControls();
         
+        // Any encoder input ends the boot splash
+        uint32_t now = System::GetNow();
+        if (boot_splash
+            && (now - boot_splash_start >= BOOT_SPLASH_MS
+                || hw.encoder.Increment() != 0 || hw.encoder.Pressed())) {
+            boot_splash = false;
+            refresh.NotifyActivity(now);
+        }
+        
         // Update encoder state
         UpdateEncoder();
+        menu.undo_count = edit_history.GetUndoCount();
+        menu.redo_count = edit_history.GetRedoCount();
         
-        // Update display at ~60Hz
-        uint32_t now = System::GetNow();
-        if (now - last_display_update >= 16) {
-            last_display_update = now;
+        // SD card preset I/O, one short file system call per iteration
+        UpdatePresets(now);
+        
+        // Parameter state for the next power-up
+        UpdateLastState(now);
+        
+        // SysEx slot stores and paced dump output
+        UpdateSysex(now);
+        
+        // Update display: ~60Hz on activity, a few Hz when idle,
+        // not at all under heavy audio load
+        if (UpdateLiveValues()) {
+            refresh.NotifyActivity(now);
+        }
+        float audio_load = cpu_meter.GetAvgCpuLoad();
+        if (!boot_splash && refresh.ShouldRender(now, audio_load)) {
+            uint32_t start_us = System::GetUs();
             UpdateDisplay();
+            uint32_t cost_us = System::GetUs() - start_us;
+            refresh.OnRendered(now, cost_us);
+            profiler.Record(prof_display_us, cost_us);
+        }
+        
+        // Spectrum analysis in idle time, only in the first half of the
+        // active display period so a frame never delays the next render
+        if (menu.state == UIState::Spectrum
+            && now - refresh.GetLastRenderMs() < RefreshScheduler::kActiveIntervalMs / 2) {
+            uint32_t start_us = System::GetUs();
+            if (spectrum.Process(start_us, 1.0f - audio_load)) {
+                spectrum.ReportFrameCost(System::GetUs() - start_us);
+                refresh.NotifyActivity(now);
+            }
+        }
+        
+        // Report main-loop time saved by the adaptive refresh
+        if (now - last_report >= 5000) {
+            last_report = now;
+            profiler.Set(prof_display_saved_ms, refresh.GetSavedMs(now));
+            profiler.Set(prof_display_skipped, refresh.GetSkippedCount(now));
+            profiler.Set(prof_boot_audio, first_audio_us);
+            profiler.Set(prof_state_writes, state_store.GetWriteCount());
+            profiler.Set(prof_state_erases, state_store.GetEraseCount());
+#ifdef MUTABLES_PROFILE
+            profiler.Report([](const char* line) { hw.seed.PrintLine("%s", line); });
+#endif
         }
         
         // Minimal delay to prevent busy-wait
@@ -1,6 +1,8 @@
 #include "plaits_port.h"
 #include "../eurorack/plaits/dsp/voice.h"
 #include "../eurorack/stmlib/utils/buffer_allocator.h"
+#include <algorithm>
+#include <cstring>
 
 namespace mutables_plaits {
 
@@ -52,29 +54,36 @@ PlaitsPort::PlaitsPort()
     , patch_(nullptr)
     , modulations_(nullptr)
     , allocator_(nullptr)
+    , buffer_(nullptr)
     , current_bank_(0)
     , midi_note_(60.0f)
     , midi_gate_(false)
     , gate_state_(false)
     , previous_gate_(false)
+    , gate_fell_(false)
     , sample_rate_(48000.0f) {
 }
 
 PlaitsPort::~PlaitsPort() {
-    if (voice_) delete voice_;
-    if (patch_) delete patch_;
-    if (modulations_) delete modulations_;
-    if (allocator_) delete allocator_;
+    Destroy(voice_);
+    Destroy(patch_);
+    Destroy(modulations_);
+    Destroy(allocator_);
+    FreeBuffer(buffer_);
 }
 
 void PlaitsPort::Init(float sample_rate) {
     sample_rate_ = sample_rate;
     
-    // Allocate Plaits objects
-    voice_ = new plaits::Voice;
-    patch_ = new plaits::Patch;
-    modulations_ = new plaits::Modulations;
-    allocator_ = new stmlib::BufferAllocator(buffer_, kBufferSize);
+    // Allocate Plaits objects, the ones the DSP reads every block in DTCM
+    // when the module lives in the memory regions
+    voice_ = Create<plaits::Voice>(mutables_ui::MemoryRegion::Dtcm);
+    patch_ = Create<plaits::Patch>(mutables_ui::MemoryRegion::Dtcm);
+    modulations_ = Create<plaits::Modulations>(mutables_ui::MemoryRegion::Dtcm);
+    buffer_ = static_cast<uint8_t*>(AllocateBuffer(kBufferSize, mutables_ui::MemoryRegion::Dtcm));
+    allocator_ = Create<stmlib::BufferAllocator>();
+    if (!voice_ || !patch_ || !modulations_ || !buffer_ || !allocator_) return;  // Out of memory
+    allocator_->Init(buffer_, kBufferSize);
     
     // Initialize voice with buffer allocator
     voice_->Init(allocator_);
@@ -141,7 +150,9 @@ void PlaitsPort::UpdateEngineListForBank(int bank) {
     
     current_bank_ = bank;
     
-    // Reset engine selection to 0 when changing banks
+    // The engine number carries over to the new bank (clamped to its
+    // size), so a bank change is one undoable edit of the Bank parameter
+    mutables_ui::Parameter engine = params_[1];
     switch (bank) {
         case 0:  // Synth
             params_[1] = mutables_ui::Parameter("Engine", synth_engine_names_, kNumSynthEngines);
@@ -153,6 +164,9 @@ void PlaitsPort::UpdateEngineListForBank(int bank) {
             params_[1] = mutables_ui::Parameter("Engine", new_engine_names_, kNumNewEngines);
             break;
     }
+    params_[1].value = std::clamp(engine.value, params_[1].min, params_[1].max);
+    params_[1].modulation = engine.modulation;
+    params_[1].cv_mapping = engine.cv_mapping;
 }
 
 int PlaitsPort::GetActualEngineIndex(int bank, int engine_in_bank) {
@@ -179,13 +193,15 @@ void PlaitsPort::UpdatePatchFromParams() {
     int engine_in_bank = params_[1].GetIndex();
     patch_->engine = GetActualEngineIndex(bank, engine_in_bank);
     
+    // Continuous parameters with their CV modulation, which stays out of
+    // the parameter values the UI shows and presets store
     // MIDI note + transpose (0.5 = no transpose, 0.0 = -12, 1.0 = +12)
-    float transpose = (params_[5].value - 0.5f) * 24.0f;  // +-12 semitones
+    float transpose = (params_[5].GetEffective() - 0.5f) * 24.0f;  // +-12 semitones
     patch_->note = midi_note_ + transpose;
     
-    patch_->harmonics = params_[2].value;
-    patch_->timbre = params_[3].value;
-    patch_->morph = params_[4].value;
+    patch_->harmonics = params_[2].GetEffective();
+    patch_->timbre = params_[3].GetEffective();
+    patch_->morph = params_[4].GetEffective();
     
     // Modulation amounts (for internal envelope routing)
     patch_->frequency_modulation_amount = 0.0f;
@@ -193,12 +209,16 @@ void PlaitsPort::UpdatePatchFromParams() {
     patch_->morph_modulation_amount = 0.0f;
     
     // LPG parameters
-    patch_->lpg_colour = params_[6].value;
-    patch_->decay = params_[7].value;
+    patch_->lpg_colour = params_[6].GetEffective();
+    patch_->decay = params_[7].GetEffective();
 }
 
 void PlaitsPort::Process(float** in, float** out, size_t size) {
-    if (!voice_ || !patch_ || !modulations_) return;
+    if (!voice_ || !patch_ || !modulations_) {
+        memset(out[0], 0, size * sizeof(float));
+        memset(out[1], 0, size * sizeof(float));
+        return;
+    }
     
     UpdatePatchFromParams();
     
@@ -212,9 +232,14 @@ void PlaitsPort::Process(float** in, float** out, size_t size) {
         bool active_gate = midi_gate_ || gate_state_;
         
         // Set modulations - keep trigger high while gate is active
-        // Plaits does its own edge detection internally
-        modulations_->trigger = active_gate ? 1.0f : 0.0f;
-        modulations_->level = params_[8].value;
+        // Plaits does its own edge detection internally, once per render:
+        // a gate that fell and rose again since the last one is held low
+        // for this render so the next one triggers
+        bool trigger = active_gate && !(gate_fell_ && previous_gate_);
+        gate_fell_ = false;
+        previous_gate_ = trigger;
+        modulations_->trigger = trigger ? 1.0f : 0.0f;
+        modulations_->level = params_[8].GetEffective();
         modulations_->frequency_patched = false;
         modulations_->timbre_patched = false;
         modulations_->morph_patched = false;
@@ -232,18 +257,27 @@ void PlaitsPort::Process(float** in, float** out, size_t size) {
     }
 }
 
-mutables_ui::Parameter* PlaitsPort::GetParameters() {
-    return params_.data();
+size_t PlaitsPort::GetEffectiveValues(float* out, size_t max_count) {
+    size_t count = std::min(max_count, params_.size());
+    for (size_t i = 0; i < count; i++) {
+        out[i] = params_[i].value;
+    }
+    if (!patch_ || !modulations_ || count < kNumParams) return count;
+    
+    // Values as last handed to the voice
+    out[2] = patch_->harmonics;
+    out[3] = patch_->timbre;
+    out[4] = patch_->morph;
+    out[5] = (patch_->note - midi_note_) / 24.0f + 0.5f;
+    out[6] = patch_->lpg_colour;
+    out[7] = patch_->decay;
+    out[8] = modulations_->level;
+    return count;
 }
 
-size_t PlaitsPort::GetParameterCount() const {
-    return params_.size();
-}
-
-void PlaitsPort::ProcessGate(int gate_index, bool state) {
-    if (gate_index == 0) {
-        gate_state_ = state;
-    }
+void PlaitsPort::OnParametersLoaded() {
+    // Switch the engine list to the loaded bank, keeping the loaded engine
+    UpdateEngineListForBank(params_[0].GetIndex());
 }
 
 float PlaitsPort::GetCVOutput(int cv_index) {
@@ -251,6 +285,59 @@ float PlaitsPort::GetCVOutput(int cv_index) {
     return 0.0f;
 }
 
+void PlaitsPort::Process(const mutables_ui::EventList& events, float** in, float** out, size_t size) {
+    // Plaits advances its envelopes, LPG and trigger delay once per render,
+    // timed for full blocks, so renders stay kBlockSize long: notes and
+    // gates move to the nearest block boundary (at most half a block, 0.25
+    // ms, early or late) and split the block only there. The patch is read
+    // once per piece, so parameter changes apply at the start of the piece
+    // they fall in.
+    size_t done = 0;
+    size_t next = 0;
+    while (done < size) {
+        size_t end = size;
+        for (; next < events.GetCount(); next++) {
+            const mutables_ui::ModuleEvent& event = events[next];
+            size_t boundary = (event.time + kBlockSize / 2) / kBlockSize * kBlockSize;
+            if (boundary > done && event.type != mutables_ui::ModuleEvent::Type::SetParameter) {
+                end = std::min(boundary, size);
+                break;
+            }
+            HandleEvent(event);
+        }
+        float* piece[2] = {out[0] + done, out[1] + done};
+        Process(in, piece, end - done);
+        done = end;
+    }
+    for (; next < events.GetCount(); next++) {
+        HandleEvent(events[next]);
+    }
+}
+
+void PlaitsPort::HandleEvent(const mutables_ui::ModuleEvent& event) {
+    ModuleBase::HandleEvent(event);
+    // A bank written by an event (edit, undo, automation) switches the
+    // engine list before the engine is read
+    if (event.type == mutables_ui::ModuleEvent::Type::SetParameter && event.index == 0) {
+        OnParametersLoaded();
+    }
+}
+
+void PlaitsPort::ProcessMidi(daisy::MidiEvent& event) {
+    if (event.type == daisy::NoteOn) {
+        daisy::NoteOnEvent note = event.AsNoteOn();
+        if (note.velocity > 0) {
+            NoteOn(note.note, note.velocity);
+        } else {
+            // Note on with velocity 0 = note off
+            NoteOff(note.note, 0);
+        }
+    } else if (event.type == daisy::NoteOff) {
+        daisy::NoteOffEvent note = event.AsNoteOff();
+        NoteOff(note.note, note.velocity);
+    }
+}
+
 void PlaitsPort::NoteOn(uint8_t note, uint8_t velocity) {
     midi_note_ = static_cast<float>(note);
     midi_gate_ = true;
@@ -260,6 +347,7 @@ void PlaitsPort::NoteOff(uint8_t note, uint8_t velocity) {
     // Only release if it's the same note (monophonic)
     if (static_cast<uint8_t>(midi_note_) == note) {
         midi_gate_ = false;
+        if (!gate_state_) gate_fell_ = true;
     }
 }
 
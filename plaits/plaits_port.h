@@ -17,7 +17,9 @@ class BufferAllocator;
 
 namespace mutables_plaits {
 
-class PlaitsPort : public mutables_ui::ModuleBase {
+// final: calls on a PlaitsPort (ModuleHarness, host tools) resolve at
+// compile time
+class PlaitsPort final : public mutables_ui::ModuleBase {
 public:
     PlaitsPort();
     ~PlaitsPort() override;
@@ -28,10 +30,26 @@ public:
     
     void Init(float sample_rate) override;
     void Process(float** in, float** out, size_t size) override;
-    mutables_ui::Parameter* GetParameters() override;
-    size_t GetParameterCount() const override;
+    void Process(const mutables_ui::EventList& events, float** in, float** out, size_t size) override;
+    void HandleEvent(const mutables_ui::ModuleEvent& event) override;
+    mutables_ui::Parameter* GetParameters() override { return params_.data(); }
+    size_t GetParameterCount() const override { return params_.size(); }
+    size_t GetOutputCount() const override { return 2; }
+    const char* GetOutputName(size_t channel) const override {
+        return channel == 0 ? "out" : channel == 1 ? "aux" : "";
+    }
+    size_t GetEffectiveValues(float* out, size_t max_count) override;
     
-    void ProcessGate(int gate_index, bool state) override;
+    void OnParametersLoaded() override;
+    void ProcessMidi(daisy::MidiEvent& event) override;
+    void NoteOn(uint8_t note, uint8_t velocity) override;
+    void NoteOff(uint8_t note, uint8_t velocity) override;
+    void ProcessGate(int gate_index, bool state) override {
+        if (gate_index == 0) {
+            gate_state_ = state;
+            if (!state && !midi_gate_) gate_fell_ = true;
+        }
+    }
     float GetCVOutput(int cv_index) override;
     
 private:
@@ -44,7 +62,7 @@ private:
     // Buffers
     static constexpr size_t kBlockSize = 24;
     static constexpr size_t kBufferSize = 32768;  // Buffer for Plaits engines
-    uint8_t buffer_[kBufferSize];
+    uint8_t* buffer_;
     
     // Parameters
     static constexpr int kNumParams = 9;  // Added Bank parameter
@@ -68,18 +86,14 @@ private:
     
     // State
     bool gate_state_;
-    bool previous_gate_;   // For trigger detection
+    bool previous_gate_;   // Trigger handed to the last render
+    bool gate_fell_;       // Gate went low since the last render
     float sample_rate_;
     
     void UpdatePatchFromParams();
     void SetupParameters();
     void UpdateEngineListForBank(int bank);
     int GetActualEngineIndex(int bank, int engine_in_bank);
-    
-public:
-    // MIDI interface
-    void NoteOn(uint8_t note, uint8_t velocity);
-    void NoteOff(uint8_t note, uint8_t velocity);
 };
 
 } // namespace mutables_plaits